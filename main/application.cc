@@ -5,6 +5,7 @@
 #include "freertos/task.h"
 #include "lang.h"
 #include "system_info.h"
+#include "mcp_server.h"
 
 static const char* TAG = "Application";
 
@@ -33,20 +34,34 @@ void Application::Initialize() {
     audio_service_->Initialize();
 
     // ==================== 新架构核心组件初始化 ====================
-    // 初始化讯飞和豆包服务 (URL和KEY暂时为空，后续填充)
-    xunfei_service_ = std::make_unique<XunfeiSttService>("", "", ""); 
+    // 初始化讯飞和豆包服务 (豆包的KEY暂时为空，后续填充)
+    xunfei_service_ = std::make_unique<XunfeiSttService>(CONFIG_XUNFEI_STT_APP_ID, CONFIG_XUNFEI_STT_API_KEY,
+        CONFIG_XUNFEI_STT_API_SECRET, CONFIG_XUNFEI_STT_URL);
     doubao_service_ = std::make_unique<DoubaoApiService>("", "");
+    vision_service_ = std::make_unique<PrivateVisionService>();
+    vision_service_->Initialize(CONFIG_PRIVATE_VISION_URL, CONFIG_PRIVATE_VISION_API_KEY);
 
     // 初始化语音拍照助手
     assistant_ = std::make_unique<VoicePhotoAssistant>(
         *xunfei_service_, 
         *doubao_service_,
+        *vision_service_,
         std::bind(&Application::HandleAssistantStateChange, this, std::placeholders::_1)
     );
     // ==========================================================
 
-    // 设置唤醒词回调
-    audio_service_->SetWakeWordCallback(std::bind(&Application::HandleWakeWord, this));
+    // 唤醒词交给助手；聆听时编码好的音频和 VAD 状态直接交给语音识别，边说边上传
+    AudioServiceCallbacks callbacks;
+    callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+        HandleWakeWord();
+    };
+    callbacks.on_send_queue_available = [this]() {
+        xunfei_service_->OnAudioAvailable();
+    };
+    callbacks.on_vad_change = [this](bool speaking) {
+        xunfei_service_->OnVadChange(speaking);
+    };
+    audio_service_->SetCallbacks(callbacks);
     
     ESP_LOGI(TAG, "Application initialized.");
 }
@@ -76,6 +91,7 @@ void Application::SetState(DeviceState state) {
     if (current_state_ != state) {
         current_state_ = state;
         ESP_LOGI(TAG, "Device state changed to: %d", static_cast<int>(state));
+        McpServer::GetInstance().NotifyResourceChanged("device://state");
     }
 }
 
@@ -116,12 +132,25 @@ void Application::HandleSpeechResult(const std::string& text) {
 
 void Application::HandleAssistantStateChange(VoicePhotoAssistant::State state) {
     // 将助手的内部状态映射到全局设备状态
+    auto camera = Board::GetInstance().GetCamera();
     switch (state) {
         case VoicePhotoAssistant::State::kIdle:
+            if (camera != nullptr) {
+                camera->StopContinuousCapture();
+                camera->ReleaseExplain();
+            }
             SetState(kStateIdle);
             display_->SetStatus(Lang::Strings::IDLE);
             break;
         case VoicePhotoAssistant::State::kListening:
+            // 用户说话期间相机持续采集并连接识图服务器，说出拍照指令时照片和连接都已就绪
+            if (camera != nullptr) {
+                camera->StartContinuousCapture();
+                // 私有识图服务自己保持连接，只有走 Explain 时才需要提前连接
+                if (!vision_service_->IsConfigured()) {
+                    camera->PrepareExplain();
+                }
+            }
             SetState(kStateListening);
             display_->SetStatus(Lang::Strings::LISTENING);
             Alert("正在聆听", "请说出您的需求...", "neutral");
@@ -6,6 +6,7 @@
 #include "assistant/voice_photo_assistant.h" // 引入新的助手
 #include "services/xunfei_stt_service.h"      // 引入讯飞服务
 #include "services/doubao_api_service.h"    // 引入豆包服务
+#include "services/private_vision_service.h" // 引入私有识图服务
 #include <memory>
 #include <string>
 #include <functional>
@@ -56,6 +57,7 @@ private:
     // ==================== 新架构核心组件 ====================
     std::unique_ptr<XunfeiSttService> xunfei_service_;
     std::unique_ptr<DoubaoApiService> doubao_service_;
+    std::unique_ptr<PrivateVisionService> vision_service_;
     std::unique_ptr<VoicePhotoAssistant> assistant_;
     // ========================================================
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "intent_classifier.h"
+
+struct IntentKeyword {
+    std::string_view word;
+    float weight;
+};
+
+// 互相包含的词（"拍一张"和"拍"）会同时命中，权重按合并后的效果定
+static const IntentKeyword kPhotoKeywords[] = {
+    {"拍照", 0.9f},
+    {"拍一张", 0.8f},
+    {"拍张", 0.8f},
+    {"拍个", 0.6f},
+    {"照片", 0.6f},
+    {"相片", 0.6f},
+    {"拍", 0.3f},
+    {"看看这", 0.5f},
+    {"帮我看", 0.5f},
+    {"看一下", 0.3f},
+    {"这是什么", 0.5f},
+    {"识别", 0.4f},
+    {"镜头", 0.4f},
+    {"摄像头", 0.4f},
+    {"前面", 0.2f},
+    {"桌上", 0.2f},
+};
+
+static const std::string_view kNegations[] = {
+    "不要拍",
+    "别拍",
+    "不用拍",
+    "不拍",
+    "不想拍",
+    "取消",
+};
+
+float PhotoIntentConfidence(std::string_view text) {
+    for (auto negation : kNegations) {
+        if (text.find(negation) != std::string_view::npos) {
+            return 0.0f;
+        }
+    }
+    float miss = 1.0f;
+    for (auto& keyword : kPhotoKeywords) {
+        if (text.find(keyword.word) != std::string_view::npos) {
+            miss *= 1.0f - keyword.weight;
+        }
+    }
+    return 1.0f - miss;
+}
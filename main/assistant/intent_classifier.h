@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string_view>
+
+// 中间结果的拍照置信度达到这个值时提前拍照、连接识图服务
+#define PHOTO_SPECULATION_CONFIDENCE 0.8f
+
+/**
+ * @brief 本地的拍照意图估计，只看关键词，用在识别的中间结果上。
+ *
+ * 每个命中的关键词是一条独立的证据，置信度按 1 - Π(1 - 权重) 合并；出现"不要拍""别拍"等否定时为 0。
+ * 最终意图仍由 DoubaoApiService::DetectIntent 判断，这里只决定要不要提前准备。
+ * @return 0 到 1 之间的置信度。
+ */
+float PhotoIntentConfidence(std::string_view text);
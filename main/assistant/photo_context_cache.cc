@@ -0,0 +1,61 @@
+#include "photo_context_cache.h"
+#include "image_utils.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <iterator>
+
+static const char* TAG = "PhotoContextCache";
+
+PhotoContextCache::PhotoContextCache(size_t capacity, int ttl_ms, int max_distance)
+    : capacity_(capacity), ttl_us_((int64_t)ttl_ms * 1000), max_distance_(max_distance) {
+}
+
+void PhotoContextCache::RemoveExpired() {
+    int64_t now = esp_timer_get_time();
+    // 按时间顺序保存，过期的都在前面
+    while (!entries_.empty() && now - entries_.front().time_us > ttl_us_) {
+        entries_.pop_front();
+    }
+}
+
+void PhotoContextCache::Add(uint64_t hash, const std::string& analysis, const std::string& query, int64_t time_us) {
+    RemoveExpired();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (HashDistance(it->hash, hash) <= max_distance_) {
+            entries_.erase(it);
+            break;
+        }
+    }
+    if (entries_.size() >= capacity_) {
+        entries_.pop_front();
+    }
+    // 按拍摄时间排序，过期的都在前面；拍摄较早的照片识图较晚完成时插到前面
+    auto position = entries_.end();
+    while (position != entries_.begin() && std::prev(position)->time_us > time_us) {
+        --position;
+    }
+    entries_.insert(position, {hash, analysis, query, time_us});
+    ESP_LOGI(TAG, "Saved context %016llx, %u entries", hash, entries_.size());
+}
+
+const PhotoContext* PhotoContextCache::Find(uint64_t hash, int64_t time_us, int* distance) {
+    RemoveExpired();
+    const PhotoContext* best = nullptr;
+    int best_distance = max_distance_ + 1;
+    // 从新到旧查找，距离相同时取较新的结果
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+        if (it->time_us > time_us || time_us - it->time_us > ttl_us_) {
+            continue;
+        }
+        int d = HashDistance(it->hash, hash);
+        if (d < best_distance) {
+            best = &*it;
+            best_distance = d;
+        }
+    }
+    if (best != nullptr && distance != nullptr) {
+        *distance = best_distance;
+    }
+    return best;
+}
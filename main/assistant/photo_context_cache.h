@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// 保留最近几张照片的分析结果
+#define PHOTO_CONTEXT_CAPACITY 4
+// 超过这个时间的结果不再复用，场景可能已经变了
+#define PHOTO_CONTEXT_TTL_MS (2 * 60 * 1000)
+// 64 位 dHash 相差不超过这么多位视为同一场景
+#define PHOTO_CONTEXT_MAX_DISTANCE 6
+
+struct PhotoContext {
+    uint64_t hash;
+    std::string analysis;   // 识图服务返回的 JSON
+    std::string query;
+    int64_t time_us;        // 拍摄时间
+};
+
+/**
+ * @brief 最近照片的分析结果缓存，用感知哈希判断新照片是不是同一场景。
+ *
+ * 同一场景在有效期内再次提问时，不必重新上传和识图：问题相同直接复用分析结果，
+ * 问题不同则只把新问题连同已有的分析结果交给语言模型。
+ */
+class PhotoContextCache {
+public:
+    PhotoContextCache(size_t capacity = PHOTO_CONTEXT_CAPACITY, int ttl_ms = PHOTO_CONTEXT_TTL_MS,
+        int max_distance = PHOTO_CONTEXT_MAX_DISTANCE);
+
+    /**
+     * @brief 保存一张照片的分析结果，已满时丢弃最早的一条，同一场景的旧结果被替换。
+     * @param time_us 照片的拍摄时间，有效期从拍摄时算起，而不是识图完成时。
+     */
+    void Add(uint64_t hash, const std::string& analysis, const std::string& query, int64_t time_us);
+
+    /**
+     * @brief 查找与 hash 最接近且未过期的结果。
+     * @param time_us 新照片的拍摄时间。提前拍好的照片可能已经放了一会儿，结果要在它拍摄时仍然有效，
+     *        且不能晚于它（之后才拍的照片说明不了这一张）。
+     * @param distance 找到时设为两个哈希相差的位数。
+     * @return 没有匹配时返回 nullptr，指针在下一次 Add() 或 Clear() 之前有效。
+     */
+    const PhotoContext* Find(uint64_t hash, int64_t time_us, int* distance = nullptr);
+
+    void Clear() { entries_.clear(); }
+
+private:
+    size_t capacity_;
+    int64_t ttl_us_;
+    int max_distance_;
+    std::deque<PhotoContext> entries_;
+
+    void RemoveExpired();
+};
@@ -1,18 +1,26 @@
 #include "voice_photo_assistant.h"
 #include "application.h" // 引入Application头文件以访问全局服务
 #include "board.h"
+#include "display.h"
 #include "esp_log.h"
+#include <esp_timer.h>
+#include <cJSON.h>
+#include <algorithm>
 
 static const char* TAG = "VoicePhotoAssistant";
 
 VoicePhotoAssistant::VoicePhotoAssistant(
     XunfeiSttService& stt_service,
     DoubaoApiService& doubao_service,
+    PrivateVisionService& vision_service,
     std::function<void(State)> on_state_change)
     : current_state_(State::kIdle),
       stt_service_(stt_service),
       doubao_service_(doubao_service),
+      vision_service_(vision_service),
       state_change_callback_(on_state_change) {
+    speculation_event_ = xEventGroupCreate();
+    xEventGroupSetBits(speculation_event_, PHOTO_SPECULATION_IDLE_EVENT);
 }
 
 void VoicePhotoAssistant::SetState(State new_state) {
@@ -39,33 +47,152 @@ void VoicePhotoAssistant::StartListening() {
     app.GetAudioService().EnableVoiceProcessing(true);
     app.GetAudioService().EnableWakeWordDetection(false);
 
-    // 调用STT服务进行识别
-    stt_service_.Recognize([this](const std::string& text) {
-        // STT回调在新任务中执行，避免阻塞
-        xTaskCreate([](void* param) {
-            auto* assistant = static_cast<VoicePhotoAssistant*>(param);
-            std::string* speech_text = static_cast<std::string*>(assistant->user_speech_text_param);
-            assistant->ProcessUserSpeech(*speech_text);
-            delete speech_text;
+    {
+        std::lock_guard<std::mutex> lock(speculation_mutex_);
+        speculation_started_ = false;
+        speculation_captured_ = false;
+        speculation_busy_us_ = 0;
+    }
+
+    // 边说边把音频流给讯飞，中间结果实时显示，说完后很快拿到最终文本
+    bool started = stt_service_.Recognize(app.GetAudioService(), [this](const std::string& text) {
+        Application::GetInstance().SetChatMessage("user", text);
+        OnPartialSpeech(text);
+    }, [this](const std::string& text) {
+        // 最终结果在 STT 任务中回调，意图识别和拍照放到新任务中，不占用 STT 任务；
+        // 这个任务里要发 HTTPS 请求并解析 JSON，栈至少 8KB
+        auto param = new std::pair<VoicePhotoAssistant*, std::string>(this, text);
+        xTaskCreate([](void* arg) {
+            auto param = static_cast<std::pair<VoicePhotoAssistant*, std::string>*>(arg);
+            param->first->ProcessUserSpeech(param->second);
+            delete param;
             vTaskDelete(NULL);
-        }, "ProcessSpeechTask", 4096, new std::pair<VoicePhotoAssistant*, new std::string(text)>{this, new std::string(text)}, 5, NULL);
+        }, "ProcessSpeechTask", 4096 * 2, param, 5, NULL);
     });
+    if (!started) {
+        app.Alert("识别失败", "语音识别不可用", "sad");
+        app.GetAudioService().EnableVoiceProcessing(false);
+        SetState(State::kIdle);
+        app.GetAudioService().EnableWakeWordDetection(true);
+    }
+}
+
+
+void VoicePhotoAssistant::OnPartialSpeech(const std::string& text) {
+    {
+        std::lock_guard<std::mutex> lock(speculation_mutex_);
+        if (speculation_started_) {
+            return;
+        }
+        float confidence = PhotoIntentConfidence(text);
+        if (confidence < PHOTO_SPECULATION_CONFIDENCE) {
+            return;
+        }
+        ESP_LOGI(TAG, "Photo intent likely (%.2f) from \"%s\", capturing before the user finishes", confidence,
+            text.c_str());
+        speculation_started_ = true;
+        xEventGroupClearBits(speculation_event_, PHOTO_SPECULATION_IDLE_EVENT);
+    }
+    // 中间结果在 STT 的接收任务中回调，拍照放到新任务中；Prepare() 建立 TLS 连接，栈与 ProcessSpeechTask 相同
+    xTaskCreate([](void* arg) {
+        static_cast<VoicePhotoAssistant*>(arg)->SpeculatePhoto();
+        vTaskDelete(NULL);
+    }, "PhotoSpeculation", 4096 * 2, this, 5, NULL);
 }
 
+void VoicePhotoAssistant::SpeculatePhoto() {
+    int64_t start_time = esp_timer_get_time();
+    // 聆听期间相机已经在持续采集，Capture() 只是取出最近最清晰的一帧；识图服务趁用户还在说话时连上
+    auto camera = Board::GetInstance().GetCamera();
+    bool captured = camera != nullptr && camera->Capture();
+    if (captured && vision_service_.IsConfigured()) {
+        vision_service_.Prepare();
+    }
+    int64_t busy_us = esp_timer_get_time() - start_time;
+    ESP_LOGI(TAG, "Speculative capture %s in %lu ms", captured ? "ready" : "failed", (uint32_t)(busy_us / 1000));
+    {
+        std::lock_guard<std::mutex> lock(speculation_mutex_);
+        speculation_captured_ = captured;
+        speculation_busy_us_ = busy_us;
+        speculation_frame_time_us_ = esp_timer_get_time();
+    }
+    xEventGroupSetBits(speculation_event_, PHOTO_SPECULATION_IDLE_EVENT);
+}
+
+// 按最终意图收尾：拍照时返回提前拍好的照片能否直接使用，不是拍照时回滚
+bool VoicePhotoAssistant::FinishSpeculation(bool photo_intent) {
+    bool started;
+    {
+        std::lock_guard<std::mutex> lock(speculation_mutex_);
+        started = speculation_started_;
+        // 之后才到的中间结果不再触发
+        speculation_started_ = true;
+    }
+    if (photo_intent) {
+        speculation_stats_.photo_intents++;
+    }
+    if (!started) {
+        return false;
+    }
+
+    // 提前拍照还没完成时等它结束，相机和识图连接不能与后面的流程同时使用
+    int64_t start_time = esp_timer_get_time();
+    xEventGroupWaitBits(speculation_event_, PHOTO_SPECULATION_IDLE_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
+    int64_t waited_us = esp_timer_get_time() - start_time;
+    bool captured;
+    int64_t busy_us;
+    {
+        std::lock_guard<std::mutex> lock(speculation_mutex_);
+        captured = speculation_captured_;
+        busy_us = speculation_busy_us_;
+    }
+
+    if (!photo_intent) {
+        // 拍到的帧留在相机里，下次 Capture() 覆盖；识图连接保持着，下次拍照还能用。
+        // Capture() 已经把这一帧显示在预览上，用户没有要拍照，收起预览
+        if (captured) {
+            auto display = Board::GetInstance().GetDisplay();
+            if (display != nullptr) {
+                display->SetPreviewImage(nullptr);
+            }
+        }
+        speculation_stats_.rollbacks++;
+        speculation_stats_.wasted_us += busy_us;
+        ESP_LOGI(TAG, "Final intent is not a photo, dropping the speculative capture (%lu ms)",
+            (uint32_t)(busy_us / 1000));
+        return false;
+    }
+    if (captured) {
+        speculation_stats_.hits++;
+        speculation_stats_.saved_us += std::max<int64_t>(0, busy_us - waited_us);
+    }
+    return captured;
+}
 
 void VoicePhotoAssistant::ProcessUserSpeech(const std::string& text) {
+    auto& app = Application::GetInstance();
+    if (text.empty()) {
+        FinishSpeculation(false);
+        ESP_LOGI(TAG, "Nothing recognized, back to idle");
+        app.GetAudioService().EnableVoiceProcessing(false);
+        SetState(State::kIdle);
+        app.GetAudioService().EnableWakeWordDetection(true);
+        return;
+    }
     SetState(State::kThinking);
     
     std::string intent = doubao_service_.DetectIntent(text);
 
-    if (intent == "拍照") {
-        HandlePhotoIntent(text);
+    bool photo_intent = intent == "拍照";
+    bool frame_ready = FinishSpeculation(photo_intent);
+    if (photo_intent) {
+        HandlePhotoIntent(text, frame_ready);
     } else {
         HandleChatIntent(text);
     }
 }
 
-void VoicePhotoAssistant::HandlePhotoIntent(const std::string& query) {
+void VoicePhotoAssistant::HandlePhotoIntent(const std::string& query, bool frame_ready) {
     ESP_LOGI(TAG, "Handling photo intent: %s", query.c_str());
     auto& app = Application::GetInstance();
 
@@ -74,11 +201,16 @@ void VoicePhotoAssistant::HandlePhotoIntent(const std::string& query) {
     app.GetAudioService().EnableVoiceProcessing(false);
     app.GetAudioService().EnableWakeWordDetection(false);
 
-    SetState(State::kCapturingPhoto);
-    app.Alert("正在拍照", "请保持稳定...", "happy");
-    
+    int64_t start_time = esp_timer_get_time();
     auto camera = Board::GetInstance().GetCamera();
-    if (!camera || !camera->Capture()) {
+    if (frame_ready) {
+        // 用户说话时已经拍好
+        ESP_LOGI(TAG, "Using the frame captured while the user was speaking");
+    } else {
+        SetState(State::kCapturingPhoto);
+        app.Alert("正在拍照", "请保持稳定...", "happy");
+    }
+    if (!camera || (!frame_ready && !camera->Capture())) {
         app.Alert("拍照失败", "无法拍照，请重试", "sad");
         SetState(State::kIdle);
         // 恢复待机状态（只开启唤醒词）
@@ -86,20 +218,59 @@ void VoicePhotoAssistant::HandlePhotoIntent(const std::string& query) {
         return;
     }
     
+    int64_t captured_time = esp_timer_get_time();
+    // 提前拍好的照片在用户说完前就拍了，缓存的结果要按它真正的拍摄时间判断是否过期
+    int64_t frame_time = captured_time;
+    if (frame_ready) {
+        std::lock_guard<std::mutex> lock(speculation_mutex_);
+        frame_time = speculation_frame_time_us_;
+    }
+    
     SetState(State::kAnalyzingPhoto);
     app.Alert("正在分析", "请稍候...", "neutral");
     
-    // ================== 私有模型调用（模拟） ==================
-    ESP_LOGW(TAG, "MOCK: Calling private vision model...");
-    // 真实实现：camera->Explain(query) 会将图像上传到私有服务器
-    // std::string analysis_result = camera->Explain(query); 
-    vTaskDelay(pdMS_TO_TICKS(3000)); // 模拟网络和分析耗时
-    std::string analysis_result = "{\"description\":\"a cute cat is sitting on the table\"}";
-    ESP_LOGW(TAG, "MOCK: Private model result: %s", analysis_result.c_str());
-    // ==========================================================
+    // 有效期内拍过同一场景时复用那次的分析结果，不再上传识图
+    uint64_t frame_hash = 0;
+    bool has_hash = camera->GetFrameHash(frame_hash);
+    int distance = 0;
+    const PhotoContext* context = has_hash ? photo_context_.Find(frame_hash, frame_time, &distance) : nullptr;
+
+    std::string analysis_result;
+    std::unique_ptr<JpegSource> source;
+    if (context == nullptr && vision_service_.IsConfigured()) {
+        source = camera->GetJpegSource();
+    }
+    if (context != nullptr) {
+        // 问题相同直接复用；问题不同时只把新问题连同已有的分析交给语言模型
+        ESP_LOGI(TAG, "Same scene as %lu ms before this photo (distance %d), %s without a vision call",
+            (uint32_t)((frame_time - context->time_us) / 1000), distance,
+            context->query == query ? "reusing the analysis" : "asking a follow-up");
+        analysis_result = context->analysis;
+    } else if (source) {
+        // 图像边编码边上传到私有识图服务，回复到达一段显示一段
+        analysis_result = vision_service_.AnalyzeImage(*source, query, [&app](const std::string& text) {
+            app.SetChatMessage("system", text);
+        });
+        // source 引用着帧缓冲区，下次 Capture() 之前必须释放
+        source.reset();
+    } else {
+        // 聆听时已经连上识图服务器，编码和上传同时进行
+        analysis_result = camera->Explain(query);
+    }
+    ESP_LOGI(TAG, "Private model result: %s", analysis_result.c_str());
+    int64_t explained_time = esp_timer_get_time();
 
     SetState(State::kGeneratingResponse);
     std::string response = doubao_service_.GenerateResponseFromAnalysis(analysis_result, query);
+    int64_t generated_time = esp_timer_get_time();
+    ESP_LOGI(TAG, "Photo intent stages: capture %lu ms, explain %lu ms, response %lu ms, total %lu ms",
+        (uint32_t)((captured_time - start_time) / 1000), (uint32_t)((explained_time - captured_time) / 1000),
+        (uint32_t)((generated_time - explained_time) / 1000), (uint32_t)((generated_time - start_time) / 1000));
+    
+    const auto& stats = speculation_stats_;
+    ESP_LOGI(TAG, "Photo speculation: %d of %d photos ready early (%d%%), %d rollbacks, saved %lu ms, wasted %lu ms",
+        stats.hits, stats.photo_intents, stats.photo_intents > 0 ? stats.hits * 100 / stats.photo_intents : 0,
+        stats.rollbacks, (uint32_t)(stats.saved_us / 1000), (uint32_t)(stats.wasted_us / 1000));
     
     SetState(State::kSpeaking);
     app.Alert("分析结果", response.c_str(), "happy");
@@ -109,7 +280,10 @@ void VoicePhotoAssistant::HandlePhotoIntent(const std::string& query) {
     ESP_LOGI(TAG, "Photo intent finished. Resuming to idle state.");
     app.GetAudioService().EnableWakeWordDetection(true);
 
-    SavePhotoContext(analysis_result, query);
+    // 复用的结果不再保存，有效期从真正识图的那次算起
+    if (has_hash && context == nullptr) {
+        SavePhotoContext(frame_hash, analysis_result, query, frame_time);
+    }
 }
 
 void VoicePhotoAssistant::HandleChatIntent(const std::string& query) {
@@ -119,7 +293,19 @@ void VoicePhotoAssistant::HandleChatIntent(const std::string& query) {
     Application::GetInstance().GetAudioService().EnableWakeWordDetection(true);
 }
 
-void VoicePhotoAssistant::SavePhotoContext(const std::string& analysis_result, const std::string& query) {
-    // 上下文保存逻辑（待实现）
-    ESP_LOGI(TAG, "Saving photo context...");
+void VoicePhotoAssistant::SavePhotoContext(uint64_t frame_hash, const std::string& analysis_result, const std::string& query,
+    int64_t frame_time) {
+    // 失败的结果不保存，下次同一场景还要重新识图
+    auto root = cJSON_Parse(analysis_result.c_str());
+    if (root == nullptr) {
+        ESP_LOGW(TAG, "Analysis is not JSON, not saving photo context");
+        return;
+    }
+    auto success = cJSON_GetObjectItem(root, "success");
+    bool failed = cJSON_IsFalse(success);
+    cJSON_Delete(root);
+    if (failed) {
+        return;
+    }
+    photo_context_.Add(frame_hash, analysis_result, query, frame_time);
 }
\ No newline at end of file
@@ -2,8 +2,26 @@
 
 #include "services/xunfei_stt_service.h"
 #include "services/doubao_api_service.h"
+#include "services/private_vision_service.h"
+#include "assistant/photo_context_cache.h"
+#include "assistant/intent_classifier.h"
 #include <string>
 #include <functional>
+#include <mutex>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+// 提前拍照的任务结束（或没有开始）
+#define PHOTO_SPECULATION_IDLE_EVENT (1 << 0)
+
+// 说话时根据中间结果提前拍照的统计，每次拍照后打印
+struct PhotoSpeculationStats {
+    int photo_intents = 0;      // 最终意图是拍照的次数
+    int hits = 0;               // 其中已经提前拍好的
+    int rollbacks = 0;          // 提前拍了但最终意图不是拍照
+    int64_t saved_us = 0;       // 提前完成、不必在说完之后等待的时间
+    int64_t wasted_us = 0;      // 回滚的提前拍照花掉的时间
+};
 
 class VoicePhotoAssistant {
 public:
@@ -20,6 +38,7 @@ public:
     VoicePhotoAssistant(
         XunfeiSttService& stt_service,
         DoubaoApiService& doubao_service,
+        PrivateVisionService& vision_service,
         std::function<void(State)> on_state_change
     );
 
@@ -31,13 +50,27 @@ public:
 private:
     void SetState(State new_state);
     void StartListening();
+    void OnPartialSpeech(const std::string& text);
+    void SpeculatePhoto();
+    bool FinishSpeculation(bool photo_intent);
     void ProcessUserSpeech(const std::string& text);
-    void HandlePhotoIntent(const std::string& query);
+    void HandlePhotoIntent(const std::string& query, bool frame_ready);
     void HandleChatIntent(const std::string& query);
-    void SavePhotoContext(const std::string& analysis_result, const std::string& query);
+    void SavePhotoContext(uint64_t frame_hash, const std::string& analysis_result, const std::string& query, int64_t frame_time);
 
     State current_state_;
     XunfeiSttService& stt_service_;
     DoubaoApiService& doubao_service_;
+    PrivateVisionService& vision_service_;
     std::function<void(State)> state_change_callback_;
+    PhotoContextCache photo_context_;
+
+    // 中间结果判断为拍照时，在用户说完之前拍照并连接识图服务；最终意图不是拍照时丢弃
+    EventGroupHandle_t speculation_event_;
+    std::mutex speculation_mutex_;
+    bool speculation_started_ = false;
+    bool speculation_captured_ = false;
+    int64_t speculation_busy_us_ = 0;
+    int64_t speculation_frame_time_us_ = 0;
+    PhotoSpeculationStats speculation_stats_;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "audio_codec.h"
 #include "board.h"
 #include "settings.h"
+#include "mcp_server.h"
 
 #include <esp_log.h>
 #include <cstring>
@@ -53,6 +54,7 @@ void AudioCodec::SetOutputVolume(int volume) {
     
     Settings settings("audio", true);
     settings.SetInt("output_volume", output_volume_);
+    McpServer::GetInstance().NotifyResourceChanged("device://audio_speaker");
 }
 
 void AudioCodec::EnableInput(bool enable) {
@@ -1,5 +1,6 @@
 #include "backlight.h"
 #include "settings.h"
+#include "mcp_server.h"
 
 #include <esp_log.h>
 #include <driver/ledc.h>
@@ -78,6 +79,8 @@ void Backlight::OnTransitionTimer() {
 
     if (brightness_ == target_brightness_) {
         esp_timer_stop(transition_timer_);
+        // 渐变结束后再通知，订阅者只收到最终亮度；这里是 esp_timer 回调，读取和发送交给 MCP 的线程
+        McpServer::GetInstance().PostResourceChanged("device://screen");
     }
 }
 
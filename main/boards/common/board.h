@@ -50,6 +50,8 @@ public:
     virtual void SetPowerSaveMode(bool enabled) = 0;
     virtual std::string GetBoardJson() = 0;
     virtual std::string GetDeviceStatusJson() = 0;
+    // The "network" part of GetDeviceStatusJson() alone, for the device://network MCP resource
+    virtual std::string GetNetworkStatusJson() = 0;
 };
 
 #define DECLARE_BOARD(BOARD_CLASS_NAME) \
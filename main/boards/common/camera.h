@@ -2,14 +2,92 @@
 #define CAMERA_H
 
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <cstdlib>
+#include <algorithm>
+
+// How a photo is prepared before it leaves the device, set per server from the MCP vision
+// capability. Zero means no limit, the default uploads the frame as captured
+struct CameraUploadConfig {
+    int max_width = 0;
+    int max_height = 0;
+    bool crop = false;          // Center crop to the max_width:max_height aspect ratio first
+    bool grayscale = false;
+    int quality = 80;           // Starting JPEG quality
+    size_t max_bytes = 0;       // Lower the quality until the JPEG fits
+};
+
+struct JpegStreamStats;
+
+// The JPEG of a captured frame, handed out piece by piece so it never has to be copied whole
+class JpegSource {
+public:
+    virtual ~JpegSource() = default;
+    // Next piece, false at the end or on failure. data stays valid until the next call
+    virtual bool Next(const uint8_t*& data, size_t& len) = 0;
+    // Start again from the first byte for a retry, false if the JPEG cannot be produced again
+    virtual bool Rewind() { return false; }
+    virtual bool failed() const { return false; }
+    // Encoder and upload timings of a JPEG encoded while it is uploaded, final once Next() returned false
+    virtual const JpegStreamStats* stream_stats() const { return nullptr; }
+};
+
+// A JPEG already complete in memory, handed out in chunk_size pieces. owned, if set, is freed
+// with free() together with the source
+class BufferJpegSource : public JpegSource {
+public:
+    BufferJpegSource(const uint8_t* data, size_t len, void* owned, size_t chunk_size)
+        : data_(data), len_(len), owned_(owned), chunk_size_(chunk_size) {}
+    ~BufferJpegSource() { free(owned_); }
+
+    bool Next(const uint8_t*& data, size_t& len) override {
+        if (offset_ >= len_) {
+            return false;
+        }
+        data = data_ + offset_;
+        len = std::min(chunk_size_, len_ - offset_);
+        offset_ += len;
+        return true;
+    }
+
+    bool Rewind() override {
+        offset_ = 0;
+        return true;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t len_;
+    void* owned_;
+    size_t chunk_size_;
+    size_t offset_ = 0;
+};
 
 class Camera {
 public:
     virtual void SetExplainUrl(const std::string& url, const std::string& token) = 0;
+    virtual void SetUploadConfig(const CameraUploadConfig& config) {}
     virtual bool Capture() = 0;
     virtual bool SetHMirror(bool enabled) = 0;
     virtual bool SetVFlip(bool enabled) = 0;
     virtual std::string Explain(const std::string& question) = 0;
+    // JPEG of the last captured frame, for tools that hand the photo to the client themselves
+    virtual bool GetJpeg(int quality, std::vector<uint8_t>& jpeg) { return false; }
+    // Perceptual hash of the last captured frame, close hashes (see HashDistance) mean the same scene
+    virtual bool GetFrameHash(uint64_t& hash) { return false; }
+    // Streaming JPEG of the last captured frame, must be destroyed before the next Capture()
+    virtual std::unique_ptr<JpegSource> GetJpegSource() { return nullptr; }
+    // Keep grabbing frames in the background, the next Capture() picks the sharpest recent one
+    // instead of waiting for the sensor. Stopped by Capture() or StopContinuousCapture()
+    virtual void StartContinuousCapture() {}
+    virtual void StopContinuousCapture() {}
+    // Connect to the explain server ahead of Explain(), so the photo upload does not wait for
+    // the TCP/TLS handshake. ReleaseExplain() drops the connection when no photo follows
+    virtual void PrepareExplain() {}
+    virtual void ReleaseExplain() {}
 };
 
 #endif // CAMERA_H
@@ -91,3 +91,7 @@ std::string DualNetworkBoard::GetBoardJson() {
 std::string DualNetworkBoard::GetDeviceStatusJson() {
     return current_board_->GetDeviceStatusJson();
 }
+
+std::string DualNetworkBoard::GetNetworkStatusJson() {
+    return current_board_->GetNetworkStatusJson();
+}
@@ -8,6 +8,7 @@
 #include <esp_heap_caps.h>
 #include <img_converters.h>
 #include <cstring>
+#include <algorithm>
 #include <esp_timer.h>
 
 #define TAG "Esp32Camera"
@@ -50,9 +51,63 @@ bool detect_and_configure_camera(sensor_t* s) {
     return true;
 }
 
+// 带硬件 JPEG 编码器的传感器
+static bool sensor_has_jpeg(sensor_t* s) {
+    return s != nullptr && (s->id.PID == OV2640_PID || s->id.PID == OV3660_PID);
+}
+
+// 驱动为一帧分配的大小：JPEG 按约 1/5 压缩估算，其余按每像素字节数
+static size_t frame_buffer_size(const camera_config_t& config) {
+    size_t pixels = (size_t)resolution[config.frame_size].width * resolution[config.frame_size].height;
+    switch (config.pixel_format) {
+        case PIXFORMAT_JPEG:
+            return pixels / 5;
+        case PIXFORMAT_GRAYSCALE:
+            return pixels;
+        case PIXFORMAT_RGB888:
+            return pixels * 3;
+        default:
+            return pixels * 2;
+    }
+}
+
+// 连续采集需要额外的帧缓冲区，只在帧缓冲区放在 PSRAM 且按帧大小算下来放得下时才多分配
+static bool configure_frame_ring(camera_config_t& config) {
+    if (config.fb_location != CAMERA_FB_IN_PSRAM || config.fb_count >= CAMERA_FRAME_RING_SIZE + 1) {
+        return false;
+    }
+    size_t frame_size = frame_buffer_size(config);
+    size_t budget = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) * CAMERA_FRAME_RING_MAX_PSRAM_PERCENT / 100;
+    int extra = std::min<int>(CAMERA_FRAME_RING_SIZE + 1 - config.fb_count, budget / frame_size);
+    if (extra <= 0) {
+        ESP_LOGI(TAG, "Not enough PSRAM for continuous capture, %u bytes per frame", frame_size);
+        return false;
+    }
+    config.fb_count += extra;
+    config.grab_mode = CAMERA_GRAB_LATEST;
+    return true;
+}
+
 Esp32Camera::Esp32Camera(const camera_config_t& config) {
     // 尝试多种初始化策略
     bool camera_init_success = false;
+    camera_config_t active_config = config;
+
+    // 先按板子的配置加上连续采集的帧缓冲区试一次，失败再走原来的降级流程，不为此降低时钟
+    camera_config_t ring_config = config;
+    if (configure_frame_ring(ring_config)) {
+        esp_err_t err = esp_camera_init(&ring_config);
+        if (err == ESP_OK && detect_and_configure_camera(esp_camera_sensor_get())) {
+            camera_init_success = true;
+            active_config = ring_config;
+            ESP_LOGI(TAG, "Camera initialized with %d frame buffers for continuous capture", (int)ring_config.fb_count);
+        } else {
+            ESP_LOGW(TAG, "Camera init with %d frame buffers failed, using the board config", (int)ring_config.fb_count);
+            if (err == ESP_OK) {
+                esp_camera_deinit();
+            }
+        }
+    }
     
     for (int attempt = 0; attempt < 3 && !camera_init_success; attempt++) {
         ESP_LOGI(TAG, "Camera initialization attempt %d/3", attempt + 1);
@@ -83,6 +138,7 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
         sensor_t *s = esp_camera_sensor_get();
         if (detect_and_configure_camera(s)) {
             camera_init_success = true;
+            active_config = adjusted_config;
             ESP_LOGI(TAG, "Camera initialized successfully on attempt %d", attempt + 1);
         } else {
             // 传感器配置失败，释放资源并重试
@@ -95,6 +151,33 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
         ESP_LOGE(TAG, "All camera initialization attempts failed");
         return;
     }
+
+#if CAMERA_USE_HW_JPEG
+    // 传感器自带 JPEG 编码时改用 JPEG 输出，上传不再需要软件编码；GC0308 等仍使用 RGB565
+    if (active_config.pixel_format != PIXFORMAT_JPEG && sensor_has_jpeg(esp_camera_sensor_get())) {
+        camera_config_t jpeg_config = active_config;
+        jpeg_config.pixel_format = PIXFORMAT_JPEG;
+        esp_camera_deinit();
+        if (esp_camera_init(&jpeg_config) == ESP_OK && detect_and_configure_camera(esp_camera_sensor_get())) {
+            ESP_LOGI(TAG, "Using hardware JPEG");
+            active_config = jpeg_config;
+        } else {
+            ESP_LOGW(TAG, "Hardware JPEG init failed, falling back to pixel format %d", active_config.pixel_format);
+            esp_camera_deinit();
+            if (esp_camera_init(&active_config) != ESP_OK) {
+                ESP_LOGE(TAG, "Camera re-initialization failed");
+                return;
+            }
+            detect_and_configure_camera(esp_camera_sensor_get());
+        }
+    }
+#endif
+
+    // 驱动至少要留一个帧缓冲区继续采集；板子自己配了多个帧缓冲区但不是 GRAB_LATEST 时，
+    // 驱动只按顺序交出旧帧，保留下来也没有意义
+    if (active_config.grab_mode == CAMERA_GRAB_LATEST) {
+        ring_capacity_ = std::min((int)active_config.fb_count - 1, CAMERA_FRAME_RING_SIZE);
+    }
     
     // 初始化预览图片的内存
     memset(&preview_image_, 0, sizeof(preview_image_));
@@ -102,44 +185,14 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
     preview_image_.header.cf = LV_COLOR_FORMAT_RGB565;
     preview_image_.header.flags = LV_IMAGE_FLAGS_ALLOCATED | LV_IMAGE_FLAGS_MODIFIABLE;
 
-    switch (config.frame_size) {
-        case FRAMESIZE_SVGA:
-            preview_image_.header.w = 800;
-            preview_image_.header.h = 600;
-            break;
-        case FRAMESIZE_VGA:
-            preview_image_.header.w = 640;
-            preview_image_.header.h = 480;
-            break;
-        case FRAMESIZE_QVGA:
-            preview_image_.header.w = 320;
-            preview_image_.header.h = 240;
-            break;
-        case FRAMESIZE_128X128:
-            preview_image_.header.w = 128;
-            preview_image_.header.h = 128;
-            break;
-        case FRAMESIZE_240X240:
-            preview_image_.header.w = 240;
-            preview_image_.header.h = 240;
-            break;
-        default:
-            ESP_LOGE(TAG, "Unsupported frame size: %d, image preview will not be shown", config.frame_size);
-            preview_image_.data_size = 0;
-            preview_image_.data = nullptr;
-            return;
-    }
-
-    preview_image_.header.stride = preview_image_.header.w * 2;
-    preview_image_.data_size = preview_image_.header.w * preview_image_.header.h * 2;
-    preview_image_.data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM);
-    if (preview_image_.data == nullptr) {
-        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-        return;
-    }
+    // 预览尺寸取决于屏幕和帧大小，第一次预览时再分配
+    preview_image_.data_size = 0;
+    preview_image_.data = nullptr;
 }
 
 Esp32Camera::~Esp32Camera() {
+    StopContinuousCapture();
+    ReleaseExplain();
     if (fb_) {
         esp_camera_fb_return(fb_);
         fb_ = nullptr;
@@ -148,6 +201,7 @@ Esp32Camera::~Esp32Camera() {
         heap_caps_free((void*)preview_image_.data);
         preview_image_.data = nullptr;
     }
+    heap_caps_free(preview_decode_);
     esp_camera_deinit();
 }
 
@@ -157,9 +211,10 @@ void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token
 }
 
 bool Esp32Camera::Capture() {
-    // 等待上一个编码线程完成
-    if (encoder_thread_.joinable()) {
-        encoder_thread_.join();
+    // 连续采集中已有现成的帧，直接取最清晰的一帧
+    if (TakeSharpestFrame()) {
+        UpdatePreview();
+        return true;
     }
     
     // 检查相机传感器可用性
@@ -228,24 +283,249 @@ bool Esp32Camera::Capture() {
         ESP_LOGE(TAG, "Camera capture failed after multiple attempts");
         return false;
     }
-    
-    // 处理预览图像
-    if (preview_image_.data_size > 0 && preview_image_.data != nullptr) {
-        auto display = Board::GetInstance().GetDisplay();
-        if (display != nullptr) {
-            auto src = (uint16_t*)fb_->buf;
-            auto dst = (uint16_t*)preview_image_.data;
-            size_t pixel_count = fb_->len / 2;
-            for (size_t i = 0; i < pixel_count; i++) {
-                // 交换每个16位字内的字节
-                dst[i] = __builtin_bswap16(src[i]);
+
+    UpdatePreview();
+    return true;
+}
+
+// LcdDisplay 以屏幕一半的宽度显示预览，预览图正好是这个尺寸时 LVGL 不需要每次重绘都缩放
+bool Esp32Camera::PreparePreview(int frame_width, int frame_height) {
+    auto display = Board::GetInstance().GetDisplay();
+    if (display == nullptr || display->width() <= 0 || display->height() <= 0) {
+        return false;
+    }
+    bool swapped = preview_rotation_ == kImageRotate90 || preview_rotation_ == kImageRotate270;
+    int rotated_width = swapped ? frame_height : frame_width;
+    int rotated_height = swapped ? frame_width : frame_height;
+    int width = std::max(display->width() / 2, 1);
+    int height = std::max(rotated_height * width / rotated_width, 1);
+    if (height > display->height()) {
+        height = display->height();
+        width = std::max(rotated_width * height / rotated_height, 1);
+    }
+    if (preview_image_.data != nullptr && preview_image_.header.w == width && preview_image_.header.h == height) {
+        return true;
+    }
+
+    if (preview_image_.data != nullptr) {
+        // 屏幕可能还引用着旧的预览图
+        display->SetPreviewImage(nullptr);
+        heap_caps_free((void*)preview_image_.data);
+        preview_image_.data = nullptr;
+        preview_image_.data_size = 0;
+    }
+    size_t data_size = width * height * 2;
+    auto data = (uint8_t*)heap_caps_malloc(data_size, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+        return false;
+    }
+    preview_image_.header.w = width;
+    preview_image_.header.h = height;
+    preview_image_.header.stride = width * 2;
+    preview_image_.data_size = data_size;
+    preview_image_.data = data;
+    ESP_LOGI(TAG, "Preview %dx%d for %dx%d frames", width, height, frame_width, frame_height);
+    return true;
+}
+
+void Esp32Camera::UpdatePreview() {
+    auto display = Board::GetInstance().GetDisplay();
+    if (display == nullptr) {
+        return;
+    }
+
+    // 硬件 JPEG 先按 2 的幂缩小解码，解码尺寸仍不小于预览，再和 RGB565 帧一样缩放
+    const uint8_t* src = fb_->buf;
+    int src_width = fb_->width;
+    int src_height = fb_->height;
+    if (fb_->format == PIXFORMAT_JPEG) {
+        if (!PreparePreview(src_width, src_height)) {
+            return;
+        }
+        bool swapped = preview_rotation_ == kImageRotate90 || preview_rotation_ == kImageRotate270;
+        int needed_width = swapped ? preview_image_.header.h : preview_image_.header.w;
+        int needed_height = swapped ? preview_image_.header.w : preview_image_.header.h;
+        int scale = 0;
+        while (scale < JPG_SCALE_8X && (src_width >> (scale + 1)) >= needed_width && (src_height >> (scale + 1)) >= needed_height) {
+            scale++;
+        }
+        src_width >>= scale;
+        src_height >>= scale;
+        size_t decode_size = src_width * src_height * 2;
+        if (preview_decode_size_ < decode_size) {
+            heap_caps_free(preview_decode_);
+            preview_decode_ = (uint8_t*)heap_caps_malloc(decode_size, MALLOC_CAP_SPIRAM);
+            preview_decode_size_ = preview_decode_ != nullptr ? decode_size : 0;
+        }
+        if (preview_decode_ == nullptr || !jpg2rgb565(fb_->buf, fb_->len, preview_decode_, (jpg_scale_t)scale)) {
+            ESP_LOGW(TAG, "Failed to decode JPEG preview");
+            return;
+        }
+        src = preview_decode_;
+    } else if (fb_->format != PIXFORMAT_RGB565) {
+        ESP_LOGW(TAG, "Skip preview of pixel format %d", fb_->format);
+        return;
+    } else if (!PreparePreview(src_width, src_height)) {
+        return;
+    }
+
+    // 缩放、旋转和字节交换一次完成，直接写入预览图
+    int width = preview_image_.header.w;
+    int height = preview_image_.header.h;
+    auto dst = (uint16_t*)preview_image_.data;
+    if (preview_rotation_ == kImageRotate0 && width == src_width && height == src_height) {
+        Rgb565SwapBytes(src, (uint8_t*)dst, width * height);
+    } else if (src_width * src_height >= width * height * 4) {
+        // 缩小到一半以下时双线性插值看不出区别
+        Rgb565ScaleNearest(src, src_width, src_height, dst, width, height, preview_rotation_);
+    } else {
+        Rgb565ScaleBilinear(src, src_width, src_height, dst, width, height, preview_rotation_);
+    }
+    display->SetPreviewImage(&preview_image_);
+}
+
+void Esp32Camera::StartContinuousCapture() {
+    std::lock_guard<std::mutex> control_lock(ring_control_mutex_);
+    if (ring_capacity_ <= 0 || ring_running_) {
+        return;
+    }
+    // 上一张照片占着一个帧缓冲区时少保留一帧
+    int capacity = ring_capacity_ - (fb_ != nullptr ? 1 : 0);
+    if (capacity <= 0) {
+        return;
+    }
+    ring_running_ = true;
+    ring_thread_ = std::thread([this, capacity]() {
+        RingLoop(capacity);
+    });
+    ESP_LOGI(TAG, "Continuous capture started, keeping %d frames", capacity);
+}
+
+void Esp32Camera::StopContinuousCapture() {
+    std::lock_guard<std::mutex> control_lock(ring_control_mutex_);
+    ring_running_ = false;
+    if (ring_thread_.joinable()) {
+        ring_thread_.join();
+    }
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    for (auto fb : ring_) {
+        esp_camera_fb_return(fb);
+    }
+    ring_.clear();
+}
+
+// 只保留帧不做计算，清晰度在拍照时才对留下的几帧计算一次
+void Esp32Camera::RingLoop(int capacity) {
+    while (ring_running_) {
+        // 先归还最旧的一帧，驱动才有空闲的帧缓冲区
+        camera_fb_t* oldest = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(ring_mutex_);
+            if ((int)ring_.size() >= capacity) {
+                oldest = ring_.front();
+                ring_.pop_front();
             }
-            display->SetPreviewImage(&preview_image_);
         }
+        if (oldest != nullptr) {
+            esp_camera_fb_return(oldest);
+        }
+
+        camera_fb_t* fb = esp_camera_fb_get();
+        if (fb == nullptr) {
+            vTaskDelay(pdMS_TO_TICKS(20));
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(ring_mutex_);
+            ring_.push_back(fb);
+        }
+        vTaskDelay(pdMS_TO_TICKS(CAMERA_FRAME_RING_INTERVAL_MS));
+    }
+}
+
+// 帧的小尺寸亮度图，放在 focus_buffer_ 开头，清晰度和场景哈希都在它上面计算
+bool Esp32Camera::FrameLuma(camera_fb_t* fb, int& width, int& height) {
+    width = fb->width;
+    height = fb->height;
+    if (fb->format == PIXFORMAT_JPEG) {
+        // JPEG 按 1/2 到 1/8 缩小解码，缩得越小解码越快
+        jpg_scale_t scale = JPG_SCALE_NONE;
+        while (width > CAMERA_FOCUS_MAX_WIDTH && scale < JPG_SCALE_8X) {
+            width /= 2;
+            height /= 2;
+            scale = (jpg_scale_t)(scale + 1);
+        }
+        focus_buffer_.resize(width * height * 3);
+        uint8_t* rgb565 = focus_buffer_.data() + width * height;
+        if (!jpg2rgb565(fb->buf, fb->len, rgb565, scale)) {
+            return false;
+        }
+        Rgb565ToLuma(rgb565, width, height, 1, focus_buffer_.data());
+    } else if (fb->format == PIXFORMAT_RGB565) {
+        int step = (width + CAMERA_FOCUS_MAX_WIDTH - 1) / CAMERA_FOCUS_MAX_WIDTH;
+        width /= step;
+        height /= step;
+        focus_buffer_.resize(width * height);
+        Rgb565ToLuma(fb->buf, fb->width, fb->height, step, focus_buffer_.data());
     } else {
-        ESP_LOGW(TAG, "Skip preview because of unsupported frame size or uninitialized data");
+        return false;
     }
-    
+    return true;
+}
+
+uint32_t Esp32Camera::MeasureSharpness(camera_fb_t* fb) {
+    int width, height;
+    if (!FrameLuma(fb, width, height)) {
+        return 0;
+    }
+    return LaplacianVariance(focus_buffer_.data(), width, height);
+}
+
+bool Esp32Camera::GetFrameHash(uint64_t& hash) {
+    // 连续采集中 fb_ 还是上一张照片；focus_buffer_ 与 TakeSharpestFrame() 共用
+    std::lock_guard<std::mutex> control_lock(ring_control_mutex_);
+    int width, height;
+    if (fb_ == nullptr || ring_running_ || !FrameLuma(fb_, width, height)) {
+        return false;
+    }
+    hash = LumaDifferenceHash(focus_buffer_.data(), width, height);
+    return true;
+}
+
+bool Esp32Camera::TakeSharpestFrame() {
+    std::lock_guard<std::mutex> control_lock(ring_control_mutex_);
+    if (!ring_running_) {
+        return false;
+    }
+    // 停止采集线程，挑出最清晰的一帧留作 fb_，其余归还驱动
+    ring_running_ = false;
+    ring_thread_.join();
+
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    if (ring_.empty()) {
+        return false;
+    }
+    camera_fb_t* best = nullptr;
+    uint32_t best_sharpness = 0;
+    for (auto fb : ring_) {
+        uint32_t sharpness = MeasureSharpness(fb);
+        if (best == nullptr || sharpness > best_sharpness) {
+            best = fb;
+            best_sharpness = sharpness;
+        }
+    }
+    if (fb_ != nullptr) {
+        esp_camera_fb_return(fb_);
+    }
+    fb_ = best;
+    ESP_LOGI(TAG, "Picked frame with sharpness %lu from %u frames", best_sharpness, ring_.size());
+    for (auto fb : ring_) {
+        if (fb != fb_) {
+            esp_camera_fb_return(fb);
+        }
+    }
+    ring_.clear();
     return true;
 }
 
@@ -283,88 +563,281 @@ bool Esp32Camera::SetVFlip(bool enabled) {
     return true;
 }
 
-std::string Esp32Camera::Explain(const std::string& question) {
-    // 检查相机状态并尝试捕获
+void Esp32Camera::SetUploadConfig(const CameraUploadConfig& config) {
+    upload_config_ = config;
+    upload_quality_ = config.quality;
+    ESP_LOGI(TAG, "Upload config: max %dx%d, crop=%d, grayscale=%d, quality=%d, max bytes=%u",
+        config.max_width, config.max_height, config.crop, config.grayscale, config.quality, config.max_bytes);
+}
+
+bool Esp32Camera::NeedsPreprocess() const {
     if (fb_ == nullptr) {
-        ESP_LOGW(TAG, "No camera frame available, attempting to capture");
-        if (!Capture()) {
-            return "{\"success\": false, \"message\": \"Failed to capture image from camera\"}";
+        return false;
+    }
+    if (upload_config_.grayscale || upload_config_.max_bytes > 0) {
+        return true;
+    }
+    auto plan = PlanImageResize(fb_->width, fb_->height, upload_config_.max_width, upload_config_.max_height,
+        upload_config_.crop);
+    return plan.resizes(fb_->width, fb_->height);
+}
+
+// 裁剪、缩小、灰度化后重新编码，输出由 fmt2jpg 分配，调用者用 free() 释放
+bool Esp32Camera::Preprocess(uint8_t** jpeg, size_t* jpeg_len) {
+    int64_t start_time = esp_timer_get_time();
+    int width = fb_->width;
+    int height = fb_->height;
+    const auto& config = upload_config_;
+
+    auto plan = PlanImageResize(width, height, config.max_width, config.max_height, config.crop);
+    int out_width = plan.out_width;
+    int out_height = plan.out_height;
+
+    // RGB565 源图；硬件 JPEG 先按 2 的幂缩小解码，解码后仍不小于输出尺寸
+    const uint8_t* src = fb_->buf;
+    uint8_t* decoded = nullptr;
+    if (fb_->format == PIXFORMAT_JPEG) {
+        int scale = PlanJpegDecodeScale(plan);
+        width >>= scale;
+        height >>= scale;
+        ScaleImageResizePlan(plan, scale, width, height);
+        decoded = (uint8_t*)heap_caps_malloc(width * height * 2, MALLOC_CAP_SPIRAM);
+        if (decoded == nullptr || !jpg2rgb565(fb_->buf, fb_->len, decoded, (jpg_scale_t)scale)) {
+            ESP_LOGE(TAG, "Failed to decode JPEG for preprocessing");
+            heap_caps_free(decoded);
+            return false;
         }
+        src = decoded;
+    } else if (fb_->format != PIXFORMAT_RGB565) {
+        ESP_LOGW(TAG, "Preprocessing does not support pixel format %d", fb_->format);
+        return false;
     }
-    
-    if (explain_url_.empty()) {
-        return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
+
+    uint8_t* scaled = (uint8_t*)heap_caps_malloc(out_width * out_height * 2, MALLOC_CAP_SPIRAM);
+    if (scaled == nullptr) {
+        heap_caps_free(decoded);
+        return false;
     }
+    Rgb565DownscaleArea(src, width, plan.crop_x, plan.crop_y, plan.crop_width, plan.crop_height,
+        scaled, out_width, out_height);
+    heap_caps_free(decoded);
 
-    // 创建局部的 JPEG 队列
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
-        ESP_LOGE(TAG, "Failed to create JPEG queue");
-        return "{\"success\": false, \"message\": \"Failed to create JPEG queue\"}";
+    // 灰度图只编码一个分量，原地转换
+    pixformat_t format = PIXFORMAT_RGB565;
+    size_t scaled_len = out_width * out_height * 2;
+    if (config.grayscale) {
+        Rgb565ToLuma(scaled, out_width, out_height, 1, scaled);
+        format = PIXFORMAT_GRAYSCALE;
+        scaled_len = out_width * out_height;
     }
 
-    // 在独立线程中编码图像为JPEG
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
-        // 确保fb_有效
-        if (fb_ == nullptr) {
-            ESP_LOGE(TAG, "Frame buffer is null in encoder thread");
-            JpegChunk end_marker = {.data = nullptr, .len = 0};
-            xQueueSend(jpeg_queue, &end_marker, portMAX_DELAY);
-            return;
+    // 超过目标大小时按比例降低质量重新编码，最后的质量留给下一张照片作起点
+    int quality = upload_quality_ > 0 ? upload_quality_ : config.quality;
+    bool ok = false;
+    for (int attempt = 0; attempt < 3; attempt++) {
+        ok = fmt2jpg(scaled, scaled_len, out_width, out_height, format, quality, jpeg, jpeg_len);
+        if (!ok || config.max_bytes == 0 || *jpeg_len <= config.max_bytes || quality <= IMAGE_MIN_JPEG_QUALITY) {
+            break;
         }
-        
-        // 将帧缓冲区转换为JPEG
-        frame2jpg_cb(fb_, 80, [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
-            auto jpeg_queue = (QueueHandle_t)arg;
-            if (data == nullptr || len == 0) {
-                return 0;
-            }
-            
-            // 分配内存存储JPEG块
-            JpegChunk chunk;
-            chunk.data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM);
-            if (chunk.data == nullptr) {
-                ESP_LOGE(TAG, "Failed to allocate memory for JPEG chunk");
-                return 0;
-            }
-            
-            chunk.len = len;
-            memcpy(chunk.data, data, len);
-            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
-            return len;
-        }, jpeg_queue);
-        
-        // 发送结束标记
-        JpegChunk end_marker = {.data = nullptr, .len = 0};
-        xQueueSend(jpeg_queue, &end_marker, portMAX_DELAY);
+        if (attempt < 2) {
+            free(*jpeg);
+            *jpeg = nullptr;
+            quality = ReduceJpegQuality(quality, *jpeg_len, config.max_bytes);
+        }
+    }
+    heap_caps_free(scaled);
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to encode preprocessed JPEG");
+        return false;
+    }
+    upload_quality_ = NextJpegQuality(quality, *jpeg_len, config.max_bytes, config.quality);
+
+    ESP_LOGI(TAG, "Preprocessed %dx%d -> %dx%d%s, JPEG %u bytes at quality %d in %lu ms",
+        fb_->width, fb_->height, out_width, out_height, config.grayscale ? " gray" : "",
+        *jpeg_len, quality, (uint32_t)((esp_timer_get_time() - start_time) / 1000));
+    return true;
+}
+
+bool Esp32Camera::GetJpeg(int quality, std::vector<uint8_t>& jpeg) {
+    if (fb_ == nullptr) {
+        return false;
+    }
+    if (NeedsPreprocess()) {
+        uint8_t* data = nullptr;
+        size_t len = 0;
+        if (Preprocess(&data, &len)) {
+            jpeg.assign(data, data + len);
+            free(data);
+            return true;
+        }
+    }
+    if (fb_->format == PIXFORMAT_JPEG) {
+        jpeg.assign(fb_->buf, fb_->buf + fb_->len);
+        return true;
+    }
+
+    // 编码器分块输出，直接追加到 jpeg 中
+    jpeg.clear();
+    bool ok = frame2jpg_cb(fb_, quality, [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
+        auto jpeg = (std::vector<uint8_t>*)arg;
+        if (data != nullptr) {
+            jpeg->insert(jpeg->end(), (const uint8_t*)data, (const uint8_t*)data + len);
+        }
+        return len;
+    }, &jpeg);
+    if (!ok || jpeg.empty()) {
+        ESP_LOGE(TAG, "Failed to encode JPEG");
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<JpegSource> Esp32Camera::GetJpegSource() {
+    if (fb_ == nullptr) {
+        return nullptr;
+    }
+    if (NeedsPreprocess()) {
+        uint8_t* data = nullptr;
+        size_t len = 0;
+        if (Preprocess(&data, &len)) {
+            return std::make_unique<BufferJpegSource>(data, len, data, JPEG_STREAM_CHUNK_SIZE);
+        }
+        ESP_LOGW(TAG, "Preprocessing failed, using the original frame");
+    }
+    if (fb_->format == PIXFORMAT_JPEG) {
+        return std::make_unique<BufferJpegSource>(fb_->buf, fb_->len, nullptr, JPEG_STREAM_CHUNK_SIZE);
+    }
+    if (jpeg_stream_ == nullptr) {
+        jpeg_stream_ = std::make_unique<JpegStream>();
+    }
+    if (!jpeg_stream_->valid()) {
+        return nullptr;
+    }
+    // 软件编码：编码线程经块池边编码边交出，重试时重新编码
+    camera_fb_t* fb = fb_;
+    int quality = upload_config_.quality;
+    return std::make_unique<StreamJpegSource>(*jpeg_stream_, [fb, quality](JpegStream& stream) {
+        return frame2jpg_cb(fb, quality, [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
+            auto stream = (JpegStream*)arg;
+            return stream->Write(data, len) ? len : 0;
+        }, &stream);
     });
+}
 
+// 建立到识图服务器的连接并发出请求头，请求体随后以分块编码写出
+std::unique_ptr<Http> Esp32Camera::OpenExplainConnection() {
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(3);
-    // 构造multipart/form-data请求体
-    std::string boundary = "----ESP32_CAMERA_BOUNDARY";
-
-    // 配置HTTP客户端，使用分块传输编码
     http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
     http->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
     if (!explain_token_.empty()) {
         http->SetHeader("Authorization", "Bearer " + explain_token_);
     }
-    http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
+    http->SetHeader("Content-Type", std::string("multipart/form-data; boundary=") + CAMERA_EXPLAIN_BOUNDARY);
     http->SetHeader("Transfer-Encoding", "chunked");
     if (!http->Open("POST", explain_url_)) {
-        ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // 清理队列
-        encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
-            }
+        return nullptr;
+    }
+    return http;
+}
+
+// 唯一回收连接线程的地方，调用时持有 explain_mutex_；join 期间释放锁，连接线程结束时也要拿这把锁
+void Esp32Camera::JoinConnectThread(std::unique_lock<std::mutex>& lock) {
+    if (connect_thread_.joinable()) {
+        auto thread = std::move(connect_thread_);
+        lock.unlock();
+        thread.join();
+        lock.lock();
+    }
+    // 线程已被另一个调用者取走回收时，等它把连接放下
+    explain_cv_.wait(lock, [this]() { return !connecting_; });
+}
+
+void Esp32Camera::PrepareExplain() {
+    std::unique_lock<std::mutex> lock(explain_mutex_);
+    if (explain_url_.empty() || connecting_ || prepared_http_ != nullptr) {
+        return;
+    }
+    // 上一次的连接线程已经结束，回收后再启动新的
+    JoinConnectThread(lock);
+    if (connecting_ || prepared_http_ != nullptr) {
+        return;
+    }
+    // TLS 握手要几百毫秒，放在后台，用户说话或编码图像时同时进行
+    connecting_ = true;
+    connect_thread_ = std::thread([this]() {
+        int64_t start_time = esp_timer_get_time();
+        auto http = OpenExplainConnection();
+        std::lock_guard<std::mutex> lock(explain_mutex_);
+        connecting_ = false;
+        explain_cv_.notify_all();
+        if (http == nullptr) {
+            ESP_LOGW(TAG, "Failed to pre-open explain connection");
+            return;
+        }
+        ESP_LOGI(TAG, "Explain connection ready in %lu ms", (uint32_t)((esp_timer_get_time() - start_time) / 1000));
+        prepared_http_ = std::move(http);
+        prepared_time_ = esp_timer_get_time();
+    });
+}
+
+void Esp32Camera::ReleaseExplain() {
+    std::unique_lock<std::mutex> lock(explain_mutex_);
+    JoinConnectThread(lock);
+    if (prepared_http_ != nullptr) {
+        prepared_http_->Close();
+        prepared_http_.reset();
+    }
+}
+
+// 取出预先建立的连接，太久没用的连接服务器可能已经关闭，重新连接
+std::unique_ptr<Http> Esp32Camera::TakeExplainConnection() {
+    std::unique_ptr<Http> http;
+    {
+        std::unique_lock<std::mutex> lock(explain_mutex_);
+        JoinConnectThread(lock);
+        http = std::move(prepared_http_);
+        if (http != nullptr && esp_timer_get_time() - prepared_time_ > CAMERA_EXPLAIN_IDLE_TIMEOUT_MS * 1000LL) {
+            ESP_LOGI(TAG, "Pre-opened explain connection is stale, reconnecting");
+            http->Close();
+            http.reset();
+        }
+    }
+    if (http == nullptr) {
+        http = OpenExplainConnection();
+    }
+    return http;
+}
+
+std::string Esp32Camera::Explain(const std::string& question) {
+    // 检查相机状态并尝试捕获
+    if (fb_ == nullptr) {
+        ESP_LOGW(TAG, "No camera frame available, attempting to capture");
+        if (!Capture()) {
+            return "{\"success\": false, \"message\": \"Failed to capture image from camera\"}";
         }
-        vQueueDelete(jpeg_queue);
+    }
+    
+    if (explain_url_.empty()) {
+        return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
+    }
+
+    // 还没有预先建立的连接时现在开始连接，连接和下面的图像准备同时进行
+    int64_t start_time = esp_timer_get_time();
+    PrepareExplain();
+
+    // 和私有识图服务走同一个图像源：缩放裁剪后的 JPEG、传感器 JPEG 或边编码边上传，质量取自上传配置
+    auto source = GetJpegSource();
+    if (source == nullptr) {
+        return "{\"success\": false, \"message\": \"Failed to encode photo\"}";
+    }
+    int64_t prepared_time = esp_timer_get_time();
+
+    auto http = TakeExplainConnection();
+    std::string boundary = CAMERA_EXPLAIN_BOUNDARY;
+    int64_t connected_time = esp_timer_get_time();
+    if (http == nullptr) {
+        ESP_LOGE(TAG, "Failed to connect to explain URL");
         return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
     }
     
@@ -387,25 +860,36 @@ std::string Esp32Camera::Explain(const std::string& question) {
         http->Write(file_header.c_str(), file_header.size());
     }
 
-    // 第三块：JPEG数据
-    size_t total_sent = 0;
-    while (true) {
-        JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
-            ESP_LOGE(TAG, "Failed to receive JPEG chunk");
-            break;
-        }
-        if (chunk.data == nullptr) {
-            break; // The last chunk
+    // 第三块：JPEG数据，按块写出，不复制
+    size_t jpeg_size = 0;
+    const uint8_t* data = nullptr;
+    size_t len = 0;
+    while (source->Next(data, len)) {
+        if (http->Write((const char*)data, len) < 0) {
+            ESP_LOGE(TAG, "Failed to upload JPEG chunk");
+            http->Close();
+            return "{\"success\": false, \"message\": \"Failed to upload photo\"}";
         }
-        http->Write((const char*)chunk.data, chunk.len);
-        total_sent += chunk.len;
-        heap_caps_free(chunk.data);
+        jpeg_size += len;
     }
-    // 等待编码线程完成
-    encoder_thread_.join();
-    // 清理队列
-    vQueueDelete(jpeg_queue);
+    if (source->failed()) {
+        ESP_LOGE(TAG, "Failed to encode JPEG");
+        http->Close();
+        return "{\"success\": false, \"message\": \"Failed to encode photo\"}";
+    }
+    // 软件编码时编码和上传分开统计：编码线程等待的时间说明瓶颈在网络
+    if (auto stats = source->stream_stats()) {
+        uint32_t encode_us = stats->producer_us - stats->producer_wait_us;
+        ESP_LOGI(TAG, "JPEG %u bytes: encode %lu ms (%lu KB/s), encoder waited %lu ms for upload, upload %lu ms (%lu KB/s)",
+            stats->bytes, encode_us / 1000, encode_us > 0 ? (uint32_t)(stats->bytes * 1000ULL / encode_us) : 0,
+            stats->producer_wait_us / 1000, stats->consumer_us / 1000,
+            stats->consumer_us > 0 ? (uint32_t)(stats->bytes * 1000ULL / stats->consumer_us) : 0);
+    }
+    // 图像已经全部写出，释放图像源（软件编码时编码线程随之结束）
+    source.reset();
+    uint32_t upload_us = esp_timer_get_time() - connected_time;
+    ESP_LOGI(TAG, "JPEG %u bytes, upload %lu ms (%lu KB/s)", jpeg_size, upload_us / 1000,
+        upload_us > 0 ? (uint32_t)(jpeg_size * 1000ULL / upload_us) : 0);
 
     {
         // 第四块：multipart尾部
@@ -415,18 +899,27 @@ std::string Esp32Camera::Explain(const std::string& question) {
     }
     // 结束块
     http->Write("", 0);
+    int64_t uploaded_time = esp_timer_get_time();
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
+    int status_code = http->GetStatusCode();
+    if (status_code != 200) {
+        ESP_LOGE(TAG, "Failed to upload photo, status code: %d", status_code);
+        http->Close();
         return "{\"success\": false, \"message\": \"Failed to upload photo\"}";
     }
 
     std::string result = http->ReadAll();
     http->Close();
 
+    // 各阶段耗时：等待连接的时间越短说明预连接越有效
+    ESP_LOGI(TAG, "Explain stages: prepare %lu ms, connect wait %lu ms, upload %lu ms, response %lu ms, total %lu ms",
+        (uint32_t)((prepared_time - start_time) / 1000), (uint32_t)((connected_time - prepared_time) / 1000),
+        (uint32_t)((uploaded_time - connected_time) / 1000), (uint32_t)((esp_timer_get_time() - uploaded_time) / 1000),
+        (uint32_t)((esp_timer_get_time() - start_time) / 1000));
+
     // 获取剩余任务栈大小
     size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
     ESP_LOGI(TAG, "Explain image size=%dx%d, compressed size=%d, remain stack size=%d, question=%s\n%s",
-        fb_->width, fb_->height, total_sent, remain_stack_size, question.c_str(), result.c_str());
+        fb_->width, fb_->height, jpeg_size, remain_stack_size, question.c_str(), result.c_str());
     return result;
 }
\ No newline at end of file
@@ -2,38 +2,107 @@
 #define ESP32_CAMERA_H
 
 #include <esp_camera.h>
+#include <img_converters.h>
 #include <lvgl.h>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <http.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 
 #include "camera.h"
+#include "jpeg_stream.h"
+#include "image_utils.h"
 
-struct JpegChunk {
-    uint8_t* data;
-    size_t len;
-};
+// Sensors with a JPEG encoder (OV2640, OV3660) are switched to hardware JPEG, the upload skips
+// the software encode and the preview is decoded from the JPEG at reduced size
+#define CAMERA_USE_HW_JPEG 1
+
+// Frames kept by continuous capture, the driver gets one more frame buffer to keep filling
+#define CAMERA_FRAME_RING_SIZE 3
+#define CAMERA_FRAME_RING_INTERVAL_MS 100
+// The extra frame buffers are only allocated when they take at most this share of the free PSRAM
+#define CAMERA_FRAME_RING_MAX_PSRAM_PERCENT 25
+// The focus measure runs on a luma plane at most this wide
+#define CAMERA_FOCUS_MAX_WIDTH 160
+
+// The explain request is opened when listening starts, servers drop idle requests after a while
+#define CAMERA_EXPLAIN_IDLE_TIMEOUT_MS 20000
+#define CAMERA_EXPLAIN_BOUNDARY "----ESP32_CAMERA_BOUNDARY"
 
 class Esp32Camera : public Camera {
 private:
     camera_fb_t* fb_ = nullptr;
     lv_img_dsc_t preview_image_;
+    ImageRotation preview_rotation_ = kImageRotate0;
+    // Hardware JPEG frames are decoded here at reduced size before scaling to the preview
+    uint8_t* preview_decode_ = nullptr;
+    size_t preview_decode_size_ = 0;
     std::string explain_url_;
     std::string explain_token_;
-    std::thread encoder_thread_;
+    // Chunks between the JPEG encoder and the upload, allocated on the first GetJpegSource()
+    std::unique_ptr<JpegStream> jpeg_stream_;
+
+    // 连续采集：最近几帧留在帧缓冲区中，拍照时直接取最清晰的一帧
+    int ring_capacity_ = 0;
+    // ring_mutex_ 保护 ring_，采集线程也会持有；ring_control_mutex_ 保护采集线程的启停和取帧
+    std::mutex ring_mutex_;
+    std::mutex ring_control_mutex_;
+    std::deque<camera_fb_t*> ring_;
+    std::thread ring_thread_;
+    std::atomic<bool> ring_running_ = false;
+    std::vector<uint8_t> focus_buffer_;
+
+    // 提前建立的识图连接，请求头已发出，等待写入请求体；以下成员都由 explain_mutex_ 保护
+    std::mutex explain_mutex_;
+    std::condition_variable explain_cv_;
+    std::unique_ptr<Http> prepared_http_;
+    int64_t prepared_time_ = 0;
+    std::thread connect_thread_;
+    bool connecting_ = false;
+    void JoinConnectThread(std::unique_lock<std::mutex>& lock);
+    std::unique_ptr<Http> OpenExplainConnection();
+    std::unique_ptr<Http> TakeExplainConnection();
+
+    // 上传前的缩放、裁剪和质量调整
+    CameraUploadConfig upload_config_;
+    int upload_quality_ = 0;
+    bool NeedsPreprocess() const;
+    bool Preprocess(uint8_t** jpeg, size_t* jpeg_len);
+
+    void RingLoop(int capacity);
+    bool FrameLuma(camera_fb_t* fb, int& width, int& height);
+    uint32_t MeasureSharpness(camera_fb_t* fb);
+    bool TakeSharpestFrame();
+    bool PreparePreview(int frame_width, int frame_height);
+    void UpdatePreview();
 
 public:
     Esp32Camera(const camera_config_t& config);
     ~Esp32Camera();
 
     virtual void SetExplainUrl(const std::string& url, const std::string& token);
+    virtual void SetUploadConfig(const CameraUploadConfig& config) override;
     virtual bool Capture();
     // 翻转控制函数
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
+    // 传感器安装方向与屏幕不一致时旋转预览
+    void SetPreviewRotation(ImageRotation rotation) { preview_rotation_ = rotation; }
     virtual std::string Explain(const std::string& question);
+    virtual bool GetJpeg(int quality, std::vector<uint8_t>& jpeg) override;
+    virtual bool GetFrameHash(uint64_t& hash) override;
+    virtual std::unique_ptr<JpegSource> GetJpegSource() override;
+    virtual void StartContinuousCapture() override;
+    virtual void StopContinuousCapture() override;
+    virtual void PrepareExplain() override;
+    virtual void ReleaseExplain() override;
 };
 
 #endif // ESP32_CAMERA_H
\ No newline at end of file
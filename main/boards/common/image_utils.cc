@@ -0,0 +1,377 @@
+#include "image_utils.h"
+
+#include <vector>
+#include <algorithm>
+
+void Rgb565SwapBytes(const uint8_t* src, uint8_t* dst, size_t pixel_count) {
+    auto s = (const uint16_t*)src;
+    auto d = (uint16_t*)dst;
+    for (size_t i = 0; i < pixel_count; i++) {
+        d[i] = __builtin_bswap16(s[i]);
+    }
+}
+
+// 输出坐标 (x, y) 对应的未旋转图像坐标，width / height 是未旋转图像的尺寸
+template <ImageRotation rotation>
+static inline void Unrotate(int x, int y, int width, int height, int& ux, int& uy) {
+    if constexpr (rotation == kImageRotate0) {
+        ux = x;
+        uy = y;
+    } else if constexpr (rotation == kImageRotate90) {
+        ux = y;
+        uy = height - 1 - x;
+    } else if constexpr (rotation == kImageRotate180) {
+        ux = width - 1 - x;
+        uy = height - 1 - y;
+    } else {
+        ux = width - 1 - y;
+        uy = x;
+    }
+}
+
+template <ImageRotation rotation>
+static void ScaleNearest(const uint16_t* src, int src_width, const int* x_map, const int* y_map,
+    int width, int height, uint16_t* dst, int dst_width, int dst_height) {
+    for (int y = 0; y < dst_height; y++) {
+        for (int x = 0; x < dst_width; x++) {
+            int ux, uy;
+            Unrotate<rotation>(x, y, width, height, ux, uy);
+            *dst++ = __builtin_bswap16(src[y_map[uy] * src_width + x_map[ux]]);
+        }
+    }
+}
+
+void Rgb565ScaleNearest(const uint8_t* src, int src_width, int src_height,
+    uint16_t* dst, int dst_width, int dst_height, ImageRotation rotation) {
+    bool swapped = rotation == kImageRotate90 || rotation == kImageRotate270;
+    int width = swapped ? dst_height : dst_width;
+    int height = swapped ? dst_width : dst_height;
+    // 每个输出列、行对应的源列、行，取像素中心
+    std::vector<int> x_map(width), y_map(height);
+    for (int i = 0; i < width; i++) {
+        x_map[i] = (int)(((int64_t)i * 2 + 1) * src_width / (width * 2));
+    }
+    for (int i = 0; i < height; i++) {
+        y_map[i] = (int)(((int64_t)i * 2 + 1) * src_height / (height * 2));
+    }
+    auto pixels = (const uint16_t*)src;
+    switch (rotation) {
+        case kImageRotate0:
+            ScaleNearest<kImageRotate0>(pixels, src_width, x_map.data(), y_map.data(), width, height, dst, dst_width, dst_height);
+            break;
+        case kImageRotate90:
+            ScaleNearest<kImageRotate90>(pixels, src_width, x_map.data(), y_map.data(), width, height, dst, dst_width, dst_height);
+            break;
+        case kImageRotate180:
+            ScaleNearest<kImageRotate180>(pixels, src_width, x_map.data(), y_map.data(), width, height, dst, dst_width, dst_height);
+            break;
+        case kImageRotate270:
+            ScaleNearest<kImageRotate270>(pixels, src_width, x_map.data(), y_map.data(), width, height, dst, dst_width, dst_height);
+            break;
+    }
+}
+
+// 源坐标的整数部分和 5 位小数权重
+struct SampleTap {
+    int index;
+    int next;
+    uint32_t weight;
+};
+
+static std::vector<SampleTap> BilinearTaps(int src_size, int size) {
+    std::vector<SampleTap> taps(size);
+    for (int i = 0; i < size; i++) {
+        // 像素中心对齐，定点数 x32
+        int64_t position = (((int64_t)i * 2 + 1) * src_size * 32 + size) / (size * 2) - 16;
+        if (position < 0) {
+            position = 0;
+        }
+        int index = (int)(position >> 5);
+        if (index >= src_size - 1) {
+            taps[i] = {src_size - 1, src_size - 1, 0};
+        } else {
+            taps[i] = {index, index + 1, (uint32_t)(position & 31)};
+        }
+    }
+    return taps;
+}
+
+// 把 RGB565 的三个分量拉开放进一个 32 位字：G 在高位，R、B 在低位，分量之间留出空位，
+// 乘以 5 位权重并加上舍入量后不会互相溢出，一次乘法同时插值三个分量
+static inline uint32_t Spread(uint16_t pixel) {
+    uint32_t native = __builtin_bswap16(pixel);
+    return (native | (native << 16)) & 0x07E0F81F;
+}
+
+static inline uint32_t Lerp(uint32_t a, uint32_t b, uint32_t weight) {
+    return ((a * (32 - weight) + b * weight + 0x02008010) >> 5) & 0x07E0F81F;
+}
+
+template <ImageRotation rotation>
+static void ScaleBilinear(const uint16_t* src, int src_width, const SampleTap* x_taps, const SampleTap* y_taps,
+    int width, int height, uint16_t* dst, int dst_width, int dst_height) {
+    for (int y = 0; y < dst_height; y++) {
+        for (int x = 0; x < dst_width; x++) {
+            int ux, uy;
+            Unrotate<rotation>(x, y, width, height, ux, uy);
+            const SampleTap& tx = x_taps[ux];
+            const SampleTap& ty = y_taps[uy];
+            const uint16_t* row0 = src + ty.index * src_width;
+            const uint16_t* row1 = src + ty.next * src_width;
+            uint32_t top = Lerp(Spread(row0[tx.index]), Spread(row0[tx.next]), tx.weight);
+            uint32_t bottom = Lerp(Spread(row1[tx.index]), Spread(row1[tx.next]), tx.weight);
+            uint32_t value = Lerp(top, bottom, ty.weight);
+            *dst++ = (uint16_t)(value | (value >> 16));
+        }
+    }
+}
+
+void Rgb565ScaleBilinear(const uint8_t* src, int src_width, int src_height,
+    uint16_t* dst, int dst_width, int dst_height, ImageRotation rotation) {
+    bool swapped = rotation == kImageRotate90 || rotation == kImageRotate270;
+    int width = swapped ? dst_height : dst_width;
+    int height = swapped ? dst_width : dst_height;
+    auto x_taps = BilinearTaps(src_width, width);
+    auto y_taps = BilinearTaps(src_height, height);
+    auto pixels = (const uint16_t*)src;
+    switch (rotation) {
+        case kImageRotate0:
+            ScaleBilinear<kImageRotate0>(pixels, src_width, x_taps.data(), y_taps.data(), width, height, dst, dst_width, dst_height);
+            break;
+        case kImageRotate90:
+            ScaleBilinear<kImageRotate90>(pixels, src_width, x_taps.data(), y_taps.data(), width, height, dst, dst_width, dst_height);
+            break;
+        case kImageRotate180:
+            ScaleBilinear<kImageRotate180>(pixels, src_width, x_taps.data(), y_taps.data(), width, height, dst, dst_width, dst_height);
+            break;
+        case kImageRotate270:
+            ScaleBilinear<kImageRotate270>(pixels, src_width, x_taps.data(), y_taps.data(), width, height, dst, dst_width, dst_height);
+            break;
+    }
+}
+
+void Rgb565ToLuma(const uint8_t* src, int width, int height, int step, uint8_t* dst) {
+    int out_width = width / step;
+    int out_height = height / step;
+    for (int y = 0; y < out_height; y++) {
+        const uint8_t* row = src + (size_t)y * step * width * 2;
+        for (int x = 0; x < out_width; x++) {
+            const uint8_t* p = row + x * step * 2;
+            uint16_t pixel = (p[0] << 8) | p[1];
+            // 扩展到 8 位后按 BT.601 近似系数 (77, 150, 29) / 256 求亮度
+            uint32_t r = (pixel >> 8) & 0xF8;
+            uint32_t g = (pixel >> 3) & 0xFC;
+            uint32_t b = (pixel << 3) & 0xF8;
+            *dst++ = (r * 77 + g * 150 + b * 29) >> 8;
+        }
+    }
+}
+
+ImageResizePlan PlanImageResize(int width, int height, int max_width, int max_height, bool crop) {
+    ImageResizePlan plan;
+    plan.crop_width = width;
+    plan.crop_height = height;
+    // 居中裁剪到目标宽高比
+    if (crop && max_width > 0 && max_height > 0) {
+        if ((int64_t)width * max_height > (int64_t)height * max_width) {
+            plan.crop_width = height * max_width / max_height;
+            plan.crop_x = (width - plan.crop_width) / 2;
+        } else {
+            plan.crop_height = width * max_height / max_width;
+            plan.crop_y = (height - plan.crop_height) / 2;
+        }
+    }
+
+    // 等比缩小到目标尺寸以内，不放大
+    int out_width = plan.crop_width;
+    int out_height = plan.crop_height;
+    if (max_width > 0 && out_width > max_width) {
+        out_height = out_height * max_width / out_width;
+        out_width = max_width;
+    }
+    if (max_height > 0 && out_height > max_height) {
+        out_width = out_width * max_height / out_height;
+        out_height = max_height;
+    }
+    plan.out_width = std::max(out_width, 1);
+    plan.out_height = std::max(out_height, 1);
+    return plan;
+}
+
+int PlanJpegDecodeScale(const ImageResizePlan& plan) {
+    int scale = 0;
+    while (scale < 3 && (plan.crop_width >> (scale + 1)) >= plan.out_width &&
+        (plan.crop_height >> (scale + 1)) >= plan.out_height) {
+        scale++;
+    }
+    return scale;
+}
+
+void ScaleImageResizePlan(ImageResizePlan& plan, int scale, int decoded_width, int decoded_height) {
+    plan.crop_x >>= scale;
+    plan.crop_y >>= scale;
+    plan.crop_width = std::min(plan.crop_width >> scale, decoded_width - plan.crop_x);
+    plan.crop_height = std::min(plan.crop_height >> scale, decoded_height - plan.crop_y);
+}
+
+int ReduceJpegQuality(int quality, size_t jpeg_len, size_t max_bytes) {
+    return std::max(IMAGE_MIN_JPEG_QUALITY, (int)(quality * max_bytes / jpeg_len));
+}
+
+int NextJpegQuality(int quality, size_t jpeg_len, size_t max_bytes, int max_quality) {
+    if (max_bytes > 0 && jpeg_len < max_bytes / 2 && quality < max_quality) {
+        // 远小于目标时下一张照片提高质量
+        return std::min(max_quality, quality + 10);
+    }
+    return quality;
+}
+
+void Rgb565DownscaleArea(const uint8_t* src, int src_width, int x, int y, int width, int height,
+    uint8_t* dst, int dst_width, int dst_height) {
+    // 每个输出列覆盖的源列范围，输出不大于源时每列至少一个像素
+    std::vector<int> columns(dst_width + 1);
+    for (int i = 0; i <= dst_width; i++) {
+        columns[i] = x + (int)((int64_t)i * width / dst_width);
+    }
+    // 一行输出的 R、G、B 累加值，按源行逐行累加，源图只顺序读一遍
+    std::vector<uint32_t> sums(dst_width * 3);
+    for (int out_y = 0; out_y < dst_height; out_y++) {
+        int y0 = y + (int)((int64_t)out_y * height / dst_height);
+        int y1 = y + (int)((int64_t)(out_y + 1) * height / dst_height);
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int src_y = y0; src_y < y1; src_y++) {
+            const uint8_t* row = src + (size_t)src_y * src_width * 2;
+            uint32_t* sum = sums.data();
+            for (int out_x = 0; out_x < dst_width; out_x++, sum += 3) {
+                uint32_t r = 0, g = 0, b = 0;
+                for (int src_x = columns[out_x]; src_x < columns[out_x + 1]; src_x++) {
+                    uint16_t pixel = (row[src_x * 2] << 8) | row[src_x * 2 + 1];
+                    r += pixel >> 11;
+                    g += (pixel >> 5) & 0x3F;
+                    b += pixel & 0x1F;
+                }
+                sum[0] += r;
+                sum[1] += g;
+                sum[2] += b;
+            }
+        }
+        const uint32_t* sum = sums.data();
+        for (int out_x = 0; out_x < dst_width; out_x++, sum += 3) {
+            uint32_t count = (columns[out_x + 1] - columns[out_x]) * (y1 - y0);
+            uint32_t half = count / 2;
+            uint16_t pixel = (((sum[0] + half) / count) << 11) | (((sum[1] + half) / count) << 5) | ((sum[2] + half) / count);
+            *dst++ = pixel >> 8;
+            *dst++ = pixel & 0xFF;
+        }
+    }
+}
+
+bool Rgb565BandDownscaler::Begin(int src_width, int src_height, uint16_t* dst, int dst_width, int dst_height) {
+    if (dst_width <= 0 || dst_height <= 0 || dst_width > src_width || dst_height > src_height) {
+        return false;
+    }
+    src_width_ = src_width;
+    src_height_ = src_height;
+    dst_ = dst;
+    dst_width_ = dst_width;
+    dst_height_ = dst_height;
+    src_y_ = 0;
+    out_y_ = 0;
+    columns_.resize(dst_width + 1);
+    for (int i = 0; i <= dst_width; i++) {
+        columns_[i] = (int)((int64_t)i * src_width / dst_width);
+    }
+    sums_.assign(dst_width * 3, 0);
+    return true;
+}
+
+int Rgb565BandDownscaler::RowEnd(int out_y) const {
+    return (int)((int64_t)(out_y + 1) * src_height_ / dst_height_);
+}
+
+void Rgb565BandDownscaler::Push(const uint16_t* rows, int row_count) {
+    // 与 Rgb565DownscaleArea 相同的累加，只是源行分批到达，累加值跨批保留
+    for (int i = 0; i < row_count && !done(); i++, src_y_++) {
+        const uint16_t* row = rows + (size_t)i * src_width_;
+        uint32_t* sum = sums_.data();
+        for (int out_x = 0; out_x < dst_width_; out_x++, sum += 3) {
+            uint32_t r = 0, g = 0, b = 0;
+            for (int src_x = columns_[out_x]; src_x < columns_[out_x + 1]; src_x++) {
+                uint16_t pixel = row[src_x];
+                r += pixel >> 11;
+                g += (pixel >> 5) & 0x3F;
+                b += pixel & 0x1F;
+            }
+            sum[0] += r;
+            sum[1] += g;
+            sum[2] += b;
+        }
+        if (src_y_ + 1 == RowEnd(out_y_)) {
+            FlushRow();
+        }
+    }
+}
+
+void Rgb565BandDownscaler::FlushRow() {
+    int y0 = (int)((int64_t)out_y_ * src_height_ / dst_height_);
+    int rows = RowEnd(out_y_) - y0;
+    uint16_t* out = dst_ + (size_t)out_y_ * dst_width_;
+    uint32_t* sum = sums_.data();
+    for (int out_x = 0; out_x < dst_width_; out_x++, sum += 3) {
+        uint32_t count = (columns_[out_x + 1] - columns_[out_x]) * rows;
+        uint32_t half = count / 2;
+        out[out_x] = (((sum[0] + half) / count) << 11) | (((sum[1] + half) / count) << 5) | ((sum[2] + half) / count);
+        sum[0] = sum[1] = sum[2] = 0;
+    }
+    out_y_++;
+}
+
+uint32_t LaplacianVariance(const uint8_t* luma, int width, int height) {
+    if (width < 3 || height < 3) {
+        return 0;
+    }
+    int64_t sum = 0;
+    uint64_t sum_squares = 0;
+    for (int y = 1; y < height - 1; y++) {
+        const uint8_t* row = luma + y * width;
+        for (int x = 1; x < width - 1; x++) {
+            int value = 4 * row[x] - row[x - 1] - row[x + 1] - row[x - width] - row[x + width];
+            sum += value;
+            sum_squares += value * value;
+        }
+    }
+    uint64_t count = (uint64_t)(width - 2) * (height - 2);
+    int64_t mean = sum / (int64_t)count;
+    return (uint32_t)(sum_squares / count - mean * mean);
+}
+
+uint64_t LumaDifferenceHash(const uint8_t* luma, int width, int height) {
+    if (width < 9 || height < 8) {
+        return 0;
+    }
+    // 先按面积平均缩到 9x8，再逐行比较相邻两格
+    uint32_t cells[8][9];
+    for (int cy = 0; cy < 8; cy++) {
+        int y0 = cy * height / 8;
+        int y1 = (cy + 1) * height / 8;
+        for (int cx = 0; cx < 9; cx++) {
+            int x0 = cx * width / 9;
+            int x1 = (cx + 1) * width / 9;
+            uint32_t sum = 0;
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* row = luma + (size_t)y * width;
+                for (int x = x0; x < x1; x++) {
+                    sum += row[x];
+                }
+            }
+            cells[cy][cx] = sum / ((x1 - x0) * (y1 - y0));
+        }
+    }
+    uint64_t hash = 0;
+    for (int cy = 0; cy < 8; cy++) {
+        for (int cx = 0; cx < 8; cx++) {
+            hash = (hash << 1) | (cells[cy][cx] > cells[cy][cx + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
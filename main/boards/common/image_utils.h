@@ -0,0 +1,119 @@
+#ifndef IMAGE_UTILS_H
+#define IMAGE_UTILS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Small image kernels for camera frames, independent of the camera driver.
+ *
+ * RGB565 input is big endian, the byte order the sensors and the esp32-camera JPEG decoder
+ * produce. Luma planes are 8 bit, one byte per pixel, rows packed without padding. Preview
+ * output is native (little endian) RGB565 as LVGL expects.
+ */
+
+enum ImageRotation {
+    kImageRotate0,
+    kImageRotate90,     // Clockwise
+    kImageRotate180,
+    kImageRotate270,
+};
+
+// Byte swap between big endian and native RGB565, one bswap16 per pixel. Both buffers must be 16 bit
+// aligned, src and dst may be the same buffer
+void Rgb565SwapBytes(const uint8_t* src, uint8_t* dst, size_t pixel_count);
+
+// Scale, rotate and byte swap a frame into a preview in one pass, without an intermediate frame.
+// dst_width and dst_height are the size after rotation. Nearest is cheapest and fine when
+// shrinking by 2x or more, bilinear looks better close to 1:1 and when enlarging
+void Rgb565ScaleNearest(const uint8_t* src, int src_width, int src_height,
+    uint16_t* dst, int dst_width, int dst_height, ImageRotation rotation);
+void Rgb565ScaleBilinear(const uint8_t* src, int src_width, int src_height,
+    uint16_t* dst, int dst_width, int dst_height, ImageRotation rotation);
+
+// Luma of every step-th pixel in both directions, dst holds (width / step) * (height / step) bytes
+void Rgb565ToLuma(const uint8_t* src, int width, int height, int step, uint8_t* dst);
+
+// How a frame is cut and shrunk before upload: a centre crop to the max_width:max_height aspect
+// ratio when crop is set, then a proportional shrink to fit max_width x max_height. Zero means no
+// limit, frames are never enlarged
+struct ImageResizePlan {
+    int crop_x = 0;
+    int crop_y = 0;
+    int crop_width = 0;
+    int crop_height = 0;
+    int out_width = 0;
+    int out_height = 0;
+
+    // False when the plan keeps a width x height frame as it is
+    inline bool resizes(int width, int height) const {
+        return crop_width != width || crop_height != height || out_width != crop_width || out_height != crop_height;
+    }
+};
+
+ImageResizePlan PlanImageResize(int width, int height, int max_width, int max_height, bool crop);
+
+// Largest power of two JPEG decode reduction, 0 (1:1) to 3 (1/8) as jpg2rgb565 and libjpeg offer,
+// that still leaves the crop at least as large as the output
+int PlanJpegDecodeScale(const ImageResizePlan& plan);
+
+// Moves the crop onto the frame decoded at 1 / 2^scale. Decoders that round the decoded size up
+// rather than down are covered by clamping the crop to decoded_width x decoded_height
+void ScaleImageResizePlan(ImageResizePlan& plan, int scale, int decoded_width, int decoded_height);
+
+#define IMAGE_MIN_JPEG_QUALITY 10
+
+// Quality for another encode after a JPEG of jpeg_len bytes came out over max_bytes, lowered in
+// proportion to the excess and not below IMAGE_MIN_JPEG_QUALITY
+int ReduceJpegQuality(int quality, size_t jpeg_len, size_t max_bytes);
+
+// Starting quality for the next photo once this one is encoded at quality: raised again when the
+// JPEG used less than half of max_bytes, never above max_quality
+int NextJpegQuality(int quality, size_t jpeg_len, size_t max_bytes, int max_quality);
+
+// Area-average downscale of the (x, y, width, height) rectangle of an RGB565 image that is
+// src_width pixels wide. Every output pixel is the mean of the source pixels it covers, which
+// avoids the aliasing of nearest-neighbour sampling. The output is not larger than the rectangle
+void Rgb565DownscaleArea(const uint8_t* src, int src_width, int x, int y, int width, int height,
+    uint8_t* dst, int dst_width, int dst_height);
+
+// Area-average downscale fed a band of rows at a time, for JPEG decoders that output one MCU row
+// per call, so the full-size frame never exists in memory. Unlike the functions above, input and
+// output are both native RGB565 (the decoders' RGB565_LE). The output is not larger than the input
+class Rgb565BandDownscaler {
+public:
+    bool Begin(int src_width, int src_height, uint16_t* dst, int dst_width, int dst_height);
+    // Next rows of the source, src_width pixels each, top to bottom
+    void Push(const uint16_t* rows, int row_count);
+    inline bool done() const { return out_y_ >= dst_height_; }
+
+private:
+    int src_width_ = 0;
+    int src_height_ = 0;
+    uint16_t* dst_ = nullptr;
+    int dst_width_ = 0;
+    int dst_height_ = 0;
+    int src_y_ = 0;
+    int out_y_ = 0;
+    std::vector<int> columns_;
+    std::vector<uint32_t> sums_;
+
+    int RowEnd(int out_y) const;
+    void FlushRow();
+};
+
+// Variance of the 4-neighbour Laplacian over the interior of a luma plane, a cheap focus measure:
+// edges of a sharp frame give large responses, motion blur and defocus flatten them
+uint32_t LaplacianVariance(const uint8_t* luma, int width, int height);
+
+// 64 bit difference hash (dHash) of a luma plane: the plane is area-averaged to 9x8 and each bit
+// tells whether a cell is brighter than its right neighbour. Exposure changes and small shifts
+// leave it mostly unchanged, so photos of the same scene differ in only a few bits. Needs at
+// least 9x8 pixels, returns 0 otherwise
+uint64_t LumaDifferenceHash(const uint8_t* luma, int width, int height);
+
+// Number of differing bits between two hashes
+inline int HashDistance(uint64_t a, uint64_t b) { return __builtin_popcountll(a ^ b); }
+
+#endif // IMAGE_UTILS_H
@@ -0,0 +1,180 @@
+#include "jpeg_stream.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "JpegStream"
+
+JpegStream::JpegStream(size_t chunk_size, int chunk_count)
+    : chunk_size_(chunk_size), chunk_count_(chunk_count) {
+    pool_ = (uint8_t*)heap_caps_malloc(chunk_size_ * chunk_count_, MALLOC_CAP_SPIRAM);
+    if (pool_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for JPEG chunks", chunk_size_ * chunk_count_);
+        return;
+    }
+    free_queue_ = xQueueCreate(chunk_count_, sizeof(uint8_t*));
+    // One more slot for the end marker
+    full_queue_ = xQueueCreate(chunk_count_ + 1, sizeof(JpegChunk));
+    Reset();
+}
+
+JpegStream::~JpegStream() {
+    if (free_queue_ != nullptr) {
+        vQueueDelete(free_queue_);
+    }
+    if (full_queue_ != nullptr) {
+        vQueueDelete(full_queue_);
+    }
+    if (pool_ != nullptr) {
+        heap_caps_free(pool_);
+    }
+}
+
+void JpegStream::Reset() {
+    if (pool_ == nullptr) {
+        return;
+    }
+    xQueueReset(free_queue_);
+    xQueueReset(full_queue_);
+    for (int i = 0; i < chunk_count_; i++) {
+        uint8_t* data = pool_ + i * chunk_size_;
+        xQueueSend(free_queue_, &data, 0);
+    }
+    current_ = {nullptr, 0};
+    aborted_ = false;
+    finished_ = false;
+    stats_ = JpegStreamStats();
+    start_time_us_ = esp_timer_get_time();
+}
+
+bool JpegStream::NextChunk() {
+    int64_t wait_start = esp_timer_get_time();
+    uint8_t* data = nullptr;
+    xQueueReceive(free_queue_, &data, portMAX_DELAY);
+    stats_.producer_wait_us += esp_timer_get_time() - wait_start;
+    current_ = {data, 0};
+    return !aborted_;
+}
+
+void JpegStream::SendCurrent() {
+    xQueueSend(full_queue_, &current_, portMAX_DELAY);
+    current_ = {nullptr, 0};
+}
+
+bool JpegStream::Write(const void* data, size_t len) {
+    auto src = (const uint8_t*)data;
+    while (len > 0) {
+        if (aborted_) {
+            return false;
+        }
+        if (current_.data == nullptr && !NextChunk()) {
+            return false;
+        }
+        size_t n = std::min(len, chunk_size_ - current_.len);
+        memcpy(current_.data + current_.len, src, n);
+        current_.len += n;
+        stats_.bytes += n;
+        src += n;
+        len -= n;
+        if (current_.len == chunk_size_) {
+            SendCurrent();
+        }
+    }
+    return true;
+}
+
+void JpegStream::Finish() {
+    if (current_.data != nullptr) {
+        if (current_.len > 0 && !aborted_) {
+            SendCurrent();
+        } else {
+            xQueueSend(free_queue_, &current_.data, 0);
+            current_ = {nullptr, 0};
+        }
+    }
+    stats_.producer_us = esp_timer_get_time() - start_time_us_;
+    // The end marker always fits, the full queue has a slot more than there are chunks
+    JpegChunk end_marker = {nullptr, 0};
+    xQueueSend(full_queue_, &end_marker, portMAX_DELAY);
+}
+
+bool JpegStream::Read(JpegChunk& chunk) {
+    if (finished_) {
+        return false;
+    }
+    xQueueReceive(full_queue_, &chunk, portMAX_DELAY);
+    if (chunk.data == nullptr) {
+        finished_ = true;
+        return false;
+    }
+    read_time_us_ = esp_timer_get_time();
+    return true;
+}
+
+void JpegStream::Release(const JpegChunk& chunk) {
+    stats_.consumer_us += esp_timer_get_time() - read_time_us_;
+    xQueueSend(free_queue_, &chunk.data, 0);
+}
+
+void JpegStream::Abort() {
+    aborted_ = true;
+    // Returning the chunks wakes a producer blocked on a full pool, it then sees the abort
+    JpegChunk chunk;
+    while (Read(chunk)) {
+        Release(chunk);
+    }
+}
+
+StreamJpegSource::StreamJpegSource(JpegStream& stream, Encoder encode) : stream_(stream), encode_(std::move(encode)) {
+    Start();
+}
+
+StreamJpegSource::~StreamJpegSource() {
+    Stop();
+}
+
+bool StreamJpegSource::Next(const uint8_t*& data, size_t& len) {
+    ReleaseChunk();
+    if (!stream_.Read(chunk_)) {
+        return false;
+    }
+    holding_ = true;
+    data = chunk_.data;
+    len = chunk_.len;
+    return true;
+}
+
+bool StreamJpegSource::Rewind() {
+    Stop();
+    Start();
+    return true;
+}
+
+void StreamJpegSource::Start() {
+    stream_.Reset();
+    failed_ = false;
+    thread_ = std::thread([this]() {
+        if (!encode_(stream_)) {
+            failed_ = true;
+        }
+        stream_.Finish();
+    });
+}
+
+void StreamJpegSource::ReleaseChunk() {
+    if (holding_) {
+        stream_.Release(chunk_);
+        holding_ = false;
+    }
+}
+
+void StreamJpegSource::Stop() {
+    ReleaseChunk();
+    if (thread_.joinable()) {
+        stream_.Abort();
+        thread_.join();
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef JPEG_STREAM_H
+#define JPEG_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include "camera.h"
+
+// 4KB per chunk keeps the number of HTTP chunked writes low, 8 chunks let the encoder run ahead
+#define JPEG_STREAM_CHUNK_SIZE (4 * 1024)
+#define JPEG_STREAM_CHUNK_COUNT 8
+
+struct JpegChunk {
+    uint8_t* data;
+    size_t len;
+};
+
+struct JpegStreamStats {
+    size_t bytes = 0;
+    uint32_t producer_us = 0;        // From Reset() to Finish()
+    uint32_t producer_wait_us = 0;   // Blocked on a full pool, the consumer was the bottleneck
+    uint32_t consumer_us = 0;        // Time spent by the consumer on the chunks, between Read() and Release()
+};
+
+/*
+ * A fixed pool of chunk buffers in PSRAM passed from a JPEG producer to a consumer (the uploader).
+ *
+ * The producer copies its output into the current chunk and hands the chunk over when it is
+ * full. When every chunk is waiting for the consumer, Write() blocks, so memory stays bounded
+ * however slow the network is. Chunks are allocated once and reused for every photo, there is
+ * no allocation per encoder callback.
+ */
+class JpegStream {
+public:
+    JpegStream(size_t chunk_size = JPEG_STREAM_CHUNK_SIZE, int chunk_count = JPEG_STREAM_CHUNK_COUNT);
+    ~JpegStream();
+
+    inline bool valid() const { return pool_ != nullptr; }
+    // Before each photo, neither side may be active
+    void Reset();
+
+    // Producer side. Write() returns false once the consumer has aborted
+    bool Write(const void* data, size_t len);
+    void Finish();
+
+    // Consumer side. Read() returns false at the end of the stream, every chunk read must be released
+    bool Read(JpegChunk& chunk);
+    void Release(const JpegChunk& chunk);
+    // The consumer gives up: the producer fails its next Write() and the remaining chunks are drained
+    void Abort();
+
+    inline const JpegStreamStats& stats() const { return stats_; }
+
+private:
+    size_t chunk_size_;
+    int chunk_count_;
+    uint8_t* pool_ = nullptr;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t full_queue_ = nullptr;
+    JpegChunk current_ = {nullptr, 0};
+    std::atomic<bool> aborted_ = false;
+    bool finished_ = false;
+    int64_t start_time_us_ = 0;
+    int64_t read_time_us_ = 0;
+    JpegStreamStats stats_;
+
+    bool NextChunk();
+    void SendCurrent();
+};
+
+// Software encoding: an encoder thread hands the JPEG over through the stream while it is being
+// uploaded. encode writes into the stream and returns false on failure; Rewind() encodes again
+class StreamJpegSource : public JpegSource {
+public:
+    using Encoder = std::function<bool(JpegStream& stream)>;
+
+    StreamJpegSource(JpegStream& stream, Encoder encode);
+    ~StreamJpegSource();
+
+    bool Next(const uint8_t*& data, size_t& len) override;
+    bool Rewind() override;
+    bool failed() const override { return failed_; }
+    const JpegStreamStats* stream_stats() const override { return &stream_.stats(); }
+
+private:
+    JpegStream& stream_;
+    Encoder encode_;
+    std::thread thread_;
+    std::atomic<bool> failed_ = false;
+    JpegChunk chunk_ = {nullptr, 0};
+    bool holding_ = false;
+
+    void Start();
+    void ReleaseChunk();
+    void Stop();
+};
+
+#endif // JPEG_STREAM_H
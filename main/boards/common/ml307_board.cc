@@ -110,6 +110,34 @@ void Ml307Board::SetPowerSaveMode(bool enabled) {
     // TODO: Implement power save mode for ML307
 }
 
+cJSON* Ml307Board::GetNetworkStatus() {
+    auto network = cJSON_CreateObject();
+    cJSON_AddStringToObject(network, "type", "cellular");
+    cJSON_AddStringToObject(network, "carrier", modem_->GetCarrierName().c_str());
+    int csq = modem_->GetCsq();
+    if (csq == -1) {
+        cJSON_AddStringToObject(network, "signal", "unknown");
+    } else if (csq >= 0 && csq <= 14) {
+        cJSON_AddStringToObject(network, "signal", "very weak");
+    } else if (csq >= 15 && csq <= 19) {
+        cJSON_AddStringToObject(network, "signal", "weak");
+    } else if (csq >= 20 && csq <= 24) {
+        cJSON_AddStringToObject(network, "signal", "medium");
+    } else if (csq >= 25 && csq <= 31) {
+        cJSON_AddStringToObject(network, "signal", "strong");
+    }
+    return network;
+}
+
+std::string Ml307Board::GetNetworkStatusJson() {
+    auto network = GetNetworkStatus();
+    auto json_str = cJSON_PrintUnformatted(network);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(network);
+    return json;
+}
+
 std::string Ml307Board::GetDeviceStatusJson() {
     /*
      * 返回设备状态JSON
@@ -169,22 +197,7 @@ std::string Ml307Board::GetDeviceStatusJson() {
     }
 
     // Network
-    auto network = cJSON_CreateObject();
-    cJSON_AddStringToObject(network, "type", "cellular");
-    cJSON_AddStringToObject(network, "carrier", modem_->GetCarrierName().c_str());
-    int csq = modem_->GetCsq();
-    if (csq == -1) {
-        cJSON_AddStringToObject(network, "signal", "unknown");
-    } else if (csq >= 0 && csq <= 14) {
-        cJSON_AddStringToObject(network, "signal", "very weak");
-    } else if (csq >= 15 && csq <= 19) {
-        cJSON_AddStringToObject(network, "signal", "weak");
-    } else if (csq >= 20 && csq <= 24) {
-        cJSON_AddStringToObject(network, "signal", "medium");
-    } else if (csq >= 25 && csq <= 31) {
-        cJSON_AddStringToObject(network, "signal", "strong");
-    }
-    cJSON_AddItemToObject(root, "network", network);
+    cJSON_AddItemToObject(root, "network", GetNetworkStatus());
 
     auto json_str = cJSON_PrintUnformatted(root);
     std::string json(json_str);
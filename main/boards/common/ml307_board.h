@@ -5,6 +5,8 @@
 #include <at_modem.h>
 #include "board.h"
 
+struct cJSON;
+
 
 class Ml307Board : public Board {
 protected:
@@ -14,6 +16,7 @@ protected:
     gpio_num_t dtr_pin_;
 
     virtual std::string GetBoardJson() override;
+    cJSON* GetNetworkStatus();
 
 public:
     Ml307Board(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin = GPIO_NUM_NC);
@@ -24,6 +27,7 @@ public:
     virtual void SetPowerSaveMode(bool enabled) override;
     virtual AudioCodec* GetAudioCodec() override { return nullptr; }
     virtual std::string GetDeviceStatusJson() override;
+    virtual std::string GetNetworkStatusJson() override;
 };
 
 #endif // ML307_BOARD_H
@@ -166,6 +166,31 @@ void WifiBoard::ResetWifiConfiguration() {
     esp_restart();
 }
 
+cJSON* WifiBoard::GetNetworkStatus() {
+    auto network = cJSON_CreateObject();
+    auto& wifi_station = WifiStation::GetInstance();
+    cJSON_AddStringToObject(network, "type", "wifi");
+    cJSON_AddStringToObject(network, "ssid", wifi_station.GetSsid().c_str());
+    int rssi = wifi_station.GetRssi();
+    if (rssi >= -60) {
+        cJSON_AddStringToObject(network, "signal", "strong");
+    } else if (rssi >= -70) {
+        cJSON_AddStringToObject(network, "signal", "medium");
+    } else {
+        cJSON_AddStringToObject(network, "signal", "weak");
+    }
+    return network;
+}
+
+std::string WifiBoard::GetNetworkStatusJson() {
+    auto network = GetNetworkStatus();
+    auto json_str = cJSON_PrintUnformatted(network);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(network);
+    return json;
+}
+
 std::string WifiBoard::GetDeviceStatusJson() {
     /*
      * 返回设备状态JSON
@@ -228,19 +253,7 @@ std::string WifiBoard::GetDeviceStatusJson() {
     }
 
     // Network
-    auto network = cJSON_CreateObject();
-    auto& wifi_station = WifiStation::GetInstance();
-    cJSON_AddStringToObject(network, "type", "wifi");
-    cJSON_AddStringToObject(network, "ssid", wifi_station.GetSsid().c_str());
-    int rssi = wifi_station.GetRssi();
-    if (rssi >= -60) {
-        cJSON_AddStringToObject(network, "signal", "strong");
-    } else if (rssi >= -70) {
-        cJSON_AddStringToObject(network, "signal", "medium");
-    } else {
-        cJSON_AddStringToObject(network, "signal", "weak");
-    }
-    cJSON_AddItemToObject(root, "network", network);
+    cJSON_AddItemToObject(root, "network", GetNetworkStatus());
 
     // Chip
     float esp32temp = 0.0f;
@@ -3,11 +3,14 @@
 
 #include "board.h"
 
+struct cJSON;
+
 class WifiBoard : public Board {
 protected:
     bool wifi_config_mode_ = false;
     void EnterWifiConfigMode();
     virtual std::string GetBoardJson() override;
+    cJSON* GetNetworkStatus();
 
 public:
     WifiBoard();
@@ -19,6 +22,7 @@ public:
     virtual void ResetWifiConfiguration();
     virtual AudioCodec* GetAudioCodec() override { return nullptr; }
     virtual std::string GetDeviceStatusJson() override;
+    virtual std::string GetNetworkStatusJson() override;
 };
 
 #endif // WIFI_BOARD_H
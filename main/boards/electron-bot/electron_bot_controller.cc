@@ -354,6 +354,12 @@ public:
                                return status;
                            });
 
+        // 动作工具串行执行，停止和状态查询不排队
+        mcp_server.SetToolSerialGroup("self.electron.", "servo");
+        mcp_server.SetToolSerialGroup("self.electron.stop", "");
+        mcp_server.SetToolSerialGroup("self.electron.get_trims", "");
+        mcp_server.SetToolSerialGroup("self.electron.get_status", "");
+
         ESP_LOGI(TAG, "Electron Bot MCP工具注册完成");
     }
 
@@ -383,6 +383,9 @@ private:
             SetLedColor(r, g, b);
             return true;
         });
+
+        // 舵机动作串行执行
+        mcp_server.SetToolSerialGroup("self.dog.", "servo");
     }
 
 public:
@@ -471,6 +471,12 @@ public:
                                return status;
                            });
 
+        // 动作工具串行执行，停止和状态查询不排队
+        mcp_server.SetToolSerialGroup("self.otto.", "servo");
+        mcp_server.SetToolSerialGroup("self.otto.stop", "");
+        mcp_server.SetToolSerialGroup("self.otto.get_trims", "");
+        mcp_server.SetToolSerialGroup("self.otto.get_status", "");
+
         ESP_LOGI(TAG, "MCP工具注册完成");
     }
 
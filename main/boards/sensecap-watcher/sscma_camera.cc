@@ -7,8 +7,10 @@
 
 #include <esp_log.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
 #include <img_converters.h>
 #include <cstring>
+#include <algorithm>
 
 #define TAG "SscmaCamera"
 
@@ -110,6 +112,8 @@ SscmaCamera::SscmaCamera(esp_io_expander_handle_t io_exp_handle) {
 
     //初始化JPEG解码
     jpeg_dec_config_t config = { .output_type = JPEG_RAW_TYPE_RGB565_LE, .rotate = JPEG_ROTATE_0D };
+    // 按块（MCU 行）输出，预览不需要整帧的解码缓冲区
+    config.block_enable = true;
     jpeg_dec_ = jpeg_dec_open(&config);
     if (!jpeg_dec_) {
         ESP_LOGE(TAG, "Failed to open JPEG decoder");
@@ -132,21 +136,11 @@ SscmaCamera::SscmaCamera(esp_io_expander_handle_t io_exp_handle) {
     }
     memset(jpeg_out_, 0, sizeof(jpeg_dec_header_info_t));
 
-    // 初始化预览图片的内存
+    // 预览图片的内存在第一次拍照时按屏幕大小分配
     memset(&preview_image_, 0, sizeof(preview_image_));
     preview_image_.header.magic = LV_IMAGE_HEADER_MAGIC;
     preview_image_.header.cf = LV_COLOR_FORMAT_RGB565;
     preview_image_.header.flags = LV_IMAGE_FLAGS_ALLOCATED | LV_IMAGE_FLAGS_MODIFIABLE;
-    preview_image_.header.w = 640;
-    preview_image_.header.h = 480;
-
-    preview_image_.header.stride = preview_image_.header.w * 2;
-    preview_image_.data_size = preview_image_.header.w * preview_image_.header.h * 2;
-    preview_image_.data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM);
-    if (preview_image_.data == nullptr) {
-        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-        return;
-    }
 }
 
 SscmaCamera::~SscmaCamera() {
@@ -176,6 +170,10 @@ SscmaCamera::~SscmaCamera() {
         heap_caps_free(jpeg_out_);
         jpeg_out_ = nullptr;
     }
+    if (jpeg_block_) {
+        heap_caps_free(jpeg_block_);
+        jpeg_block_ = nullptr;
+    }
 }
 
 void SscmaCamera::SetExplainUrl(const std::string& url, const std::string& token) {
@@ -194,6 +192,7 @@ bool SscmaCamera::Capture() {
     }
 
     ESP_LOGI(TAG, "Capturing image...");
+    preview_ready_ = false;
 
     // himax 有缓存数据,需要拍两张照片, 只获取最新的照片即可.
     if (sscma_client_sample(sscma_client_handle_, 2) ) {
@@ -219,35 +218,158 @@ bool SscmaCamera::Capture() {
     }
     heap_caps_free(data.img);
 
-    //DECODE JPEG
-    if (!jpeg_dec_ || !jpeg_io_ || !jpeg_out_ || !preview_image_.data) {
+    // 预览解码失败不影响拍照结果，JPEG 仍可用于识图
+    preview_ready_ = DecodePreview();
+    if (preview_ready_) {
+        auto display = Board::GetInstance().GetDisplay();
+        if (display != nullptr) {
+            display->SetPreviewImage(&preview_image_);
+        }
+    }
+    return true;
+}
+
+// 预览宽度为屏幕的一半（与 LcdDisplay 的显示比例一致），保持照片的宽高比
+bool SscmaCamera::PreparePreview(int frame_width, int frame_height) {
+    auto display = Board::GetInstance().GetDisplay();
+    if (display == nullptr || display->width() <= 0 || display->height() <= 0) {
+        return false;
+    }
+    int width = std::min(std::max(display->width() / 2, 1), frame_width);
+    int height = std::max(frame_height * width / frame_width, 1);
+    if (height > display->height()) {
+        height = display->height();
+        width = std::max(frame_width * height / frame_height, 1);
+    }
+    if (preview_image_.data != nullptr && preview_image_.header.w == width && preview_image_.header.h == height) {
         return true;
     }
+
+    if (preview_image_.data != nullptr) {
+        // 屏幕可能还引用着旧的预览图
+        display->SetPreviewImage(nullptr);
+        heap_caps_free((void*)preview_image_.data);
+        preview_image_.data = nullptr;
+        preview_image_.data_size = 0;
+    }
+    size_t data_size = width * height * 2;
+    auto data = (uint8_t*)heap_caps_malloc(data_size, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+        return false;
+    }
+    preview_image_.header.w = width;
+    preview_image_.header.h = height;
+    preview_image_.header.stride = width * 2;
+    preview_image_.data_size = data_size;
+    preview_image_.data = data;
+    ESP_LOGI(TAG, "Preview %dx%d for %dx%d frames", width, height, frame_width, frame_height);
+    return true;
+}
+
+// 逐块解码 jpeg_data_，每块（一个 MCU 行，8 或 16 行像素）解出后立即缩小写入预览图
+bool SscmaCamera::DecodePreview() {
+    if (!jpeg_dec_ || !jpeg_io_ || !jpeg_out_) {
+        return false;
+    }
+    int64_t start_time = esp_timer_get_time();
     jpeg_io_->inbuf = jpeg_data_.buf;
     jpeg_io_->inbuf_len = jpeg_data_.len;
-    ret = jpeg_dec_parse_header(jpeg_dec_, jpeg_io_, jpeg_out_);
+    int ret = jpeg_dec_parse_header(jpeg_dec_, jpeg_io_, jpeg_out_);
     if (ret < 0) {
         ESP_LOGE(TAG, "Failed to parse JPEG header, ret: %d", ret);
-        return true;
+        return false;
     }
-    jpeg_io_->outbuf = (unsigned char*)preview_image_.data;
+    int width = jpeg_out_->width;
+    int height = jpeg_out_->height;
+    if (!PreparePreview(width, height)) {
+        return false;
+    }
+
+    int block_size = 0;
+    int block_count = 0;
+    if (jpeg_dec_get_outbuf_len(jpeg_dec_, &block_size) != JPEG_ERR_OK ||
+        jpeg_dec_get_process_count(jpeg_dec_, &block_count) != JPEG_ERR_OK || block_size <= 0) {
+        ESP_LOGE(TAG, "Failed to get JPEG block size");
+        return false;
+    }
+    if (block_size > jpeg_block_size_) {
+        if (jpeg_block_) {
+            heap_caps_free(jpeg_block_);
+        }
+        // 一块只有几十 KB，放在内部 RAM 中解码和缩小都更快
+        jpeg_block_ = (uint8_t*)heap_caps_aligned_alloc(16, block_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (jpeg_block_ == nullptr) {
+            jpeg_block_ = (uint8_t*)heap_caps_aligned_alloc(16, block_size, MALLOC_CAP_SPIRAM);
+        }
+        if (jpeg_block_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate %d bytes for JPEG block", block_size);
+            jpeg_block_size_ = 0;
+            return false;
+        }
+        jpeg_block_size_ = block_size;
+    }
+    if (!preview_scaler_.Begin(width, height, (uint16_t*)preview_image_.data,
+            preview_image_.header.w, preview_image_.header.h)) {
+        return false;
+    }
+
     int inbuf_consumed = jpeg_io_->inbuf_len - jpeg_io_->inbuf_remain;
-    jpeg_io_->inbuf =  jpeg_data_.buf + inbuf_consumed;
+    jpeg_io_->inbuf = jpeg_data_.buf + inbuf_consumed;
     jpeg_io_->inbuf_len = jpeg_io_->inbuf_remain;
-
-    ret = jpeg_dec_process(jpeg_dec_, jpeg_io_);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to decode JPEG image, ret: %d", ret);
-        return true;
+    int block_rows = block_size / (width * 2);
+    int rows = 0;
+    for (int i = 0; i < block_count && rows < height; i++) {
+        jpeg_io_->outbuf = jpeg_block_;
+        ret = jpeg_dec_process(jpeg_dec_, jpeg_io_);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to decode JPEG block %d, ret: %d", i, ret);
+            return false;
+        }
+        // 最后一块可能超出图像底部
+        int count = std::min(block_rows, height - rows);
+        preview_scaler_.Push((const uint16_t*)jpeg_block_, count);
+        rows += count;
     }
+    if (!preview_scaler_.done()) {
+        ESP_LOGE(TAG, "JPEG ended after %d of %d rows", rows, height);
+        return false;
+    }
+    ESP_LOGI(TAG, "Preview decoded from %dx%d JPEG in %d blocks, %lu ms", width, height, block_count,
+        (uint32_t)((esp_timer_get_time() - start_time) / 1000));
+    return true;
+}
+bool SscmaCamera::GetJpeg(int quality, std::vector<uint8_t>& jpeg) {
+    // SSCMA 直接输出 JPEG，quality 由模组决定
+    if (jpeg_data_.buf == nullptr || jpeg_data_.len == 0) {
+        return false;
+    }
+    jpeg.assign(jpeg_data_.buf, jpeg_data_.buf + jpeg_data_.len);
+    return true;
+}
 
-    // 显示预览图片
-    auto display = Board::GetInstance().GetDisplay();
-    if (display != nullptr) {
-        display->SetPreviewImage(&preview_image_);
+bool SscmaCamera::GetFrameHash(uint64_t& hash) {
+    // 预览图已经是缩小的整张照片，在它上面算哈希，不用再解码一遍
+    if (!preview_ready_ || preview_image_.data == nullptr) {
+        return false;
     }
+    int width = preview_image_.header.w;
+    int height = preview_image_.header.h;
+    std::vector<uint8_t> luma(width * height * 2);
+    Rgb565SwapBytes(preview_image_.data, luma.data(), width * height);
+    Rgb565ToLuma(luma.data(), width, height, 1, luma.data());
+    hash = LumaDifferenceHash(luma.data(), width, height);
     return true;
 }
+
+std::unique_ptr<JpegSource> SscmaCamera::GetJpegSource() {
+    // 模组送来的 JPEG 原样上传，不解码也不重新编码
+    if (jpeg_data_.buf == nullptr || jpeg_data_.len == 0) {
+        return nullptr;
+    }
+    return std::make_unique<BufferJpegSource>(jpeg_data_.buf, jpeg_data_.len, nullptr, 4 * 1024);
+}
+
 bool SscmaCamera::SetHMirror(bool enabled) {
     return false;
 }
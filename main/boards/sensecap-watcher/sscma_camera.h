@@ -13,6 +13,7 @@
 
 #include "sscma_client.h"
 #include "camera.h"
+#include "image_utils.h"
 
 struct SscmaData {
     uint8_t* img;
@@ -35,6 +36,14 @@ private:
     jpeg_dec_handle_t *jpeg_dec_;
     jpeg_dec_io_t *jpeg_io_;
     jpeg_dec_header_info_t *jpeg_out_;
+    // 解码器按 MCU 行输出，每行直接缩小到屏幕大小的预览图中，不存在整帧 RGB565
+    uint8_t* jpeg_block_ = nullptr;
+    int jpeg_block_size_ = 0;
+    Rgb565BandDownscaler preview_scaler_;
+    bool preview_ready_ = false;    // 预览图是最近一次拍照的
+
+    bool PreparePreview(int frame_width, int frame_height);
+    bool DecodePreview();
 public:
     SscmaCamera(esp_io_expander_handle_t io_exp_handle);
     ~SscmaCamera();
@@ -45,6 +54,9 @@ public:
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
     virtual std::string Explain(const std::string& question);
+    virtual bool GetJpeg(int quality, std::vector<uint8_t>& jpeg) override;
+    virtual bool GetFrameHash(uint64_t& hash) override;
+    virtual std::unique_ptr<JpegSource> GetJpegSource() override;
 };
 
 #endif // ESP32_CAMERA_H
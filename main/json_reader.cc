@@ -0,0 +1,336 @@
+#include "json_reader.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+
+#define JSON_READER_MAX_DEPTH 32
+
+JsonReader::JsonReader(const char* data, size_t length) {
+    if (data == nullptr) {
+        return;
+    }
+    const char* end = data + length;
+    const char* p = SkipWhitespace(data, end);
+    const char* value_end = SkipValue(p, end);
+    if (value_end == nullptr) {
+        return;
+    }
+    // Only whitespace (or the terminating zero of a C string) may follow the value
+    const char* rest = SkipWhitespace(value_end, end);
+    if (rest != end && *rest != '\0') {
+        return;
+    }
+    raw_ = std::string_view(p, value_end - p);
+    type_ = TypeOf(*p);
+}
+
+JsonReader JsonReader::Trusted(const char* data, size_t length) {
+    JsonReader reader;
+    reader.raw_ = std::string_view(data, length);
+    reader.type_ = length > 0 ? TypeOf(*data) : kJsonTypeInvalid;
+    return reader;
+}
+
+JsonType JsonReader::TypeOf(char c) {
+    switch (c) {
+        case '{': return kJsonTypeObject;
+        case '[': return kJsonTypeArray;
+        case '"': return kJsonTypeString;
+        case 't':
+        case 'f': return kJsonTypeBool;
+        case 'n': return kJsonTypeNull;
+        default: return kJsonTypeNumber;
+    }
+}
+
+const char* JsonReader::SkipWhitespace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+const char* JsonReader::SkipString(const char* p, const char* end) {
+    // p points to the opening quote
+    for (p++; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+        } else if (*p == '"') {
+            return p + 1;
+        } else if ((unsigned char)*p < 0x20) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+static inline const char* MatchLiteral(const char* p, const char* end, const char* literal) {
+    size_t length = strlen(literal);
+    if ((size_t)(end - p) < length || memcmp(p, literal, length) != 0) {
+        return nullptr;
+    }
+    return p + length;
+}
+
+const char* JsonReader::SkipValue(const char* p, const char* end, int depth) {
+    if (p == nullptr || p >= end || depth > JSON_READER_MAX_DEPTH) {
+        return nullptr;
+    }
+    switch (*p) {
+        case '"':
+            return SkipString(p, end);
+        case 't':
+            return MatchLiteral(p, end, "true");
+        case 'f':
+            return MatchLiteral(p, end, "false");
+        case 'n':
+            return MatchLiteral(p, end, "null");
+        case '{': {
+            p = SkipWhitespace(p + 1, end);
+            if (p < end && *p == '}') {
+                return p + 1;
+            }
+            while (p < end && *p == '"') {
+                p = SkipString(p, end);
+                if (p == nullptr) {
+                    return nullptr;
+                }
+                p = SkipWhitespace(p, end);
+                if (p >= end || *p != ':') {
+                    return nullptr;
+                }
+                p = SkipValue(SkipWhitespace(p + 1, end), end, depth + 1);
+                if (p == nullptr) {
+                    return nullptr;
+                }
+                p = SkipWhitespace(p, end);
+                if (p < end && *p == '}') {
+                    return p + 1;
+                }
+                if (p >= end || *p != ',') {
+                    return nullptr;
+                }
+                p = SkipWhitespace(p + 1, end);
+            }
+            return nullptr;
+        }
+        case '[': {
+            p = SkipWhitespace(p + 1, end);
+            if (p < end && *p == ']') {
+                return p + 1;
+            }
+            while (p < end) {
+                p = SkipValue(p, end, depth + 1);
+                if (p == nullptr) {
+                    return nullptr;
+                }
+                p = SkipWhitespace(p, end);
+                if (p < end && *p == ']') {
+                    return p + 1;
+                }
+                if (p >= end || *p != ',') {
+                    return nullptr;
+                }
+                p = SkipWhitespace(p + 1, end);
+            }
+            return nullptr;
+        }
+        default: {
+            const char* start = p;
+            bool has_digit = false;
+            while (p < end) {
+                char c = *p;
+                if (c >= '0' && c <= '9') {
+                    has_digit = true;
+                } else if (c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E') {
+                    break;
+                }
+                p++;
+            }
+            return (p > start && has_digit) ? p : nullptr;
+        }
+    }
+}
+
+JsonReader JsonReader::operator[](std::string_view key) const {
+    JsonReader result;
+    ForEachMember([&](std::string_view raw_key, const JsonReader& value) {
+        bool match;
+        if (raw_key.find('\\') == std::string_view::npos) {
+            match = raw_key == key;
+        } else {
+            std::string decoded;
+            match = DecodeString(raw_key, decoded) && decoded == key;
+        }
+        if (match) {
+            result = value;
+            return false;
+        }
+        return true;
+    });
+    return result;
+}
+
+bool JsonReader::Equals(std::string_view text) const {
+    if (type_ != kJsonTypeString) {
+        return false;
+    }
+    auto inner = raw_.substr(1, raw_.size() - 2);
+    if (inner.find('\\') == std::string_view::npos) {
+        return inner == text;
+    }
+    std::string decoded;
+    return DecodeString(inner, decoded) && decoded == text;
+}
+
+bool JsonReader::StartsWith(std::string_view prefix) const {
+    if (type_ != kJsonTypeString) {
+        return false;
+    }
+    auto inner = raw_.substr(1, raw_.size() - 2);
+    if (inner.find('\\') == std::string_view::npos) {
+        return inner.substr(0, prefix.size()) == prefix;
+    }
+    std::string decoded;
+    return DecodeString(inner, decoded) && decoded.compare(0, prefix.size(), prefix) == 0;
+}
+
+std::string JsonReader::GetString(const std::string& default_value) const {
+    if (type_ != kJsonTypeString) {
+        return default_value;
+    }
+    std::string result;
+    if (!DecodeString(raw_.substr(1, raw_.size() - 2), result)) {
+        return default_value;
+    }
+    return result;
+}
+
+double JsonReader::GetDouble(double default_value) const {
+    if (type_ != kJsonTypeNumber || raw_.size() >= 32) {
+        return default_value;
+    }
+    // The view is not zero terminated, copy it for strtod
+    char buffer[32];
+    memcpy(buffer, raw_.data(), raw_.size());
+    buffer[raw_.size()] = '\0';
+    return strtod(buffer, nullptr);
+}
+
+int JsonReader::GetInt(int default_value) const {
+    if (type_ != kJsonTypeNumber) {
+        return default_value;
+    }
+    // Saturate like cJSON does for valueint
+    double value = GetDouble(default_value);
+    if (value >= INT_MAX) {
+        return INT_MAX;
+    } else if (value <= (double)INT_MIN) {
+        return INT_MIN;
+    }
+    return (int)value;
+}
+
+bool JsonReader::GetBool(bool default_value) const {
+    if (type_ != kJsonTypeBool) {
+        return default_value;
+    }
+    return raw_[0] == 't';
+}
+
+cJSON* JsonReader::Parse() const {
+    if (type_ == kJsonTypeInvalid) {
+        return nullptr;
+    }
+    return cJSON_ParseWithLength(raw_.data(), raw_.size());
+}
+
+static inline int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool ReadHex4(std::string_view s, size_t pos, uint32_t& value) {
+    if (pos + 4 > s.size()) {
+        return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < 4; i++) {
+        int v = HexValue(s[pos + i]);
+        if (v < 0) {
+            return false;
+        }
+        value = (value << 4) | v;
+    }
+    return true;
+}
+
+static void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back((char)cp);
+    } else if (cp < 0x800) {
+        out.push_back((char)(0xC0 | (cp >> 6)));
+        out.push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back((char)(0xE0 | (cp >> 12)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back((char)(0xF0 | (cp >> 18)));
+        out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool JsonReader::DecodeString(std::string_view escaped, std::string& out) {
+    out.clear();
+    out.reserve(escaped.size());
+    for (size_t i = 0; i < escaped.size(); i++) {
+        char c = escaped[i];
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        if (++i >= escaped.size()) {
+            return false;
+        }
+        switch (escaped[i]) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t cp;
+                if (!ReadHex4(escaped, i + 1, cp)) {
+                    return false;
+                }
+                i += 4;
+                // Combine UTF-16 surrogate pairs
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint32_t low;
+                    if (i + 2 < escaped.size() && escaped[i + 1] == '\\' && escaped[i + 2] == 'u' &&
+                        ReadHex4(escaped, i + 3, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    } else {
+                        return false;
+                    }
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
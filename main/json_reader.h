@@ -0,0 +1,122 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <string>
+#include <string_view>
+#include <cJSON.h>
+
+enum JsonType {
+    kJsonTypeInvalid,
+    kJsonTypeNull,
+    kJsonTypeBool,
+    kJsonTypeNumber,
+    kJsonTypeString,
+    kJsonTypeArray,
+    kJsonTypeObject
+};
+
+/*
+ * A read-only view over a JSON text that never builds a DOM.
+ *
+ * Member lookups scan the raw text of the object on demand and return another view,
+ * so dispatching on `type` or `method` costs no allocation at all. Only the value that
+ * is actually used is converted (GetString / GetInt), and Parse() builds a cJSON tree
+ * for a single sub-value when a consumer really needs one.
+ *
+ * The view does not own the text, it must not outlive the buffer it was created from.
+ * Structure is validated while scanning; malformed text yields kJsonTypeInvalid.
+ */
+class JsonReader {
+public:
+    JsonReader() = default;
+    JsonReader(const char* data, size_t length);
+    explicit JsonReader(std::string_view json) : JsonReader(json.data(), json.size()) {}
+
+    inline JsonType type() const { return type_; }
+    inline bool IsValid() const { return type_ != kJsonTypeInvalid; }
+    inline bool IsNull() const { return type_ == kJsonTypeNull; }
+    inline bool IsBool() const { return type_ == kJsonTypeBool; }
+    inline bool IsNumber() const { return type_ == kJsonTypeNumber; }
+    inline bool IsString() const { return type_ == kJsonTypeString; }
+    inline bool IsArray() const { return type_ == kJsonTypeArray; }
+    inline bool IsObject() const { return type_ == kJsonTypeObject; }
+    // The raw JSON text of this value, e.g. `"abc"` or `{"a":1}`
+    inline std::string_view raw() const { return raw_; }
+
+    // Object member lookup, returns an invalid view if this is not an object or the key is missing
+    JsonReader operator[](std::string_view key) const;
+
+    // Compare a string value without unescaping it into a temporary
+    bool Equals(std::string_view text) const;
+    bool StartsWith(std::string_view prefix) const;
+
+    std::string GetString(const std::string& default_value = "") const;
+    int GetInt(int default_value = 0) const;
+    double GetDouble(double default_value = 0) const;
+    bool GetBool(bool default_value = false) const;
+
+    // Build a cJSON tree for this value only, the caller must cJSON_Delete() it
+    cJSON* Parse() const;
+
+    // callback(std::string_view key, const JsonReader& value) -> bool, return false to stop
+    template<typename Callback>
+    void ForEachMember(Callback&& callback) const {
+        if (type_ != kJsonTypeObject) {
+            return;
+        }
+        const char* p = SkipWhitespace(raw_.data() + 1, End());
+        while (p < End() && *p == '"') {
+            const char* key_end = SkipString(p, End());
+            std::string_view key(p + 1, key_end - p - 2);
+            p = SkipWhitespace(key_end, End());
+            p = SkipWhitespace(p + 1, End());   // ':'
+            const char* value_end = SkipValue(p, End());
+            if (!callback(key, Trusted(p, value_end - p))) {
+                return;
+            }
+            p = SkipWhitespace(value_end, End());
+            if (*p != ',') {
+                return;
+            }
+            p = SkipWhitespace(p + 1, End());
+        }
+    }
+
+    // callback(const JsonReader& element) -> bool, return false to stop
+    template<typename Callback>
+    void ForEachElement(Callback&& callback) const {
+        if (type_ != kJsonTypeArray) {
+            return;
+        }
+        const char* p = SkipWhitespace(raw_.data() + 1, End());
+        while (p < End() && *p != ']') {
+            const char* value_end = SkipValue(p, End());
+            if (!callback(Trusted(p, value_end - p))) {
+                return;
+            }
+            p = SkipWhitespace(value_end, End());
+            if (*p != ',') {
+                return;
+            }
+            p = SkipWhitespace(p + 1, End());
+        }
+    }
+
+    // Unescape the content between the quotes of a JSON string into out
+    static bool DecodeString(std::string_view escaped, std::string& out);
+
+private:
+    std::string_view raw_;
+    JsonType type_ = kJsonTypeInvalid;
+
+    inline const char* End() const { return raw_.data() + raw_.size(); }
+    // Wrap a sub-value of an already validated text without scanning it again
+    static JsonReader Trusted(const char* data, size_t length);
+    static JsonType TypeOf(char c);
+
+    static const char* SkipWhitespace(const char* p, const char* end);
+    static const char* SkipString(const char* p, const char* end);
+    static const char* SkipValue(const char* p, const char* end, int depth = 0);
+};
+
+#endif // JSON_READER_H
@@ -0,0 +1,241 @@
+#include "json_writer.h"
+
+#include <cstring>
+#include <algorithm>
+
+static const char kHexDigits[] = "0123456789abcdef";
+
+// Bytes that must be escaped inside a JSON string: control characters, quote and backslash
+static const struct EscapeTable {
+    bool needs_escape[256];
+    constexpr EscapeTable() : needs_escape() {
+        for (int c = 0; c < 0x20; c++) {
+            needs_escape[c] = true;
+        }
+        needs_escape['"'] = true;
+        needs_escape['\\'] = true;
+    }
+} kEscapeTable;
+
+static inline bool NeedsEscape(unsigned char c) {
+    return kEscapeTable.needs_escape[c];
+}
+
+static const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Returns the number of characters written, size must be a multiple of 3 except for the last chunk
+static size_t EncodeBase64(const uint8_t* data, size_t size, char* out) {
+    char* p = out;
+    size_t i = 0;
+    // Four groups per round, the loads and table lookups of one round do not depend on each other
+    for (; i + 12 <= size; i += 12, p += 16) {
+        for (int k = 0; k < 4; k++) {
+            const uint8_t* in = data + i + k * 3;
+            uint32_t v = (uint32_t)in[0] << 16 | (uint32_t)in[1] << 8 | in[2];
+            p[k * 4] = kBase64Alphabet[v >> 18];
+            p[k * 4 + 1] = kBase64Alphabet[(v >> 12) & 0x3F];
+            p[k * 4 + 2] = kBase64Alphabet[(v >> 6) & 0x3F];
+            p[k * 4 + 3] = kBase64Alphabet[v & 0x3F];
+        }
+    }
+    for (; i + 3 <= size; i += 3, p += 4) {
+        uint32_t v = (uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8 | data[i + 2];
+        p[0] = kBase64Alphabet[v >> 18];
+        p[1] = kBase64Alphabet[(v >> 12) & 0x3F];
+        p[2] = kBase64Alphabet[(v >> 6) & 0x3F];
+        p[3] = kBase64Alphabet[v & 0x3F];
+    }
+    if (i < size) {
+        uint32_t v = (uint32_t)data[i] << 16 | (i + 1 < size ? (uint32_t)data[i + 1] << 8 : 0);
+        p[0] = kBase64Alphabet[v >> 18];
+        p[1] = kBase64Alphabet[(v >> 12) & 0x3F];
+        p[2] = i + 1 < size ? kBase64Alphabet[(v >> 6) & 0x3F] : '=';
+        p[3] = '=';
+        p += 4;
+    }
+    return p - out;
+}
+
+// Slow path of Append(): the std::string target, or a fixed buffer that is full
+void JsonWriter::Grow(const char* data, size_t length) {
+    if (output_ != nullptr) {
+        output_->append(data, length);
+        return;
+    }
+    // Stop writing at the first chunk that does not fit, so a later smaller chunk
+    // cannot produce a truncated but seemingly complete message
+    overflow_ = true;
+    capacity_ = length_;
+}
+
+void JsonWriter::BeforeValue() {
+    if (after_key_) {
+        after_key_ = false;
+        return;
+    }
+    if (has_value_ & (1u << depth_)) {
+        Append(',');
+    }
+    has_value_ |= (1u << depth_);
+}
+
+void JsonWriter::WriteKey(const char* key, size_t length, bool escape) {
+    if (has_value_ & (1u << depth_)) {
+        Append(',');
+    }
+    has_value_ |= (1u << depth_);
+    Append('"');
+    if (escape) {
+        WriteEscaped(std::string_view(key, length));
+    } else {
+        Append(key, length);
+    }
+    Append("\":", 2);
+    after_key_ = true;
+}
+
+void JsonWriter::BeginObject() {
+    BeforeValue();
+    if (skipped_depth_ > 0 || depth_ + 1 >= JSON_WRITER_MAX_DEPTH) {
+        overflow_ = true;
+        skipped_depth_++;
+        return;
+    }
+    depth_++;
+    has_value_ &= ~(1u << depth_);
+    Append('{');
+}
+
+void JsonWriter::EndObject() {
+    if (skipped_depth_ > 0) {
+        skipped_depth_--;
+        return;
+    }
+    if (depth_ > 0) {
+        depth_--;
+    }
+    Append('}');
+}
+
+void JsonWriter::BeginArray() {
+    BeforeValue();
+    if (skipped_depth_ > 0 || depth_ + 1 >= JSON_WRITER_MAX_DEPTH) {
+        overflow_ = true;
+        skipped_depth_++;
+        return;
+    }
+    depth_++;
+    has_value_ &= ~(1u << depth_);
+    Append('[');
+}
+
+void JsonWriter::EndArray() {
+    if (skipped_depth_ > 0) {
+        skipped_depth_--;
+        return;
+    }
+    if (depth_ > 0) {
+        depth_--;
+    }
+    Append(']');
+}
+
+void JsonWriter::String(std::string_view value) {
+    BeforeValue();
+    Append('"');
+    WriteEscaped(value);
+    Append('"');
+}
+
+void JsonWriter::Int(int64_t value) {
+    BeforeValue();
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    // Work on the unsigned magnitude so INT64_MIN does not overflow
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    do {
+        *--p = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+    Append(p, digits + sizeof(digits) - p);
+}
+
+void JsonWriter::Bool(bool value) {
+    BeforeValue();
+    if (value) {
+        Append("true", 4);
+    } else {
+        Append("false", 5);
+    }
+}
+
+void JsonWriter::Null() {
+    BeforeValue();
+    Append("null", 4);
+}
+
+void JsonWriter::Raw(std::string_view json) {
+    BeforeValue();
+    Append(json.data(), json.size());
+}
+
+void JsonWriter::Base64(const uint8_t* data, size_t size) {
+    BeforeValue();
+    Append('"');
+    if (output_ != nullptr) {
+        // Grow the string once by the exact encoded size and encode in place
+        size_t offset = output_->size();
+        output_->resize(offset + Base64Length(size));
+        EncodeBase64(data, size, output_->data() + offset);
+    } else {
+        // Fixed buffer, go through a small chunk so Append() can still detect the overflow
+        char chunk[256];
+        for (size_t i = 0; i < size && ok(); i += 192) {
+            size_t n = std::min<size_t>(192, size - i);
+            Append(chunk, EncodeBase64(data + i, n, chunk));
+        }
+    }
+    Append('"');
+}
+
+void JsonWriter::AppendBase64(const uint8_t* data, size_t size, std::string& out) {
+    size_t offset = out.size();
+    out.resize(offset + Base64Length(size));
+    EncodeBase64(data, size, out.data() + offset);
+}
+
+void JsonWriter::WriteEscaped(std::string_view text) {
+    // Copy runs of plain bytes in one go, most text needs no escaping at all
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if (!NeedsEscape(c)) {
+            continue;
+        }
+        Append(text.data() + start, i - start);
+        start = i + 1;
+        switch (c) {
+            case '"': Append("\\\"", 2); break;
+            case '\\': Append("\\\\", 2); break;
+            case '\n': Append("\\n", 2); break;
+            case '\r': Append("\\r", 2); break;
+            case '\t': Append("\\t", 2); break;
+            case '\b': Append("\\b", 2); break;
+            case '\f': Append("\\f", 2); break;
+            default: {
+                char escaped[6] = { '\\', 'u', '0', '0', kHexDigits[c >> 4], kHexDigits[c & 0xF] };
+                Append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    Append(text.data() + start, text.size() - start);
+}
+
+void JsonWriter::Escape(std::string_view text, std::string& out) {
+    JsonWriter writer(out);
+    writer.WriteEscaped(text);
+}
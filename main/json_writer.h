@@ -0,0 +1,126 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+/*
+ * Writes compact JSON straight into a caller provided buffer.
+ *
+ * The shape of a message is spelled out in code (BeginObject / Key / value / EndObject),
+ * so nothing is built in between: no cJSON tree, no temporary strings. Commas are tracked
+ * with one bit per nesting level. String values and dynamic keys are escaped; keys given
+ * as string literals are copied as they are, their length is known at compile time.
+ *
+ * Two targets are supported:
+ * - a fixed char buffer, for small messages built on the stack. Running out of space
+ *   marks the writer as overflowed instead of writing past the end, check ok().
+ * - a std::string, for payloads without a known bound. Reserve it once up front and
+ *   the writer only appends.
+ *
+ * Example:
+ *   char buffer[128];
+ *   JsonWriter writer(buffer, sizeof(buffer));
+ *   writer.BeginObject();
+ *   writer.Field("type", "listen");
+ *   writer.Field("text", wake_word);
+ *   writer.EndObject();
+ *   if (writer.ok()) Send(writer.view());
+ */
+class JsonWriter {
+public:
+    JsonWriter(char* buffer, size_t capacity) : buffer_(buffer), capacity_(capacity) {}
+    explicit JsonWriter(std::string& output) : output_(&output), output_start_(output.size()) {}
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    // Keys written from a string literal are trusted to need no escaping
+    template<size_t N>
+    inline void Key(const char (&key)[N]) {
+        WriteKey(key, N - 1, false);
+    }
+    inline void Key(std::string_view key) {
+        WriteKey(key.data(), key.size(), true);
+    }
+
+    void String(std::string_view value);
+    void Int(int64_t value);
+    void Bool(bool value);
+    void Null();
+    // Insert an already serialized JSON value, e.g. a payload produced elsewhere
+    void Raw(std::string_view json);
+    // A string value holding data as standard base64, encoded straight into the output
+    void Base64(const uint8_t* data, size_t size);
+
+    template<size_t N, typename T>
+    inline void Field(const char (&key)[N], const T& value) {
+        Key(key);
+        Value(value);
+    }
+
+    // Whether everything fit into the buffer
+    inline bool ok() const { return !overflow_; }
+    inline size_t size() const { return output_ != nullptr ? output_->size() - output_start_ : length_; }
+    inline std::string_view view() const {
+        return output_ != nullptr ? std::string_view(*output_).substr(output_start_) : std::string_view(buffer_, length_);
+    }
+
+    // Escape a string into out without the surrounding quotes
+    static void Escape(std::string_view text, std::string& out);
+    static inline size_t Base64Length(size_t size) { return (size + 2) / 3 * 4; }
+    // Base64 of data appended to out without quotes, for a value that is sent in pieces.
+    // Every piece but the last must be a multiple of 3 bytes long
+    static void AppendBase64(const uint8_t* data, size_t size, std::string& out);
+
+private:
+    char* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t length_ = 0;
+    std::string* output_ = nullptr;
+    size_t output_start_ = 0;
+    bool overflow_ = false;
+
+    int depth_ = 0;
+    // Containers opened past JSON_WRITER_MAX_DEPTH, their End*() calls are skipped too
+    int skipped_depth_ = 0;
+    // Bit n is set once the container at depth n holds a value, so the next one needs a comma
+    uint32_t has_value_ = 0;
+    bool after_key_ = false;
+
+    inline void Value(std::string_view value) { String(value); }
+    inline void Value(const char* value) { String(value); }
+    inline void Value(const std::string& value) { String(value); }
+    inline void Value(bool value) { Bool(value); }
+    inline void Value(int value) { Int(value); }
+    inline void Value(int64_t value) { Int(value); }
+
+    void BeforeValue();
+    void WriteKey(const char* key, size_t length, bool escape);
+    void WriteEscaped(std::string_view text);
+    void Grow(const char* data, size_t length);
+    inline void Append(const char* data, size_t length) {
+        if (output_ == nullptr && length <= capacity_ - length_) {
+            memcpy(buffer_ + length_, data, length);
+            length_ += length;
+        } else {
+            Grow(data, length);
+        }
+    }
+    inline void Append(char c) {
+        if (output_ == nullptr && length_ < capacity_) {
+            buffer_[length_++] = c;
+        } else {
+            Grow(&c, 1);
+        }
+    }
+};
+
+#endif // JSON_WRITER_H
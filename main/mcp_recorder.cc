@@ -0,0 +1,99 @@
+#include "mcp_recorder.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#define TAG "McpRecorder"
+
+McpRecorder::McpRecorder() {
+    buffer_ = (char*)heap_caps_malloc(MCP_RECORDER_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for the recorder", MCP_RECORDER_BUFFER_SIZE);
+        return;
+    }
+    capacity_ = MCP_RECORDER_BUFFER_SIZE;
+}
+
+McpRecorder::~McpRecorder() {
+    if (buffer_ != nullptr) {
+        heap_caps_free(buffer_);
+    }
+}
+
+// Copies across the end of the ring
+void McpRecorder::Write(size_t offset, const void* data, size_t length) {
+    offset %= capacity_;
+    size_t first = std::min(length, capacity_ - offset);
+    memcpy(buffer_ + offset, data, first);
+    memcpy(buffer_, (const char*)data + first, length - first);
+}
+
+void McpRecorder::Read(size_t offset, void* data, size_t length) const {
+    offset %= capacity_;
+    size_t first = std::min(length, capacity_ - offset);
+    memcpy(data, buffer_ + offset, first);
+    memcpy((char*)data + first, buffer_, length - first);
+}
+
+void McpRecorder::Record(std::string_view message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t size = sizeof(RecordHeader) + message.size();
+    if (size > capacity_) {
+        dropped_++;
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (start_time_us_ < 0) {
+        start_time_us_ = now;
+    }
+    while (capacity_ - used_ < size) {
+        RecordHeader oldest;
+        Read(head_, &oldest, sizeof(oldest));
+        head_ = (head_ + sizeof(oldest) + oldest.length) % capacity_;
+        used_ -= sizeof(oldest) + oldest.length;
+        count_--;
+        dropped_++;
+    }
+
+    RecordHeader header = {
+        .length = (uint32_t)message.size(),
+        .time_ms = (uint32_t)((now - start_time_us_) / 1000),
+    };
+    size_t tail = head_ + used_;
+    Write(tail, &header, sizeof(header));
+    Write(tail + sizeof(header), message.data(), message.size());
+    used_ += size;
+    count_++;
+}
+
+void McpRecorder::Dump(FILE* out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ESP_LOGI(TAG, "Dumping %lu messages, %lu dropped", count_, dropped_);
+    std::string message;
+    size_t offset = head_;
+    for (uint32_t i = 0; i < count_; i++) {
+        RecordHeader header;
+        Read(offset, &header, sizeof(header));
+        message.resize(header.length);
+        Read(offset + sizeof(header), message.data(), header.length);
+        offset += sizeof(header) + header.length;
+        // Line breaks can only be whitespace between tokens, a string would have them escaped
+        std::replace_if(message.begin(), message.end(), [](char c) { return c == '\n' || c == '\r'; }, ' ');
+        fprintf(out, "{\"t\":%lu,\"msg\":%s}\n", header.time_ms, message.c_str());
+    }
+    fflush(out);
+}
+
+void McpRecorder::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    head_ = 0;
+    used_ = 0;
+    count_ = 0;
+    dropped_ = 0;
+    start_time_us_ = -1;
+}
@@ -0,0 +1,54 @@
+#ifndef MCP_RECORDER_H
+#define MCP_RECORDER_H
+
+#include <string_view>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+
+#ifdef CONFIG_MCP_RECORDER_BUFFER_SIZE
+#define MCP_RECORDER_BUFFER_SIZE (CONFIG_MCP_RECORDER_BUFFER_SIZE * 1024)
+#else
+#define MCP_RECORDER_BUFFER_SIZE (64 * 1024)
+#endif
+
+/*
+ * Keeps the latest incoming MCP messages with their arrival time in a ring in PSRAM, the
+ * oldest messages are dropped when it is full. Dump() writes them out as JSON lines that
+ * scripts/mcp_replay pushes through McpServer::ParseMessage() on the host.
+ */
+class McpRecorder {
+public:
+    static McpRecorder& GetInstance() {
+        static McpRecorder instance;
+        return instance;
+    }
+
+    void Record(std::string_view message);
+    // One line per message: {"t":<ms since the first recorded message>,"msg":<message>}
+    void Dump(FILE* out);
+    void Clear();
+
+private:
+    McpRecorder();
+    ~McpRecorder();
+
+    struct RecordHeader {
+        uint32_t length;
+        uint32_t time_ms;
+    };
+
+    std::mutex mutex_;
+    char* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t head_ = 0;   // Offset of the oldest record
+    size_t used_ = 0;
+    uint32_t count_ = 0;
+    uint32_t dropped_ = 0;
+    int64_t start_time_us_ = -1;
+
+    void Write(size_t offset, const void* data, size_t length);
+    void Read(size_t offset, void* data, size_t length) const;
+};
+
+#endif // MCP_RECORDER_H
@@ -0,0 +1,436 @@
+#ifndef MCP_SCHEMA_H
+#define MCP_SCHEMA_H
+
+#include "mcp_server.h"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+
+/*
+ * Compile-time tool definitions.
+ *
+ *   struct VolumeArgs {
+ *       int volume;
+ *   };
+ *   using VolumeSchema = McpSchema<
+ *       McpInt<"volume", &VolumeArgs::volume, McpRange(0, 100)>>;
+ *
+ *   mcp_server.AddTool<VolumeSchema>("self.audio_speaker.set_volume", "Set the volume.",
+ *       [](const VolumeArgs& args) -> ReturnValue { ... });
+ *
+ * The inputSchema JSON is a constant produced by the compiler. A tools/call is decoded in
+ * one pass over the arguments object straight into the struct, range checks are generated
+ * from the declaration, and a bad argument is reported as an error string instead of an
+ * exception. Nothing is copied from a PropertyList and no name is looked up at call time.
+ *
+ * Fields:
+ *   McpInt<"name", &Args::member>                          required integer
+ *   McpInt<"name", &Args::member, McpRange(0, 100)>         required, with minimum / maximum
+ *   McpInt<"name", &Args::member, McpRange(1, 10).Default(3)>
+ *   McpInt<"name", &Args::member, McpDefault(3)>
+ *   McpBool<"name", &Args::member[, McpDefault(true)]>
+ *   McpString<"name", &Args::member[, McpDefault("text")]>  std::string member
+ */
+
+template<size_t N>
+struct McpLiteral {
+    char value[N];
+
+    constexpr McpLiteral(const char (&text)[N]) {
+        std::copy_n(text, N, value);
+    }
+    constexpr std::string_view view() const { return std::string_view(value, N - 1); }
+};
+
+// Writes JSON text into buffer, or only counts its length when buffer is null
+class McpSchemaSink {
+public:
+    constexpr explicit McpSchemaSink(char* buffer) : buffer_(buffer) {}
+
+    constexpr void Append(char c) {
+        if (buffer_ != nullptr) {
+            buffer_[length_] = c;
+        }
+        length_++;
+    }
+
+    constexpr void Append(std::string_view text) {
+        for (char c : text) {
+            Append(c);
+        }
+    }
+
+    constexpr void AppendInt(int value) {
+        char digits[12] = {};
+        int count = 0;
+        unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+        do {
+            digits[count++] = '0' + (magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (value < 0) {
+            Append('-');
+        }
+        while (count > 0) {
+            Append(digits[--count]);
+        }
+    }
+
+    // Same escaping rules as JsonWriter
+    constexpr void AppendString(std::string_view text) {
+        constexpr char hex[] = "0123456789abcdef";
+        Append('"');
+        for (char ch : text) {
+            unsigned char c = ch;
+            if (c == '"' || c == '\\') {
+                Append('\\');
+                Append(ch);
+            } else if (c < 0x20) {
+                Append("\\u00");
+                Append(hex[c >> 4]);
+                Append(hex[c & 0xF]);
+            } else {
+                Append(ch);
+            }
+        }
+        Append('"');
+    }
+
+    constexpr size_t length() const { return length_; }
+
+private:
+    char* buffer_;
+    size_t length_ = 0;
+};
+
+struct McpRequired {};
+
+struct McpIntSpec {
+    bool has_range = false;
+    int min_value = 0;
+    int max_value = 0;
+    bool has_default = false;
+    int default_value = 0;
+
+    constexpr McpIntSpec Default(int value) const {
+        McpIntSpec spec = *this;
+        spec.has_default = true;
+        spec.default_value = value;
+        return spec;
+    }
+};
+
+struct McpBoolDefault {
+    bool value;
+};
+
+template<size_t N>
+struct McpStringDefault {
+    McpLiteral<N> value;
+};
+
+constexpr McpIntSpec McpRange(int min_value, int max_value) {
+    return McpIntSpec{true, min_value, max_value};
+}
+
+constexpr McpIntSpec McpDefault(int value) {
+    return McpIntSpec{}.Default(value);
+}
+
+constexpr McpBoolDefault McpDefault(bool value) {
+    return McpBoolDefault{value};
+}
+
+template<size_t N>
+constexpr McpStringDefault<N> McpDefault(const char (&value)[N]) {
+    return McpStringDefault<N>{McpLiteral<N>(value)};
+}
+
+template<typename T>
+struct McpMemberTraits;
+
+template<typename C, typename T>
+struct McpMemberTraits<T C::*> {
+    using Class = C;
+    using Type = T;
+};
+
+template<typename T>
+struct McpIsStringDefault : std::false_type {};
+
+template<size_t N>
+struct McpIsStringDefault<McpStringDefault<N>> : std::true_type {};
+
+template<McpLiteral Name, auto Member, McpIntSpec Spec = McpIntSpec{}>
+struct McpInt {
+    using Args = typename McpMemberTraits<decltype(Member)>::Class;
+    static_assert(std::is_same_v<typename McpMemberTraits<decltype(Member)>::Type, int>, "McpInt needs an int member");
+    static_assert(!Spec.has_range || Spec.min_value <= Spec.max_value, "Minimum is above maximum");
+    static_assert(!Spec.has_default || !Spec.has_range ||
+        (Spec.default_value >= Spec.min_value && Spec.default_value <= Spec.max_value),
+        "Default value must be within the specified range");
+
+    static constexpr std::string_view name = Name.view();
+    static constexpr bool required = !Spec.has_default;
+
+    static constexpr void WriteSchema(McpSchemaSink& sink) {
+        sink.Append("{\"type\":\"integer\"");
+        if (Spec.has_default) {
+            sink.Append(",\"default\":");
+            sink.AppendInt(Spec.default_value);
+        }
+        if (Spec.has_range) {
+            sink.Append(",\"minimum\":");
+            sink.AppendInt(Spec.min_value);
+            sink.Append(",\"maximum\":");
+            sink.AppendInt(Spec.max_value);
+        }
+        sink.Append('}');
+    }
+
+    static bool Decode(const JsonReader& value, Args& args, std::string& error) {
+        if (!value.IsNumber()) {
+            return SetDefault(args, error);
+        }
+        int number = value.GetInt();
+        if constexpr (Spec.has_range) {
+            if (number < Spec.min_value) {
+                error = "Value is below minimum allowed: " + std::to_string(Spec.min_value);
+                return false;
+            }
+            if (number > Spec.max_value) {
+                error = "Value exceeds maximum allowed: " + std::to_string(Spec.max_value);
+                return false;
+            }
+        }
+        args.*Member = number;
+        return true;
+    }
+
+    static bool SetDefault(Args& args, std::string& error) {
+        if constexpr (Spec.has_default) {
+            args.*Member = Spec.default_value;
+            return true;
+        } else {
+            error = "Missing valid argument: ";
+            error += name;
+            return false;
+        }
+    }
+};
+
+template<McpLiteral Name, auto Member, auto Spec = McpRequired{}>
+struct McpBool {
+    using Args = typename McpMemberTraits<decltype(Member)>::Class;
+    static_assert(std::is_same_v<typename McpMemberTraits<decltype(Member)>::Type, bool>, "McpBool needs a bool member");
+    static constexpr bool has_default = std::is_same_v<std::remove_cv_t<decltype(Spec)>, McpBoolDefault>;
+    static_assert(has_default || std::is_same_v<std::remove_cv_t<decltype(Spec)>, McpRequired>, "Use McpDefault(true / false)");
+
+    static constexpr std::string_view name = Name.view();
+    static constexpr bool required = !has_default;
+
+    static constexpr void WriteSchema(McpSchemaSink& sink) {
+        sink.Append("{\"type\":\"boolean\"");
+        if constexpr (has_default) {
+            sink.Append(Spec.value ? ",\"default\":true" : ",\"default\":false");
+        }
+        sink.Append('}');
+    }
+
+    static bool Decode(const JsonReader& value, Args& args, std::string& error) {
+        if (!value.IsBool()) {
+            return SetDefault(args, error);
+        }
+        args.*Member = value.GetBool();
+        return true;
+    }
+
+    static bool SetDefault(Args& args, std::string& error) {
+        if constexpr (has_default) {
+            args.*Member = Spec.value;
+            return true;
+        } else {
+            error = "Missing valid argument: ";
+            error += name;
+            return false;
+        }
+    }
+};
+
+template<McpLiteral Name, auto Member, auto Spec = McpRequired{}>
+struct McpString {
+    using Args = typename McpMemberTraits<decltype(Member)>::Class;
+    static_assert(std::is_same_v<typename McpMemberTraits<decltype(Member)>::Type, std::string>, "McpString needs a std::string member");
+    static constexpr bool has_default = McpIsStringDefault<std::remove_cv_t<decltype(Spec)>>::value;
+    static_assert(has_default || std::is_same_v<std::remove_cv_t<decltype(Spec)>, McpRequired>, "Use McpDefault(\"text\")");
+
+    static constexpr std::string_view name = Name.view();
+    static constexpr bool required = !has_default;
+
+    static constexpr void WriteSchema(McpSchemaSink& sink) {
+        sink.Append("{\"type\":\"string\"");
+        if constexpr (has_default) {
+            sink.Append(",\"default\":");
+            sink.AppendString(Spec.value.view());
+        }
+        sink.Append('}');
+    }
+
+    static bool Decode(const JsonReader& value, Args& args, std::string& error) {
+        if (!value.IsString()) {
+            return SetDefault(args, error);
+        }
+        args.*Member = value.GetString();
+        return true;
+    }
+
+    static bool SetDefault(Args& args, std::string& error) {
+        if constexpr (has_default) {
+            args.*Member = std::string(Spec.value.view());
+            return true;
+        } else {
+            error = "Missing valid argument: ";
+            error += name;
+            return false;
+        }
+    }
+};
+
+template<typename Field>
+constexpr void McpWriteProperty(McpSchemaSink& sink, bool& first) {
+    if (!first) {
+        sink.Append(',');
+    }
+    first = false;
+    sink.AppendString(Field::name);
+    sink.Append(':');
+    Field::WriteSchema(sink);
+}
+
+template<typename Field>
+constexpr void McpWriteRequired(McpSchemaSink& sink, bool& first) {
+    if constexpr (Field::required) {
+        if (!first) {
+            sink.Append(',');
+        }
+        first = false;
+        sink.AppendString(Field::name);
+    }
+}
+
+// The inputSchema object, in the same layout PropertyList produces
+template<typename... Fields>
+constexpr void McpWriteSchema(McpSchemaSink& sink) {
+    sink.Append("{\"type\":\"object\",\"properties\":{");
+    bool first = true;
+    (McpWriteProperty<Fields>(sink, first), ...);
+    sink.Append('}');
+    if constexpr ((Fields::required || ...)) {
+        sink.Append(",\"required\":[");
+        first = true;
+        (McpWriteRequired<Fields>(sink, first), ...);
+        sink.Append(']');
+    }
+    sink.Append('}');
+}
+
+template<typename... Fields>
+struct McpSchema {
+    static_assert(sizeof...(Fields) > 0, "A tool without arguments does not need a schema");
+    static_assert(sizeof...(Fields) <= 32, "Too many fields");
+    using Args = typename std::tuple_element_t<0, std::tuple<Fields...>>::Args;
+    using Callback = std::function<ReturnValue(const Args&)>;
+    static_assert((std::is_same_v<typename Fields::Args, Args> && ...), "All fields must belong to the same struct");
+
+    static constexpr size_t kJsonLength = [] {
+        McpSchemaSink sink(nullptr);
+        McpWriteSchema<Fields...>(sink);
+        return sink.length();
+    }();
+    static constexpr std::array<char, kJsonLength> kJsonData = [] {
+        std::array<char, kJsonLength> data = {};
+        McpSchemaSink sink(data.data());
+        McpWriteSchema<Fields...>(sink);
+        return data;
+    }();
+    static constexpr std::string_view kJson = std::string_view(kJsonData.data(), kJsonLength);
+
+    // One pass over the arguments object, then defaults for whatever was not present
+    static bool Decode(const JsonReader& arguments, Args& args, std::string& error) {
+        uint32_t seen = 0;
+        bool ok = true;
+        arguments.ForEachMember([&](std::string_view key, const JsonReader& value) {
+            size_t index = 0;
+            ok = (DecodeMember<Fields>(key, value, args, error, index, seen) && ...);
+            return ok;
+        });
+        if (!ok) {
+            return false;
+        }
+        size_t index = 0;
+        return (DecodeMissing<Fields>(args, error, index, seen) && ...);
+    }
+
+private:
+    template<typename F>
+    static bool DecodeMember(std::string_view key, const JsonReader& value, Args& args, std::string& error,
+        size_t& index, uint32_t& seen) {
+        uint32_t bit = 1u << index++;
+        if (key != F::name || (seen & bit)) {
+            return true;
+        }
+        seen |= bit;
+        return F::Decode(value, args, error);
+    }
+
+    template<typename F>
+    static bool DecodeMissing(Args& args, std::string& error, size_t& index, uint32_t seen) {
+        uint32_t bit = 1u << index++;
+        return (seen & bit) || F::SetDefault(args, error);
+    }
+};
+
+template<typename Schema>
+class McpTypedTool : public McpTool {
+public:
+    using Args = typename Schema::Args;
+
+    McpTypedTool(const std::string& name, const std::string& description, typename Schema::Callback callback)
+        : McpTool(name, description), callback_(std::move(callback)) {}
+
+    std::shared_ptr<McpToolCall> Bind(const JsonReader& arguments, std::string& error) override {
+        auto call = std::make_shared<BoundCall>(this);
+        if (!Schema::Decode(arguments, call->args, error)) {
+            return nullptr;
+        }
+        return call;
+    }
+
+    void WriteInputSchema(JsonWriter& writer) const override {
+        writer.Raw(Schema::kJson);
+    }
+
+    ReturnValue Call(McpToolCall& call) override {
+        return callback_(static_cast<BoundCall&>(call).args);
+    }
+
+private:
+    class BoundCall : public McpToolCall {
+    public:
+        explicit BoundCall(McpTool* tool) : McpToolCall(tool) {}
+        Args args = {};
+    };
+
+    typename Schema::Callback callback_;
+};
+
+template<typename Schema>
+void McpServer::AddTool(const std::string& name, const std::string& description, typename Schema::Callback callback) {
+    AddTool(new McpTypedTool<Schema>(name, description, std::move(callback)));
+}
+
+#endif // MCP_SCHEMA_H
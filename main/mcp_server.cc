@@ -4,11 +4,15 @@
  */
 
 #include "mcp_server.h"
+#include "mcp_schema.h"
+#include "mcp_tool_executor.h"
+#include "mcp_recorder.h"
 #include <esp_log.h>
 #include <esp_app_desc.h>
 #include <algorithm>
 #include <cstring>
-#include <esp_pthread.h>
+#include <iterator>
+#include <esp_heap_caps.h>
 
 #include "application.h"
 #include "display.h"
@@ -17,15 +21,66 @@
 #define TAG "MCP"
 
 #define DEFAULT_TOOLCALL_STACK_SIZE 6144
+// self.camera.get_photo returns the photo inline, a low quality keeps the reply small
+#define MCP_PHOTO_JPEG_QUALITY 60
+
+struct VolumeArgs {
+    int volume;
+};
+using VolumeSchema = McpSchema<
+    McpInt<"volume", &VolumeArgs::volume, McpRange(0, 100)>>;
+
+struct BrightnessArgs {
+    int brightness;
+};
+using BrightnessSchema = McpSchema<
+    McpInt<"brightness", &BrightnessArgs::brightness, McpRange(0, 100)>>;
+
+struct ThemeArgs {
+    std::string theme;
+};
+using ThemeSchema = McpSchema<
+    McpString<"theme", &ThemeArgs::theme>>;
+
+// Names of Application's DeviceState for the device://state resource
+static const char* const kDeviceStateNames[] = {
+    "booting", "idle", "listening", "thinking", "speaking",
+    "capturing_photo", "analyzing_photo", "generating_response", "error"
+};
 
 McpServer::McpServer() {
+    tool_executor_ = std::make_unique<McpToolExecutor>(
+        [this](int id, const ReturnValue& value) { ReplyToolResult(id, value); },
+        [this](int id, const std::string& message) { ReplyError(id, message); },
+        [this](const std::string& progress_token, int progress, int total, const std::string& message) {
+            SendProgress(progress_token, progress, total, message);
+        });
+
+    esp_timer_create_args_t poll_timer_args = {
+        .callback = [](void *arg) {
+            // Readers may talk to the modem, keep that off the esp_timer task
+            auto server = static_cast<McpServer*>(arg);
+            server->tool_executor_->Post([server]() {
+                server->PollResources();
+            });
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "mcp_resources",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&poll_timer_args, &resource_poll_timer_));
 }
 
 McpServer::~McpServer() {
+    esp_timer_stop(resource_poll_timer_);
+    esp_timer_delete(resource_poll_timer_);
+    tool_executor_.reset();
     for (auto tool : tools_) {
         delete tool;
     }
     tools_.clear();
+    tool_index_.clear();
 }
 
 void McpServer::AddCommonTools() {
@@ -45,47 +100,42 @@ void McpServer::AddCommonTools() {
             return board.GetDeviceStatusJson();
         });
 
-    AddTool("self.audio_speaker.set_volume", 
+    AddTool<VolumeSchema>("self.audio_speaker.set_volume", 
         "Set the volume of the audio speaker. If the current volume is unknown, you must call `self.get_device_status` tool first and then call this tool.",
-        PropertyList({
-            Property("volume", kPropertyTypeInteger, 0, 100)
-        }), 
-        [&board](const PropertyList& properties) -> ReturnValue {
+        [&board](const VolumeArgs& args) -> ReturnValue {
             auto codec = board.GetAudioCodec();
-            codec->SetOutputVolume(properties["volume"].value<int>());
+            codec->SetOutputVolume(args.volume);
             return true;
         });
+    SetToolSerialGroup("self.audio_speaker.set_volume", "audio");
     
     auto backlight = board.GetBacklight();
     if (backlight) {
-        AddTool("self.screen.set_brightness",
+        AddTool<BrightnessSchema>("self.screen.set_brightness",
             "Set the brightness of the screen.",
-            PropertyList({
-                Property("brightness", kPropertyTypeInteger, 0, 100)
-            }),
-            [backlight](const PropertyList& properties) -> ReturnValue {
-                uint8_t brightness = static_cast<uint8_t>(properties["brightness"].value<int>());
+            [backlight](const BrightnessArgs& args) -> ReturnValue {
+                uint8_t brightness = static_cast<uint8_t>(args.brightness);
                 backlight->SetBrightness(brightness, true);
                 return true;
             });
+        SetToolSerialGroup("self.screen.set_brightness", "display");
     }
 
     auto display = board.GetDisplay();
     if (display && !display->GetTheme().empty()) {
-        AddTool("self.screen.set_theme",
+        AddTool<ThemeSchema>("self.screen.set_theme",
             "Set the theme of the screen. The theme can be `light` or `dark`.",
-            PropertyList({
-                Property("theme", kPropertyTypeString)
-            }),
-            [display](const PropertyList& properties) -> ReturnValue {
-                display->SetTheme(properties["theme"].value<std::string>().c_str());
+            [display](const ThemeArgs& args) -> ReturnValue {
+                display->SetTheme(args.theme.c_str());
+                McpServer::GetInstance().NotifyResourceChanged("device://screen");
                 return true;
             });
+        SetToolSerialGroup("self.screen.set_theme", "display");
     }
 
     auto camera = board.GetCamera();
     if (camera) {
-        AddTool("self.camera.take_photo",
+        AddAsyncTool("self.camera.take_photo",
             "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
             "Args:\n"
             "  `question`: The question that you want to ask about the photo.\n"
@@ -94,274 +144,963 @@ void McpServer::AddCommonTools() {
             PropertyList({
                 Property("question", kPropertyTypeString)
             }),
+            [camera](const PropertyList& properties, std::shared_ptr<McpToolCall> call) {
+                call->ReportProgress(0, 3, "Capturing photo");
+                if (!camera->Capture()) {
+                    call->Resolve("{\"success\": false, \"message\": \"Failed to capture photo\"}");
+                    return;
+                }
+                call->ReportProgress(1, 3, "Photo captured");
+
+                // Explain() blocks on the upload and on the vision server for seconds. The executor's blocking
+                // thread takes it so the worker is free for other tools, the camera group keeps it to one at a time
+                call->RunBlocking([camera, question = properties["question"].value<std::string>(), call]() {
+                    if (call->IsDone()) {
+                        call->Reject("Cancelled");
+                        return;
+                    }
+                    call->ReportProgress(2, 3, "Waiting for the explanation");
+                    call->Resolve(camera->Explain(question));
+                });
+            });
+
+        AddTool("self.camera.get_photo",
+            "Take a photo and return the image itself, so that you can look at it directly.\n"
+            "Prefer this over `self.camera.take_photo` for simple questions about what is in front of the device.",
+            PropertyList(),
             [camera](const PropertyList& properties) -> ReturnValue {
                 if (!camera->Capture()) {
-                    return "{\"success\": false, \"message\": \"Failed to capture photo\"}";
+                    throw std::runtime_error("Failed to capture photo");
+                }
+                McpBinaryContent image = {kMcpContentImage, "image/jpeg", {}};
+                if (!camera->GetJpeg(MCP_PHOTO_JPEG_QUALITY, image.data)) {
+                    throw std::runtime_error("Failed to encode photo");
                 }
-                auto question = properties["question"].value<std::string>();
-                return camera->Explain(question);
+                return image;
             });
+        // Capture and upload share one frame buffer, and the vision server may take a while to answer
+        SetToolSerialGroup("self.camera.", "camera");
+        SetToolTimeout("self.camera.take_photo", 60000);
     }
 
+#if CONFIG_USE_MCP_RECORDER
+    // Development builds only: the capture goes to the serial log, scripts/mcp_replay takes it from there
+    AddTool("self.mcp_recorder.dump",
+        "Debug tool. Write the recorded MCP messages to the device log for replay on a host.\n"
+        "Args:\n"
+        "  `clear`: Start a new recording after the dump.",
+        PropertyList({
+            Property("clear", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& recorder = McpRecorder::GetInstance();
+            recorder.Dump(stdout);
+            if (properties["clear"].value<bool>()) {
+                recorder.Clear();
+            }
+            return true;
+        });
+    SetToolSerialGroup("self.mcp_recorder.dump", "mcp_recorder");
+#endif
+
     // Restore the original tools list to the end of the tools list
     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
+    tools_list_pages_.clear();
+}
+
+void McpServer::AddCommonResources() {
+    auto& board = Board::GetInstance();
+
+    auto codec = board.GetAudioCodec();
+    if (codec) {
+        AddResource("device://audio_speaker", "Audio speaker",
+            "Output volume of the audio speaker, from 0 to 100.",
+            [codec]() {
+                std::string json;
+                JsonWriter writer(json);
+                writer.BeginObject();
+                writer.Field("volume", codec->output_volume());
+                writer.EndObject();
+                return json;
+            });
+    }
+
+    auto backlight = board.GetBacklight();
+    auto display = board.GetDisplay();
+    bool has_theme = display && !display->GetTheme().empty();
+    if (backlight || has_theme) {
+        AddResource("device://screen", "Screen",
+            "Brightness of the screen from 0 to 100, and its theme.",
+            [backlight, display, has_theme]() {
+                std::string json;
+                JsonWriter writer(json);
+                writer.BeginObject();
+                if (backlight) {
+                    writer.Field("brightness", (int)backlight->brightness());
+                }
+                if (has_theme) {
+                    writer.Field("theme", display->GetTheme());
+                }
+                writer.EndObject();
+                return json;
+            });
+    }
+
+    int battery_level = 0;
+    bool charging = false;
+    bool discharging = false;
+    if (board.GetBatteryLevel(battery_level, charging, discharging)) {
+        AddResource("device://battery", "Battery",
+            "Battery level in percent and whether the battery is charging.",
+            [&board]() {
+                int level = 0;
+                bool charging = false;
+                bool discharging = false;
+                board.GetBatteryLevel(level, charging, discharging);
+                std::string json;
+                JsonWriter writer(json);
+                writer.BeginObject();
+                writer.Field("level", level);
+                writer.Field("charging", charging);
+                writer.EndObject();
+                return json;
+            }, true);
+    }
+
+    AddResource("device://network", "Network",
+        "Type of the network connection and its signal strength.",
+        [&board]() {
+            return board.GetNetworkStatusJson();
+        }, true);
+
+    AddResource("device://state", "Device state",
+        "What the device is doing: idle, listening, thinking, speaking, capturing_photo, ...",
+        []() {
+            size_t state = Application::GetInstance().GetState();
+            std::string json;
+            JsonWriter writer(json);
+            writer.BeginObject();
+            writer.Field("state", state < std::size(kDeviceStateNames) ? kDeviceStateNames[state] : "unknown");
+            writer.EndObject();
+            return json;
+        });
+}
+
+void McpServer::AddResource(const std::string& uri, const std::string& name, const std::string& description, McpResourceReader reader, bool polled) {
+    std::lock_guard<std::mutex> lock(resources_mutex_);
+    if (FindResource(uri) != nullptr) {
+        ESP_LOGW(TAG, "Resource %s already added", uri.c_str());
+        return;
+    }
+    ESP_LOGI(TAG, "Add resource: %s", uri.c_str());
+    resources_.push_back({uri, name, description, reader, polled});
+}
+
+// Must be called with resources_mutex_ held
+McpResource* McpServer::FindResource(const std::string& uri) {
+    for (auto& resource : resources_) {
+        if (resource.uri == uri) {
+            return &resource;
+        }
+    }
+    return nullptr;
+}
+
+void McpServer::NotifyResourceChanged(const std::string& uri) {
+    McpResourceReader reader;
+    {
+        std::lock_guard<std::mutex> lock(resources_mutex_);
+        auto resource = FindResource(uri);
+        if (resource == nullptr || !resource->subscribed) {
+            return;
+        }
+        reader = resource->reader;
+    }
+
+    // Read without the lock, a reader may have to ask the battery gauge or the modem
+    std::string text = reader();
+    {
+        std::lock_guard<std::mutex> lock(resources_mutex_);
+        auto resource = FindResource(uri);
+        if (!resource->subscribed || resource->last_value == text) {
+            return;
+        }
+        resource->last_value = text;
+    }
+
+    // The new contents go along with the notification, the client does not have to read it back
+    std::string payload;
+    payload.reserve(text.size() * 2 + uri.size() * 2 + 128);
+    JsonWriter writer(payload);
+    writer.BeginObject();
+    writer.Field("jsonrpc", "2.0");
+    writer.Field("method", "notifications/resources/updated");
+    writer.Key("params");
+    writer.BeginObject();
+    writer.Field("uri", uri);
+    WriteResourceContents(writer, uri, text);
+    writer.EndObject();
+    writer.EndObject();
+    Application::GetInstance().SendMcpMessage(payload);
+}
+
+void McpServer::PostResourceChanged(const std::string& uri) {
+    {
+        // Nothing to do without a subscriber, don't wake the executor for it
+        std::lock_guard<std::mutex> lock(resources_mutex_);
+        auto resource = FindResource(uri);
+        if (resource == nullptr || !resource->subscribed) {
+            return;
+        }
+    }
+    tool_executor_->Post([this, uri]() {
+        NotifyResourceChanged(uri);
+    });
+}
+
+void McpServer::PollResources() {
+    std::vector<std::string> uris;
+    {
+        std::lock_guard<std::mutex> lock(resources_mutex_);
+        for (const auto& resource : resources_) {
+            if (resource.polled && resource.subscribed) {
+                uris.push_back(resource.uri);
+            }
+        }
+    }
+    for (const auto& uri : uris) {
+        NotifyResourceChanged(uri);
+    }
+}
+
+void McpServer::WriteResourceContents(JsonWriter& writer, const std::string& uri, const std::string& text) {
+    writer.Key("contents");
+    writer.BeginArray();
+    writer.BeginObject();
+    writer.Field("uri", uri);
+    writer.Field("mimeType", "application/json");
+    writer.Field("text", text);
+    writer.EndObject();
+    writer.EndArray();
+}
+
+void McpServer::GetResourcesList(int id) {
+    std::string result;
+    result.reserve(1024);
+    JsonWriter writer(result);
+    writer.BeginObject();
+    writer.Key("resources");
+    writer.BeginArray();
+    {
+        std::lock_guard<std::mutex> lock(resources_mutex_);
+        for (const auto& resource : resources_) {
+            writer.BeginObject();
+            writer.Field("uri", resource.uri);
+            writer.Field("name", resource.name);
+            writer.Field("description", resource.description);
+            writer.Field("mimeType", "application/json");
+            writer.EndObject();
+        }
+    }
+    writer.EndArray();
+    writer.EndObject();
+    ReplyResult(id, result);
+}
+
+void McpServer::ReadResource(int id, const std::string& uri) {
+    McpResourceReader reader;
+    {
+        std::lock_guard<std::mutex> lock(resources_mutex_);
+        auto resource = FindResource(uri);
+        if (resource != nullptr) {
+            reader = resource->reader;
+        }
+    }
+    if (reader == nullptr) {
+        ReplyError(id, "Resource not found: " + uri);
+        return;
+    }
+
+    std::string text = reader();
+    std::string result;
+    result.reserve(text.size() * 2 + uri.size() + 96);
+    JsonWriter writer(result);
+    writer.BeginObject();
+    WriteResourceContents(writer, uri, text);
+    writer.EndObject();
+    ReplyResult(id, result);
+}
+
+void McpServer::SubscribeResource(int id, const std::string& uri, bool subscribe) {
+    McpResourceReader reader;
+    bool poll = false;
+    {
+        std::lock_guard<std::mutex> lock(resources_mutex_);
+        auto resource = FindResource(uri);
+        if (resource != nullptr) {
+            resource->subscribed = subscribe;
+            resource->last_value.clear();
+            reader = resource->reader;
+        }
+        for (const auto& resource : resources_) {
+            poll = poll || (resource.polled && resource.subscribed);
+        }
+    }
+    if (reader == nullptr) {
+        ReplyError(id, "Resource not found: " + uri);
+        return;
+    }
+
+    if (subscribe) {
+        // What the client reads now is the baseline, only later changes are pushed
+        std::string text = reader();
+        std::lock_guard<std::mutex> lock(resources_mutex_);
+        auto resource = FindResource(uri);
+        if (resource->subscribed && resource->last_value.empty()) {
+            resource->last_value = std::move(text);
+        }
+    }
+    if (poll && !esp_timer_is_active(resource_poll_timer_)) {
+        esp_timer_start_periodic(resource_poll_timer_, MCP_RESOURCE_POLL_INTERVAL_MS * 1000);
+    } else if (!poll && esp_timer_is_active(resource_poll_timer_)) {
+        esp_timer_stop(resource_poll_timer_);
+    }
+    ESP_LOGI(TAG, "%s %s", subscribe ? "Subscribed to" : "Unsubscribed from", uri.c_str());
+    ReplyResult(id, "{}");
 }
 
 void McpServer::AddTool(McpTool* tool) {
     // Prevent adding duplicate tools
-    if (std::find_if(tools_.begin(), tools_.end(), [tool](const McpTool* t) { return t->name() == tool->name(); }) != tools_.end()) {
+    if (tool_index_.find(tool->name()) != tool_index_.end()) {
         ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
         return;
     }
 
     ESP_LOGI(TAG, "Add tool: %s", tool->name().c_str());
     tools_.push_back(tool);
+    tool_index_[tool->name()] = tool;
+    tools_list_pages_.clear();
 }
 
-void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
+void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, McpToolCallback callback) {
     AddTool(new McpTool(name, description, properties, callback));
 }
 
+void McpServer::AddAsyncTool(const std::string& name, const std::string& description, const PropertyList& properties, McpAsyncToolCallback callback) {
+    AddTool(new McpTool(name, description, properties, callback));
+}
+
+std::shared_ptr<McpToolCall> McpTool::Bind(const JsonReader& tool_arguments, std::string& error) {
+    PropertyList arguments = properties_;
+    try {
+        for (auto& argument : arguments) {
+            bool found = false;
+            // Arguments are decoded straight from the message text, no cJSON tree is built
+            auto value = tool_arguments[argument.name()];
+            if (argument.type() == kPropertyTypeBoolean && value.IsBool()) {
+                argument.set_value<bool>(value.GetBool());
+                found = true;
+            } else if (argument.type() == kPropertyTypeInteger && value.IsNumber()) {
+                argument.set_value<int>(value.GetInt());
+                found = true;
+            } else if (argument.type() == kPropertyTypeString && value.IsString()) {
+                argument.set_value<std::string>(value.GetString());
+                found = true;
+            }
+
+            if (!argument.has_default_value() && !found) {
+                error = "Missing valid argument: " + argument.name();
+                return nullptr;
+            }
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+        return nullptr;
+    }
+    return std::make_shared<McpPropertyListCall>(this, std::move(arguments));
+}
+
+template<typename F>
+void McpServer::ForEachTool(const std::string& name, F&& callback) {
+    bool prefix = !name.empty() && name.back() == '.';
+    for (auto tool : tools_) {
+        if (prefix ? tool->name().compare(0, name.size(), name) == 0 : tool->name() == name) {
+            callback(tool);
+        }
+    }
+}
+
+void McpServer::SetToolSerialGroup(const std::string& name, const std::string& group) {
+    ForEachTool(name, [&group](McpTool* tool) {
+        tool->set_serial_group(group);
+    });
+}
+
+void McpServer::SetToolTimeout(const std::string& name, int timeout_ms) {
+    ForEachTool(name, [timeout_ms](McpTool* tool) {
+        tool->set_timeout_ms(timeout_ms);
+    });
+}
+
+void McpServer::LogToolStatistics() {
+    tool_executor_->LogStatistics();
+}
+
 void McpServer::ParseMessage(const std::string& message) {
-    cJSON* json = cJSON_Parse(message.c_str());
-    if (json == nullptr) {
+    JsonReader json(message);
+    if (!json.IsObject() && !json.IsArray()) {
         ESP_LOGE(TAG, "Failed to parse MCP message: %s", message.c_str());
         return;
     }
     ParseMessage(json);
-    cJSON_Delete(json);
 }
 
-void McpServer::ParseCapabilities(const cJSON* capabilities) {
-    auto vision = cJSON_GetObjectItem(capabilities, "vision");
-    if (cJSON_IsObject(vision)) {
-        auto url = cJSON_GetObjectItem(vision, "url");
-        auto token = cJSON_GetObjectItem(vision, "token");
-        if (cJSON_IsString(url)) {
-            auto camera = Board::GetInstance().GetCamera();
+void McpServer::ParseCapabilities(const JsonReader& capabilities) {
+    auto vision = capabilities["vision"];
+    if (vision.IsObject()) {
+        auto url = vision["url"];
+        auto token = vision["token"];
+        auto camera = Board::GetInstance().GetCamera();
+        if (url.IsString()) {
             if (camera) {
-                std::string url_str = std::string(url->valuestring);
-                std::string token_str;
-                if (cJSON_IsString(token)) {
-                    token_str = std::string(token->valuestring);
-                }
+                std::string url_str = url.GetString();
+                std::string token_str = token.GetString();
                 camera->SetExplainUrl(url_str, token_str);
             }
         }
+        // 服务器需要的图片尺寸和大小，例如 {"width":640,"height":480,"crop":true,"max_bytes":40000}
+        if (camera && (vision["width"].IsNumber() || vision["height"].IsNumber() ||
+            vision["grayscale"].IsBool() || vision["max_bytes"].IsNumber())) {
+            CameraUploadConfig config;
+            config.max_width = vision["width"].GetInt(0);
+            config.max_height = vision["height"].GetInt(0);
+            config.crop = vision["crop"].GetBool(false);
+            config.grayscale = vision["grayscale"].GetBool(false);
+            config.quality = std::clamp(vision["quality"].GetInt(config.quality), 10, 100);
+            config.max_bytes = std::max(vision["max_bytes"].GetInt(0), 0);
+            camera->SetUploadConfig(config);
+        }
     }
 }
 
-void McpServer::ParseMessage(const cJSON* json) {
-    // Check JSONRPC version
-    auto version = cJSON_GetObjectItem(json, "jsonrpc");
-    if (version == nullptr || !cJSON_IsString(version) || strcmp(version->valuestring, "2.0") != 0) {
-        ESP_LOGE(TAG, "Invalid JSONRPC version: %s", version ? version->valuestring : "null");
+void McpServer::ParseMessage(const JsonReader& json) {
+#if CONFIG_USE_MCP_RECORDER
+    McpRecorder::GetInstance().Record(json.raw());
+#endif
+    if (json.IsArray()) {
+        ParseBatch(json);
         return;
     }
-    
-    // Check method
-    auto method = cJSON_GetObjectItem(json, "method");
-    if (method == nullptr || !cJSON_IsString(method)) {
-        ESP_LOGE(TAG, "Missing method");
+    auto id = json["id"];
+    bool has_id = id.IsNumber() && !json["method"].StartsWith("notifications");
+    if (has_id && !ClaimReply(id.GetInt(), nullptr)) {
+        // Its reply would be collected into the batch that waits on the same id
+        ESP_LOGW(TAG, "Request id %d is still pending in a batch", id.GetInt());
+        Application::GetInstance().SendMcpMessage(BuildError(id.GetInt(), "Duplicate request id"));
         return;
     }
-    
-    auto method_str = std::string(method->valuestring);
-    if (method_str.find("notifications") == 0) {
+    if (!HandleRequest(json) && has_id) {
+        DropReply(id.GetInt());
+    }
+}
+
+void McpServer::ParseBatch(const JsonReader& json) {
+    // Every request of the batch is dispatched right away, so independent tool calls run
+    // concurrently on the executor. Their replies are collected and go out as one array
+    auto batch = std::make_shared<Batch>();
+    batch->replies.reserve(256);
+    batch->replies.push_back('[');
+    // Every id is claimed before anything is dispatched. Otherwise a request that finishes quickly
+    // frees its id, and a later request reusing it would be dispatched as well
+    std::vector<bool> dispatch;
+    json.ForEachElement([this, &batch, &dispatch](const JsonReader& request) {
+        dispatch.push_back(false);
+        if (!request.IsObject()) {
+            ESP_LOGE(TAG, "Invalid request in batch");
+            return true;
+        }
+        auto id = request["id"];
+        bool has_id = id.IsNumber() && !request["method"].StartsWith("notifications");
+        if (has_id && !ClaimReply(id.GetInt(), batch)) {
+            // Twice in this batch or still pending elsewhere: replies are matched by id, so it is refused
+            // in place rather than dispatched and given a reply that the other request would take
+            ESP_LOGW(TAG, "Duplicate request id %d in batch", id.GetInt());
+            std::lock_guard<std::mutex> lock(reply_mutex_);
+            batch->Append(BuildError(id.GetInt(), "Duplicate request id"));
+            return true;
+        }
+        dispatch.back() = true;
+        return true;
+    });
+    size_t index = 0;
+    json.ForEachElement([this, &dispatch, &index](const JsonReader& request) {
+        if (!dispatch[index++]) {
+            return true;
+        }
+        auto id = request["id"];
+        bool has_id = id.IsNumber() && !request["method"].StartsWith("notifications");
+        if (!HandleRequest(request) && has_id) {
+            DropReply(id.GetInt());
+        }
+        return true;
+    });
+    int requests = dispatch.size();
+    if (requests == 0) {
+        ESP_LOGE(TAG, "Empty batch");
         return;
     }
+    ESP_LOGI(TAG, "Batch of %d requests dispatched", requests);
+
+    std::unique_lock<std::mutex> lock(reply_mutex_);
+    batch->sealed = true;
+    if (batch->pending == 0) {
+        FlushBatch(batch, lock);
+    }
+}
+
+// Returns whether a reply has been or will be sent for this message
+bool McpServer::HandleRequest(const JsonReader& json) {
+    // Check JSONRPC version
+    auto version = json["jsonrpc"];
+    if (!version.Equals("2.0")) {
+        ESP_LOGE(TAG, "Invalid JSONRPC version: %s", version.GetString("null").c_str());
+        return false;
+    }
+    
+    // Check method, notifications other than a cancellation are dropped before anything else is looked at
+    auto method = json["method"];
+    if (!method.IsString()) {
+        ESP_LOGE(TAG, "Missing method");
+        return false;
+    }
+    if (method.StartsWith("notifications")) {
+        if (method.Equals("notifications/cancelled")) {
+            auto request_id = json["params"]["requestId"];
+            if (request_id.IsNumber()) {
+                tool_executor_->Cancel(request_id.GetInt());
+                // A cancelled request gets no reply, so a batch must not wait for it
+                DropReply(request_id.GetInt());
+            }
+        }
+        return false;
+    }
+    
+    auto method_str = method.GetString();
     
     // Check params
-    auto params = cJSON_GetObjectItem(json, "params");
-    if (params != nullptr && !cJSON_IsObject(params)) {
+    auto params = json["params"];
+    if (params.IsValid() && !params.IsObject()) {
         ESP_LOGE(TAG, "Invalid params for method: %s", method_str.c_str());
-        return;
+        return false;
     }
 
-    auto id = cJSON_GetObjectItem(json, "id");
-    if (id == nullptr || !cJSON_IsNumber(id)) {
+    auto id = json["id"];
+    if (!id.IsNumber()) {
         ESP_LOGE(TAG, "Invalid id for method: %s", method_str.c_str());
-        return;
+        return false;
     }
-    auto id_int = id->valueint;
+    auto id_int = id.GetInt();
     
     if (method_str == "initialize") {
-        if (cJSON_IsObject(params)) {
-            auto capabilities = cJSON_GetObjectItem(params, "capabilities");
-            if (cJSON_IsObject(capabilities)) {
-                ParseCapabilities(capabilities);
-            }
+        auto capabilities = params["capabilities"];
+        if (capabilities.IsObject()) {
+            ParseCapabilities(capabilities);
         }
         auto app_desc = esp_app_get_description();
-        std::string message = "{\"protocolVersion\":\"2024-11-05\",\"capabilities\":{\"tools\":{}},\"serverInfo\":{\"name\":\"" BOARD_NAME "\",\"version\":\"";
-        message += app_desc->version;
-        message += "\"}}";
+        std::string message;
+        message.reserve(128);
+        JsonWriter writer(message);
+        writer.BeginObject();
+        writer.Field("protocolVersion", "2024-11-05");
+        writer.Key("capabilities");
+        writer.BeginObject();
+        writer.Key("tools");
+        writer.BeginObject();
+        writer.EndObject();
+        writer.Key("resources");
+        writer.BeginObject();
+        writer.Field("subscribe", true);
+        writer.EndObject();
+        writer.EndObject();
+        writer.Key("serverInfo");
+        writer.BeginObject();
+        writer.Field("name", BOARD_NAME);
+        writer.Field("version", app_desc->version);
+        writer.EndObject();
+        writer.EndObject();
         ReplyResult(id_int, message);
     } else if (method_str == "tools/list") {
-        std::string cursor_str = "";
-        if (params != nullptr) {
-            auto cursor = cJSON_GetObjectItem(params, "cursor");
-            if (cJSON_IsString(cursor)) {
-                cursor_str = std::string(cursor->valuestring);
-            }
-        }
+        std::string cursor_str = params["cursor"].GetString();
         GetToolsList(id_int, cursor_str);
+    } else if (method_str == "resources/list") {
+        GetResourcesList(id_int);
+    } else if (method_str == "resources/read" || method_str == "resources/subscribe" || method_str == "resources/unsubscribe") {
+        auto uri = params["uri"];
+        if (!uri.IsString()) {
+            ESP_LOGE(TAG, "%s: Missing uri", method_str.c_str());
+            ReplyError(id_int, "Missing uri");
+            return true;
+        }
+        if (method_str == "resources/read") {
+            ReadResource(id_int, uri.GetString());
+        } else {
+            SubscribeResource(id_int, uri.GetString(), method_str == "resources/subscribe");
+        }
     } else if (method_str == "tools/call") {
-        if (!cJSON_IsObject(params)) {
+        if (!params.IsObject()) {
             ESP_LOGE(TAG, "tools/call: Missing params");
             ReplyError(id_int, "Missing params");
-            return;
+            return true;
         }
-        auto tool_name = cJSON_GetObjectItem(params, "name");
-        if (!cJSON_IsString(tool_name)) {
+        auto tool_name = params["name"];
+        if (!tool_name.IsString()) {
             ESP_LOGE(TAG, "tools/call: Missing name");
             ReplyError(id_int, "Missing name");
-            return;
+            return true;
         }
-        auto tool_arguments = cJSON_GetObjectItem(params, "arguments");
-        if (tool_arguments != nullptr && !cJSON_IsObject(tool_arguments)) {
+        auto tool_arguments = params["arguments"];
+        if (tool_arguments.IsValid() && !tool_arguments.IsObject()) {
             ESP_LOGE(TAG, "tools/call: Invalid arguments");
             ReplyError(id_int, "Invalid arguments");
-            return;
+            return true;
         }
-        auto stack_size = cJSON_GetObjectItem(params, "stackSize");
-        if (stack_size != nullptr && !cJSON_IsNumber(stack_size)) {
+        auto stack_size = params["stackSize"];
+        if (stack_size.IsValid() && !stack_size.IsNumber()) {
             ESP_LOGE(TAG, "tools/call: Invalid stackSize");
             ReplyError(id_int, "Invalid stackSize");
-            return;
+            return true;
         }
-        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, stack_size ? stack_size->valueint : DEFAULT_TOOLCALL_STACK_SIZE);
+        // The progress token may be a string or a number, it is echoed back verbatim
+        auto progress_token = params["_meta"]["progressToken"];
+        std::string_view progress_token_raw = progress_token.IsString() || progress_token.IsNumber() ? progress_token.raw() : std::string_view();
+        DoToolCall(id_int, tool_name.GetString(), tool_arguments, stack_size.GetInt(DEFAULT_TOOLCALL_STACK_SIZE), progress_token_raw);
     } else {
         ESP_LOGE(TAG, "Method not implemented: %s", method_str.c_str());
         ReplyError(id_int, "Method not implemented: " + method_str);
     }
+    return true;
 }
 
-void McpServer::ReplyResult(int id, const std::string& result) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id) + ",\"result\":";
-    payload += result;
-    payload += "}";
+// Called with reply_mutex_ held, once the batch is sealed and nothing is pending
+void McpServer::FlushBatch(const std::shared_ptr<Batch>& batch, std::unique_lock<std::mutex>& lock) {
+    if (batch->replies.size() <= 1) {
+        // Only notifications, JSON-RPC sends nothing back
+        return;
+    }
+    batch->replies.push_back(']');
+    std::string payload = std::move(batch->replies);
+    lock.unlock();
     Application::GetInstance().SendMcpMessage(payload);
 }
 
+// Registers a request before it is dispatched, false if its id is taken. A batch request needs an id
+// that nothing else waits on; a plain request only conflicts with a batch, two plain requests under one
+// id are answered one after the other as before
+bool McpServer::ClaimReply(int id, const std::shared_ptr<Batch>& batch) {
+    std::lock_guard<std::mutex> lock(reply_mutex_);
+    auto it = pending_replies_.find(id);
+    if (batch != nullptr) {
+        if (it != pending_replies_.end()) {
+            return false;
+        }
+        pending_replies_[id].batch = batch;
+        batch->pending++;
+        return true;
+    }
+    if (it != pending_replies_.end() && it->second.batch != nullptr) {
+        return false;
+    }
+    pending_replies_[id].plain++;
+    return true;
+}
+
+void McpServer::DropReply(int id) {
+    std::unique_lock<std::mutex> lock(reply_mutex_);
+    auto it = pending_replies_.find(id);
+    if (it == pending_replies_.end()) {
+        return;
+    }
+    if (it->second.batch == nullptr) {
+        if (--it->second.plain == 0) {
+            pending_replies_.erase(it);
+        }
+        return;
+    }
+    auto batch = std::move(it->second.batch);
+    pending_replies_.erase(it);
+    if (--batch->pending == 0 && batch->sealed) {
+        FlushBatch(batch, lock);
+    }
+}
+
+// Whether the reply to id goes out on its own rather than into a batch. If so the reply is accounted
+// for here as in SendReply(), the caller must send it
+bool McpServer::TakeDirectReply(int id) {
+    std::lock_guard<std::mutex> lock(reply_mutex_);
+    auto it = pending_replies_.find(id);
+    if (it == pending_replies_.end()) {
+        return true;
+    }
+    if (it->second.batch != nullptr) {
+        return false;
+    }
+    if (--it->second.plain == 0) {
+        pending_replies_.erase(it);
+    }
+    return true;
+}
+
+void McpServer::SendReply(int id, const std::string& payload) {
+    std::unique_lock<std::mutex> lock(reply_mutex_);
+    auto it = pending_replies_.find(id);
+    if (it == pending_replies_.end() || it->second.batch == nullptr) {
+        if (it != pending_replies_.end() && --it->second.plain == 0) {
+            pending_replies_.erase(it);
+        }
+        lock.unlock();
+        Application::GetInstance().SendMcpMessage(payload);
+        return;
+    }
+    auto batch = std::move(it->second.batch);
+    pending_replies_.erase(it);
+    batch->Append(payload);
+    if (--batch->pending == 0 && batch->sealed) {
+        FlushBatch(batch, lock);
+    }
+}
+
+void McpServer::ReplyResult(int id, const std::string& result) {
+    std::string payload;
+    payload.reserve(result.size() + 48);
+    JsonWriter writer(payload);
+    writer.BeginObject();
+    writer.Field("jsonrpc", "2.0");
+    writer.Field("id", id);
+    writer.Key("result");
+    writer.Raw(result);
+    writer.EndObject();
+    SendReply(id, payload);
+}
+
+void McpServer::ReplyToolResult(int id, const ReturnValue& value) {
+    auto content = std::get_if<McpBinaryContent>(&value);
+    if (content != nullptr && content->data.size() > MCP_CONTENT_MAX_SIZE) {
+        ESP_LOGW(TAG, "tools/call: %u bytes of content exceed the limit", content->data.size());
+        ReplyError(id, "Content too large: " + std::to_string(content->data.size()) + " bytes");
+        return;
+    }
+    if (content != nullptr && TakeDirectReply(id)) {
+        SendContentReply(id, value);
+        return;
+    }
+    if (content != nullptr) {
+        // A batch collects its replies into one string, which the protocol copies once more into its
+        // frame. Refuse what the heap cannot hold rather than fail halfway through an allocation
+        size_t encoded = JsonWriter::Base64Length(content->data.size());
+        uint32_t caps = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0 ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT;
+        size_t largest_block = heap_caps_get_largest_free_block(caps);
+        if (encoded * 2 + MCP_CONTENT_HEAP_MARGIN > largest_block) {
+            ESP_LOGW(TAG, "tools/call: %u bytes of content do not fit, largest free block %u",
+                content->data.size(), largest_block);
+            ReplyError(id, "Content too large: " + std::to_string(content->data.size()) + " bytes");
+            return;
+        }
+    }
+
+    std::string payload;
+    payload.reserve(McpTool::ResultSize(value) + 48);
+    JsonWriter writer(payload);
+    writer.BeginObject();
+    writer.Field("jsonrpc", "2.0");
+    writer.Field("id", id);
+    writer.Key("result");
+    McpTool::WriteResult(writer, value);
+    writer.EndObject();
+    SendReply(id, payload);
+}
+
+// Sends a tool result with binary content in pieces: the reply up to the content, the base64 one chunk
+// at a time, then the rest. Neither the encoded content nor the whole reply is ever held in memory
+void McpServer::SendContentReply(int id, const ReturnValue& value) {
+    auto& content = std::get<McpBinaryContent>(value);
+    std::string reply;
+    reply.reserve(content.mime_type.size() + 128);
+    size_t data_offset = 0;
+    JsonWriter writer(reply);
+    writer.BeginObject();
+    writer.Field("jsonrpc", "2.0");
+    writer.Field("id", id);
+    writer.Key("result");
+    McpTool::WriteResult(writer, value, &data_offset);
+    writer.EndObject();
+
+    std::string_view head(reply.data(), data_offset);
+    std::string_view tail(reply.data() + data_offset, reply.size() - data_offset);
+    size_t encoded = 0;
+    int piece = 0;
+    Application::GetInstance().SendMcpMessageChunked([&](std::string& chunk) {
+        chunk.clear();
+        if (piece == 0) {
+            chunk.assign(head);
+            piece++;
+        } else if (encoded < content.data.size()) {
+            size_t size = std::min<size_t>(MCP_CONTENT_CHUNK_SIZE, content.data.size() - encoded);
+            JsonWriter::AppendBase64(content.data.data() + encoded, size, chunk);
+            encoded += size;
+        } else if (piece == 1) {
+            chunk.assign(tail);
+            piece++;
+        } else {
+            return false;
+        }
+        return true;
+    });
+}
+
 void McpServer::ReplyError(int id, const std::string& message) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id);
-    payload += ",\"error\":{\"message\":\"";
-    payload += message;
-    payload += "\"}}";
+    SendReply(id, BuildError(id, message));
+}
+
+std::string McpServer::BuildError(int id, const std::string& message) {
+    std::string payload;
+    payload.reserve(message.size() + 64);
+    JsonWriter writer(payload);
+    writer.BeginObject();
+    writer.Field("jsonrpc", "2.0");
+    writer.Field("id", id);
+    writer.Key("error");
+    writer.BeginObject();
+    writer.Field("message", message);
+    writer.EndObject();
+    writer.EndObject();
+    return payload;
+}
+
+void McpServer::SendProgress(const std::string& progress_token, int progress, int total, const std::string& message) {
+    std::string payload;
+    payload.reserve(message.size() + 128);
+    JsonWriter writer(payload);
+    writer.BeginObject();
+    writer.Field("jsonrpc", "2.0");
+    writer.Field("method", "notifications/progress");
+    writer.Key("params");
+    writer.BeginObject();
+    writer.Key("progressToken");
+    writer.Raw(progress_token);
+    writer.Field("progress", progress);
+    writer.Field("total", total);
+    if (!message.empty()) {
+        writer.Field("message", message);
+    }
+    writer.EndObject();
+    writer.EndObject();
     Application::GetInstance().SendMcpMessage(payload);
 }
 
-void McpServer::GetToolsList(int id, const std::string& cursor) {
-    const int max_payload_size = 8000;
-    std::string json = "{\"tools\":[";
-    
-    bool found_cursor = cursor.empty();
-    auto it = tools_.begin();
-    std::string next_cursor = "";
-    
-    while (it != tools_.end()) {
-        // 如果我们还没有找到起始位置，继续搜索
-        if (!found_cursor) {
-            if ((*it)->name() == cursor) {
-                found_cursor = true;
-            } else {
-                ++it;
-                continue;
-            }
-        }
-        
+#define TOOLS_LIST_MAX_PAYLOAD_SIZE 8000
+
+// Pack tools from start into one tools/list result, returns the index of the first tool that did not fit.
+// result is left empty if not even the first tool fits.
+size_t McpServer::BuildToolsListPage(size_t start, std::string& result) {
+    result.clear();
+    result.reserve(TOOLS_LIST_MAX_PAYLOAD_SIZE);
+    JsonWriter writer(result);
+    writer.BeginObject();
+    writer.Key("tools");
+    writer.BeginArray();
+
+    size_t index = start;
+    for (; index < tools_.size(); index++) {
         // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
-            // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
-            next_cursor = (*it)->name();
+        const std::string& tool_json = tools_[index]->to_json();
+        if (result.length() + tool_json.length() + 30 > TOOLS_LIST_MAX_PAYLOAD_SIZE) {
             break;
         }
-        
-        json += tool_json;
-        ++it;
+        writer.Raw(tool_json);
     }
-    
-    if (json.back() == ',') {
-        json.pop_back();
+
+    if (index == start && index < tools_.size()) {
+        result.clear();
+        return index;
     }
-    
-    if (json.back() == '[' && !tools_.empty()) {
-        // 如果没有添加任何tool，返回错误
-        ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
+
+    writer.EndArray();
+    if (index < tools_.size()) {
+        writer.Field("nextCursor", tools_[index]->name());
+    }
+    writer.EndObject();
+    result.shrink_to_fit();
+    return index;
+}
+
+void McpServer::BuildToolsListPages() {
+    // Tool schemas do not change after registration, so the pages and their cursors are
+    // computed once and every later tools/list is a map lookup
+    size_t start = 0;
+    do {
+        std::string cursor = start == 0 ? "" : tools_[start]->name();
+        std::string result;
+        size_t next = BuildToolsListPage(start, result);
+        tools_list_pages_[cursor] = std::move(result);
+        if (next == start) {
+            break;
+        }
+        start = next;
+    } while (start < tools_.size());
+}
+
+void McpServer::GetToolsList(int id, const std::string& cursor) {
+    if (tools_list_pages_.empty()) {
+        BuildToolsListPages();
+    }
+
+    auto page = tools_list_pages_.find(cursor);
+    if (page != tools_list_pages_.end() && !page->second.empty()) {
+        ReplyResult(id, page->second);
         return;
     }
 
-    if (next_cursor.empty()) {
-        json += "]}";
-    } else {
-        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+    // The client may resume from any tool name, not only from a cursor we handed out
+    std::string result;
+    std::string failed_tool = cursor.empty() && !tools_.empty() ? tools_.front()->name() : cursor;
+    if (page == tools_list_pages_.end()) {
+        auto it = std::find_if(tools_.begin(), tools_.end(), [&cursor](const McpTool* tool) {
+            return tool->name() == cursor;
+        });
+        if (it != tools_.end()) {
+            BuildToolsListPage(it - tools_.begin(), result);
+        }
     }
-    
-    ReplyResult(id, json);
+
+    if (result.empty()) {
+        // 如果没有添加任何tool，返回错误
+        ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", failed_tool.c_str());
+        ReplyError(id, "Failed to add tool " + failed_tool + " because of payload size limit");
+        return;
+    }
+    ReplyResult(id, result);
 }
 
-void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size) {
-    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
-                                 [&tool_name](const McpTool* tool) { 
-                                     return tool->name() == tool_name; 
-                                 });
-    
-    if (tool_iter == tools_.end()) {
+void McpServer::DoToolCall(int id, const std::string& tool_name, const JsonReader& tool_arguments, int stack_size, std::string_view progress_token) {
+    auto tool_iter = tool_index_.find(tool_name);
+    if (tool_iter == tool_index_.end()) {
         ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
         ReplyError(id, "Unknown tool: " + tool_name);
         return;
     }
 
-    PropertyList arguments = (*tool_iter)->properties();
-    try {
-        for (auto& argument : arguments) {
-            bool found = false;
-            if (cJSON_IsObject(tool_arguments)) {
-                auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
-                if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
-                    argument.set_value<bool>(value->valueint == 1);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
-                    argument.set_value<int>(value->valueint);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
-                    argument.set_value<std::string>(value->valuestring);
-                    found = true;
-                }
-            }
-
-            if (!argument.has_default_value() && !found) {
-                ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
-                ReplyError(id, "Missing valid argument: " + argument.name());
-                return;
-            }
-        }
-    } catch (const std::exception& e) {
-        ESP_LOGE(TAG, "tools/call: %s", e.what());
-        ReplyError(id, e.what());
+    McpTool* tool = tool_iter->second;
+    std::string error;
+    auto call = tool->Bind(tool_arguments, error);
+    if (call == nullptr) {
+        ESP_LOGE(TAG, "tools/call: %s", error.c_str());
+        ReplyError(id, error);
         return;
     }
 
-    // Start a task to receive data with stack size
-    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
-    cfg.thread_name = "tool_call";
-    cfg.stack_size = stack_size;
-    cfg.prio = 1;
-    esp_pthread_set_cfg(&cfg);
-
-    // Use a thread to call the tool to avoid blocking the main thread
-    tool_call_thread_ = std::thread([this, id, tool_iter, arguments = std::move(arguments)]() {
-        try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
-        } catch (const std::exception& e) {
-            ESP_LOGE(TAG, "tools/call: %s", e.what());
-            ReplyError(id, e.what());
-        }
-    });
-    tool_call_thread_.detach();
-}
\ No newline at end of file
+    // Tools run on a fixed pool of workers, a per-call stack size can no longer be honored
+    if (stack_size > MCP_TOOL_WORKER_STACK_SIZE) {
+        ESP_LOGW(TAG, "tools/call: %s asks for a %d bytes stack, workers have %d", tool_name.c_str(), stack_size, MCP_TOOL_WORKER_STACK_SIZE);
+    }
+    tool_executor_->Submit(id, std::move(call), std::string(progress_token));
+}
@@ -4,16 +4,44 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <variant>
 #include <optional>
+#include <memory>
+#include <atomic>
+#include <mutex>
 #include <stdexcept>
-#include <thread>
+#include <esp_timer.h>
+
+#include "json_reader.h"
+#include "json_writer.h"
+
+// A tools/call gets an error reply once this much time has passed since it arrived
+#define MCP_TOOL_CALL_TIMEOUT_MS 30000
+// Largest image or audio a tool may return, before base64. A reply inside a batch is built whole
+// and also needs twice the encoded size plus this margin in one free block, see McpServer::ReplyToolResult()
+#define MCP_CONTENT_MAX_SIZE (192 * 1024)
+#define MCP_CONTENT_HEAP_MARGIN (32 * 1024)
+// Other replies with content go to the protocol in pieces, this many bytes of content (a multiple of 3) each
+#define MCP_CONTENT_CHUNK_SIZE (3 * 1024)
+// Resources nothing reports changes for (battery, network) are re-read this often while subscribed
+#define MCP_RESOURCE_POLL_INTERVAL_MS 10000
+
+enum McpContentType {
+    kMcpContentImage,
+    kMcpContentAudio
+};
 
-#include <cJSON.h>
+// Image or audio returned by a tool, sent base64 encoded as MCP image / audio content
+struct McpBinaryContent {
+    McpContentType type;
+    std::string mime_type;
+    std::vector<uint8_t> data;
+};
 
 // 添加类型别名
-using ReturnValue = std::variant<bool, int, std::string>;
+using ReturnValue = std::variant<bool, int, std::string, McpBinaryContent>;
 
 enum PropertyType {
     kPropertyTypeBoolean,
@@ -86,37 +114,37 @@ public:
         value_ = value;
     }
 
-    std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        
+    void to_json(JsonWriter& writer) const {
+        writer.BeginObject();
         if (type_ == kPropertyTypeBoolean) {
-            cJSON_AddStringToObject(json, "type", "boolean");
+            writer.Field("type", "boolean");
             if (has_default_value_) {
-                cJSON_AddBoolToObject(json, "default", value<bool>());
+                writer.Field("default", value<bool>());
             }
         } else if (type_ == kPropertyTypeInteger) {
-            cJSON_AddStringToObject(json, "type", "integer");
+            writer.Field("type", "integer");
             if (has_default_value_) {
-                cJSON_AddNumberToObject(json, "default", value<int>());
+                writer.Field("default", value<int>());
             }
             if (min_value_.has_value()) {
-                cJSON_AddNumberToObject(json, "minimum", min_value_.value());
+                writer.Field("minimum", min_value_.value());
             }
             if (max_value_.has_value()) {
-                cJSON_AddNumberToObject(json, "maximum", max_value_.value());
+                writer.Field("maximum", max_value_.value());
             }
         } else if (type_ == kPropertyTypeString) {
-            cJSON_AddStringToObject(json, "type", "string");
+            writer.Field("type", "string");
             if (has_default_value_) {
-                cJSON_AddStringToObject(json, "default", value<std::string>().c_str());
+                writer.Field("default", value<std::string>());
             }
         }
-        
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
+        writer.EndObject();
+    }
+
+    std::string to_json() const {
+        std::string result;
+        JsonWriter writer(result);
+        to_json(writer);
         return result;
     }
 };
@@ -154,99 +182,236 @@ public:
         return required;
     }
 
-    std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        
+    void to_json(JsonWriter& writer) const {
+        writer.BeginObject();
         for (const auto& property : properties_) {
-            cJSON *prop_json = cJSON_Parse(property.to_json().c_str());
-            cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
+            writer.Key(property.name());
+            property.to_json(writer);
         }
-        
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
+        writer.EndObject();
+    }
+
+    std::string to_json() const {
+        std::string result;
+        JsonWriter writer(result);
+        to_json(writer);
         return result;
     }
 };
 
+class McpTool;
+class McpToolExecutor;
+
+/*
+ * One tools/call in flight, created by McpTool::Bind() with the decoded arguments.
+ * A synchronous tool never sees it; an asynchronous tool keeps the shared pointer and
+ * finishes the call later from whichever task has the answer.
+ */
+class McpToolCall {
+public:
+    virtual ~McpToolCall() = default;
+
+    // Sent as notifications/progress, only when the client asked for it with params._meta.progressToken.
+    // A streaming tool can put partial content into message
+    void ReportProgress(int progress, int total, const std::string& message = "");
+    void Resolve(ReturnValue value);
+    void Reject(const std::string& message);
+    // Cancelled by the client or past the deadline: nothing more reaches the client and the tool may stop
+    // early, but it must still resolve or reject, its serial group stays busy until it does
+    inline bool IsDone() const { return done_; }
+    // Continues the call on the executor's thread for blocking work (uploads, waiting on a server), so the
+    // worker that started it is free for other tools. Jobs run one at a time in the order they are handed over
+    void RunBlocking(std::function<void()> job);
+
+protected:
+    explicit McpToolCall(McpTool* tool) : tool_(tool) {}
+
+private:
+    friend class McpToolExecutor;
+
+    McpToolExecutor* executor_ = nullptr;
+    int id_ = 0;
+    McpTool* tool_;
+    std::string progress_token_;
+    int64_t enqueue_time_us_ = 0;
+    int64_t deadline_us_ = 0;
+    int64_t start_time_us_ = 0;
+    std::atomic<bool> done_ = false;
+    bool finished_ = false;
+};
+
+// Arguments of a tool declared with a PropertyList
+class McpPropertyListCall : public McpToolCall {
+public:
+    McpPropertyListCall(McpTool* tool, PropertyList&& arguments)
+        : McpToolCall(tool), arguments(std::move(arguments)) {}
+
+    PropertyList arguments;
+};
+
+using McpToolCallback = std::function<ReturnValue(const PropertyList&)>;
+using McpAsyncToolCallback = std::function<void(const PropertyList&, std::shared_ptr<McpToolCall>)>;
+
 class McpTool {
 private:
     std::string name_;
     std::string description_;
     PropertyList properties_;
-    std::function<ReturnValue(const PropertyList&)> callback_;
+    McpToolCallback callback_;
+    McpAsyncToolCallback async_callback_;
+    // Calls of tools in the same serial group never overlap, tools without one run in parallel
+    std::string serial_group_;
+    int timeout_ms_ = MCP_TOOL_CALL_TIMEOUT_MS;
+    // A tool never changes after it is registered, so its schema is serialized once
+    mutable std::string json_;
+
+protected:
+    // For tools that decode their own arguments, see mcp_schema.h
+    McpTool(const std::string& name, const std::string& description)
+        : name_(name), description_(description) {}
 
 public:
     McpTool(const std::string& name, 
             const std::string& description, 
             const PropertyList& properties, 
-            std::function<ReturnValue(const PropertyList&)> callback)
+            McpToolCallback callback)
         : name_(name), 
         description_(description), 
         properties_(properties), 
         callback_(callback) {}
 
+    McpTool(const std::string& name,
+            const std::string& description,
+            const PropertyList& properties,
+            McpAsyncToolCallback callback)
+        : name_(name),
+        description_(description),
+        properties_(properties),
+        async_callback_(callback) {}
+
     inline const std::string& name() const { return name_; }
     inline const std::string& description() const { return description_; }
     inline const PropertyList& properties() const { return properties_; }
-
-    std::string to_json() const {
+    inline const std::string& serial_group() const { return serial_group_; }
+    inline int timeout_ms() const { return timeout_ms_; }
+    inline void set_serial_group(const std::string& group) { serial_group_ = group; }
+    inline void set_timeout_ms(int timeout_ms) { timeout_ms_ = timeout_ms; }
+
+    virtual ~McpTool() = default;
+
+    // Decode and validate the arguments of a tools/call. Returns nullptr and sets error if they are invalid
+    virtual std::shared_ptr<McpToolCall> Bind(const JsonReader& arguments, std::string& error);
+    virtual void WriteInputSchema(JsonWriter& writer) const {
+        writer.BeginObject();
+        writer.Field("type", "object");
+        writer.Key("properties");
+        properties_.to_json(writer);
         std::vector<std::string> required = properties_.GetRequired();
-        
-        cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "name", name_.c_str());
-        cJSON_AddStringToObject(json, "description", description_.c_str());
-        
-        cJSON *input_schema = cJSON_CreateObject();
-        cJSON_AddStringToObject(input_schema, "type", "object");
-        
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
-        cJSON_AddItemToObject(input_schema, "properties", properties);
-        
         if (!required.empty()) {
-            cJSON *required_array = cJSON_CreateArray();
+            writer.Key("required");
+            writer.BeginArray();
             for (const auto& property : required) {
-                cJSON_AddItemToArray(required_array, cJSON_CreateString(property.c_str()));
+                writer.String(property);
             }
-            cJSON_AddItemToObject(input_schema, "required", required_array);
+            writer.EndArray();
         }
-        
-        cJSON_AddItemToObject(json, "inputSchema", input_schema);
-        
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
-        return result;
+        writer.EndObject();
+    }
+
+    void to_json(JsonWriter& writer) const {
+        writer.BeginObject();
+        writer.Field("name", name_);
+        writer.Field("description", description_);
+        writer.Key("inputSchema");
+        WriteInputSchema(writer);
+        writer.EndObject();
     }
 
-    std::string Call(const PropertyList& properties) {
-        ReturnValue return_value = callback_(properties);
-        // 返回结果
-        cJSON* result = cJSON_CreateObject();
-        cJSON* content = cJSON_CreateArray();
-        cJSON* text = cJSON_CreateObject();
-        cJSON_AddStringToObject(text, "type", "text");
-        if (std::holds_alternative<std::string>(return_value)) {
-            cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
-        } else if (std::holds_alternative<bool>(return_value)) {
-            cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
-        } else if (std::holds_alternative<int>(return_value)) {
-            cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
+    const std::string& to_json() const {
+        if (json_.empty()) {
+            json_.reserve(description_.size() + 256);
+            JsonWriter writer(json_);
+            to_json(writer);
+            json_.shrink_to_fit();
         }
-        cJSON_AddItemToArray(content, text);
-        cJSON_AddItemToObject(result, "content", content);
-        cJSON_AddBoolToObject(result, "isError", false);
-
-        auto json_str = cJSON_PrintUnformatted(result);
-        std::string result_str(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(result);
-        return result_str;
+        return json_;
+    }
+
+    inline bool async() const { return async_callback_ != nullptr; }
+
+    // Runs a synchronous tool, the server turns the value into the result object
+    virtual ReturnValue Call(McpToolCall& call) {
+        return callback_(static_cast<McpPropertyListCall&>(call).arguments);
     }
+
+    // Returns as soon as the tool has taken the call, the result arrives through McpToolCall::Resolve()
+    void CallAsync(std::shared_ptr<McpToolCall> call) {
+        auto& arguments = static_cast<McpPropertyListCall&>(*call).arguments;
+        async_callback_(arguments, std::move(call));
+    }
+
+    // The result object of a tools/call, with binary content base64 encoded in place. With data_offset
+    // the content is left out: its string stays empty and data_offset gets the position between the quotes
+    static void WriteResult(JsonWriter& writer, const ReturnValue& return_value, size_t* data_offset = nullptr) {
+        writer.BeginObject();
+        writer.Key("content");
+        writer.BeginArray();
+        writer.BeginObject();
+        if (auto content = std::get_if<McpBinaryContent>(&return_value)) {
+            writer.Field("type", content->type == kMcpContentImage ? "image" : "audio");
+            writer.Key("data");
+            if (data_offset != nullptr) {
+                *data_offset = writer.size() + 1;
+                writer.String("");
+            } else {
+                writer.Base64(content->data.data(), content->data.size());
+            }
+            writer.Field("mimeType", content->mime_type);
+        } else {
+            // 返回结果
+            writer.Field("type", "text");
+            if (std::holds_alternative<std::string>(return_value)) {
+                writer.Field("text", std::get<std::string>(return_value));
+            } else if (std::holds_alternative<bool>(return_value)) {
+                writer.Field("text", std::get<bool>(return_value) ? "true" : "false");
+            } else if (std::holds_alternative<int>(return_value)) {
+                writer.Field("text", std::to_string(std::get<int>(return_value)));
+            }
+        }
+        writer.EndObject();
+        writer.EndArray();
+        writer.Field("isError", false);
+        writer.EndObject();
+    }
+
+    // Upper bound of what WriteResult() produces, enough to reserve the reply in one go
+    static size_t ResultSize(const ReturnValue& return_value) {
+        if (auto content = std::get_if<McpBinaryContent>(&return_value)) {
+            return JsonWriter::Base64Length(content->data.size()) + content->mime_type.size() + 96;
+        } else if (auto text = std::get_if<std::string>(&return_value)) {
+            // Escaping may still grow the string, that only costs one reallocation
+            return text->size() + 64;
+        }
+        return 64;
+    }
+};
+
+using McpResourceReader = std::function<std::string()>;
+
+/*
+ * A small piece of device state that a client reads or subscribes to, instead of polling
+ * self.get_device_status for the whole snapshot. The reader returns the JSON text of the resource.
+ */
+struct McpResource {
+    std::string uri;
+    std::string name;
+    std::string description;
+    McpResourceReader reader;
+    // No setter reports its changes, it is re-read every MCP_RESOURCE_POLL_INTERVAL_MS while subscribed
+    bool polled = false;
+    bool subscribed = false;
+    // Text last sent to the client, an update only goes out when the resource reads differently
+    std::string last_value;
 };
 
 class McpServer {
@@ -258,24 +423,94 @@ public:
 
     void AddCommonTools();
     void AddTool(McpTool* tool);
-    void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
-    void ParseMessage(const cJSON* json);
+    void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, McpToolCallback callback);
+    void AddAsyncTool(const std::string& name, const std::string& description, const PropertyList& properties, McpAsyncToolCallback callback);
+    void AddCommonResources();
+    void AddResource(const std::string& uri, const std::string& name, const std::string& description, McpResourceReader reader, bool polled = false);
+    // Called by whatever changed the value, subscribers get notifications/resources/updated with the new contents
+    void NotifyResourceChanged(const std::string& uri);
+    // For callers that must not block (esp_timer callbacks), the read and the send run on the tool executor
+    void PostResourceChanged(const std::string& uri);
+    // Tool with a compile-time schema, see mcp_schema.h
+    template<typename Schema>
+    void AddTool(const std::string& name, const std::string& description, typename Schema::Callback callback);
+    void ParseMessage(const JsonReader& json);
     void ParseMessage(const std::string& message);
 
+    // Put registered tools into a serial group, a name ending with '.' applies to every tool under that prefix
+    void SetToolSerialGroup(const std::string& name, const std::string& group);
+    void SetToolTimeout(const std::string& name, int timeout_ms);
+    // Queue wait and execution time per tool
+    void LogToolStatistics();
+
 private:
     McpServer();
     ~McpServer();
 
-    void ParseCapabilities(const cJSON* capabilities);
+    // A JSON-RPC batch, its replies are sent back together once the last one is in
+    struct Batch {
+        std::string replies;
+        int pending = 0;
+        bool sealed = false;
+
+        inline void Append(const std::string& reply) {
+            if (replies.size() > 1) {
+                replies.push_back(',');
+            }
+            replies += reply;
+        }
+    };
+    // A request waiting for its reply. A batch request's reply is collected into its batch, plain
+    // requests are only counted so that no batch request can claim their id meanwhile
+    struct PendingReply {
+        std::shared_ptr<Batch> batch;
+        int plain = 0;
+    };
+
+    void ParseCapabilities(const JsonReader& capabilities);
+    bool HandleRequest(const JsonReader& json);
+    void ParseBatch(const JsonReader& json);
+    bool ClaimReply(int id, const std::shared_ptr<Batch>& batch);
+    bool TakeDirectReply(int id);
+    void SendReply(int id, const std::string& payload);
+    void SendContentReply(int id, const ReturnValue& value);
+    void DropReply(int id);
+    void FlushBatch(const std::shared_ptr<Batch>& batch, std::unique_lock<std::mutex>& lock);
 
     void ReplyResult(int id, const std::string& result);
+    void ReplyToolResult(int id, const ReturnValue& value);
     void ReplyError(int id, const std::string& message);
+    static std::string BuildError(int id, const std::string& message);
+    void SendProgress(const std::string& progress_token, int progress, int total, const std::string& message);
 
     void GetToolsList(int id, const std::string& cursor);
-    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size);
-
+    size_t BuildToolsListPage(size_t start, std::string& result);
+    void BuildToolsListPages();
+    void DoToolCall(int id, const std::string& tool_name, const JsonReader& tool_arguments, int stack_size, std::string_view progress_token);
+    template<typename F>
+    void ForEachTool(const std::string& name, F&& callback);
+
+    void GetResourcesList(int id);
+    void ReadResource(int id, const std::string& uri);
+    void SubscribeResource(int id, const std::string& uri, bool subscribe);
+    void PollResources();
+    McpResource* FindResource(const std::string& uri);
+    static void WriteResourceContents(JsonWriter& writer, const std::string& uri, const std::string& text);
+
+    // tools_ keeps the registration order that tools/list reports, tool_index_ finds a tool by name
     std::vector<McpTool*> tools_;
-    std::thread tool_call_thread_;
+    std::unordered_map<std::string, McpTool*> tool_index_;
+    // tools/list pages keyed by their cursor (the first tool name of the page, "" for the first page)
+    std::unordered_map<std::string, std::string> tools_list_pages_;
+    std::unique_ptr<McpToolExecutor> tool_executor_;
+    // Requests waiting for their reply by id, replies to batch requests are collected instead of sent.
+    // JSON-RPC matches replies by id alone, so a batch never shares an id with another pending request
+    std::mutex reply_mutex_;
+    std::unordered_map<int, PendingReply> pending_replies_;
+    // Registered at startup, subscriptions and last values change under resources_mutex_
+    std::mutex resources_mutex_;
+    std::vector<McpResource> resources_;
+    esp_timer_handle_t resource_poll_timer_ = nullptr;
 };
 
 #endif // MCP_SERVER_H
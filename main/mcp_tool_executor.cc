@@ -0,0 +1,357 @@
+#include "mcp_tool_executor.h"
+
+#include <esp_log.h>
+#include <esp_pthread.h>
+#include <algorithm>
+
+#define TAG "MCP"
+
+McpToolExecutor::McpToolExecutor(ResultCallback on_result, ReplyCallback on_error, ProgressCallback on_progress)
+    : on_result_(on_result), on_error_(on_error), on_progress_(on_progress) {
+}
+
+McpToolExecutor::~McpToolExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    cv_.notify_all();
+    watchdog_cv_.notify_all();
+    blocking_cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    if (watchdog_thread_.joinable()) {
+        watchdog_thread_.join();
+    }
+    if (blocking_thread_.joinable()) {
+        blocking_thread_.join();
+    }
+}
+
+void McpToolExecutor::StartWorkers() {
+    // Workers are created on the first call, a device that never receives one pays nothing.
+    // The thread config is per calling task, put back the caller's after spawning
+    esp_pthread_cfg_t saved_cfg;
+    bool has_saved_cfg = esp_pthread_get_cfg(&saved_cfg) == ESP_OK;
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.thread_name = "tool_call";
+    cfg.stack_size = MCP_TOOL_WORKER_STACK_SIZE;
+    cfg.prio = 1;
+    esp_pthread_set_cfg(&cfg);
+    for (int i = 0; i < MCP_TOOL_WORKER_COUNT; i++) {
+        workers_.emplace_back([this]() {
+            WorkerLoop();
+        });
+    }
+
+    // The watchdog sends the timeout errors itself, it must not depend on a worker being free
+    cfg.thread_name = "tool_watchdog";
+    cfg.stack_size = MCP_TOOL_WATCHDOG_STACK_SIZE;
+    esp_pthread_set_cfg(&cfg);
+    watchdog_thread_ = std::thread([this]() {
+        WatchdogLoop();
+    });
+
+    if (has_saved_cfg) {
+        esp_pthread_set_cfg(&saved_cfg);
+    } else {
+        cfg = esp_pthread_get_default_config();
+        esp_pthread_set_cfg(&cfg);
+    }
+}
+
+void McpToolExecutor::Submit(int id, std::shared_ptr<McpToolCall> call, const std::string& progress_token) {
+    McpTool* tool = call->tool_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& stats = stats_[tool->name()];
+        if (queue_.size() >= MCP_TOOL_QUEUE_SIZE) {
+            stats.rejected++;
+        } else {
+            stats.calls++;
+            if (workers_.empty()) {
+                StartWorkers();
+            }
+            call->executor_ = this;
+            call->id_ = id;
+            call->progress_token_ = progress_token;
+            call->enqueue_time_us_ = esp_timer_get_time();
+            call->deadline_us_ = call->enqueue_time_us_ + tool->timeout_ms() * 1000LL;
+            queue_.push_back(std::move(call));
+            cv_.notify_all();
+            watchdog_cv_.notify_one();
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "tools/call: Queue full, rejected %s", tool->name().c_str());
+    on_error_(id, "Too many tool calls in progress");
+}
+
+void McpToolExecutor::Post(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (quit_) {
+        return;
+    }
+    if (workers_.empty()) {
+        StartWorkers();
+    }
+    jobs_.push_back(std::move(job));
+    watchdog_cv_.notify_one();
+}
+
+void McpToolExecutor::RunBlocking(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (quit_) {
+        return;
+    }
+    if (!blocking_thread_.joinable()) {
+        // Created on first use, only boards whose tools block (camera) ever pay for its stack
+        esp_pthread_cfg_t saved_cfg;
+        bool has_saved_cfg = esp_pthread_get_cfg(&saved_cfg) == ESP_OK;
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        cfg.thread_name = "tool_blocking";
+        cfg.stack_size = MCP_TOOL_BLOCKING_STACK_SIZE;
+        cfg.prio = 1;
+        esp_pthread_set_cfg(&cfg);
+        blocking_thread_ = std::thread([this]() {
+            BlockingLoop();
+        });
+        if (has_saved_cfg) {
+            esp_pthread_set_cfg(&saved_cfg);
+        } else {
+            cfg = esp_pthread_get_default_config();
+            esp_pthread_set_cfg(&cfg);
+        }
+    }
+    blocking_jobs_.push_back(std::move(job));
+    blocking_cv_.notify_one();
+}
+
+void McpToolExecutor::Cancel(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto queued = std::find_if(queue_.begin(), queue_.end(), [id](const std::shared_ptr<McpToolCall>& call) {
+        return call->id_ == id;
+    });
+    if (queued != queue_.end()) {
+        ESP_LOGI(TAG, "tools/call: Cancelled queued call %d (%s)", id, (*queued)->tool_->name().c_str());
+        stats_[(*queued)->tool_->name()].cancelled++;
+        queue_.erase(queued);
+        return;
+    }
+    for (auto& call : running_) {
+        if (call->id_ == id && !call->done_) {
+            ESP_LOGI(TAG, "tools/call: Cancelled running call %d (%s), its result will be discarded",
+                id, call->tool_->name().c_str());
+            stats_[call->tool_->name()].cancelled++;
+            call->done_ = true;
+            return;
+        }
+    }
+}
+
+// Oldest queued call whose serial group is free, must be called with mutex_ held
+std::shared_ptr<McpToolCall> McpToolExecutor::TakeRunnable() {
+    for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+        const auto& group = (*it)->tool_->serial_group();
+        if (group.empty() || busy_groups_.find(group) == busy_groups_.end()) {
+            auto call = std::move(*it);
+            queue_.erase(it);
+            return call;
+        }
+    }
+    return nullptr;
+}
+
+void McpToolExecutor::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_) {
+        auto call = TakeRunnable();
+        if (call == nullptr) {
+            cv_.wait(lock);
+            continue;
+        }
+
+        McpTool* tool = call->tool_;
+        if (!tool->serial_group().empty()) {
+            busy_groups_.insert(tool->serial_group());
+        }
+        running_.push_back(call);
+        call->start_time_us_ = esp_timer_get_time();
+        lock.unlock();
+
+        if (tool->async()) {
+            // The tool resolves the call whenever it is ready, the worker is free once it has started
+            try {
+                tool->CallAsync(call);
+            } catch (const std::exception& e) {
+                Finish(call.get(), false, e.what());
+            }
+        } else {
+            ReturnValue result;
+            std::string error;
+            try {
+                result = tool->Call(*call);
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+            Finish(call.get(), std::move(result), error);
+        }
+        call.reset();
+        lock.lock();
+    }
+}
+
+void McpToolExecutor::Finish(McpToolCall* call, ReturnValue result, const std::string& error) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (call->finished_) {
+        ESP_LOGW(TAG, "tools/call: %s resolved call %d twice", call->tool_->name().c_str(), call->id_);
+        return;
+    }
+    call->finished_ = true;
+    McpTool* tool = call->tool_;
+    int64_t end_time = esp_timer_get_time();
+    uint32_t wait_ms = (call->start_time_us_ - call->enqueue_time_us_) / 1000;
+    uint32_t exec_ms = (end_time - call->start_time_us_) / 1000;
+    // running_ holds a reference, keep the call alive until we are done with it
+    std::shared_ptr<McpToolCall> keep_alive;
+    for (auto it = running_.begin(); it != running_.end(); ++it) {
+        if (it->get() == call) {
+            keep_alive = std::move(*it);
+            running_.erase(it);
+            break;
+        }
+    }
+    if (!tool->serial_group().empty()) {
+        busy_groups_.erase(tool->serial_group());
+    }
+    auto& stats = stats_[tool->name()];
+    stats.executed++;
+    stats.total_wait_ms += wait_ms;
+    stats.max_wait_ms = std::max(stats.max_wait_ms, wait_ms);
+    stats.total_exec_ms += exec_ms;
+    stats.max_exec_ms = std::max(stats.max_exec_ms, exec_ms);
+    if (!error.empty()) {
+        stats.failed++;
+    }
+    bool discard = call->done_.exchange(true);
+    // The serial group is free again, another worker may be waiting for it
+    cv_.notify_all();
+    lock.unlock();
+
+    if (discard) {
+        ESP_LOGW(TAG, "tools/call: %s finished after its deadline or cancellation, waited %lu ms, ran %lu ms",
+            tool->name().c_str(), wait_ms, exec_ms);
+    } else if (error.empty()) {
+        ESP_LOGI(TAG, "tools/call: %s waited %lu ms, ran %lu ms", tool->name().c_str(), wait_ms, exec_ms);
+        on_result_(call->id_, result);
+    } else {
+        ESP_LOGE(TAG, "tools/call: %s", error.c_str());
+        on_error_(call->id_, error);
+    }
+}
+
+void McpToolExecutor::WatchdogLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_) {
+        if (!jobs_.empty()) {
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+            continue;
+        }
+        if (queue_.empty() && running_.empty()) {
+            // Nothing has a deadline, sleep until the next call or job arrives
+            watchdog_cv_.wait(lock);
+            continue;
+        }
+        watchdog_cv_.wait_for(lock, std::chrono::milliseconds(MCP_TOOL_WATCHDOG_INTERVAL_MS));
+        if (quit_) {
+            break;
+        }
+        auto expired = CheckTimeouts(esp_timer_get_time());
+        if (expired.empty()) {
+            continue;
+        }
+        lock.unlock();
+        for (int id : expired) {
+            on_error_(id, "Tool call timed out");
+        }
+        lock.lock();
+    }
+}
+
+void McpToolExecutor::BlockingLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_) {
+        if (blocking_jobs_.empty()) {
+            blocking_cv_.wait(lock);
+            continue;
+        }
+        auto job = std::move(blocking_jobs_.front());
+        blocking_jobs_.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+// Marks the calls past their deadline, must be called with mutex_ held. Returns their ids
+std::vector<int> McpToolExecutor::CheckTimeouts(int64_t now) {
+    std::vector<int> expired;
+    for (auto it = queue_.begin(); it != queue_.end();) {
+        if (now >= (*it)->deadline_us_) {
+            ESP_LOGW(TAG, "tools/call: %s timed out in the queue", (*it)->tool_->name().c_str());
+            stats_[(*it)->tool_->name()].timeouts++;
+            expired.push_back((*it)->id_);
+            it = queue_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto& call : running_) {
+        if (!call->done_ && now >= call->deadline_us_) {
+            // The tool keeps running, its serial group is only released when it returns or resolves
+            ESP_LOGW(TAG, "tools/call: %s timed out after %d ms, %s stays busy until it returns",
+                call->tool_->name().c_str(), call->tool_->timeout_ms(),
+                call->tool_->serial_group().empty() ? "its worker" : call->tool_->serial_group().c_str());
+            stats_[call->tool_->name()].timeouts++;
+            call->done_ = true;
+            expired.push_back(call->id_);
+        }
+    }
+    return expired;
+}
+
+void McpToolExecutor::LogStatistics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [name, stats] : stats_) {
+        ESP_LOGI(TAG, "%s: calls=%lu rejected=%lu timeouts=%lu cancelled=%lu failed=%lu wait avg/max=%lu/%lu ms exec avg/max=%lu/%lu ms",
+            name.c_str(), stats.calls, stats.rejected, stats.timeouts, stats.cancelled, stats.failed,
+            stats.executed > 0 ? (uint32_t)(stats.total_wait_ms / stats.executed) : 0, stats.max_wait_ms,
+            stats.executed > 0 ? (uint32_t)(stats.total_exec_ms / stats.executed) : 0, stats.max_exec_ms);
+    }
+}
+
+void McpToolCall::ReportProgress(int progress, int total, const std::string& message) {
+    if (progress_token_.empty() || done_) {
+        return;
+    }
+    executor_->on_progress_(progress_token_, progress, total, message);
+}
+
+void McpToolCall::Resolve(ReturnValue value) {
+    executor_->Finish(this, std::move(value), "");
+}
+
+void McpToolCall::RunBlocking(std::function<void()> job) {
+    executor_->RunBlocking(std::move(job));
+}
+
+void McpToolCall::Reject(const std::string& message) {
+    executor_->Finish(this, false, message.empty() ? "Tool call failed" : message);
+}
@@ -0,0 +1,111 @@
+#ifndef MCP_TOOL_EXECUTOR_H
+#define MCP_TOOL_EXECUTOR_H
+
+#include "mcp_server.h"
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_set>
+#include <esp_timer.h>
+
+// Tool calls run on this many long-lived workers instead of one new thread per call
+#define MCP_TOOL_WORKER_COUNT 2
+#define MCP_TOOL_WORKER_STACK_SIZE 8192
+// Calls waiting for a worker, further calls are rejected until the queue drains
+#define MCP_TOOL_QUEUE_SIZE 8
+#define MCP_TOOL_WATCHDOG_INTERVAL_MS 1000
+// Blocking parts of asynchronous tools (photo upload and explanation) share one long-lived thread
+#define MCP_TOOL_BLOCKING_STACK_SIZE 8192
+// The watchdog also runs posted jobs (resource reads, notifications), which need more than the timeout replies
+#define MCP_TOOL_WATCHDOG_STACK_SIZE 6144
+
+struct McpToolStats {
+    uint32_t calls = 0;
+    uint32_t executed = 0;      // Calls that got a worker, the averages are over these
+    uint32_t rejected = 0;      // Queue was full
+    uint32_t timeouts = 0;
+    uint32_t cancelled = 0;
+    uint32_t failed = 0;        // The tool threw
+    uint32_t max_wait_ms = 0;
+    uint32_t max_exec_ms = 0;
+    uint64_t total_wait_ms = 0;
+    uint64_t total_exec_ms = 0;
+};
+
+/*
+ * Runs tools/call requests on a fixed pool of workers.
+ *
+ * A synchronous tool occupies its worker until the callback returns. An asynchronous tool
+ * only borrows the worker to start the call and finishes it through McpToolCall later, so a
+ * call waiting on the network does not hold a worker.
+ *
+ * Tools that share a serial group (camera, servos) run one at a time in arrival order,
+ * tools without a group (status queries) run on whichever worker is free. Every call has a
+ * deadline counted from its arrival; when it passes the client gets an error and whatever
+ * the tool returns later is discarded. The deadlines are checked by a watchdog thread of the
+ * executor, which also sends the timeout errors, so no reply goes out from the esp_timer task.
+ * Timer callbacks elsewhere hand their work to the same thread through Post(). An asynchronous
+ * tool that has to block for seconds hands the rest of the call to a separate blocking thread
+ * through RunBlocking(), instead of holding a worker or spawning a thread per call.
+ *
+ * A tool cannot be interrupted, so a timed out call keeps its worker and its serial group
+ * until the tool returns or resolves (Finish). Until then later calls in the same group stay
+ * queued and time out in the queue if the tool never comes back.
+ */
+class McpToolExecutor {
+public:
+    using ResultCallback = std::function<void(int id, const ReturnValue& value)>;
+    using ReplyCallback = std::function<void(int id, const std::string& message)>;
+    using ProgressCallback = std::function<void(const std::string& progress_token, int progress, int total, const std::string& message)>;
+
+    McpToolExecutor(ResultCallback on_result, ReplyCallback on_error, ProgressCallback on_progress);
+    ~McpToolExecutor();
+
+    // call comes from McpTool::Bind() with the arguments already decoded
+    void Submit(int id, std::shared_ptr<McpToolCall> call, const std::string& progress_token);
+    // notifications/cancelled: a queued call is dropped, a running one has its result discarded.
+    // Per the MCP spec no response is sent for a cancelled request
+    void Cancel(int id);
+    // Runs job on the watchdog thread. For short work that must not run in an esp_timer callback,
+    // such as reading resources that query the modem
+    void Post(std::function<void()> job);
+    // Runs job on the blocking thread, see McpToolCall::RunBlocking()
+    void RunBlocking(std::function<void()> job);
+    void LogStatistics();
+
+private:
+    friend class McpToolCall;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::thread> workers_;
+    std::thread watchdog_thread_;
+    std::condition_variable watchdog_cv_;
+    std::deque<std::function<void()>> jobs_;
+    std::thread blocking_thread_;
+    std::condition_variable blocking_cv_;
+    std::deque<std::function<void()>> blocking_jobs_;
+    bool quit_ = false;
+    std::deque<std::shared_ptr<McpToolCall>> queue_;
+    // Started and not yet finished, including asynchronous calls that no longer hold a worker
+    std::list<std::shared_ptr<McpToolCall>> running_;
+    std::unordered_set<std::string> busy_groups_;
+    std::unordered_map<std::string, McpToolStats> stats_;
+    ResultCallback on_result_;
+    ReplyCallback on_error_;
+    ProgressCallback on_progress_;
+
+    void StartWorkers();
+    void WorkerLoop();
+    std::shared_ptr<McpToolCall> TakeRunnable();
+    void Finish(McpToolCall* call, ReturnValue result, const std::string& error);
+    void WatchdogLoop();
+    void BlockingLoop();
+    std::vector<int> CheckTimeouts(int64_t now);
+};
+
+#endif // MCP_TOOL_EXECUTOR_H
@@ -2,9 +2,11 @@
 #include "board.h"
 #include "application.h"
 #include "settings.h"
+#include "json_writer.h"
 
 #include <esp_log.h>
 #include <cstring>
+#include <algorithm>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
@@ -12,10 +14,26 @@
 
 MqttProtocol::MqttProtocol() {
     event_group_handle_ = xEventGroupCreate();
+
+    esp_timer_create_args_t reorder_timer_args = {
+        .callback = [](void* arg) {
+            MqttProtocol* protocol = (MqttProtocol*)arg;
+            protocol->OnReorderTimer();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "udp_reorder",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&reorder_timer_args, &reorder_timer_);
 }
 
 MqttProtocol::~MqttProtocol() {
     ESP_LOGI(TAG, "MqttProtocol deinit");
+    if (reorder_timer_ != nullptr) {
+        esp_timer_stop(reorder_timer_);
+        esp_timer_delete(reorder_timer_);
+    }
     vEventGroupDelete(event_group_handle_);
 }
 
@@ -54,24 +72,23 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
-        if (root == nullptr) {
+        JsonReader root(payload);
+        if (!root.IsObject()) {
             ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
             return;
         }
-        cJSON* type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
+        auto type = root["type"];
+        if (!type.IsString()) {
             ESP_LOGE(TAG, "Message type is invalid");
-            cJSON_Delete(root);
             return;
         }
 
-        if (strcmp(type->valuestring, "hello") == 0) {
+        if (type.Equals("hello")) {
             ParseServerHello(root);
-        } else if (strcmp(type->valuestring, "goodbye") == 0) {
-            auto session_id = cJSON_GetObjectItem(root, "session_id");
-            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session_id->valuestring : "null");
-            if (session_id == nullptr || session_id_ == session_id->valuestring) {
+        } else if (type.Equals("goodbye")) {
+            auto session_id = root["session_id"];
+            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id.GetString("null").c_str());
+            if (!session_id.IsString() || session_id.Equals(session_id_)) {
                 Application::GetInstance().Schedule([this]() {
                     CloseAudioChannel();
                 });
@@ -79,7 +96,6 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
         } else if (on_incoming_json_ != nullptr) {
             on_incoming_json_(root);
         }
-        cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -121,6 +137,7 @@ bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         return false;
     }
 
+    int64_t start_time = esp_timer_get_time();
     std::string nonce(aes_nonce_);
     *(uint16_t*)&nonce[2] = htons(packet->payload.size());
     *(uint32_t*)&nonce[8] = htonl(packet->timestamp);
@@ -135,10 +152,19 @@ bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
     if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
         (uint8_t*)packet->payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
+        statistics_.send_failures++;
         return false;
     }
 
-    return udp_->Send(encrypted) > 0;
+    bool success = udp_->Send(encrypted) > 0;
+    statistics_.send_time_us += esp_timer_get_time() - start_time;
+    if (success) {
+        statistics_.packets_sent++;
+        statistics_.payload_bytes_sent += packet->payload.size();
+    } else {
+        statistics_.send_failures++;
+    }
+    return success;
 }
 
 void MqttProtocol::CloseAudioChannel() {
@@ -146,11 +172,25 @@ void MqttProtocol::CloseAudioChannel() {
         std::lock_guard<std::mutex> lock(channel_mutex_);
         udp_.reset();
     }
+    esp_timer_stop(reorder_timer_);
+    LogStatistics();
+    {
+        std::lock_guard<std::mutex> lock(reorder_mutex_);
+        if (reorder_buffer_ != nullptr) {
+            auto& stats = reorder_buffer_->stats();
+            ESP_LOGI(TAG, "UDP downlink: received %lu, reordered %lu, duplicated %lu, late dropped %lu, lost %lu, concealed %lu",
+                stats.received, stats.reordered, stats.duplicated, stats.late_dropped, stats.lost, stats.concealed);
+            reorder_buffer_.reset();
+        }
+    }
 
-    std::string message = "{";
-    message += "\"session_id\":\"" + session_id_ + "\",";
-    message += "\"type\":\"goodbye\"";
-    message += "}";
+    std::string message;
+    message.reserve(64 + session_id_.size());
+    JsonWriter writer(message);
+    writer.BeginObject();
+    writer.Field("session_id", session_id_);
+    writer.Field("type", "goodbye");
+    writer.EndObject();
     SendText(message);
 
     if (on_audio_channel_closed_ != nullptr) {
@@ -168,9 +208,12 @@ bool MqttProtocol::OpenAudioChannel() {
 
     error_occurred_ = false;
     session_id_ = "";
+    ResetStatistics();
+    int64_t open_start_time = esp_timer_get_time();
     xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 
     auto message = GetHelloMessage();
+    int64_t hello_time = esp_timer_get_time();
     if (!SendText(message)) {
         return false;
     }
@@ -182,6 +225,27 @@ bool MqttProtocol::OpenAudioChannel() {
         SetError(Lang::Strings::SERVER_TIMEOUT);
         return false;
     }
+    statistics_.channel_open_time_us = esp_timer_get_time() - open_start_time;
+    statistics_.hello_rtt_us = esp_timer_get_time() - hello_time;
+    ESP_LOGI(TAG, "Audio channel opened in %lld ms, hello rtt %lld ms", statistics_.channel_open_time_us / 1000,
+        statistics_.hello_rtt_us / 1000);
+
+    {
+        Settings settings("mqtt", false);
+        int hold_ms = settings.GetInt("reorder_hold_ms", MQTT_UDP_REORDER_MAX_HOLD_MS);
+        std::lock_guard<std::mutex> lock(reorder_mutex_);
+        reorder_buffer_ = std::make_unique<UdpReorderBuffer>(MQTT_UDP_REORDER_WINDOW, hold_ms,
+            MQTT_UDP_MAX_CONCEALED_FRAMES);
+        reorder_buffer_->OnPacket([this](std::unique_ptr<AudioStreamPacket> packet) {
+            if (on_incoming_audio_ != nullptr) {
+                on_incoming_audio_(std::move(packet));
+            }
+        });
+        // The buffer releases the concealment packets itself, empty payloads that the decoder conceals
+        reorder_buffer_->OnGap([](uint32_t lost_count) {
+            ESP_LOGW(TAG, "Lost %lu audio packets", lost_count);
+        });
+    }
 
     std::lock_guard<std::mutex> lock(channel_mutex_);
     auto network = Board::GetInstance().GetNetwork();
@@ -200,15 +264,11 @@ bool MqttProtocol::OpenAudioChannel() {
             ESP_LOGE(TAG, "Invalid audio packet type: %x", data[0]);
             return;
         }
+        int64_t start_time = esp_timer_get_time();
+        statistics_.packets_received++;
+        statistics_.payload_bytes_received += data.size() - aes_nonce_.size();
         uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
         uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
-            return;
-        }
-        if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
-        }
 
         size_t decrypted_size = data.size() - aes_nonce_.size();
         size_t nc_off = 0;
@@ -225,11 +285,18 @@ bool MqttProtocol::OpenAudioChannel() {
             ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
             return;
         }
-        if (on_incoming_audio_ != nullptr) {
-            on_incoming_audio_(std::move(packet));
-        }
-        remote_sequence_ = sequence;
+        statistics_.receive_time_us += esp_timer_get_time() - start_time;
         last_incoming_time_ = std::chrono::steady_clock::now();
+
+        // Reorder by sequence, the buffer releases packets to on_incoming_audio_ in order
+        std::lock_guard<std::mutex> lock(reorder_mutex_);
+        if (reorder_buffer_ == nullptr) {
+            return;
+        }
+        reorder_buffer_->Push(sequence, std::move(packet));
+        if (reorder_buffer_->has_held_packets() && !esp_timer_is_active(reorder_timer_)) {
+            esp_timer_start_once(reorder_timer_, reorder_buffer_->max_hold_ms() * 1000);
+        }
     });
 
     udp_->Connect(udp_server_, udp_port_);
@@ -242,64 +309,66 @@ bool MqttProtocol::OpenAudioChannel() {
 
 std::string MqttProtocol::GetHelloMessage() {
     // 发送 hello 消息申请 UDP 通道
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "type", "hello");
-    cJSON_AddNumberToObject(root, "version", 3);
-    cJSON_AddStringToObject(root, "transport", "udp");
-    cJSON* features = cJSON_CreateObject();
+    std::string message;
+    message.reserve(256);
+    JsonWriter writer(message);
+    writer.BeginObject();
+    writer.Field("type", "hello");
+    writer.Field("version", 3);
+    writer.Field("transport", "udp");
+    writer.Key("features");
+    writer.BeginObject();
 #if CONFIG_USE_SERVER_AEC
-    cJSON_AddBoolToObject(features, "aec", true);
+    writer.Field("aec", true);
 #endif
-    cJSON_AddBoolToObject(features, "mcp", true);
-    cJSON_AddItemToObject(root, "features", features);
-    cJSON* audio_params = cJSON_CreateObject();
-    cJSON_AddStringToObject(audio_params, "format", "opus");
-    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
-    cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
-    cJSON_AddItemToObject(root, "audio_params", audio_params);
-    auto json_str = cJSON_PrintUnformatted(root);
-    std::string message(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
+    writer.Field("mcp", true);
+    writer.EndObject();
+    writer.Key("audio_params");
+    writer.BeginObject();
+    writer.Field("format", "opus");
+    writer.Field("sample_rate", 16000);
+    writer.Field("channels", 1);
+    writer.Field("frame_duration", OPUS_FRAME_DURATION_MS);
+    writer.EndObject();
+    writer.EndObject();
     return message;
 }
 
-void MqttProtocol::ParseServerHello(const cJSON* root) {
-    auto transport = cJSON_GetObjectItem(root, "transport");
-    if (transport == nullptr || strcmp(transport->valuestring, "udp") != 0) {
-        ESP_LOGE(TAG, "Unsupported transport: %s", transport->valuestring);
+void MqttProtocol::ParseServerHello(const JsonReader& root) {
+    auto transport = root["transport"];
+    if (!transport.Equals("udp")) {
+        ESP_LOGE(TAG, "Unsupported transport: %s", transport.GetString("null").c_str());
         return;
     }
 
-    auto session_id = cJSON_GetObjectItem(root, "session_id");
-    if (cJSON_IsString(session_id)) {
-        session_id_ = session_id->valuestring;
+    auto session_id = root["session_id"];
+    if (session_id.IsString()) {
+        session_id_ = session_id.GetString();
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
     // Get sample rate from hello message
-    auto audio_params = cJSON_GetObjectItem(root, "audio_params");
-    if (cJSON_IsObject(audio_params)) {
-        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
-        if (cJSON_IsNumber(sample_rate)) {
-            server_sample_rate_ = sample_rate->valueint;
+    auto audio_params = root["audio_params"];
+    if (audio_params.IsObject()) {
+        auto sample_rate = audio_params["sample_rate"];
+        if (sample_rate.IsNumber()) {
+            server_sample_rate_ = sample_rate.GetInt();
         }
-        auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
-        if (cJSON_IsNumber(frame_duration)) {
-            server_frame_duration_ = frame_duration->valueint;
+        auto frame_duration = audio_params["frame_duration"];
+        if (frame_duration.IsNumber()) {
+            server_frame_duration_ = frame_duration.GetInt();
         }
     }
 
-    auto udp = cJSON_GetObjectItem(root, "udp");
-    if (!cJSON_IsObject(udp)) {
+    auto udp = root["udp"];
+    if (!udp.IsObject()) {
         ESP_LOGE(TAG, "UDP is not specified");
         return;
     }
-    udp_server_ = cJSON_GetObjectItem(udp, "server")->valuestring;
-    udp_port_ = cJSON_GetObjectItem(udp, "port")->valueint;
-    auto key = cJSON_GetObjectItem(udp, "key")->valuestring;
-    auto nonce = cJSON_GetObjectItem(udp, "nonce")->valuestring;
+    udp_server_ = udp["server"].GetString();
+    udp_port_ = udp["port"].GetInt();
+    auto key = udp["key"].GetString();
+    auto nonce = udp["nonce"].GetString();
 
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
@@ -307,7 +376,6 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
     mbedtls_aes_init(&aes_ctx_);
     mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
     local_sequence_ = 0;
-    remote_sequence_ = 0;
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
@@ -330,6 +398,22 @@ std::string MqttProtocol::DecodeHexString(const std::string& hex_string) {
     return decoded;
 }
 
+void MqttProtocol::OnReorderTimer() {
+    // Release packets held behind a gap that nobody filled in time
+    std::lock_guard<std::mutex> lock(reorder_mutex_);
+    if (reorder_buffer_ != nullptr && reorder_buffer_->Flush()) {
+        esp_timer_start_once(reorder_timer_, reorder_buffer_->max_hold_ms() * 1000);
+    }
+}
+
+UdpReorderStats MqttProtocol::GetReorderStats() {
+    std::lock_guard<std::mutex> lock(reorder_mutex_);
+    if (reorder_buffer_ == nullptr) {
+        return UdpReorderStats();
+    }
+    return reorder_buffer_->stats();
+}
+
 bool MqttProtocol::IsAudioChannelOpened() const {
     return udp_ != nullptr && !error_occurred_ && !IsTimeout();
 }
@@ -3,12 +3,13 @@
 
 
 #include "protocol.h"
+#include "udp_reorder_buffer.h"
 #include <mqtt.h>
 #include <udp.h>
-#include <cJSON.h>
 #include <mbedtls/aes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <esp_timer.h>
 
 #include <functional>
 #include <string>
@@ -18,6 +19,10 @@
 #define MQTT_PING_INTERVAL_SECONDS 90
 #define MQTT_RECONNECT_INTERVAL_MS 10000
 
+#define MQTT_UDP_REORDER_WINDOW 8
+#define MQTT_UDP_REORDER_MAX_HOLD_MS 120
+#define MQTT_UDP_MAX_CONCEALED_FRAMES 3
+
 #define MQTT_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
 class MqttProtocol : public Protocol {
@@ -30,6 +35,7 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    UdpReorderStats GetReorderStats();
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -44,11 +50,15 @@ private:
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
-    uint32_t remote_sequence_;
+
+    std::mutex reorder_mutex_;
+    std::unique_ptr<UdpReorderBuffer> reorder_buffer_;
+    esp_timer_handle_t reorder_timer_ = nullptr;
 
     bool StartMqttClient(bool report_error=false);
-    void ParseServerHello(const cJSON* root);
+    void ParseServerHello(const JsonReader& root);
     std::string DecodeHexString(const std::string& hex_string);
+    void OnReorderTimer();
 
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
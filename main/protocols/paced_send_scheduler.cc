@@ -0,0 +1,347 @@
+#include "paced_send_scheduler.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_pthread.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#define TAG "PacedSendScheduler"
+
+PacedSendScheduler::PacedSendScheduler(AudioSendFunction send, int frame_duration_ms)
+    : SendScheduler(std::move(send)), frame_duration_ms_(frame_duration_ms) {
+    Settings settings("audio_send", false);
+    deadline_ms_ = settings.GetInt("deadline_ms", SEND_SCHEDULER_DEADLINE_MS);
+
+    // The thread config is per calling task, put back the caller's after spawning the sender
+    esp_pthread_cfg_t saved_cfg;
+    bool has_saved_cfg = esp_pthread_get_cfg(&saved_cfg) == ESP_OK;
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.thread_name = "audio_send";
+    cfg.stack_size = 4096;
+    cfg.prio = 4;
+    esp_pthread_set_cfg(&cfg);
+    send_thread_ = std::thread([this]() {
+        SendLoop();
+    });
+    if (has_saved_cfg) {
+        esp_pthread_set_cfg(&saved_cfg);
+    } else {
+        cfg = esp_pthread_get_default_config();
+        esp_pthread_set_cfg(&cfg);
+    }
+}
+
+PacedSendScheduler::~PacedSendScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    cv_.notify_all();
+    if (send_thread_.joinable()) {
+        send_thread_.join();
+    }
+}
+
+void PacedSendScheduler::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.clear();
+    queued_bytes_ = 0;
+    sent_records_.clear();
+    in_flight_bytes_ = 0;
+    in_flight_time_us_ = 0;
+    pacing_rate_ = 0;
+    tokens_ = 0;
+    last_refill_us_ = esp_timer_get_time();
+    last_probe_us_ = last_refill_us_;
+    resume_time_us_ = 0;
+    stall_rate_ = 0;
+    stats_ = SendSchedulerStats();
+    stats_.srtt_ms = srtt_ms_;
+    active_ = true;
+}
+
+void PacedSendScheduler::Stop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!active_) {
+        return;
+    }
+    active_ = false;
+    queue_.clear();
+    queued_bytes_ = 0;
+    cv_.notify_all();
+    cv_.wait(lock, [this]() { return !sending_; });
+    stats_.srtt_ms = srtt_ms_;
+    stats_.pacing_rate_bps = (int)(pacing_rate_ * 8);
+    LogStatistics();
+}
+
+void PacedSendScheduler::Enqueue(std::unique_ptr<AudioStreamPacket> packet, bool voice) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_) {
+            return;
+        }
+        // Track the rate the encoder produces, it is the floor and the unit for pacing
+        double packet_rate = packet->payload.size() * 1000.0 / frame_duration_ms_;
+        audio_rate_ = audio_rate_ == 0 ? packet_rate : audio_rate_ * 0.9 + packet_rate * 0.1;
+
+        queued_bytes_ += packet->payload.size();
+        queue_.push_back({std::move(packet), esp_timer_get_time(), voice});
+        // Never hold more than the deadline allows, even if the sender is stuck in a send
+        size_t max_packets = deadline_ms_ / frame_duration_ms_ + 1;
+        while (queue_.size() > max_packets) {
+            DropOne();
+        }
+    }
+    cv_.notify_all();
+}
+
+void PacedSendScheduler::OnRttSample(int rtt_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    srtt_ms_ = srtt_ms_ == 0 ? rtt_ms : (srtt_ms_ * 7 + rtt_ms) / 8;
+    ESP_LOGD(TAG, "RTT sample %d ms, srtt %d ms", rtt_ms, srtt_ms_);
+}
+
+void PacedSendScheduler::SendLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_) {
+        if (!active_ || queue_.empty()) {
+            cv_.wait(lock, [this]() { return quit_ || (active_ && !queue_.empty()); });
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        DropStale(now);
+        if (queue_.empty()) {
+            continue;
+        }
+
+        // Coalesce a few frames into one wakeup when the link is slow
+        size_t batch = IsLinkSlow() ? std::min<size_t>(queue_.size(), SEND_SCHEDULER_COALESCE_FRAMES) : 1;
+        size_t batch_bytes = 0;
+        for (size_t i = 0; i < batch; i++) {
+            batch_bytes += queue_[i].packet->payload.size();
+        }
+        int delay_ms = GetSendDelayMs(now, batch_bytes);
+        if (delay_ms > 0) {
+            cv_.wait_for(lock, std::chrono::milliseconds(delay_ms));
+            continue;
+        }
+
+        tokens_ = std::max(0.0, tokens_ - batch_bytes);
+        std::vector<QueuedPacket> items;
+        for (size_t i = 0; i < batch; i++) {
+            queued_bytes_ -= queue_.front().packet->payload.size();
+            items.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+
+        sending_ = true;
+        lock.unlock();
+        size_t sent = 0;
+        while (sent < items.size() && Send(items[sent])) {
+            sent++;
+        }
+        lock.lock();
+        sending_ = false;
+        // A failed send backs off, the rest of the batch waits for the next attempt
+        if (active_) {
+            for (size_t i = items.size(); i > sent + 1; i--) {
+                queued_bytes_ += items[i - 1].packet->payload.size();
+                queue_.push_front(std::move(items[i - 1]));
+            }
+        }
+        cv_.notify_all();
+    }
+}
+
+bool PacedSendScheduler::Send(QueuedPacket& item) {
+    {
+        // Stopped in the middle of a coalesced batch
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_) {
+            return false;
+        }
+    }
+    int64_t start_time = esp_timer_get_time();
+    uint32_t queue_delay_ms = (start_time - item.enqueue_time_us) / 1000;
+    size_t bytes = item.packet->payload.size();
+    bool success = send_(std::move(item.packet));
+    int64_t end_time = esp_timer_get_time();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_) {
+        return false;
+    }
+    stats_.total_queue_delay_ms += queue_delay_ms;
+    stats_.max_queue_delay_ms = std::max(stats_.max_queue_delay_ms, queue_delay_ms);
+    if (success) {
+        OnSendCompleted(end_time, bytes, end_time - start_time);
+    } else {
+        OnSendFailed(end_time);
+    }
+    return success;
+}
+
+void PacedSendScheduler::OnSendCompleted(int64_t now_us, size_t bytes, int64_t duration_us) {
+    stats_.packets_sent++;
+    stats_.bytes_sent += bytes;
+    sent_records_.push_back({now_us, bytes});
+    PruneRecords(now_us);
+    DrainInFlight(now_us);
+    in_flight_bytes_ += bytes;
+
+    if (duration_us > deadline_ms_ * 1000LL) {
+        // Blocked longer than any packet may wait: the link stopped (radio outage, zero window)
+        // rather than slowed down, and one packet over that time says nothing about its rate.
+        // Resume gently at the audio rate and probe up quickly, like after a failed send
+        stats_.stalls++;
+        pacing_rate_ = audio_rate_;
+        stall_rate_ = 0;
+        in_flight_bytes_ = 0;
+        tokens_ = 0;
+        last_refill_us_ = now_us;
+        last_probe_us_ = now_us;
+        ESP_LOGW(TAG, "Send blocked %lld ms, link stopped", duration_us / 1000);
+    } else if (duration_us > SEND_SCHEDULER_STALL_MS * 1000) {
+        // The send buffer was full, so while we were blocked the link drained exactly
+        // this packet worth of bytes: that is the delivery rate. Pace a bit below it
+        stats_.stalls++;
+        double delivery_rate = bytes * 1000000.0 / duration_us;
+        stall_rate_ = delivery_rate;
+        double rate = delivery_rate * 0.9;
+        if (pacing_rate_ > 0) {
+            rate = std::min(rate, pacing_rate_);
+        }
+        pacing_rate_ = std::max(rate, audio_rate_ / 8);
+        tokens_ = 0;
+        last_refill_us_ = now_us;
+        last_probe_us_ = now_us;
+        // Whatever was handed over beyond what the link delivered is still sitting in the send buffer
+        in_flight_bytes_ = std::max<double>(bytes, EstimateBacklog(now_us, delivery_rate));
+        ESP_LOGW(TAG, "Send blocked %lld ms, pacing at %d bps", duration_us / 1000, (int)(pacing_rate_ * 8));
+    } else if (pacing_rate_ > 0 && now_us - last_probe_us_ >= std::max(srtt_ms_, SEND_SCHEDULER_PROBE_INTERVAL_MS) * 1000LL) {
+        // Probe upwards once per interval, not per packet, an overestimate only shows up as the
+        // next stall after the send buffer has filled again. Well below the last stall rate the
+        // link is known to cope, so grow fast there. Once the link sustains several times the
+        // audio rate stop pacing
+        last_probe_us_ = now_us;
+        if (pacing_rate_ < stall_rate_ * 0.8 || stall_rate_ == 0) {
+            pacing_rate_ *= 1.5;
+        } else {
+            pacing_rate_ += audio_rate_ / 40;
+        }
+        if (pacing_rate_ > audio_rate_ * 4) {
+            ESP_LOGI(TAG, "Link recovered, pacing off");
+            pacing_rate_ = 0;
+        }
+    }
+}
+
+void PacedSendScheduler::OnSendFailed(int64_t now_us) {
+    stats_.send_failures++;
+    // The channel is broken or closing, give it one RTT before trying again and
+    // come back at a lower rate so the backlog is not burst out all at once
+    int backoff_ms = std::max(srtt_ms_, 100);
+    resume_time_us_ = now_us + backoff_ms * 1000LL;
+    pacing_rate_ = pacing_rate_ > 0 ? std::max(pacing_rate_ / 2, audio_rate_) : audio_rate_;
+    tokens_ = 0;
+    last_refill_us_ = resume_time_us_;
+    last_probe_us_ = resume_time_us_;
+}
+
+void PacedSendScheduler::DrainInFlight(int64_t now_us) {
+    // Model the transport send buffer as a leaky bucket emptied at the pacing rate
+    if (pacing_rate_ > 0) {
+        in_flight_bytes_ = std::max(0.0, in_flight_bytes_ - pacing_rate_ * (now_us - in_flight_time_us_) / 1000000.0);
+    } else {
+        in_flight_bytes_ = 0;
+    }
+    in_flight_time_us_ = now_us;
+}
+
+void PacedSendScheduler::PruneRecords(int64_t now_us) {
+    while (!sent_records_.empty() && now_us - sent_records_.front().time_us > SEND_SCHEDULER_HISTORY_MS * 1000LL) {
+        sent_records_.pop_front();
+    }
+}
+
+// Replay the recent sends through a leaky bucket drained at rate, what is left is still queued
+double PacedSendScheduler::EstimateBacklog(int64_t now_us, double rate) const {
+    double backlog = 0;
+    int64_t last_us = sent_records_.empty() ? now_us : sent_records_.front().time_us;
+    for (auto& record : sent_records_) {
+        backlog = std::max(0.0, backlog - rate * (record.time_us - last_us) / 1000000.0) + record.bytes;
+        last_us = record.time_us;
+    }
+    return std::max(0.0, backlog - rate * (now_us - last_us) / 1000000.0);
+}
+
+int PacedSendScheduler::GetSendDelayMs(int64_t now_us, size_t batch_bytes) {
+    if (now_us < resume_time_us_) {
+        return (resume_time_us_ - now_us + 999) / 1000;
+    }
+    if (pacing_rate_ <= 0) {
+        return 0;
+    }
+
+    // Keep the send buffer short: at most two bandwidth-delay products in flight, so the
+    // backlog waits in our queue where stale packets can still be dropped
+    double burst = std::max<double>(audio_rate_ * frame_duration_ms_ * SEND_SCHEDULER_MAX_BURST_FRAMES / 1000.0, batch_bytes);
+    DrainInFlight(now_us);
+    double max_in_flight = std::max(pacing_rate_ * srtt_ms_ * 2 / 1000.0, burst);
+    if (in_flight_bytes_ + batch_bytes > max_in_flight) {
+        return (int)std::ceil((in_flight_bytes_ + batch_bytes - max_in_flight) * 1000.0 / pacing_rate_);
+    }
+
+    tokens_ = std::min(burst, tokens_ + pacing_rate_ * (now_us - last_refill_us_) / 1000000.0);
+    last_refill_us_ = now_us;
+    if (tokens_ >= batch_bytes) {
+        return 0;
+    }
+    return (int)std::ceil((batch_bytes - tokens_) * 1000.0 / pacing_rate_);
+}
+
+void PacedSendScheduler::DropStale(int64_t now_us) {
+    DrainInFlight(now_us);
+    while (!queue_.empty()) {
+        // Lag of the head packet once the send buffer and everything in the queue have been sent
+        int64_t drain_ms = pacing_rate_ > 0 ? (int64_t)((queued_bytes_ + in_flight_bytes_) * 1000.0 / pacing_rate_) : 0;
+        int64_t age_ms = (now_us - queue_.front().enqueue_time_us) / 1000;
+        if (age_ms + drain_ms <= deadline_ms_) {
+            break;
+        }
+        if (age_ms > deadline_ms_) {
+            // The head itself is too late, whatever it carries
+            auto& head = queue_.front();
+            if (head.voice) {
+                stats_.dropped_voice++;
+            } else {
+                stats_.dropped_silence++;
+            }
+            queued_bytes_ -= head.packet->payload.size();
+            queue_.pop_front();
+        } else {
+            // The backlog is too long to drain in time, shorten it where it hurts least
+            DropOne();
+        }
+    }
+}
+
+void PacedSendScheduler::DropOne() {
+    // Silence is worth nothing to the server, shed the oldest silent packet before any voice
+    auto it = std::find_if(queue_.begin(), queue_.end(), [](const QueuedPacket& item) {
+        return !item.voice;
+    });
+    if (it != queue_.end()) {
+        stats_.dropped_silence++;
+    } else {
+        it = queue_.begin();
+        stats_.dropped_voice++;
+    }
+    queued_bytes_ -= it->packet->payload.size();
+    queue_.erase(it);
+}
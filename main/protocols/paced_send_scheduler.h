@@ -0,0 +1,103 @@
+#ifndef PACED_SEND_SCHEDULER_H
+#define PACED_SEND_SCHEDULER_H
+
+#include "send_scheduler.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// Packets older than this (queue delay plus estimated drain time) are dropped
+#define SEND_SCHEDULER_DEADLINE_MS 1200
+// A send blocking longer than this means the transport send buffer is full, blocking longer
+// than the deadline means the link stopped altogether
+#define SEND_SCHEDULER_STALL_MS 40
+// Recent sends replayed at the measured rate after a stall to estimate what is still queued in
+// the send buffer, long enough to cover the buffer filling up at a small overload
+#define SEND_SCHEDULER_HISTORY_MS 10000
+// While pacing without stalls the rate is raised once per this interval (or per RTT if longer)
+#define SEND_SCHEDULER_PROBE_INTERVAL_MS 200
+// Token bucket depth when pacing, in frames
+#define SEND_SCHEDULER_MAX_BURST_FRAMES 2
+// On a slow link this many frames are written back to back, so TCP can fill its segments
+#define SEND_SCHEDULER_COALESCE_FRAMES 3
+
+/*
+ * Congestion-aware uplink scheduler.
+ *
+ * While the link keeps up, packets go out as soon as they are encoded. When a send blocks
+ * on the transport (TCP send buffer full, typically a 2G/4G fallback link) the scheduler
+ * switches to pacing: the backlog is drained at the measured delivery rate through a small
+ * token bucket instead of being burst into a buffer that has just stalled. The rate is raised
+ * additively above the last stall rate and multiplicatively below it (or when only failed
+ * sends started the pacing) until the link proves fast enough to go unpaced again.
+ *
+ * Each queued packet has a deadline. When the queue delay plus the estimated time to drain
+ * the queue exceeds it, stale silence is dropped first and voice only when no silence is left.
+ * A failed send backs off for one RTT instead of retrying in a tight loop.
+ */
+class PacedSendScheduler : public SendScheduler {
+public:
+    PacedSendScheduler(AudioSendFunction send, int frame_duration_ms);
+    ~PacedSendScheduler();
+
+    void Start() override;
+    void Stop() override;
+    void Enqueue(std::unique_ptr<AudioStreamPacket> packet, bool voice) override;
+    void OnRttSample(int rtt_ms) override;
+
+private:
+    struct QueuedPacket {
+        std::unique_ptr<AudioStreamPacket> packet;
+        int64_t enqueue_time_us;
+        bool voice;
+    };
+    struct SentRecord {
+        int64_t time_us;
+        size_t bytes;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread send_thread_;
+    bool quit_ = false;
+    bool active_ = false;
+    // The sender thread is inside send_, Stop() waits for it
+    bool sending_ = false;
+
+    std::deque<QueuedPacket> queue_;
+    size_t queued_bytes_ = 0;
+    // Bytes handed to the transport within the history window
+    std::deque<SentRecord> sent_records_;
+    // Estimated bytes still waiting in the transport send buffer
+    double in_flight_bytes_ = 0;
+    int64_t in_flight_time_us_ = 0;
+
+    int frame_duration_ms_;
+    int deadline_ms_;
+    int srtt_ms_ = 0;
+    // Bytes per second, pacing_rate_ == 0 means the link keeps up and nothing is paced
+    double audio_rate_ = 0;
+    double pacing_rate_ = 0;
+    double tokens_ = 0;
+    int64_t last_refill_us_ = 0;
+    int64_t resume_time_us_ = 0;
+    int64_t last_probe_us_ = 0;
+    // Delivery rate measured at the last stall of the session, 0 before the first one
+    double stall_rate_ = 0;
+
+    void SendLoop();
+    bool Send(QueuedPacket& item);
+    void DropStale(int64_t now_us);
+    void DropOne();
+    int GetSendDelayMs(int64_t now_us, size_t batch_bytes);
+    void DrainInFlight(int64_t now_us);
+    void PruneRecords(int64_t now_us);
+    double EstimateBacklog(int64_t now_us, double rate) const;
+    void OnSendCompleted(int64_t now_us, size_t bytes, int64_t duration_us);
+    void OnSendFailed(int64_t now_us);
+    inline bool IsLinkSlow() const { return pacing_rate_ > 0 && pacing_rate_ < audio_rate_ * 2; }
+};
+
+#endif // PACED_SEND_SCHEDULER_H
@@ -1,10 +1,11 @@
 #include "protocol.h"
+#include "json_writer.h"
 
 #include <esp_log.h>
 
 #define TAG "Protocol"
 
-void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
+void Protocol::OnIncomingJson(std::function<void(const JsonReader& root)> callback) {
     on_incoming_json_ = callback;
 }
 
@@ -31,45 +32,119 @@ void Protocol::SetError(const std::string& message) {
     }
 }
 
+// Control messages are small, one reserve covers the fixed keys plus the dynamic strings
+#define CONTROL_MESSAGE_RESERVE 96
+
 void Protocol::SendAbortSpeaking(AbortReason reason) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"abort\"";
+    std::string message;
+    message.reserve(CONTROL_MESSAGE_RESERVE + session_id_.size());
+    JsonWriter writer(message);
+    writer.BeginObject();
+    writer.Field("session_id", session_id_);
+    writer.Field("type", "abort");
     if (reason == kAbortReasonWakeWordDetected) {
-        message += ",\"reason\":\"wake_word_detected\"";
+        writer.Field("reason", "wake_word_detected");
     }
-    message += "}";
+    writer.EndObject();
     SendText(message);
 }
 
 void Protocol::SendWakeWordDetected(const std::string& wake_word) {
-    std::string json = "{\"session_id\":\"" + session_id_ + 
-                      "\",\"type\":\"listen\",\"state\":\"detect\",\"text\":\"" + wake_word + "\"}";
-    SendText(json);
+    std::string message;
+    message.reserve(CONTROL_MESSAGE_RESERVE + session_id_.size() + wake_word.size());
+    JsonWriter writer(message);
+    writer.BeginObject();
+    writer.Field("session_id", session_id_);
+    writer.Field("type", "listen");
+    writer.Field("state", "detect");
+    writer.Field("text", wake_word);
+    writer.EndObject();
+    SendText(message);
 }
 
 void Protocol::SendStartListening(ListeningMode mode) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\"";
-    message += ",\"type\":\"listen\",\"state\":\"start\"";
+    std::string message;
+    message.reserve(CONTROL_MESSAGE_RESERVE + session_id_.size());
+    JsonWriter writer(message);
+    writer.BeginObject();
+    writer.Field("session_id", session_id_);
+    writer.Field("type", "listen");
+    writer.Field("state", "start");
     if (mode == kListeningModeRealtime) {
-        message += ",\"mode\":\"realtime\"";
+        writer.Field("mode", "realtime");
     } else if (mode == kListeningModeAutoStop) {
-        message += ",\"mode\":\"auto\"";
+        writer.Field("mode", "auto");
     } else {
-        message += ",\"mode\":\"manual\"";
+        writer.Field("mode", "manual");
     }
-    message += "}";
+    writer.EndObject();
     SendText(message);
 }
 
 void Protocol::SendStopListening() {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"listen\",\"state\":\"stop\"}";
+    std::string message;
+    message.reserve(CONTROL_MESSAGE_RESERVE + session_id_.size());
+    JsonWriter writer(message);
+    writer.BeginObject();
+    writer.Field("session_id", session_id_);
+    writer.Field("type", "listen");
+    writer.Field("state", "stop");
+    writer.EndObject();
     SendText(message);
 }
 
 void Protocol::SendMcpMessage(const std::string& payload) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":" + payload + "}";
+    std::string message;
+    message.reserve(CONTROL_MESSAGE_RESERVE + session_id_.size() + payload.size());
+    JsonWriter writer(message);
+    writer.BeginObject();
+    writer.Field("session_id", session_id_);
+    writer.Field("type", "mcp");
+    writer.Key("payload");
+    writer.Raw(payload);
+    writer.EndObject();
     SendText(message);
 }
 
+// The envelope that SendMcpMessage() puts around a payload, without the closing brace
+std::string Protocol::McpMessageHead() const {
+    std::string head;
+    head.reserve(CONTROL_MESSAGE_RESERVE + session_id_.size());
+    JsonWriter writer(head);
+    writer.BeginObject();
+    writer.Field("session_id", session_id_);
+    writer.Field("type", "mcp");
+    writer.Key("payload");
+    return head;
+}
+
+// Transports that cannot fragment a message collect the pieces into one
+void Protocol::SendMcpMessageChunked(const MessageSource& source) {
+    std::string message = McpMessageHead();
+    std::string chunk;
+    while (source(chunk)) {
+        message += chunk;
+    }
+    message += '}';
+    SendText(message);
+}
+
+void Protocol::ResetStatistics() {
+    statistics_ = ProtocolStatistics();
+}
+
+void Protocol::LogStatistics() const {
+    auto& s = statistics_;
+    ESP_LOGI(TAG, "Channel opened in %lld ms, sent %lu packets / %llu payload bytes (%lu failed), received %lu packets / %llu payload bytes",
+        s.channel_open_time_us / 1000, s.packets_sent, s.payload_bytes_sent, s.send_failures, s.packets_received,
+        s.payload_bytes_received);
+    if (s.packets_sent > 0 || s.packets_received > 0) {
+        ESP_LOGI(TAG, "CPU per packet: send %lld us, receive %lld us",
+            s.packets_sent > 0 ? s.send_time_us / s.packets_sent : 0,
+            s.packets_received > 0 ? s.receive_time_us / s.packets_received : 0);
+    }
+}
+
 bool Protocol::IsTimeout() const {
     const int kTimeoutSeconds = 120;
     auto now = std::chrono::steady_clock::now();
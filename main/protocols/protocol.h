@@ -1,8 +1,9 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
-#include <cJSON.h>
+#include "json_reader.h"
 #include <string>
+#include <memory>
 #include <functional>
 #include <chrono>
 #include <vector>
@@ -11,7 +12,7 @@ struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
-    std::vector<uint8_t> payload;
+    std::vector<uint8_t> payload;   // Empty payload marks a lost frame, the decoder conceals it
 };
 
 struct BinaryProtocol2 {
@@ -30,6 +31,20 @@ struct BinaryProtocol3 {
     uint8_t payload[];
 } __attribute__((packed));
 
+struct ProtocolStatistics {
+    int64_t channel_open_time_us = 0;   // From OpenAudioChannel() to server hello
+    int64_t hello_rtt_us = 0;           // From sending client hello to server hello, one round trip
+    uint32_t packets_sent = 0;
+    uint32_t packets_received = 0;
+    uint32_t send_failures = 0;
+    // Opus payload only, without the binary protocol header or the UDP nonce, so WebSocket and
+    // MQTT+UDP channels report the same quantity
+    uint64_t payload_bytes_sent = 0;
+    uint64_t payload_bytes_received = 0;
+    int64_t send_time_us = 0;           // Time spent framing / encrypting / writing uplink packets
+    int64_t receive_time_us = 0;        // Time spent parsing / decrypting downlink packets
+};
+
 enum AbortReason {
     kAbortReasonNone,
     kAbortReasonWakeWordDetected
@@ -54,9 +69,13 @@ public:
     inline const std::string& session_id() const {
         return session_id_;
     }
+    inline const ProtocolStatistics& statistics() const {
+        return statistics_;
+    }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
-    void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    // The reader is only valid during the callback, use root.Parse() if a cJSON tree is needed
+    void OnIncomingJson(std::function<void(const JsonReader& root)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -71,9 +90,13 @@ public:
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    // Sends an MCP payload produced in pieces: source fills chunk and returns true until the payload
+    // is complete. It is called synchronously, so it may refer to the caller's locals
+    using MessageSource = std::function<bool(std::string& chunk)>;
+    virtual void SendMcpMessageChunked(const MessageSource& source);
 
 protected:
-    std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const JsonReader& root)> on_incoming_json_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
@@ -84,6 +107,11 @@ protected:
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+    ProtocolStatistics statistics_;
+
+    void ResetStatistics();
+    void LogStatistics() const;
+    std::string McpMessageHead() const;
 
     virtual bool SendText(const std::string& text) = 0;
     virtual void SetError(const std::string& message);
@@ -0,0 +1,15 @@
+#include "send_scheduler.h"
+
+#include <esp_log.h>
+
+#define TAG "SendScheduler"
+
+void SendScheduler::LogStatistics() const {
+    uint32_t handled = stats_.packets_sent + stats_.send_failures;
+    ESP_LOGI(TAG, "Uplink: sent %lu packets / %lu bytes, failures %lu, stalls %lu, dropped silence %lu voice %lu",
+        stats_.packets_sent, stats_.bytes_sent, stats_.send_failures, stats_.stalls,
+        stats_.dropped_silence, stats_.dropped_voice);
+    ESP_LOGI(TAG, "Uplink: queue delay avg %lu ms max %lu ms, srtt %d ms, pacing %d bps",
+        handled > 0 ? (uint32_t)(stats_.total_queue_delay_ms / handled) : 0,
+        stats_.max_queue_delay_ms, stats_.srtt_ms, stats_.pacing_rate_bps);
+}
@@ -0,0 +1,58 @@
+#ifndef SEND_SCHEDULER_H
+#define SEND_SCHEDULER_H
+
+#include "protocol.h"
+
+#include <memory>
+#include <functional>
+
+struct SendSchedulerStats {
+    uint32_t packets_sent = 0;
+    uint32_t bytes_sent = 0;
+    uint32_t send_failures = 0;
+    uint32_t stalls = 0;              // Sends that blocked on the transport send buffer
+    uint32_t dropped_silence = 0;     // Stale packets without voice, dropped first
+    uint32_t dropped_voice = 0;       // Stale packets with voice, dropped only when no silence is left
+    uint32_t max_queue_delay_ms = 0;
+    uint64_t total_queue_delay_ms = 0;
+    int srtt_ms = 0;
+    int pacing_rate_bps = 0;
+};
+
+// Writes one packet to the transport, may block while the send buffer is full
+using AudioSendFunction = std::function<bool(std::unique_ptr<AudioStreamPacket> packet)>;
+
+/*
+ * Sits inside a Protocol and decides when an encoded uplink packet is written to
+ * the transport. WebsocketProtocol wires it like this:
+ *
+ *   SendAudio(packet)      -> send_scheduler_->Enqueue(std::move(packet), voice)
+ *   audio channel opened   -> send_scheduler_->OnRttSample(hello rtt); send_scheduler_->Start()
+ *   audio channel closing  -> send_scheduler_->Stop()
+ *
+ * and the scheduler calls back into WebsocketProtocol::WriteAudio() from its own thread.
+ * Enqueue() is called from the opus codec task and must not block.
+ */
+class SendScheduler {
+public:
+    explicit SendScheduler(AudioSendFunction send) : send_(std::move(send)) {}
+    virtual ~SendScheduler() = default;
+
+    // Begin / end an uplink session. Stop() discards whatever is still queued, waits for a send
+    // in progress, so the transport can be closed right after, and logs the stats
+    virtual void Start() = 0;
+    virtual void Stop() = 0;
+    virtual void Enqueue(std::unique_ptr<AudioStreamPacket> packet, bool voice) = 0;
+    // Round trip time measured by the transport, e.g. hello -> server hello
+    virtual void OnRttSample(int rtt_ms) {}
+
+    inline const SendSchedulerStats& stats() const { return stats_; }
+
+protected:
+    AudioSendFunction send_;
+    SendSchedulerStats stats_;
+
+    void LogStatistics() const;
+};
+
+#endif // SEND_SCHEDULER_H
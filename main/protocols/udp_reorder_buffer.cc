@@ -0,0 +1,194 @@
+#include "udp_reorder_buffer.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "UdpReorder"
+
+UdpReorderBuffer::UdpReorderBuffer(size_t window_size, int max_hold_ms, int max_concealed_frames)
+    : max_hold_ms_(max_hold_ms), max_concealed_frames_(max_concealed_frames) {
+    // Slots are indexed by sequence & (size - 1), round up to a power of two so that
+    // the index stays continuous when the 32-bit sequence wraps around
+    size_t size = 1;
+    while (size < window_size) {
+        size <<= 1;
+    }
+    slots_.resize(size);
+}
+
+void UdpReorderBuffer::OnPacket(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
+    on_packet_ = callback;
+}
+
+void UdpReorderBuffer::OnGap(std::function<void(uint32_t lost_count)> callback) {
+    on_gap_ = callback;
+}
+
+void UdpReorderBuffer::Reset() {
+    for (auto& slot : slots_) {
+        slot.occupied = false;
+        slot.packet.reset();
+    }
+    started_ = false;
+    next_sequence_ = 0;
+    highest_sequence_ = 0;
+    released_mask_ = 0;
+    held_count_ = 0;
+    sample_rate_ = 0;
+    frame_duration_ = 0;
+    timestamp_ = 0;
+    stats_ = UdpReorderStats();
+}
+
+void UdpReorderBuffer::Push(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet) {
+    stats_.received++;
+    if (!started_) {
+        started_ = true;
+        next_sequence_ = sequence;
+        highest_sequence_ = sequence;
+    }
+
+    int32_t diff = (int32_t)(sequence - next_sequence_);
+    if (diff < 0) {
+        uint32_t behind = (uint32_t)(-(int64_t)diff) - 1;
+        if (behind < 64 && ((released_mask_ >> behind) & 1)) {
+            stats_.duplicated++;
+        } else {
+            stats_.late_dropped++;
+            ESP_LOGD(TAG, "Late packet %lu dropped, expected: %lu", (unsigned long)sequence, (unsigned long)next_sequence_);
+        }
+        return;
+    }
+
+    uint32_t window = slots_.size();
+    if ((uint32_t)diff >= window * 4) {
+        // The sender restarted or we were away for a long time, flush what we have
+        // in order and resynchronize instead of concealing a huge gap
+        ESP_LOGW(TAG, "Sequence jumped from %lu to %lu, resync", (unsigned long)next_sequence_, (unsigned long)sequence);
+        for (uint32_t i = 0; i < window && held_count_ > 0; i++) {
+            auto& slot = slots_[(next_sequence_ + i) & (window - 1)];
+            if (slot.occupied && slot.sequence == next_sequence_ + i) {
+                slot.occupied = false;
+                held_count_--;
+                Release(std::move(slot.packet));
+            }
+        }
+        next_sequence_ = sequence;
+        highest_sequence_ = sequence;
+        released_mask_ = 0;
+    } else {
+        // Make room in the window by giving up on the oldest missing sequences
+        uint32_t min_next = sequence - window + 1;
+        while ((int32_t)(min_next - next_sequence_) > 0) {
+            SkipGap(min_next);
+            DrainInOrder();
+        }
+    }
+
+    auto& slot = slots_[sequence & (window - 1)];
+    if (slot.occupied) {
+        stats_.duplicated++;
+        return;
+    }
+    if ((int32_t)(sequence - highest_sequence_) < 0) {
+        stats_.reordered++;
+    } else {
+        highest_sequence_ = sequence;
+    }
+
+    slot.occupied = true;
+    slot.sequence = sequence;
+    slot.arrival_time = std::chrono::steady_clock::now();
+    slot.packet = std::move(packet);
+    held_count_++;
+
+    DrainInOrder();
+    Flush();
+}
+
+bool UdpReorderBuffer::Flush() {
+    auto now = std::chrono::steady_clock::now();
+    auto max_hold = std::chrono::milliseconds(max_hold_ms_);
+    while (held_count_ > 0) {
+        auto oldest = now;
+        for (auto& slot : slots_) {
+            if (slot.occupied && slot.arrival_time < oldest) {
+                oldest = slot.arrival_time;
+            }
+        }
+        if (now - oldest < max_hold) {
+            break;
+        }
+        // The head of the window is missing, otherwise it would have been drained
+        SkipGap(next_sequence_ + slots_.size());
+        DrainInOrder();
+    }
+    return held_count_ > 0;
+}
+
+void UdpReorderBuffer::Advance(bool released) {
+    released_mask_ = (released_mask_ << 1) | (released ? 1 : 0);
+    next_sequence_++;
+}
+
+void UdpReorderBuffer::Release(std::unique_ptr<AudioStreamPacket> packet) {
+    if (packet->sample_rate > 0) {
+        sample_rate_ = packet->sample_rate;
+        frame_duration_ = packet->frame_duration;
+    }
+    timestamp_ = packet->timestamp;
+    if (on_packet_) {
+        on_packet_(std::move(packet));
+    }
+}
+
+void UdpReorderBuffer::DrainInOrder() {
+    uint32_t mask = slots_.size() - 1;
+    while (true) {
+        auto& slot = slots_[next_sequence_ & mask];
+        if (!slot.occupied || slot.sequence != next_sequence_) {
+            break;
+        }
+        slot.occupied = false;
+        held_count_--;
+        auto packet = std::move(slot.packet);
+        Advance(true);
+        Release(std::move(packet));
+    }
+}
+
+void UdpReorderBuffer::SkipGap(uint32_t limit) {
+    uint32_t mask = slots_.size() - 1;
+    uint32_t lost = 0;
+    while (next_sequence_ != limit) {
+        auto& slot = slots_[next_sequence_ & mask];
+        if (slot.occupied && slot.sequence == next_sequence_) {
+            break;
+        }
+        Advance(false);
+        lost++;
+    }
+    if (lost == 0) {
+        return;
+    }
+    stats_.lost += lost;
+    if (on_gap_) {
+        on_gap_(lost);
+    }
+
+    // Timestamps count milliseconds like frame_duration; a server that sends none keeps them at 0
+    uint32_t conceal_count = std::min<uint32_t>(lost, max_concealed_frames_);
+    for (uint32_t i = 0; i < conceal_count; i++) {
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->sample_rate = sample_rate_;
+        packet->frame_duration = frame_duration_;
+        packet->timestamp = timestamp_ != 0 ? timestamp_ + (i + 1) * frame_duration_ : 0;
+        stats_.concealed++;
+        if (on_packet_) {
+            on_packet_(std::move(packet));
+        }
+    }
+    if (timestamp_ != 0) {
+        timestamp_ += lost * frame_duration_;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef UDP_REORDER_BUFFER_H
+#define UDP_REORDER_BUFFER_H
+
+#include "protocol.h"
+
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+struct UdpReorderStats {
+    uint32_t received = 0;      // Packets pushed into the buffer
+    uint32_t reordered = 0;     // Packets that arrived after a higher sequence and were put back in order
+    uint32_t duplicated = 0;    // Packets whose sequence was already held or released
+    uint32_t late_dropped = 0;  // Packets that arrived after their slot was skipped as a gap
+    uint32_t lost = 0;          // Sequences reported to the decoder as gaps
+    uint32_t concealed = 0;     // Empty packets released in place of lost ones
+};
+
+/*
+ * A small jitter window keyed by the 32-bit UDP sequence number.
+ *
+ * Packets are released strictly in sequence order. A missing sequence is waited for
+ * until the oldest held packet exceeds max_hold_ms, or until a newer packet no longer
+ * fits into the window; then the hole is reported through OnGap() and skipped. The first
+ * max_concealed_frames sequences of a hole are released as empty packets, which tell the decoder
+ * to conceal the frame; their timestamps continue from the last released packet. Longer holes are
+ * not concealed further because the extrapolated audio would be worse than silence.
+ * Sequence comparison is done on the signed 32-bit difference, so wraparound is handled.
+ *
+ * The buffer is not thread-safe, the owner serializes Push() and Flush().
+ */
+class UdpReorderBuffer {
+public:
+    UdpReorderBuffer(size_t window_size, int max_hold_ms, int max_concealed_frames = 0);
+
+    void OnPacket(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
+    void OnGap(std::function<void(uint32_t lost_count)> callback);
+
+    void Reset();
+    void Push(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet);
+    // Skip gaps whose hold time has expired, returns true if packets are still held
+    bool Flush();
+
+    inline int max_hold_ms() const { return max_hold_ms_; }
+    inline bool has_held_packets() const { return held_count_ > 0; }
+    inline const UdpReorderStats& stats() const { return stats_; }
+
+private:
+    struct Slot {
+        bool occupied = false;
+        uint32_t sequence = 0;
+        std::chrono::steady_clock::time_point arrival_time;
+        std::unique_ptr<AudioStreamPacket> packet;
+    };
+
+    std::vector<Slot> slots_;
+    int max_hold_ms_;
+    int max_concealed_frames_;
+    bool started_ = false;
+    uint32_t next_sequence_ = 0;
+    uint32_t highest_sequence_ = 0;
+    // Bit n set means (next_sequence_ - 1 - n) was released, used to tell duplicates from late packets
+    uint64_t released_mask_ = 0;
+    size_t held_count_ = 0;
+    // Format and timestamp of the last released packet, copied into concealment packets
+    int sample_rate_ = 0;
+    int frame_duration_ = 0;
+    uint32_t timestamp_ = 0;
+    UdpReorderStats stats_;
+
+    std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_packet_;
+    std::function<void(uint32_t lost_count)> on_gap_;
+
+    void Advance(bool released);
+    void Release(std::unique_ptr<AudioStreamPacket> packet);
+    void DrainInOrder();
+    void SkipGap(uint32_t limit);
+};
+
+#endif // UDP_REORDER_BUFFER_H
@@ -1,12 +1,14 @@
 #include "websocket_protocol.h"
+#include "paced_send_scheduler.h"
 #include "board.h"
 #include "system_info.h"
 #include "application.h"
 #include "settings.h"
 
 #include <cstring>
-#include <cJSON.h>
+#include "json_writer.h"
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
@@ -14,9 +16,13 @@
 
 WebsocketProtocol::WebsocketProtocol() {
     event_group_handle_ = xEventGroupCreate();
+    send_scheduler_ = std::make_unique<PacedSendScheduler>([this](std::unique_ptr<AudioStreamPacket> packet) {
+        return WriteAudio(std::move(packet));
+    }, OPUS_FRAME_DURATION_MS);
 }
 
 WebsocketProtocol::~WebsocketProtocol() {
+    send_scheduler_.reset();
     vEventGroupDelete(event_group_handle_);
 }
 
@@ -29,7 +35,20 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
+    // The scheduler drops stale silence before voice when the backlog cannot be sent in time
+    send_scheduler_->Enqueue(std::move(packet), Application::GetInstance().GetAudioService().IsVoiceDetected());
+    return true;
+}
+
+// Called from the scheduler's thread, blocks while the websocket send buffer is full
+bool WebsocketProtocol::WriteAudio(std::unique_ptr<AudioStreamPacket> packet) {
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return false;
+    }
 
+    int64_t start_time = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    bool success;
     if (version_ == 2) {
         std::string serialized;
         serialized.resize(sizeof(BinaryProtocol2) + packet->payload.size());
@@ -41,7 +60,7 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         bp2->payload_size = htonl(packet->payload.size());
         memcpy(bp2->payload, packet->payload.data(), packet->payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        success = websocket_->Send(serialized.data(), serialized.size(), true);
     } else if (version_ == 3) {
         std::string serialized;
         serialized.resize(sizeof(BinaryProtocol3) + packet->payload.size());
@@ -51,10 +70,19 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         bp3->payload_size = htons(packet->payload.size());
         memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        success = websocket_->Send(serialized.data(), serialized.size(), true);
     } else {
-        return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
+        success = websocket_->Send(packet->payload.data(), packet->payload.size(), true);
     }
+
+    statistics_.send_time_us += esp_timer_get_time() - start_time;
+    if (success) {
+        statistics_.packets_sent++;
+        statistics_.payload_bytes_sent += packet->payload.size();
+    } else {
+        statistics_.send_failures++;
+    }
+    return success;
 }
 
 bool WebsocketProtocol::SendText(const std::string& text) {
@@ -62,6 +90,7 @@ bool WebsocketProtocol::SendText(const std::string& text) {
         return false;
     }
 
+    std::lock_guard<std::mutex> lock(send_mutex_);
     if (!websocket_->Send(text)) {
         ESP_LOGE(TAG, "Failed to send text: %s", text.c_str());
         SetError(Lang::Strings::SERVER_ERROR);
@@ -71,11 +100,40 @@ bool WebsocketProtocol::SendText(const std::string& text) {
     return true;
 }
 
+// One text message in fragments, so a large tool result is never assembled in memory
+void WebsocketProtocol::SendMcpMessageChunked(const MessageSource& source) {
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return;
+    }
+
+    std::string chunk = McpMessageHead();
+    size_t size = chunk.size();
+    bool success;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        success = websocket_->Send(chunk.data(), chunk.size(), false, false);
+        while (success && source(chunk)) {
+            success = websocket_->Send(chunk.data(), chunk.size(), false, false);
+            size += chunk.size();
+        }
+        if (success) {
+            success = websocket_->Send("}", 1, false, true);
+        }
+    }
+    if (!success) {
+        ESP_LOGE(TAG, "Failed to send mcp message after %u bytes", size);
+        SetError(Lang::Strings::SERVER_ERROR);
+    }
+}
+
 bool WebsocketProtocol::IsAudioChannelOpened() const {
     return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
+    // Wait for a write in progress before the websocket goes away
+    send_scheduler_->Stop();
+    LogStatistics();
     websocket_.reset();
 }
 
@@ -88,7 +146,10 @@ bool WebsocketProtocol::OpenAudioChannel() {
         version_ = version;
     }
 
+    send_scheduler_->Stop();
     error_occurred_ = false;
+    ResetStatistics();
+    int64_t open_start_time = esp_timer_get_time();
 
     auto network = Board::GetInstance().GetNetwork();
     websocket_ = network->CreateWebSocket(1);
@@ -110,7 +171,16 @@ bool WebsocketProtocol::OpenAudioChannel() {
 
     websocket_->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
+            statistics_.packets_received++;
+            if (version_ == 2) {
+                statistics_.payload_bytes_received += len > sizeof(BinaryProtocol2) ? len - sizeof(BinaryProtocol2) : 0;
+            } else if (version_ == 3) {
+                statistics_.payload_bytes_received += len > sizeof(BinaryProtocol3) ? len - sizeof(BinaryProtocol3) : 0;
+            } else {
+                statistics_.payload_bytes_received += len;
+            }
             if (on_incoming_audio_ != nullptr) {
+                int64_t start_time = esp_timer_get_time();
                 if (version_ == 2) {
                     BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
                     bp2->version = ntohs(bp2->version);
@@ -143,13 +213,14 @@ bool WebsocketProtocol::OpenAudioChannel() {
                         .payload = std::vector<uint8_t>((uint8_t*)data, (uint8_t*)data + len)
                     }));
                 }
+                statistics_.receive_time_us += esp_timer_get_time() - start_time;
             }
         } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
-            auto type = cJSON_GetObjectItem(root, "type");
-            if (cJSON_IsString(type)) {
-                if (strcmp(type->valuestring, "hello") == 0) {
+            // Dispatch on type without building a DOM
+            JsonReader root(data, len);
+            auto type = root["type"];
+            if (type.IsString()) {
+                if (type.Equals("hello")) {
                     ParseServerHello(root);
                 } else {
                     if (on_incoming_json_ != nullptr) {
@@ -157,9 +228,8 @@ bool WebsocketProtocol::OpenAudioChannel() {
                     }
                 }
             } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
+                ESP_LOGE(TAG, "Missing message type, data: %.*s", (int)len, data);
             }
-            cJSON_Delete(root);
         }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
@@ -180,6 +250,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
 
     // Send hello message to describe the client
     auto message = GetHelloMessage();
+    int64_t hello_time = esp_timer_get_time();
     if (!SendText(message)) {
         return false;
     }
@@ -191,6 +262,12 @@ bool WebsocketProtocol::OpenAudioChannel() {
         SetError(Lang::Strings::SERVER_TIMEOUT);
         return false;
     }
+    statistics_.channel_open_time_us = esp_timer_get_time() - open_start_time;
+    statistics_.hello_rtt_us = esp_timer_get_time() - hello_time;
+    ESP_LOGI(TAG, "Audio channel opened in %lld ms, hello rtt %lld ms", statistics_.channel_open_time_us / 1000,
+        statistics_.hello_rtt_us / 1000);
+    send_scheduler_->OnRttSample(statistics_.hello_rtt_us / 1000);
+    send_scheduler_->Start();
 
     if (on_audio_channel_opened_ != nullptr) {
         on_audio_channel_opened_();
@@ -201,51 +278,53 @@ bool WebsocketProtocol::OpenAudioChannel() {
 
 std::string WebsocketProtocol::GetHelloMessage() {
     // keys: message type, version, audio_params (format, sample_rate, channels)
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "type", "hello");
-    cJSON_AddNumberToObject(root, "version", version_);
-    cJSON* features = cJSON_CreateObject();
+    std::string message;
+    message.reserve(256);
+    JsonWriter writer(message);
+    writer.BeginObject();
+    writer.Field("type", "hello");
+    writer.Field("version", version_);
+    writer.Key("features");
+    writer.BeginObject();
 #if CONFIG_USE_SERVER_AEC
-    cJSON_AddBoolToObject(features, "aec", true);
+    writer.Field("aec", true);
 #endif
-    cJSON_AddBoolToObject(features, "mcp", true);
-    cJSON_AddItemToObject(root, "features", features);
-    cJSON_AddStringToObject(root, "transport", "websocket");
-    cJSON* audio_params = cJSON_CreateObject();
-    cJSON_AddStringToObject(audio_params, "format", "opus");
-    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
-    cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
-    cJSON_AddItemToObject(root, "audio_params", audio_params);
-    auto json_str = cJSON_PrintUnformatted(root);
-    std::string message(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
+    writer.Field("mcp", true);
+    writer.EndObject();
+    writer.Field("transport", "websocket");
+    writer.Key("audio_params");
+    writer.BeginObject();
+    writer.Field("format", "opus");
+    writer.Field("sample_rate", 16000);
+    writer.Field("channels", 1);
+    writer.Field("frame_duration", OPUS_FRAME_DURATION_MS);
+    writer.EndObject();
+    writer.EndObject();
     return message;
 }
 
-void WebsocketProtocol::ParseServerHello(const cJSON* root) {
-    auto transport = cJSON_GetObjectItem(root, "transport");
-    if (transport == nullptr || strcmp(transport->valuestring, "websocket") != 0) {
-        ESP_LOGE(TAG, "Unsupported transport: %s", transport->valuestring);
+void WebsocketProtocol::ParseServerHello(const JsonReader& root) {
+    auto transport = root["transport"];
+    if (!transport.Equals("websocket")) {
+        ESP_LOGE(TAG, "Unsupported transport: %s", transport.GetString("null").c_str());
         return;
     }
 
-    auto session_id = cJSON_GetObjectItem(root, "session_id");
-    if (cJSON_IsString(session_id)) {
-        session_id_ = session_id->valuestring;
+    auto session_id = root["session_id"];
+    if (session_id.IsString()) {
+        session_id_ = session_id.GetString();
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
-    auto audio_params = cJSON_GetObjectItem(root, "audio_params");
-    if (cJSON_IsObject(audio_params)) {
-        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
-        if (cJSON_IsNumber(sample_rate)) {
-            server_sample_rate_ = sample_rate->valueint;
+    auto audio_params = root["audio_params"];
+    if (audio_params.IsObject()) {
+        auto sample_rate = audio_params["sample_rate"];
+        if (sample_rate.IsNumber()) {
+            server_sample_rate_ = sample_rate.GetInt();
         }
-        auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
-        if (cJSON_IsNumber(frame_duration)) {
-            server_frame_duration_ = frame_duration->valueint;
+        auto frame_duration = audio_params["frame_duration"];
+        if (frame_duration.IsNumber()) {
+            server_frame_duration_ = frame_duration.GetInt();
         }
     }
 
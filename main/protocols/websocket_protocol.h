@@ -3,8 +3,10 @@
 
 
 #include "protocol.h"
+#include "send_scheduler.h"
 
 #include <web_socket.h>
+#include <mutex>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
@@ -20,13 +22,19 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void SendMcpMessageChunked(const MessageSource& source) override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
+    // Uplink audio is queued here and written by the scheduler's thread, paced when the link is slow
+    std::unique_ptr<SendScheduler> send_scheduler_;
+    // Keeps audio frames out of the middle of a fragmented text message
+    std::mutex send_mutex_;
 
-    void ParseServerHello(const cJSON* root);
+    bool WriteAudio(std::unique_ptr<AudioStreamPacket> packet);
+    void ParseServerHello(const JsonReader& root);
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
 };
@@ -1,23 +1,362 @@
 #include "private_vision_service.h"
+#include "board.h"
+#include "system_info.h"
+
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 #define TAG "PrivateVisionService"
 
+// 回复只用来生成回答，超过这个大小说明服务器出错了
+#define VISION_MAX_RESPONSE_SIZE (32 * 1024)
+
+// 不含末尾被截断的多字节字符的长度，回调拿到的文字总是完整的 UTF-8
+static size_t CompleteUtf8Length(const std::string& text) {
+    size_t len = text.size();
+    size_t i = len;
+    while (i > 0 && len - i < 4) {
+        uint8_t c = text[i - 1];
+        if ((c & 0xC0) != 0x80) {
+            size_t needed = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : 4;
+            return len - (i - 1) >= needed ? len : i - 1;
+        }
+        i--;
+    }
+    return len;
+}
+
+void VisionResponseParser::Feed(const char* data, size_t len) {
+    size_t text_size = text_.size();
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (in_string_) {
+            OnStringChar(c);
+            continue;
+        }
+        switch (c) {
+            case '{':
+            case '[':
+                depth_++;
+                break;
+            case '}':
+            case ']':
+                depth_--;
+                break;
+            case ':':
+                if (depth_ == 1) {
+                    expect_value_ = true;
+                }
+                break;
+            case ',':
+                if (depth_ == 1) {
+                    expect_value_ = false;
+                }
+                break;
+            case '"':
+                in_string_ = true;
+                string_is_key_ = depth_ == 1 && !expect_value_;
+                capturing_ = depth_ == 1 && expect_value_ && !captured_ &&
+                    (key_ == "text" || key_ == "description" || key_ == "result");
+                if (string_is_key_) {
+                    key_.clear();
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (on_text_ && text_.size() != text_size) {
+        size_t complete = CompleteUtf8Length(text_);
+        if (complete > reported_) {
+            reported_ = complete;
+            on_text_(text_.substr(0, complete));
+        }
+    }
+}
+
+void VisionResponseParser::OnStringChar(char c) {
+    if (unicode_digits_ >= 0) {
+        int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+            (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 0;
+        unicode_ = (unicode_ << 4) | digit;
+        if (++unicode_digits_ == 4) {
+            unicode_digits_ = -1;
+            AppendCodepoint(unicode_);
+        }
+        return;
+    }
+    if (escape_) {
+        escape_ = false;
+        switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'u':
+                unicode_digits_ = 0;
+                unicode_ = 0;
+                return;
+            default: break;     // \" \\ \/
+        }
+    } else if (c == '\\') {
+        escape_ = true;
+        return;
+    } else if (c == '"') {
+        in_string_ = false;
+        if (capturing_) {
+            capturing_ = false;
+            captured_ = true;
+        }
+        return;
+    }
+    if (string_is_key_) {
+        key_ += c;
+    } else if (capturing_) {
+        text_ += c;
+    }
+}
+
+void VisionResponseParser::AppendCodepoint(uint32_t codepoint) {
+    // UTF-16 代理对合成一个码点
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+        high_surrogate_ = codepoint;
+        return;
+    }
+    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF && high_surrogate_ != 0) {
+        codepoint = 0x10000 + ((high_surrogate_ - 0xD800) << 10) + (codepoint - 0xDC00);
+    }
+    high_surrogate_ = 0;
+
+    char utf8[4];
+    int n;
+    if (codepoint < 0x80) {
+        utf8[0] = codepoint;
+        n = 1;
+    } else if (codepoint < 0x800) {
+        utf8[0] = 0xC0 | (codepoint >> 6);
+        utf8[1] = 0x80 | (codepoint & 0x3F);
+        n = 2;
+    } else if (codepoint < 0x10000) {
+        utf8[0] = 0xE0 | (codepoint >> 12);
+        utf8[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+        utf8[2] = 0x80 | (codepoint & 0x3F);
+        n = 3;
+    } else {
+        utf8[0] = 0xF0 | (codepoint >> 18);
+        utf8[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+        utf8[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+        utf8[3] = 0x80 | (codepoint & 0x3F);
+        n = 4;
+    }
+    if (string_is_key_) {
+        key_.append(utf8, n);
+    } else if (capturing_) {
+        text_.append(utf8, n);
+    }
+}
+
 PrivateVisionService::PrivateVisionService() {
 }
 
 PrivateVisionService::~PrivateVisionService() {
+    CloseConnection();
 }
 
 bool PrivateVisionService::Initialize(const std::string& api_url, const std::string& api_key) {
     ESP_LOGI(TAG, "Initializing PrivateVisionService");
     api_url_ = api_url;
     api_key_ = api_key;
+    CloseConnection();
+    return true;
+}
+
+void PrivateVisionService::CloseConnection() {
+    if (http_ != nullptr) {
+        http_->Close();
+        http_.reset();
+    }
+}
+
+bool PrivateVisionService::Prepare() {
+    if (api_url_.empty()) {
+        return false;
+    }
+    if (http_ != nullptr) {
+        return true;
+    }
+    int64_t start_time = esp_timer_get_time();
+    http_ = Board::GetInstance().GetNetwork()->CreateHttp(4);
+    http_->SetTimeout(VISION_TIMEOUT_MS);
+    http_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    http_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    if (!api_key_.empty()) {
+        http_->SetHeader("Authorization", "Bearer " + api_key_);
+    }
+    http_->SetHeader("Connection", "keep-alive");
+    if (!http_->Open("OPTIONS", api_url_)) {
+        ESP_LOGW(TAG, "Failed to connect to %s", api_url_.c_str());
+        CloseConnection();
+        return false;
+    }
+    // 状态码不重要，只要服务器保持连接；回复要读完，连接才能用于下一个请求
+    int status_code = http_->GetStatusCode();
+    char buffer[256];
+    while (http_->Read(buffer, sizeof(buffer)) > 0) {
+    }
+    if (status_code <= 0 || http_->GetResponseHeader("Connection") == "close") {
+        ESP_LOGW(TAG, "Server did not keep the connection (status %d)", status_code);
+        CloseConnection();
+        return false;
+    }
+    ESP_LOGI(TAG, "Connection prepared in %lu ms (status %d)",
+        (uint32_t)((esp_timer_get_time() - start_time) / 1000), status_code);
     return true;
 }
 
-std::string PrivateVisionService::AnalyzeImage(const std::vector<uint8_t>& image_data, const std::string& query) {
+std::string PrivateVisionService::AnalyzeImage(JpegSource& source, const std::string& query,
+    VisionResponseParser::TextCallback on_text) {
     ESP_LOGI(TAG, "Analyzing image with query: %s", query.c_str());
-    // 基础实现，实际图像分析将在后续步骤中添加
-    return "{\"result\": \"正在分析图像中...\"}";
-}
\ No newline at end of file
+    if (api_url_.empty()) {
+        return "{\"success\": false, \"message\": \"Vision service URL is not set\"}";
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    bool image_read = false;
+    for (int attempt = 1; attempt <= VISION_MAX_ATTEMPTS; attempt++) {
+        // 图像已经读过一部分，重试要从头再读
+        if (image_read && !source.Rewind()) {
+            ESP_LOGE(TAG, "Image source cannot be rewound, giving up");
+            break;
+        }
+        image_read = false;
+        VisionResponseParser parser(on_text);
+        std::string response;
+        auto result = SendRequest(source, query, image_read, parser, response);
+        if (result == Result::kOk) {
+            ESP_LOGI(TAG, "Analysis done in %lu ms after %d attempt(s): %s",
+                (uint32_t)((esp_timer_get_time() - start_time) / 1000), attempt, parser.text().c_str());
+            return response;
+        }
+        if (result == Result::kFail || attempt == VISION_MAX_ATTEMPTS) {
+            break;
+        }
+        ESP_LOGW(TAG, "Attempt %d failed, retrying", attempt);
+        vTaskDelay(pdMS_TO_TICKS(VISION_RETRY_DELAY_MS * attempt));
+    }
+    return "{\"success\": false, \"message\": \"Failed to analyze image\"}";
+}
+
+PrivateVisionService::Result PrivateVisionService::SendRequest(JpegSource& source, const std::string& query,
+    bool& image_read, VisionResponseParser& parser, std::string& response) {
+    int64_t start_time = esp_timer_get_time();
+    bool reused = http_ != nullptr;
+    for (;;) {
+        if (http_ == nullptr) {
+            http_ = Board::GetInstance().GetNetwork()->CreateHttp(4);
+        }
+        http_->SetTimeout(VISION_TIMEOUT_MS);
+        http_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+        http_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+        if (!api_key_.empty()) {
+            http_->SetHeader("Authorization", "Bearer " + api_key_);
+        }
+        http_->SetHeader("Connection", "keep-alive");
+        http_->SetHeader("Content-Type", std::string("multipart/form-data; boundary=") + VISION_BOUNDARY);
+        http_->SetHeader("Transfer-Encoding", "chunked");
+        if (http_->Open("POST", api_url_)) {
+            break;
+        }
+        CloseConnection();
+        if (!reused) {
+            ESP_LOGE(TAG, "Failed to connect to %s", api_url_.c_str());
+            return Result::kRetry;
+        }
+        // 服务器可能已经关闭了空闲的连接，换一个新连接，不算一次重试
+        ESP_LOGI(TAG, "Kept-alive connection is gone, reconnecting");
+        reused = false;
+    }
+    int64_t connected_time = esp_timer_get_time();
+
+    std::string boundary = VISION_BOUNDARY;
+    std::string header;
+    header += "--" + boundary + "\r\n";
+    header += "Content-Disposition: form-data; name=\"question\"\r\n\r\n";
+    header += query + "\r\n";
+    header += "--" + boundary + "\r\n";
+    header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
+    header += "Content-Type: image/jpeg\r\n\r\n";
+    if (http_->Write(header.data(), header.size()) < 0) {
+        CloseConnection();
+        return Result::kRetry;
+    }
+
+    // 图像逐块写出，块由 source 提供，不经过额外的缓冲区
+    size_t image_size = 0;
+    const uint8_t* data;
+    size_t len;
+    while (source.Next(data, len)) {
+        image_read = true;
+        if (http_->Write((const char*)data, len) < 0) {
+            ESP_LOGE(TAG, "Failed to upload image after %u bytes", image_size);
+            CloseConnection();
+            return Result::kRetry;
+        }
+        image_size += len;
+    }
+    if (source.failed() || image_size == 0) {
+        ESP_LOGE(TAG, "Failed to produce the image");
+        CloseConnection();
+        return Result::kFail;
+    }
+
+    std::string footer = "\r\n--" + boundary + "--\r\n";
+    if (http_->Write(footer.data(), footer.size()) < 0 || http_->Write("", 0) < 0) {
+        CloseConnection();
+        return Result::kRetry;
+    }
+    int64_t uploaded_time = esp_timer_get_time();
+
+    int status_code = http_->GetStatusCode();
+    if (status_code != 200) {
+        ESP_LOGE(TAG, "Server returned status %d", status_code);
+        CloseConnection();
+        // 5xx 和读不到状态（超时、断开）可以重试，4xx 重试也不会变
+        return (status_code <= 0 || status_code >= 500) ? Result::kRetry : Result::kFail;
+    }
+
+    // 回复边到达边解析
+    int64_t first_byte_time = 0;
+    char buffer[512];
+    int ret;
+    while ((ret = http_->Read(buffer, sizeof(buffer))) > 0) {
+        if (first_byte_time == 0) {
+            first_byte_time = esp_timer_get_time();
+        }
+        if (response.size() + ret > VISION_MAX_RESPONSE_SIZE) {
+            ESP_LOGE(TAG, "Response too large");
+            CloseConnection();
+            return Result::kFail;
+        }
+        response.append(buffer, ret);
+        parser.Feed(buffer, ret);
+    }
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to read response: %d", ret);
+        CloseConnection();
+        return Result::kRetry;
+    }
+    int64_t end_time = esp_timer_get_time();
+
+    if (http_->GetResponseHeader("Connection") == "close") {
+        CloseConnection();
+    }
+    ESP_LOGI(TAG, "Image %u bytes: connect %lu ms%s, upload %lu ms, first byte %lu ms, response %lu ms",
+        image_size, (uint32_t)((connected_time - start_time) / 1000), reused ? " (reused)" : "",
+        (uint32_t)((uploaded_time - connected_time) / 1000),
+        (uint32_t)(((first_byte_time > 0 ? first_byte_time : end_time) - uploaded_time) / 1000),
+        (uint32_t)((end_time - uploaded_time) / 1000));
+    return Result::kOk;
+}
@@ -2,8 +2,51 @@
 #define PRIVATE_VISION_SERVICE_H
 
 #include <string>
-#include <vector>
-#include <esp_http_client.h>
+#include <memory>
+#include <functional>
+#include <http.h>
+
+#include "camera.h"
+
+#define VISION_MAX_ATTEMPTS 3
+#define VISION_RETRY_DELAY_MS 500
+#define VISION_TIMEOUT_MS 15000
+#define VISION_BOUNDARY "----XIAOZHI_VISION_BOUNDARY"
+
+/*
+ * 从识图服务器的 JSON 回复中逐段取出文字，回复到达一部分就可以显示一部分。
+ *
+ * 只看顶层对象中第一个名为 text、description 或 result 的字符串字段，其余内容（包括嵌套对象
+ * 中的同名字段）跳过。转义字符（含 \uXXXX）在这里解码，回调拿到的是 UTF-8 文本。
+ */
+class VisionResponseParser {
+public:
+    using TextCallback = std::function<void(const std::string& text)>;
+
+    explicit VisionResponseParser(TextCallback on_text = nullptr) : on_text_(on_text) {}
+
+    void Feed(const char* data, size_t len);
+    inline const std::string& text() const { return text_; }
+
+private:
+    TextCallback on_text_;
+    std::string text_;
+    size_t reported_ = 0;        // 已经交给回调的长度
+    int depth_ = 0;
+    bool in_string_ = false;
+    bool escape_ = false;
+    int unicode_digits_ = -1;    // 正在读取 \uXXXX 的第几位，-1 表示不在其中
+    uint32_t unicode_ = 0;
+    uint32_t high_surrogate_ = 0;
+    bool expect_value_ = false;  // 顶层对象中，冒号之后、逗号之前
+    bool string_is_key_ = false;
+    bool capturing_ = false;
+    bool captured_ = false;
+    std::string key_;
+
+    void OnStringChar(char c);
+    void AppendCodepoint(uint32_t codepoint);
+};
 
 // 私有视觉模型服务
 class PrivateVisionService {
@@ -13,13 +56,37 @@ public:
 
     // 初始化服务
     bool Initialize(const std::string& api_url, const std::string& api_key = "");
-    
-    // 分析图像
-    std::string AnalyzeImage(const std::vector<uint8_t>& image_data, const std::string& query);
+    inline bool IsConfigured() const { return !api_url_.empty(); }
+
+    /*
+     * 分析图像：问题和图像以分块编码的 multipart/form-data 上传（字段 question 和 file），
+     * 图像从 source 逐块读出，不在内存中整张复制。回复到达时逐段解析，on_text 收到目前为止的文字。
+     *
+     * 连接在两次请求之间保持，服务器没有要求关闭时下一张照片直接复用。连接失败、写入失败、
+     * 超时和 5xx 会重试，已经读过图像时需要 source 能够 Rewind()。返回服务器的完整回复。
+     */
+    std::string AnalyzeImage(JpegSource& source, const std::string& query,
+        VisionResponseParser::TextCallback on_text = nullptr);
+
+    /*
+     * 提前建立连接：没有保持着的连接时发一个 OPTIONS 请求，下一次 AnalyzeImage() 复用这个连接，
+     * TCP/TLS 握手不再算在拍照之后。不能与 AnalyzeImage() 同时调用。
+     */
+    bool Prepare();
 
 private:
     std::string api_url_;
     std::string api_key_;
+    std::unique_ptr<Http> http_;
+
+    enum class Result {
+        kOk,
+        kRetry,
+        kFail,
+    };
+    Result SendRequest(JpegSource& source, const std::string& query, bool& image_read,
+        VisionResponseParser& parser, std::string& response);
+    void CloseConnection();
 };
 
-#endif // PRIVATE_VISION_SERVICE_H
\ No newline at end of file
+#endif // PRIVATE_VISION_SERVICE_H
@@ -1,31 +1,432 @@
 #include "xunfei_stt_service.h"
+#include "audio/audio_service.h"
+#include "board.h"
+#include "json_reader.h"
+#include "json_writer.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include <esp_timer.h>
+#include <mbedtls/md.h>
+#include <mbedtls/base64.h>
+#include <ctime>
+#include <cctype>
+#include <algorithm>
+
 static const char* TAG = "XunfeiSttService";
 
-XunfeiSttService::XunfeiSttService(const std::string& app_id, const std::string& api_key, const std::string& api_secret)
-    : app_id_(app_id), api_key_(api_key), api_secret_(api_secret) {
-    ESP_LOGI(TAG, "Xunfei STT Service initialized.");
+// 帧状态：第一帧、中间帧、最后一帧
+enum XunfeiFrameStatus {
+    kXunfeiFrameFirst = 0,
+    kXunfeiFrameContinue = 1,
+    kXunfeiFrameLast = 2,
+};
+
+static std::string Base64Encode(const uint8_t* data, size_t len) {
+    std::string out((len + 2) / 3 * 4 + 1, '\0');
+    size_t written = 0;
+    mbedtls_base64_encode((unsigned char*)out.data(), out.size(), &written, data, len);
+    out.resize(written);
+    return out;
+}
+
+static std::string UrlEncode(const std::string& text) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    out.reserve(text.size() * 3);
+    for (unsigned char c : text) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out += c;
+        } else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 0x0F];
+        }
+    }
+    return out;
+}
+
+XunfeiSttService::XunfeiSttService(const std::string& app_id, const std::string& api_key, const std::string& api_secret,
+    const std::string& url)
+    : app_id_(app_id), api_key_(api_key), api_secret_(api_secret), url_(url) {
+    event_group_ = xEventGroupCreate();
+    ESP_LOGI(TAG, "Xunfei STT Service initialized%s.", IsConfigured() ? "" : " without credentials");
 }
 
-void XunfeiSttService::Recognize(std::function<void(const std::string& text)> on_result) {
+XunfeiSttService::~XunfeiSttService() {
+    websocket_.reset();
+    vEventGroupDelete(event_group_);
+}
+
+// 鉴权参数放在 URL 中：用 APISecret 对 host、date 和请求行做 HMAC-SHA256 签名
+std::string XunfeiSttService::GetSignedUrl() {
+    std::string url = url_.empty() ? XUNFEI_STT_DEFAULT_URL : url_;
+    if (api_key_.empty() || api_secret_.empty()) {
+        return url;
+    }
+
+    auto host_start = url.find("://");
+    host_start = host_start == std::string::npos ? 0 : host_start + 3;
+    auto path_start = url.find('/', host_start);
+    std::string host = url.substr(host_start, path_start == std::string::npos ? std::string::npos : path_start - host_start);
+    std::string path = path_start == std::string::npos ? "/" : url.substr(path_start);
+
+    // 服务端拒绝与其时间相差五分钟以上的请求，设备时间需要已经同步
+    time_t now = time(nullptr);
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    if (tm.tm_year + 1900 < 2024) {
+        ESP_LOGW(TAG, "System time is not set, authentication will fail");
+    }
+    char date[64];
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    std::string origin = "host: " + host + "\ndate: " + date + "\nGET " + path + " HTTP/1.1";
+    uint8_t hmac[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char*)api_secret_.data(),
+        api_secret_.size(), (const unsigned char*)origin.data(), origin.size(), hmac);
+    std::string signature = Base64Encode(hmac, sizeof(hmac));
+
+    std::string authorization = "api_key=\"" + api_key_ + "\", algorithm=\"hmac-sha256\", "
+        "headers=\"host date request-line\", signature=\"" + signature + "\"";
+    authorization = Base64Encode((const uint8_t*)authorization.data(), authorization.size());
+
+    return url + (url.find('?') == std::string::npos ? "?" : "&") + "authorization=" + UrlEncode(authorization) +
+        "&date=" + UrlEncode(date) + "&host=" + UrlEncode(host);
+}
+
+bool XunfeiSttService::Connect() {
+    if (websocket_ != nullptr && websocket_->IsConnected()) {
+        ESP_LOGI(TAG, "Reusing the websocket connection");
+        return true;
+    }
+    websocket_.reset();
+
+    int64_t start_time = esp_timer_get_time();
+    auto network = Board::GetInstance().GetNetwork();
+    websocket_ = network->CreateWebSocket(5);
+    if (websocket_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create websocket");
+        return false;
+    }
+    websocket_->OnData([this](const char* data, size_t len, bool binary) {
+        if (!binary) {
+            OnData(data, len);
+        }
+    });
+    websocket_->OnDisconnected([this]() {
+        ESP_LOGI(TAG, "Websocket disconnected");
+        xEventGroupSetBits(event_group_, XUNFEI_STT_EVENT_DISCONNECTED);
+    });
+
+    xEventGroupClearBits(event_group_, XUNFEI_STT_EVENT_DISCONNECTED);
+    if (!websocket_->Connect(GetSignedUrl().c_str())) {
+        ESP_LOGE(TAG, "Failed to connect to the STT server");
+        websocket_.reset();
+        return false;
+    }
+    ESP_LOGI(TAG, "Connected in %lu ms", (uint32_t)((esp_timer_get_time() - start_time) / 1000));
+    return true;
+}
+
+bool XunfeiSttService::Recognize(AudioService& audio_service, std::function<void(const std::string& text)> on_partial,
+    std::function<void(const std::string& text)> on_result) {
+    if (!IsConfigured()) {
+        ESP_LOGE(TAG, "Xunfei STT is not configured");
+        return false;
+    }
+    bool expected = false;
+    if (!active_.compare_exchange_strong(expected, true)) {
+        ESP_LOGW(TAG, "Recognition already in progress");
+        return false;
+    }
     ESP_LOGI(TAG, "Starting speech recognition...");
-    
-    // ================== 模拟实现 ==================
-    // 在真实场景中，这里会启动WebSocket连接，
-    // 从AudioService获取音频流并发送，然后异步等待结果。
-    // 为了快速调试，我们在此模拟一个2秒后返回固定结果的场景。
-    
-    ESP_LOGW(TAG, "MOCK: Simulating a 2-second speech recognition task.");
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    
-    std::string mock_result = "请拍照";
-    ESP_LOGW(TAG, "MOCK: Simulated recognition result: %s", mock_result.c_str());
-    
-    if (on_result) {
-        on_result(mock_result);
-    }
-    // ===============================================
-}
\ No newline at end of file
+
+    audio_service_ = &audio_service;
+    on_partial_ = on_partial;
+    on_result_ = on_result;
+    {
+        std::lock_guard<std::mutex> lock(result_mutex_);
+        sentences_.clear();
+        text_.clear();
+        error_.clear();
+        partial_count_ = 0;
+    }
+    speech_start_time_ = 0;
+    speech_end_time_ = 0;
+    responded_ = false;
+    unacknowledged_audio_.clear();
+    xEventGroupClearBits(event_group_, XUNFEI_STT_EVENT_AUDIO | XUNFEI_STT_EVENT_SPEECH_END |
+        XUNFEI_STT_EVENT_FINAL | XUNFEI_STT_EVENT_CANCEL);
+
+    // 上一次识别结束后残留在发送队列里的音频不属于这句话
+    while (audio_service.PopPacketFromSendQueue() != nullptr) {
+    }
+
+    // 连接和鉴权在识别任务中进行，期间录到的音频先留在发送队列里
+    xTaskCreate([](void* arg) {
+        auto service = static_cast<XunfeiSttService*>(arg);
+        service->RecognizeTask();
+        vTaskDelete(NULL);
+    }, "xunfei_stt", 4096 * 2, this, 5, NULL);
+    return true;
+}
+
+void XunfeiSttService::Cancel() {
+    if (active_) {
+        xEventGroupSetBits(event_group_, XUNFEI_STT_EVENT_CANCEL);
+    }
+}
+
+void XunfeiSttService::OnAudioAvailable() {
+    if (active_) {
+        xEventGroupSetBits(event_group_, XUNFEI_STT_EVENT_AUDIO);
+    }
+}
+
+void XunfeiSttService::OnVadChange(bool speaking) {
+    if (!active_) {
+        return;
+    }
+    if (speaking) {
+        if (speech_start_time_ == 0) {
+            speech_start_time_ = esp_timer_get_time();
+        }
+    } else if (speech_start_time_ != 0) {
+        speech_end_time_ = esp_timer_get_time();
+        xEventGroupSetBits(event_group_, XUNFEI_STT_EVENT_SPEECH_END);
+    }
+}
+
+// 第一帧带上应用和业务参数，之后只有 data
+bool XunfeiSttService::SendAudio(int status, const uint8_t* data, size_t len) {
+    std::string message;
+    message.reserve(len * 4 / 3 + 256);
+    JsonWriter writer(message);
+    writer.BeginObject();
+    if (status == kXunfeiFrameFirst) {
+        writer.Key("common");
+        writer.BeginObject();
+        writer.Field("app_id", app_id_);
+        writer.EndObject();
+        writer.Key("business");
+        writer.BeginObject();
+        writer.Field("language", "zh_cn");
+        writer.Field("domain", "iat");
+        writer.Field("accent", "mandarin");
+        writer.Field("dwa", "wpgs");    // 中间结果可以修正前面的句子
+        writer.Field("vad_eos", XUNFEI_STT_SERVER_VAD_EOS_MS);
+        writer.EndObject();
+    }
+    writer.Key("data");
+    writer.BeginObject();
+    writer.Field("status", status);
+    writer.Field("format", "audio/L16;rate=16000");
+    writer.Field("encoding", XUNFEI_STT_ENCODING);
+    writer.Key("audio");
+    writer.Base64(data, len);
+    writer.EndObject();
+    writer.EndObject();
+    return websocket_->Send(message);
+}
+
+// 把发送队列中已有的音频合成一帧发出，返回发出的包数
+size_t XunfeiSttService::SendPendingAudio(bool& first_frame) {
+    std::vector<uint8_t> buffer;
+    size_t packets = 0;
+    while (auto packet = audio_service_->PopPacketFromSendQueue()) {
+        if (packet->payload.empty()) {
+            continue;
+        }
+        buffer.push_back(packet->payload.size() >> 8);
+        buffer.push_back(packet->payload.size() & 0xFF);
+        buffer.insert(buffer.end(), packet->payload.begin(), packet->payload.end());
+        packets++;
+    }
+    if (packets == 0) {
+        return 0;
+    }
+    if (!responded_) {
+        unacknowledged_audio_.insert(unacknowledged_audio_.end(), buffer.begin(), buffer.end());
+    } else if (!unacknowledged_audio_.empty()) {
+        unacknowledged_audio_ = std::vector<uint8_t>();
+    }
+    if (!SendAudio(first_frame ? kXunfeiFrameFirst : kXunfeiFrameContinue, buffer.data(), buffer.size())) {
+        ESP_LOGE(TAG, "Failed to send audio");
+        return 0;
+    }
+    first_frame = false;
+    return packets;
+}
+
+void XunfeiSttService::RecognizeTask() {
+    int64_t start_time = esp_timer_get_time();
+    bool reused = websocket_ != nullptr && websocket_->IsConnected();
+    bool ok = Connect();
+    int64_t connected_time = esp_timer_get_time();
+
+    bool first_frame = true;
+    size_t packets_sent = 0;
+    bool cancelled = false;
+    while (ok) {
+        EventBits_t bits = xEventGroupWaitBits(event_group_, XUNFEI_STT_EVENT_AUDIO | XUNFEI_STT_EVENT_SPEECH_END |
+            XUNFEI_STT_EVENT_CANCEL | XUNFEI_STT_EVENT_DISCONNECTED, pdTRUE, pdFALSE, pdMS_TO_TICKS(100));
+        if (bits & XUNFEI_STT_EVENT_CANCEL) {
+            cancelled = true;
+            break;
+        }
+        if (bits & XUNFEI_STT_EVENT_DISCONNECTED) {
+            if (reused && !responded_) {
+                // 复用的连接在这次识别之前就在关闭，换一个新连接，已发出的音频作为第一帧重发
+                ESP_LOGW(TAG, "Reused connection was closed by the server, reconnecting");
+                reused = false;
+                websocket_.reset();
+                if (Connect() && (unacknowledged_audio_.empty() ||
+                    SendAudio(kXunfeiFrameFirst, unacknowledged_audio_.data(), unacknowledged_audio_.size()))) {
+                    first_frame = unacknowledged_audio_.empty();
+                    continue;
+                }
+            }
+            ESP_LOGE(TAG, "Disconnected while streaming audio");
+            ok = false;
+            break;
+        }
+        packets_sent += SendPendingAudio(first_frame);
+        if (bits & XUNFEI_STT_EVENT_SPEECH_END) {
+            break;
+        }
+        int64_t elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+        if (speech_start_time_ == 0 && elapsed_ms > XUNFEI_STT_NO_SPEECH_TIMEOUT_MS) {
+            ESP_LOGW(TAG, "No speech detected");
+            break;
+        }
+        if (elapsed_ms > XUNFEI_STT_MAX_SPEECH_MS) {
+            ESP_LOGW(TAG, "Speech too long, finishing");
+            break;
+        }
+        std::lock_guard<std::mutex> lock(result_mutex_);
+        if (!error_.empty()) {
+            ok = false;
+            break;
+        }
+    }
+
+    // 说完后发出最后一帧，服务端随即给出最终结果
+    int64_t last_frame_time = esp_timer_get_time();
+    bool final = false;
+    if (ok && !cancelled) {
+        packets_sent += SendPendingAudio(first_frame);
+        // 一直没有音频时也要先发第一帧，服务端才认得最后一帧
+        bool sent = !first_frame || SendAudio(kXunfeiFrameFirst, nullptr, 0);
+        if (sent && SendAudio(kXunfeiFrameLast, nullptr, 0)) {
+            EventBits_t bits = xEventGroupWaitBits(event_group_, XUNFEI_STT_EVENT_FINAL | XUNFEI_STT_EVENT_CANCEL |
+                XUNFEI_STT_EVENT_DISCONNECTED, pdFALSE, pdFALSE, pdMS_TO_TICKS(XUNFEI_STT_FINAL_TIMEOUT_MS));
+            final = bits & XUNFEI_STT_EVENT_FINAL;
+            cancelled = bits & XUNFEI_STT_EVENT_CANCEL;
+        }
+    }
+    int64_t end_time = esp_timer_get_time();
+
+    std::string text;
+    std::string error;
+    int partials;
+    {
+        std::lock_guard<std::mutex> lock(result_mutex_);
+        text = text_;
+        error = error_;
+        partials = partial_count_;
+        on_partial_ = nullptr;
+    }
+    if (!final || !error.empty()) {
+        // 识别出错或中途断开时关掉连接，下次重新建立
+        websocket_.reset();
+        ESP_LOGW(TAG, "No final result%s%s, keeping the last partial \"%s\"", error.empty() ? "" : ": ",
+            error.c_str(), text.c_str());
+    }
+
+    // 说完到拿到文字的时间，是这次识别唯一需要等待的部分
+    int64_t speech_end = speech_end_time_ != 0 ? (int64_t)speech_end_time_ : last_frame_time;
+    ESP_LOGI(TAG, "Recognized \"%s\": connect %lu ms, %u packets, %d partials, final %lu ms after end of speech",
+        text.c_str(), (uint32_t)((connected_time - start_time) / 1000), packets_sent, partials,
+        (uint32_t)((end_time - speech_end) / 1000));
+
+    auto on_result = std::move(on_result_);
+    audio_service_ = nullptr;
+    active_ = false;
+    if (!cancelled && on_result) {
+        on_result(text);
+    }
+}
+
+// 结果格式：{"code":0,"data":{"status":1,"result":{"sn":2,"pgs":"rpl","rg":[1,2],"ws":[{"cw":[{"w":"..."}]}]}}}
+void XunfeiSttService::OnData(const char* data, size_t len) {
+    if (!active_) {
+        return;
+    }
+    responded_ = true;
+    JsonReader root(data, len);
+    int code = root["code"].GetInt(-1);
+    if (code != 0) {
+        std::lock_guard<std::mutex> lock(result_mutex_);
+        error_ = std::to_string(code) + " " + root["message"].GetString();
+        ESP_LOGE(TAG, "Recognition error: %s, sid %s", error_.c_str(), root["sid"].GetString().c_str());
+        xEventGroupSetBits(event_group_, XUNFEI_STT_EVENT_FINAL);
+        return;
+    }
+
+    auto result_data = root["data"];
+    auto result = result_data["result"];
+    std::string text;
+    bool changed = false;
+    std::function<void(const std::string& text)> on_partial;
+    if (result.IsObject()) {
+        std::string sentence;
+        result["ws"].ForEachElement([&sentence](const JsonReader& word) {
+            word["cw"].ForEachElement([&sentence](const JsonReader& candidate) {
+                sentence += candidate["w"].GetString();
+                return false;   // 只取第一个候选
+            });
+            return true;
+        });
+
+        int sn = result["sn"].GetInt();
+        std::lock_guard<std::mutex> lock(result_mutex_);
+        if (sn > 0) {
+            if (result["pgs"].Equals("rpl")) {
+                // 替换 rg 范围内的句子
+                int range[2] = {0, 0};
+                int index = 0;
+                result["rg"].ForEachElement([&range, &index](const JsonReader& value) {
+                    range[index++] = value.GetInt();
+                    return index < 2;
+                });
+                for (int i = std::max(range[0], 1); i <= range[1] && i <= (int)sentences_.size(); i++) {
+                    sentences_[i - 1].clear();
+                }
+            }
+            if ((int)sentences_.size() < sn) {
+                sentences_.resize(sn);
+            }
+            sentences_[sn - 1] = std::move(sentence);
+        }
+        std::string joined;
+        for (auto& s : sentences_) {
+            joined += s;
+        }
+        changed = joined != text_;
+        text_ = std::move(joined);
+        text = text_;
+        if (changed) {
+            partial_count_++;
+            on_partial = on_partial_;
+        }
+    }
+
+    if (changed && on_partial) {
+        on_partial(text);
+    }
+    if (result_data["status"].GetInt() == kXunfeiFrameLast) {
+        xEventGroupSetBits(event_group_, XUNFEI_STT_EVENT_FINAL);
+    }
+}
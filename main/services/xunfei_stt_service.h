@@ -1,23 +1,101 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <functional>
 
+#include <web_socket.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+class AudioService;
+
+// 讯飞语音听写（流式版）的默认地址，Kconfig 中可以改为本地桩服务器
+#define XUNFEI_STT_DEFAULT_URL "wss://iat-api.xfyun.cn/v2/iat"
+// 发送队列中是 16kHz 的 Opus 包，每包前加两字节大端长度
+#define XUNFEI_STT_ENCODING "opus-wb"
+// 服务端的静音断句时间，只作兜底，正常由本地 VAD 结束
+#define XUNFEI_STT_SERVER_VAD_EOS_MS 3000
+// 一直没有检测到说话时放弃
+#define XUNFEI_STT_NO_SPEECH_TIMEOUT_MS 6000
+// 一句话最长的录音时间，服务端上限是 60 秒
+#define XUNFEI_STT_MAX_SPEECH_MS 20000
+// 发出最后一帧后等待最终结果的时间
+#define XUNFEI_STT_FINAL_TIMEOUT_MS 3000
+
+#define XUNFEI_STT_EVENT_AUDIO          (1 << 0)
+#define XUNFEI_STT_EVENT_SPEECH_END     (1 << 1)
+#define XUNFEI_STT_EVENT_FINAL          (1 << 2)
+#define XUNFEI_STT_EVENT_CANCEL         (1 << 3)
+#define XUNFEI_STT_EVENT_DISCONNECTED   (1 << 4)
+
 class XunfeiSttService {
 public:
-    XunfeiSttService(const std::string& app_id, const std::string& api_key, const std::string& api_secret);
-    
+    XunfeiSttService(const std::string& app_id, const std::string& api_key, const std::string& api_secret,
+        const std::string& url = "");
+    ~XunfeiSttService();
+
+    /**
+     * @brief 是否可以识别：设置了 app_id，或者指定了地址（本地桩服务器不需要鉴权）。
+     */
+    bool IsConfigured() const { return !app_id_.empty() || !url_.empty(); }
+
     /**
-     * @brief 开始异步语音识别。
-     * 
-     * 在真实实现中，此函数将启动WebSocket连接并开始发送音频流。
-     * 完成识别后，将通过 on_result 回调返回结果。
-     * @param on_result 识别完成后的回调函数，参数为识别出的文本。
+     * @brief 开始一次流式识别，立即返回。
+     *
+     * 识别任务从 AudioService 的发送队列中取出编码好的音频，边录边经 WebSocket 发给服务端；
+     * 本地 VAD 判断说完后（OnVadChange(false)）发出最后一帧，服务端很快返回最终结果。
+     * 连接在两次识别之间保持，服务端关闭后下次再连接。
+     * @param on_partial 中间结果，参数是到目前为止整句的识别文本，在 WebSocket 接收任务中回调。
+     * @param on_result 最终结果，失败或没有说话时为空字符串，在识别任务中回调。
+     * @return 未配置或上一次识别还没结束时返回 false，此时不会回调。
      */
-    void Recognize(std::function<void(const std::string& text)> on_result);
+    bool Recognize(AudioService& audio_service, std::function<void(const std::string& text)> on_partial,
+        std::function<void(const std::string& text)> on_result);
+
+    /**
+     * @brief 放弃当前的识别，不再回调 on_result。
+     */
+    void Cancel();
+
+    // 由 Application 从 AudioServiceCallbacks 转过来
+    void OnAudioAvailable();
+    void OnVadChange(bool speaking);
 
 private:
     std::string app_id_;
     std::string api_key_;
     std::string api_secret_;
-};
\ No newline at end of file
+    std::string url_;
+
+    EventGroupHandle_t event_group_;
+    std::unique_ptr<WebSocket> websocket_;
+    std::atomic<bool> active_ = false;
+    std::atomic<int64_t> speech_start_time_ = 0;
+    std::atomic<int64_t> speech_end_time_ = 0;
+    // 服务端发回最终结果后随即关闭连接，关闭到达之前开始的下一次识别会复用一个正在关闭的连接。
+    // 服务端还没有回复时保留已发出的音频，复用的连接被关闭后重新连接再发一次
+    std::atomic<bool> responded_ = false;
+    std::vector<uint8_t> unacknowledged_audio_;
+
+    AudioService* audio_service_ = nullptr;
+    std::function<void(const std::string& text)> on_partial_;
+    std::function<void(const std::string& text)> on_result_;
+
+    // 按句子序号保存的识别结果，动态修正（wpgs）会替换其中一段
+    std::mutex result_mutex_;
+    std::vector<std::string> sentences_;
+    std::string text_;
+    std::string error_;
+    int partial_count_ = 0;
+
+    void RecognizeTask();
+    bool Connect();
+    std::string GetSignedUrl();
+    bool SendAudio(int status, const uint8_t* data, size_t len);
+    size_t SendPendingAudio(bool& first_frame);
+    void OnData(const char* data, size_t len);
+};
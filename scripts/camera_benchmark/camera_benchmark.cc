@@ -0,0 +1,145 @@
+// 相机基准测试：用 FakeCamera 按不同分辨率、格式和质量反复拍照并上传到本地桩服务器，
+// 报告拍照、编码、上传和等待回复的耗时以及 PSRAM 峰值
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <esp_heap_caps.h>
+
+#include "fake_camera.h"
+
+static double Percentile(std::vector<double> values, int p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+static std::vector<std::string> Split(const std::string& text) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        if (end > start) {
+            items.push_back(text.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+static void Usage(const char* name) {
+    printf("Usage: %s [--dir IMAGES] [--url URL] [--key KEY] [--sizes 320x240,640x480] [--formats rgb565,jpeg]\n"
+        "    [--qualities 80] [--rounds N] [--fb-count N] [--frame-ms MS] [--preview-width W]\n"
+        "    [--max-width W] [--max-height H] [--crop] [--grayscale] [--max-bytes BYTES]\n", name);
+}
+
+int main(int argc, char** argv) {
+    std::string dir;
+    std::string url = "http://127.0.0.1:8090/vision/explain";
+    std::string key;
+    std::vector<std::string> sizes = {"320x240", "640x480"};
+    std::vector<std::string> formats = {"rgb565", "jpeg"};
+    std::vector<std::string> qualities = {"80"};
+    int rounds = 5;
+    FakeCameraConfig base;
+    CameraUploadConfig upload;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (arg == "--url" && i + 1 < argc) {
+            url = argv[++i];
+        } else if (arg == "--key" && i + 1 < argc) {
+            key = argv[++i];
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            sizes = Split(argv[++i]);
+        } else if (arg == "--formats" && i + 1 < argc) {
+            formats = Split(argv[++i]);
+        } else if (arg == "--qualities" && i + 1 < argc) {
+            qualities = Split(argv[++i]);
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            rounds = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--fb-count" && i + 1 < argc) {
+            base.fb_count = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--frame-ms" && i + 1 < argc) {
+            base.frame_interval_ms = atoi(argv[++i]);
+        } else if (arg == "--preview-width" && i + 1 < argc) {
+            base.preview_width = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--max-width" && i + 1 < argc) {
+            upload.max_width = atoi(argv[++i]);
+        } else if (arg == "--max-height" && i + 1 < argc) {
+            upload.max_height = atoi(argv[++i]);
+        } else if (arg == "--max-bytes" && i + 1 < argc) {
+            upload.max_bytes = atoi(argv[++i]);
+        } else if (arg == "--crop") {
+            upload.crop = true;
+        } else if (arg == "--grayscale") {
+            upload.grayscale = true;
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    printf("%-7s %-9s %3s  %8s %8s %8s %8s  %7s %8s %9s\n", "format", "size", "q", "capture", "encode",
+        "upload", "reply", "JPEG KB", "up KB/s", "PSRAM KB");
+    int failures = 0;
+    for (auto& format : formats) {
+        for (auto& size : sizes) {
+            for (auto& quality : qualities) {
+                FakeCameraConfig config = base;
+                if (sscanf(size.c_str(), "%dx%d", &config.width, &config.height) != 2 ||
+                    config.width <= 0 || config.height <= 0 || (format != "rgb565" && format != "jpeg")) {
+                    Usage(argv[0]);
+                    return 1;
+                }
+                config.jpeg = format == "jpeg";
+                upload.quality = atoi(quality.c_str());
+
+                // 帧只在构造时从目录载入，峰值从构造之后算起，包含驱动预先分配的帧缓冲区
+                size_t baseline = PsramTracker::current;
+                FakeCamera camera(config, dir);
+                PsramTracker::ResetPeak();
+                camera.SetUploadConfig(upload);
+                camera.SetExplainUrl(url, key);
+
+                std::vector<double> capture_ms, encode_ms, upload_ms, response_ms, jpeg_kb;
+                double uploaded_kb = 0, upload_seconds = 0;
+                for (int round = 0; round < rounds; round++) {
+                    if (!camera.Capture()) {
+                        failures++;
+                        continue;
+                    }
+                    auto result = camera.Explain("这是什么？");
+                    const auto& stats = camera.stats();
+                    if (result.find("\"success\": false") != std::string::npos || stats.upload_us == 0) {
+                        fprintf(stderr, "Explain failed: %s\n", result.c_str());
+                        failures++;
+                        continue;
+                    }
+                    capture_ms.push_back(stats.capture_us / 1000.0);
+                    encode_ms.push_back(stats.encode_us / 1000.0);
+                    upload_ms.push_back(stats.upload_us / 1000.0);
+                    response_ms.push_back(stats.response_us / 1000.0);
+                    jpeg_kb.push_back(stats.jpeg_bytes / 1024.0);
+                    uploaded_kb += stats.jpeg_bytes / 1024.0;
+                    upload_seconds += stats.upload_us / 1e6;
+                }
+                printf("%-7s %-9s %3d  %8.1f %8.1f %8.1f %8.1f  %7.1f %8.0f %9.0f\n", format.c_str(), size.c_str(),
+                    upload.quality, Percentile(capture_ms, 50), Percentile(encode_ms, 50), Percentile(upload_ms, 50),
+                    Percentile(response_ms, 50), Percentile(jpeg_kb, 50), upload_seconds > 0 ? uploaded_kb / upload_seconds : 0,
+                    (PsramTracker::peak - baseline) / 1024.0);
+                fflush(stdout);
+            }
+        }
+    }
+    printf("times are p50 in ms over %d rounds, %d failed\n", rounds, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,477 @@
+#include "fake_camera.h"
+#include "image_utils.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csetjmp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+#include <jpeglib.h>
+
+#define TAG "FakeCamera"
+
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void JpegErrorExit(j_common_ptr cinfo) {
+    longjmp(((JpegErrorManager*)cinfo->err)->jump, 1);
+}
+
+// 解码为 RGB565 大端，scale_denom 为 1、2、4、8，与 jpg2rgb565 的缩小解码对应。
+// 输出用 heap_caps_malloc(caps) 分配
+static uint8_t* DecodeJpeg(const uint8_t* data, size_t len, int scale_denom, uint32_t caps, int& width, int& height) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = JpegErrorExit;
+    uint8_t* out = nullptr;
+    std::vector<uint8_t> row;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        heap_caps_free(out);
+        return nullptr;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, data, len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+    jpeg_start_decompress(&cinfo);
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+    out = (uint8_t*)heap_caps_malloc(width * height * 2, caps);
+    row.resize(width * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint8_t* dst = out + (size_t)cinfo.output_scanline * width * 2;
+        JSAMPROW rows[] = {row.data()};
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        for (int x = 0; x < width; x++) {
+            const uint8_t* p = &row[x * 3];
+            uint16_t pixel = ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+            dst[x * 2] = pixel >> 8;
+            dst[x * 2 + 1] = pixel & 0xFF;
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return out;
+}
+
+// 编码输出交给 write，write 返回 false 时停止编码
+using JpegWriter = std::function<bool(const uint8_t* data, size_t len)>;
+
+// 与 frame2jpg_cb 一样每次交出一小段输出
+struct JpegCallbackDestination {
+    jpeg_destination_mgr pub;
+    const JpegWriter* write;
+    uint8_t buffer[1024];
+};
+
+static void InitDestination(j_compress_ptr cinfo) {
+    auto dest = (JpegCallbackDestination*)cinfo->dest;
+    dest->pub.next_output_byte = dest->buffer;
+    dest->pub.free_in_buffer = sizeof(dest->buffer);
+}
+
+static boolean EmptyOutputBuffer(j_compress_ptr cinfo) {
+    auto dest = (JpegCallbackDestination*)cinfo->dest;
+    if (!(*dest->write)(dest->buffer, sizeof(dest->buffer))) {
+        cinfo->err->error_exit((j_common_ptr)cinfo);
+    }
+    InitDestination(cinfo);
+    return TRUE;
+}
+
+static void TermDestination(j_compress_ptr cinfo) {
+    auto dest = (JpegCallbackDestination*)cinfo->dest;
+    size_t len = sizeof(dest->buffer) - dest->pub.free_in_buffer;
+    if (len > 0 && !(*dest->write)(dest->buffer, len)) {
+        cinfo->err->error_exit((j_common_ptr)cinfo);
+    }
+}
+
+// RGB565 大端或 8 位灰度编码为 JPEG
+static bool EncodeJpeg(const uint8_t* src, int width, int height, bool grayscale, int quality, const JpegWriter& write) {
+    jpeg_compress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = JpegErrorExit;
+    JpegCallbackDestination dest;
+    dest.pub.init_destination = InitDestination;
+    dest.pub.empty_output_buffer = EmptyOutputBuffer;
+    dest.pub.term_destination = TermDestination;
+    dest.write = &write;
+    std::vector<uint8_t> row(width * 3);
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    cinfo.dest = &dest.pub;
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = grayscale ? 1 : 3;
+    cinfo.in_color_space = grayscale ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW rows[1];
+        if (grayscale) {
+            rows[0] = (JSAMPROW)(src + (size_t)cinfo.next_scanline * width);
+        } else {
+            const uint8_t* p = src + (size_t)cinfo.next_scanline * width * 2;
+            for (int x = 0; x < width; x++) {
+                uint16_t pixel = (p[x * 2] << 8) | p[x * 2 + 1];
+                row[x * 3] = (pixel >> 8) & 0xF8;
+                row[x * 3 + 1] = (pixel >> 3) & 0xFC;
+                row[x * 3 + 2] = (pixel << 3) & 0xF8;
+            }
+            rows[0] = row.data();
+        }
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return true;
+}
+
+static bool EncodeJpeg(const uint8_t* src, int width, int height, bool grayscale, int quality, std::vector<uint8_t>& jpeg) {
+    jpeg.clear();
+    return EncodeJpeg(src, width, height, grayscale, quality, [&jpeg](const uint8_t* data, size_t len) {
+        jpeg.insert(jpeg.end(), data, data + len);
+        return true;
+    });
+}
+
+FakeCamera::FakeCamera(const FakeCameraConfig& config, const std::string& image_dir) : config_(config) {
+    if (!LoadFrames(image_dir)) {
+        return;
+    }
+
+    // 驱动在初始化时分配全部帧缓冲区；JPEG 帧缓冲区按 esp32-camera 的估算取 1/5 的 RGB565 大小
+    frame_buffer_size_ = config_.jpeg ? config_.width * config_.height / 5 : config_.width * config_.height * 2;
+    for (int i = 0; i < config_.fb_count; i++) {
+        frame_buffers_.push_back((uint8_t*)heap_caps_malloc(frame_buffer_size_, MALLOC_CAP_SPIRAM));
+    }
+
+    preview_height_ = std::max(config_.height * config_.preview_width / config_.width, 1);
+    preview_ = (uint16_t*)heap_caps_malloc(config_.preview_width * preview_height_ * 2, MALLOC_CAP_SPIRAM);
+}
+
+FakeCamera::~FakeCamera() {
+    for (auto buffer : frame_buffers_) {
+        heap_caps_free(buffer);
+    }
+    heap_caps_free(preview_);
+    heap_caps_free(upload_jpeg_);
+}
+
+bool FakeCamera::LoadFrames(const std::string& image_dir) {
+    std::vector<std::filesystem::path> files;
+    if (!image_dir.empty()) {
+        for (auto& entry : std::filesystem::directory_iterator(image_dir)) {
+            auto ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (ext == ".jpg" || ext == ".jpeg") {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    }
+
+    int width = config_.width;
+    int height = config_.height;
+    for (auto& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        int src_width, src_height;
+        uint8_t* src = DecodeJpeg(data.data(), data.size(), 1, 0, src_width, src_height);
+        if (src == nullptr) {
+            ESP_LOGW(TAG, "Skipping %s, not a JPEG", file.c_str());
+            continue;
+        }
+        // 居中裁剪到传感器的宽高比，再缩放到传感器分辨率
+        int crop_width = src_width, crop_height = src_height;
+        if ((int64_t)src_width * height > (int64_t)src_height * width) {
+            crop_width = src_height * width / height;
+        } else {
+            crop_height = src_width * height / width;
+        }
+        int crop_x = (src_width - crop_width) / 2;
+        int crop_y = (src_height - crop_height) / 2;
+        std::vector<uint8_t> frame(width * height * 2);
+        if (crop_width >= width && crop_height >= height) {
+            Rgb565DownscaleArea(src, src_width, crop_x, crop_y, crop_width, crop_height, frame.data(), width, height);
+        } else {
+            for (int y = 0; y < height; y++) {
+                int sy = crop_y + y * crop_height / height;
+                for (int x = 0; x < width; x++) {
+                    int sx = crop_x + x * crop_width / width;
+                    memcpy(&frame[(y * width + x) * 2], src + ((size_t)sy * src_width + sx) * 2, 2);
+                }
+            }
+        }
+        heap_caps_free(src);
+        frames_.push_back(std::move(frame));
+    }
+
+    if (frames_.empty()) {
+        // 没有图片时生成几帧有渐变、色块和细节的测试图案
+        for (int i = 0; i < 4; i++) {
+            std::vector<uint8_t> frame(width * height * 2);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    int r = (x + i * 40) * 31 / width % 32;
+                    int g = y * 63 / height;
+                    int b = ((x / 16 + y / 16 + i) % 2) ? 31 : (x * y / 97 + i * 7) % 32;
+                    uint16_t pixel = (r << 11) | (g << 5) | b;
+                    frame[(y * width + x) * 2] = pixel >> 8;
+                    frame[(y * width + x) * 2 + 1] = pixel & 0xFF;
+                }
+            }
+            frames_.push_back(std::move(frame));
+        }
+        ESP_LOGW(TAG, "No images in \"%s\", using %u generated frames", image_dir.c_str(), frames_.size());
+    }
+    return true;
+}
+
+void FakeCamera::SetExplainUrl(const std::string& url, const std::string& token) {
+    vision_service_.Initialize(url, token);
+}
+
+bool FakeCamera::Capture() {
+    int64_t start_time = esp_timer_get_time();
+    if (!valid()) {
+        return false;
+    }
+    // 等传感器出下一帧
+    int64_t next_frame_time = last_frame_time_ + config_.frame_interval_ms * 1000;
+    if (last_frame_time_ > 0 && next_frame_time > start_time) {
+        std::this_thread::sleep_for(std::chrono::microseconds(next_frame_time - start_time));
+    }
+    last_frame_time_ = esp_timer_get_time();
+
+    // 上一张照片的上传数据已经用不到了
+    heap_caps_free(upload_jpeg_);
+    upload_jpeg_ = nullptr;
+
+    const auto& frame = frames_[next_frame_++ % frames_.size()];
+    fb_ = frame_buffers_[current_buffer_++ % frame_buffers_.size()];
+    uint32_t sensor_us = 0;
+    if (config_.jpeg) {
+        // 传感器自己编码，不算在设备的耗时里
+        int64_t sensor_start = esp_timer_get_time();
+        if (!EncodeJpeg(frame.data(), config_.width, config_.height, false, upload_config_.quality, encoded_)) {
+            return false;
+        }
+        sensor_us = esp_timer_get_time() - sensor_start;
+        if (encoded_.size() > frame_buffer_size_) {
+            ESP_LOGE(TAG, "JPEG of %u bytes does not fit the %u byte frame buffer, lower the quality",
+                encoded_.size(), frame_buffer_size_);
+            fb_ = nullptr;
+            return false;
+        }
+        memcpy(fb_, encoded_.data(), encoded_.size());
+        fb_len_ = encoded_.size();
+    } else {
+        memcpy(fb_, frame.data(), frame.size());
+        fb_len_ = frame.size();
+    }
+
+    UpdatePreview();
+    stats_ = FakeCameraStats();
+    stats_.capture_us = esp_timer_get_time() - start_time - sensor_us;
+    return true;
+}
+
+// 与 Esp32Camera::UpdatePreview 相同：JPEG 先按 2 的幂缩小解码，缩小 2 倍以上用最近邻，否则用双线性
+void FakeCamera::UpdatePreview() {
+    const uint8_t* src = fb_;
+    int width = config_.width;
+    int height = config_.height;
+    uint8_t* decoded = nullptr;
+    if (config_.jpeg) {
+        int scale_denom = 1;
+        while (scale_denom < 8 && width / (scale_denom * 2) >= config_.preview_width) {
+            scale_denom *= 2;
+        }
+        decoded = DecodeJpeg(fb_, fb_len_, scale_denom, MALLOC_CAP_SPIRAM, width, height);
+        if (decoded == nullptr) {
+            return;
+        }
+        src = decoded;
+    }
+    if (width >= config_.preview_width * 2) {
+        Rgb565ScaleNearest(src, width, height, preview_, config_.preview_width, preview_height_, kImageRotate0);
+    } else {
+        Rgb565ScaleBilinear(src, width, height, preview_, config_.preview_width, preview_height_, kImageRotate0);
+    }
+    heap_caps_free(decoded);
+}
+
+// 与 Esp32Camera::Preprocess 相同，裁剪、缩小和质量调整都由 image_utils 中的 PlanImageResize 等函数决定
+bool FakeCamera::Preprocess(const uint8_t*& jpeg, size_t& len) {
+    const auto& config = upload_config_;
+    int width = config_.width;
+    int height = config_.height;
+    auto plan = PlanImageResize(width, height, config.max_width, config.max_height, config.crop);
+    int out_width = plan.out_width;
+    int out_height = plan.out_height;
+
+    const uint8_t* src = fb_;
+    uint8_t* decoded = nullptr;
+    if (config_.jpeg) {
+        // libjpeg 缩小解码时尺寸向上取整，裁剪区域按实际解码尺寸截断
+        int scale = PlanJpegDecodeScale(plan);
+        decoded = DecodeJpeg(fb_, fb_len_, 1 << scale, MALLOC_CAP_SPIRAM, width, height);
+        if (decoded == nullptr) {
+            return false;
+        }
+        ScaleImageResizePlan(plan, scale, width, height);
+        src = decoded;
+    }
+
+    auto scaled = (uint8_t*)heap_caps_malloc(out_width * out_height * 2, MALLOC_CAP_SPIRAM);
+    Rgb565DownscaleArea(src, width, plan.crop_x, plan.crop_y, plan.crop_width, plan.crop_height,
+        scaled, out_width, out_height);
+    heap_caps_free(decoded);
+    if (config.grayscale) {
+        Rgb565ToLuma(scaled, out_width, out_height, 1, scaled);
+    }
+
+    int quality = upload_quality_ > 0 ? upload_quality_ : config.quality;
+    bool ok = false;
+    for (int attempt = 0; attempt < 3; attempt++) {
+        ok = EncodeJpeg(scaled, out_width, out_height, config.grayscale, quality, encoded_);
+        if (!ok || config.max_bytes == 0 || encoded_.size() <= config.max_bytes || quality <= IMAGE_MIN_JPEG_QUALITY) {
+            break;
+        }
+        if (attempt < 2) {
+            quality = ReduceJpegQuality(quality, encoded_.size(), config.max_bytes);
+        }
+    }
+    heap_caps_free(scaled);
+    if (!ok) {
+        return false;
+    }
+    upload_quality_ = NextJpegQuality(quality, encoded_.size(), config.max_bytes, config.quality);
+
+    // 设备上 fmt2jpg 的输出整张留在 PSRAM 中直到上传完
+    upload_jpeg_ = (uint8_t*)heap_caps_malloc(encoded_.size(), MALLOC_CAP_SPIRAM);
+    memcpy(upload_jpeg_, encoded_.data(), encoded_.size());
+    jpeg = upload_jpeg_;
+    len = encoded_.size();
+    return true;
+}
+
+std::unique_ptr<JpegSource> FakeCamera::GetJpegSource() {
+    if (fb_ == nullptr) {
+        return nullptr;
+    }
+    int64_t start_time = esp_timer_get_time();
+    const auto& config = upload_config_;
+    auto plan = PlanImageResize(config_.width, config_.height, config.max_width, config.max_height, config.crop);
+    bool preprocess = config.grayscale || config.max_bytes > 0 || plan.resizes(config_.width, config_.height);
+
+    const uint8_t* data = nullptr;
+    size_t len = 0;
+    if (preprocess && Preprocess(data, len)) {
+        stats_.encode_us = esp_timer_get_time() - start_time;
+    } else if (config_.jpeg) {
+        data = fb_;
+        len = fb_len_;
+    } else {
+        // 与设备相同，编码线程经 JpegStream 的块池边编码边上传，编码耗时和大小在上传结束后从块池的统计中取
+        if (jpeg_stream_ == nullptr) {
+            jpeg_stream_ = std::make_unique<JpegStream>();
+        }
+        if (!jpeg_stream_->valid()) {
+            return nullptr;
+        }
+        const uint8_t* fb = fb_;
+        int width = config_.width;
+        int height = config_.height;
+        int quality = config.quality;
+        return std::make_unique<StreamJpegSource>(*jpeg_stream_, [fb, width, height, quality](JpegStream& stream) {
+            return EncodeJpeg(fb, width, height, false, quality, [&stream](const uint8_t* data, size_t len) {
+                return stream.Write(data, len);
+            });
+        });
+    }
+    stats_.jpeg_bytes = len;
+    return std::make_unique<BufferJpegSource>(data, len, nullptr, JPEG_STREAM_CHUNK_SIZE);
+}
+
+bool FakeCamera::GetJpeg(int quality, std::vector<uint8_t>& jpeg) {
+    if (fb_ == nullptr) {
+        return false;
+    }
+    if (config_.jpeg) {
+        jpeg.assign(fb_, fb_ + fb_len_);
+        return true;
+    }
+    return EncodeJpeg(fb_, config_.width, config_.height, false, quality, jpeg);
+}
+
+// 记录第一块图像被读取和读完的时间，把上传和等待回复分开
+class TimedJpegSource : public JpegSource {
+public:
+    TimedJpegSource(JpegSource& source) : source_(source) {}
+
+    bool Next(const uint8_t*& data, size_t& len) override {
+        if (first_us == 0) {
+            first_us = esp_timer_get_time();
+        }
+        bool ok = source_.Next(data, len);
+        if (!ok) {
+            end_us = esp_timer_get_time();
+        }
+        return ok;
+    }
+    bool Rewind() override { return source_.Rewind(); }
+    bool failed() const override { return source_.failed(); }
+    const JpegStreamStats* stream_stats() const override { return source_.stream_stats(); }
+
+    int64_t first_us = 0;
+    int64_t end_us = 0;
+
+private:
+    JpegSource& source_;
+};
+
+std::string FakeCamera::Explain(const std::string& question) {
+    if (!vision_service_.IsConfigured()) {
+        return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
+    }
+    auto source = GetJpegSource();
+    if (source == nullptr) {
+        return "{\"success\": false, \"message\": \"Failed to encode image\"}";
+    }
+    TimedJpegSource timed(*source);
+    auto result = vision_service_.AnalyzeImage(timed, question);
+    int64_t end_time = esp_timer_get_time();
+    if (timed.end_us > 0) {
+        stats_.upload_us = timed.end_us - timed.first_us;
+        stats_.response_us = end_time - timed.end_us;
+    }
+    if (auto stream_stats = timed.stream_stats()) {
+        // 等块池空出来的时间是在等上传，不算编码
+        stats_.encode_us = stream_stats->producer_us - stream_stats->producer_wait_us;
+        stats_.jpeg_bytes = stream_stats->bytes;
+    }
+    return result;
+}
@@ -0,0 +1,89 @@
+#ifndef FAKE_CAMERA_H
+#define FAKE_CAMERA_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "camera.h"
+#include "jpeg_stream.h"
+#include "services/private_vision_service.h"
+
+struct FakeCameraConfig {
+    int width = 640;
+    int height = 480;
+    bool jpeg = false;              // 传感器直接输出 JPEG（OV2640、OV3660），否则输出 RGB565
+    int fb_count = 2;               // 驱动预先分配的帧缓冲区个数
+    int frame_interval_ms = 66;     // 传感器出一帧的时间，Capture() 等待下一帧
+    int preview_width = 160;        // 预览宽度，设备上是屏幕宽度的一半
+};
+
+// 最近一次 Capture() 和 Explain() 各阶段的耗时
+struct FakeCameraStats {
+    uint32_t capture_us = 0;        // 等帧、取帧和生成预览
+    uint32_t encode_us = 0;         // 软件编码或上传前的缩放、重新编码
+    uint32_t upload_us = 0;         // 第一块图像交给 HTTP 到最后一块写完
+    uint32_t response_us = 0;       // 图像写完到回复读完
+    size_t jpeg_bytes = 0;
+};
+
+/*
+ * 不接传感器的 Camera：帧来自一个目录中的 JPEG 图片（没有目录时生成测试图案），按配置的分辨率和
+ * 格式模拟传感器输出，轮流提供。
+ *
+ * 帧缓冲区、预览图、JPEG 块池和上传前的缩放结果按 Esp32Camera 的方式用 heap_caps_malloc 分配在
+ * "PSRAM" 中，可以统计峰值。编解码用主机的 libjpeg 代替 esp32-camera 的转换函数，耗时只能横向比较；
+ * 预览缩放、上传前的裁剪缩小和质量调整用的是 main/ 中的 image_utils，软件编码经 main/ 中的 JpegStream
+ * 和 StreamJpegSource 边编码边上传。Explain() 经 PrivateVisionService 上传。
+ */
+class FakeCamera : public Camera {
+public:
+    FakeCamera(const FakeCameraConfig& config, const std::string& image_dir);
+    ~FakeCamera();
+
+    inline bool valid() const { return !frames_.empty(); }
+    inline int frame_count() const { return frames_.size(); }
+    inline const FakeCameraStats& stats() const { return stats_; }
+
+    virtual void SetExplainUrl(const std::string& url, const std::string& token) override;
+    virtual void SetUploadConfig(const CameraUploadConfig& config) override {
+        upload_config_ = config;
+        upload_quality_ = config.quality;
+    }
+    virtual bool Capture() override;
+    virtual bool SetHMirror(bool enabled) override { return false; }
+    virtual bool SetVFlip(bool enabled) override { return false; }
+    virtual std::string Explain(const std::string& question) override;
+    virtual bool GetJpeg(int quality, std::vector<uint8_t>& jpeg) override;
+    virtual std::unique_ptr<JpegSource> GetJpegSource() override;
+
+private:
+    FakeCameraConfig config_;
+    CameraUploadConfig upload_config_;
+    int upload_quality_ = 0;
+    PrivateVisionService vision_service_;
+
+    // 传感器"看到"的画面，已经是配置的分辨率，RGB565 大端
+    std::vector<std::vector<uint8_t>> frames_;
+    int next_frame_ = 0;
+    int64_t last_frame_time_ = 0;
+
+    std::vector<uint8_t*> frame_buffers_;
+    size_t frame_buffer_size_ = 0;
+    int current_buffer_ = 0;
+    uint8_t* fb_ = nullptr;
+    size_t fb_len_ = 0;
+
+    uint16_t* preview_ = nullptr;
+    int preview_height_ = 0;
+    std::unique_ptr<JpegStream> jpeg_stream_;   // 软件编码上传用的块池，与设备相同
+    uint8_t* upload_jpeg_ = nullptr;    // 上传前缩放、重新编码的结果
+    std::vector<uint8_t> encoded_;      // 传感器 JPEG 和预处理的编码输出，不计入 PSRAM
+    FakeCameraStats stats_;
+
+    bool LoadFrames(const std::string& image_dir);
+    void UpdatePreview();
+    bool Preprocess(const uint8_t*& jpeg, size_t& len);
+};
+
+#endif // FAKE_CAMERA_H
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+// 记录 MALLOC_CAP_SPIRAM 分配的当前值和峰值，FakeCamera 按设备上的方式分配缓冲区
+struct PsramTracker {
+    static inline std::mutex mutex;
+    static inline std::map<void*, size_t> blocks;
+    static inline size_t current = 0;
+    static inline size_t peak = 0;
+
+    static void ResetPeak() {
+        std::lock_guard<std::mutex> lock(mutex);
+        peak = current;
+    }
+};
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) {
+    void* ptr = malloc(size);
+    if (ptr != nullptr && (caps & MALLOC_CAP_SPIRAM)) {
+        std::lock_guard<std::mutex> lock(PsramTracker::mutex);
+        PsramTracker::blocks[ptr] = size;
+        PsramTracker::current += size;
+        if (PsramTracker::current > PsramTracker::peak) {
+            PsramTracker::peak = PsramTracker::current;
+        }
+    }
+    return ptr;
+}
+
+inline void heap_caps_free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(PsramTracker::mutex);
+        auto it = PsramTracker::blocks.find(ptr);
+        if (it != PsramTracker::blocks.end()) {
+            PsramTracker::current -= it->second;
+            PsramTracker::blocks.erase(it);
+        }
+    }
+    free(ptr);
+}
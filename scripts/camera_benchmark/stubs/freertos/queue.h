@@ -0,0 +1,74 @@
+#pragma once
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+
+// JpegStream 用到的 FreeRTOS 队列，按值复制定长元素，等待以毫秒为 tick
+typedef int BaseType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#ifndef portMAX_DELAY
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#endif
+
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+typedef QueueDefinition* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(size_t length, size_t item_size) {
+    auto queue = new QueueDefinition();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->items.clear();
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+template <typename Predicate>
+inline bool QueueWait(QueueHandle_t queue, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        queue->cv.wait(lock, ready);
+        return true;
+    }
+    return queue->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!QueueWait(queue, lock, ticks, [queue]() { return queue->items.size() < queue->length; })) {
+        return pdFALSE;
+    }
+    auto data = (const uint8_t*)item;
+    queue->items.emplace_back(data, data + queue->item_size);
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!QueueWait(queue, lock, ticks, [queue]() { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->cv.notify_all();
+    return pdTRUE;
+}
@@ -0,0 +1,395 @@
+// 在合成帧上测量 image_utils 中各个函数的耗时，并与逐像素的参考实现核对结果
+#include "image_utils.h"
+#include "photo_context_cache.h"
+#include "intent_classifier.h"
+#include "esp_timer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct FrameSize {
+    const char* name;
+    int width;
+    int height;
+};
+
+static const FrameSize kFrameSizes[] = {
+    {"QVGA", 320, 240},
+    {"VGA", 640, 480},
+    {"SVGA", 800, 600},
+    {"UXGA", 1600, 1200},
+};
+
+// 预览尺寸：常见屏幕宽度的一半
+static const FrameSize kPreviewSizes[] = {
+    {"120x90", 120, 90},
+    {"160x120", 160, 120},
+    {"240x180", 240, 180},
+};
+
+// 渐变加噪声，接近真实画面的分量分布，避免全零数据让结果失真
+static std::vector<uint8_t> MakeFrame(int width, int height, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> frame(width * height * 2);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int noise = rng() % 9;
+            int r = (x * 31 / width + noise / 3) & 31;
+            int g = (y * 63 / height + noise) & 63;
+            int b = ((x + y) * 31 / (width + height) + noise / 2) & 31;
+            uint16_t pixel = (r << 11) | (g << 5) | b;
+            frame[(y * width + x) * 2] = pixel >> 8;
+            frame[(y * width + x) * 2 + 1] = pixel & 0xFF;
+        }
+    }
+    return frame;
+}
+
+static double Measure(int rounds, const std::function<void()>& fn) {
+    fn();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / rounds;
+}
+
+// 吞吐按输出像素计算，缩放函数只读取被采样到的源像素
+static void Report(const std::string& name, double us, size_t pixels) {
+    printf("%-44s %10.1f us  %8.1f Mpix/s\n", name.c_str(), us, pixels / us);
+}
+
+// 参考实现：逐像素、浮点坐标，只用来核对结果
+static uint16_t ReferencePixel(const uint8_t* src, int width, int x, int y) {
+    return (src[(y * width + x) * 2] << 8) | src[(y * width + x) * 2 + 1];
+}
+
+static void Unrotate(int x, int y, int width, int height, ImageRotation rotation, int& ux, int& uy) {
+    switch (rotation) {
+        case kImageRotate0: ux = x; uy = y; break;
+        case kImageRotate90: ux = y; uy = height - 1 - x; break;
+        case kImageRotate180: ux = width - 1 - x; uy = height - 1 - y; break;
+        case kImageRotate270: ux = width - 1 - y; uy = x; break;
+    }
+}
+
+static int CheckNearest(const std::vector<uint8_t>& src, int src_width, int src_height, int width, int height, ImageRotation rotation) {
+    std::vector<uint16_t> dst(width * height);
+    Rgb565ScaleNearest(src.data(), src_width, src_height, dst.data(), width, height, rotation);
+    bool swapped = rotation == kImageRotate90 || rotation == kImageRotate270;
+    int unrotated_width = swapped ? height : width;
+    int unrotated_height = swapped ? width : height;
+    int errors = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int ux, uy;
+            Unrotate(x, y, unrotated_width, unrotated_height, rotation, ux, uy);
+            int sx = (int)((ux + 0.5) * src_width / unrotated_width);
+            int sy = (int)((uy + 0.5) * src_height / unrotated_height);
+            if (dst[y * width + x] != ReferencePixel(src.data(), src_width, sx, sy)) {
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+// 双线性用 5 位定点权重并逐级舍入，每个分量允许 1 加上相邻像素差值 1/32 的误差
+static int CheckBilinear(const std::vector<uint8_t>& src, int src_width, int src_height, int width, int height, ImageRotation rotation) {
+    std::vector<uint16_t> dst(width * height);
+    Rgb565ScaleBilinear(src.data(), src_width, src_height, dst.data(), width, height, rotation);
+    bool swapped = rotation == kImageRotate90 || rotation == kImageRotate270;
+    int unrotated_width = swapped ? height : width;
+    int unrotated_height = swapped ? width : height;
+    int errors = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int ux, uy;
+            Unrotate(x, y, unrotated_width, unrotated_height, rotation, ux, uy);
+            double fx = std::max(0.0, (ux + 0.5) * src_width / unrotated_width - 0.5);
+            double fy = std::max(0.0, (uy + 0.5) * src_height / unrotated_height - 0.5);
+            int x0 = std::min((int)fx, src_width - 1), y0 = std::min((int)fy, src_height - 1);
+            int x1 = std::min(x0 + 1, src_width - 1), y1 = std::min(y0 + 1, src_height - 1);
+            double wx = x0 == x1 ? 0 : fx - x0, wy = y0 == y1 ? 0 : fy - y0;
+            uint16_t p00 = ReferencePixel(src.data(), src_width, x0, y0), p01 = ReferencePixel(src.data(), src_width, x1, y0);
+            uint16_t p10 = ReferencePixel(src.data(), src_width, x0, y1), p11 = ReferencePixel(src.data(), src_width, x1, y1);
+            uint16_t out = dst[y * width + x];
+            const int shifts[] = {11, 5, 0};
+            const int masks[] = {31, 63, 31};
+            for (int c = 0; c < 3; c++) {
+                auto channel = [&](uint16_t p) { return (double)((p >> shifts[c]) & masks[c]); };
+                double top = channel(p00) * (1 - wx) + channel(p01) * wx;
+                double bottom = channel(p10) * (1 - wx) + channel(p11) * wx;
+                double expected = top * (1 - wy) + bottom * wy;
+                double range = std::max({channel(p00), channel(p01), channel(p10), channel(p11)}) -
+                    std::min({channel(p00), channel(p01), channel(p10), channel(p11)});
+                if (std::abs(((out >> shifts[c]) & masks[c]) - expected) > 1 + range / 32) {
+                    errors++;
+                    break;
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+// 分批送入的缩小与整帧的 Rgb565DownscaleArea 做的是同一个区域平均，结果应逐像素相同（字节序不同）。
+// 每批行数覆盖 JPEG 解码器的 MCU 行高（8、16）、1 行和不整除源高度的情况，最后一批可以不满
+static int CheckBandDownscaler(const std::vector<uint8_t>& src, int src_width, int src_height, int width, int height, int band) {
+    std::vector<uint8_t> expected(width * height * 2);
+    Rgb565DownscaleArea(src.data(), src_width, 0, 0, src_width, src_height, expected.data(), width, height);
+
+    std::vector<uint16_t> native(src_width * src_height);
+    Rgb565SwapBytes(src.data(), (uint8_t*)native.data(), native.size());
+    std::vector<uint16_t> dst(width * height, 0);
+    Rgb565BandDownscaler downscaler;
+    if (!downscaler.Begin(src_width, src_height, dst.data(), width, height)) {
+        return 1;
+    }
+    for (int y = 0; y < src_height; y += band) {
+        downscaler.Push(native.data() + (size_t)y * src_width, std::min(band, src_height - y));
+    }
+    int errors = downscaler.done() ? 0 : 1;
+    for (int i = 0; i < width * height; i++) {
+        if (dst[i] != ((expected[i * 2] << 8) | expected[i * 2 + 1])) {
+            errors++;
+        }
+    }
+    return errors;
+}
+
+// 亮度渐变上叠几个随机矩形，像一个有物体的场景
+static std::vector<uint8_t> MakeScene(int width, int height, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> luma(width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            luma[y * width + x] = 40 + x * 120 / width + y * 60 / height;
+        }
+    }
+    for (int i = 0; i < 12; i++) {
+        int x0 = rng() % width, y0 = rng() % height;
+        int x1 = std::min(width, x0 + 8 + (int)(rng() % (width / 3))), y1 = std::min(height, y0 + 8 + (int)(rng() % (height / 3)));
+        uint8_t value = rng() % 256;
+        for (int y = y0; y < y1; y++) {
+            std::fill(luma.begin() + y * width + x0, luma.begin() + y * width + x1, value);
+        }
+    }
+    return luma;
+}
+
+// 同一场景曝光变化、轻微移动后哈希只差几位，不同场景相差很多位
+static int CheckDifferenceHash() {
+    const int width = 160, height = 120;
+    int errors = 0;
+    auto check = [&errors](bool ok, const char* what) {
+        if (!ok) {
+            printf("LumaDifferenceHash: %s\n", what);
+            errors++;
+        }
+    };
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+        auto scene = MakeScene(width, height, seed);
+        uint64_t hash = LumaDifferenceHash(scene.data(), width, height);
+        check(hash == LumaDifferenceHash(scene.data(), width, height), "not deterministic");
+
+        auto darker = scene;
+        for (auto& value : darker) {
+            value = value * 4 / 5;
+        }
+        check(HashDistance(hash, LumaDifferenceHash(darker.data(), width, height)) <= PHOTO_CONTEXT_MAX_DISTANCE,
+            "exposure change moved the hash too far");
+
+        std::vector<uint8_t> shifted(scene.size());
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                shifted[y * width + x] = scene[y * width + std::max(0, x - 2)];
+            }
+        }
+        check(HashDistance(hash, LumaDifferenceHash(shifted.data(), width, height)) <= PHOTO_CONTEXT_MAX_DISTANCE,
+            "2 pixel shift moved the hash too far");
+
+        auto other = MakeScene(width, height, seed + 1000);
+        check(HashDistance(hash, LumaDifferenceHash(other.data(), width, height)) > PHOTO_CONTEXT_MAX_DISTANCE,
+            "different scenes hash too close");
+    }
+    auto scene = MakeScene(width, height, 1);
+    check(LumaDifferenceHash(scene.data(), 8, 8) == 0, "plane smaller than 9x8 must give 0");
+    return errors;
+}
+
+// 有效期、容量淘汰、同一场景替换和拍摄时间的判断，时间用 stubs 中的假时钟
+static int CheckPhotoContextCache() {
+    const int64_t ms = 1000;
+    int errors = 0;
+    auto check = [&errors](bool ok, const char* what) {
+        if (!ok) {
+            printf("PhotoContextCache: %s\n", what);
+            errors++;
+        }
+    };
+    const uint64_t h1 = 0x0123456789ABCDEFULL, h2 = ~h1, h3 = 0xFFFFFFFF00000000ULL;
+    int distance = -1;
+
+    fake_time_us = 0;
+    PhotoContextCache cache(2, 1000, PHOTO_CONTEXT_MAX_DISTANCE);
+    cache.Add(h1, "a1", "q", 0);
+    fake_time_us = 100 * ms;
+    auto context = cache.Find(h1 ^ 0x7, fake_time_us, &distance);
+    check(context != nullptr && context->analysis == "a1" && distance == 3, "near hash not found");
+    check(cache.Find(h2, fake_time_us) == nullptr, "far hash matched");
+    check(cache.Find(h1, -1) == nullptr, "result newer than the photo reused");
+    fake_time_us = 1001 * ms;
+    check(cache.Find(h1, fake_time_us) == nullptr, "expired result reused");
+
+    // 容量 2，第三条挤掉最早的一条
+    cache.Clear();
+    cache.Add(h1, "a1", "q", fake_time_us);
+    cache.Add(h2, "a2", "q", fake_time_us + 10 * ms);
+    cache.Add(h3, "a3", "q", fake_time_us + 20 * ms);
+    fake_time_us += 30 * ms;
+    check(cache.Find(h1, fake_time_us) == nullptr, "oldest entry not evicted");
+    check(cache.Find(h2, fake_time_us) != nullptr && cache.Find(h3, fake_time_us) != nullptr, "newer entries evicted");
+
+    // 同一场景替换旧结果，不占新的位置
+    cache.Add(h2 ^ 0x1, "a2 again", "q", fake_time_us);
+    context = cache.Find(h2, fake_time_us);
+    check(context != nullptr && context->analysis == "a2 again", "same scene not replaced");
+    check(cache.Find(h3, fake_time_us) != nullptr, "replacement evicted another scene");
+
+    // 拍摄较早、识图较晚完成的结果按拍摄时间过期
+    cache.Clear();
+    fake_time_us = 10000 * ms;
+    cache.Add(h1, "late", "q", fake_time_us);
+    cache.Add(h2, "early", "q", fake_time_us - 500 * ms);
+    fake_time_us += 700 * ms;
+    check(cache.Find(h2, fake_time_us) == nullptr, "result expired by capture time reused");
+    check(cache.Find(h1, fake_time_us) != nullptr, "valid result dropped");
+    return errors;
+}
+
+// 中间结果上的拍照置信度：明确的说法提前拍照，只沾边的不拍，否定一律为 0
+static int CheckPhotoIntentConfidence() {
+    int errors = 0;
+    auto check = [&errors](bool ok, const char* what, std::string_view text) {
+        if (!ok) {
+            printf("PhotoIntentConfidence: %s \"%.*s\" (%.2f)\n", what, (int)text.size(), text.data(),
+                PhotoIntentConfidence(text));
+            errors++;
+        }
+    };
+    for (std::string_view text : {"拍照", "帮我拍张照片", "帮我拍一张", "拍个照看看这是什么"}) {
+        check(PhotoIntentConfidence(text) >= PHOTO_SPECULATION_CONFIDENCE, "photo request below the threshold", text);
+    }
+    for (std::string_view text : {"帮我拍", "这是什么", "帮我看看前面", "识别一下"}) {
+        check(PhotoIntentConfidence(text) < PHOTO_SPECULATION_CONFIDENCE, "weak hint reached the threshold", text);
+    }
+    for (std::string_view text : {"", "今天天气怎么样", "给我讲个笑话"}) {
+        check(PhotoIntentConfidence(text) == 0.0f, "no keyword but not 0", text);
+    }
+    for (std::string_view text : {"不要拍照", "别拍照片了", "不用拍", "取消拍照"}) {
+        check(PhotoIntentConfidence(text) == 0.0f, "negation not 0", text);
+    }
+    // 中间结果逐字变长，多命中一个词置信度不会下降
+    const std::string_view growing[] = {"帮", "帮我", "帮我拍", "帮我拍一张", "帮我拍一张照片"};
+    for (size_t i = 1; i < std::size(growing); i++) {
+        check(PhotoIntentConfidence(growing[i]) >= PhotoIntentConfidence(growing[i - 1]), "dropped as the text grew",
+            growing[i]);
+    }
+    std::string_view everything = "拍照拍一张拍张拍个照片相片看看这帮我看看一下这是什么识别镜头摄像头前面桌上";
+    float confidence = PhotoIntentConfidence(everything);
+    check(confidence > 0.0f && confidence <= 1.0f, "out of range", everything);
+    return errors;
+}
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 50;
+    const char* rotation_names[] = {"0", "90", "180", "270"};
+
+    int errors = 0;
+    for (int i = 0; i < 20; i++) {
+        int src_width = 16 + rand() % 200, src_height = 16 + rand() % 200;
+        int width = 1 + rand() % 300, height = 1 + rand() % 300;
+        auto frame = MakeFrame(src_width, src_height, i);
+        for (int r = 0; r < 4; r++) {
+            errors += CheckNearest(frame, src_width, src_height, width, height, (ImageRotation)r);
+            errors += CheckBilinear(frame, src_width, src_height, width, height, (ImageRotation)r);
+        }
+    }
+    // 奇数尺寸和不整除的缩小比例
+    const int bands[] = {1, 7, 8, 16, 33, 4096};
+    for (int i = 0; i < 20; i++) {
+        int src_width = 9 + rand() % 200, src_height = 9 + rand() % 200;
+        int width = 1 + rand() % src_width, height = 1 + rand() % src_height;
+        auto frame = MakeFrame(src_width, src_height, 100 + i);
+        for (int band : bands) {
+            errors += CheckBandDownscaler(frame, src_width, src_height, width, height, band);
+        }
+    }
+    errors += CheckBandDownscaler(MakeFrame(1599, 1199, 7), 1599, 1199, 333, 251, 16);
+    errors += CheckDifferenceHash();
+    errors += CheckPhotoContextCache();
+    errors += CheckPhotoIntentConfidence();
+    printf("Self check: %s (%d mismatches)\n\n", errors == 0 ? "OK" : "FAILED", errors);
+
+    for (const auto& size : kFrameSizes) {
+        size_t pixels = size.width * size.height;
+        auto frame = MakeFrame(size.width, size.height, 1);
+        std::vector<uint8_t> out(pixels * 2);
+        printf("== %s %dx%d, %d rounds\n", size.name, size.width, size.height, rounds);
+
+        Report("Rgb565SwapBytes", Measure(rounds, [&]() {
+            Rgb565SwapBytes(frame.data(), out.data(), pixels);
+        }), pixels);
+
+        for (const auto& preview : kPreviewSizes) {
+            std::vector<uint16_t> dst(preview.width * preview.height);
+            for (int r = 0; r < 4; r++) {
+                bool swapped = r == kImageRotate90 || r == kImageRotate270;
+                int width = swapped ? preview.height : preview.width;
+                int height = swapped ? preview.width : preview.height;
+                std::string suffix = std::string(" -> ") + preview.name + " rot " + rotation_names[r];
+                Report("Rgb565ScaleNearest" + suffix, Measure(rounds, [&]() {
+                    Rgb565ScaleNearest(frame.data(), size.width, size.height, dst.data(), width, height, (ImageRotation)r);
+                }), dst.size());
+                Report("Rgb565ScaleBilinear" + suffix, Measure(rounds, [&]() {
+                    Rgb565ScaleBilinear(frame.data(), size.width, size.height, dst.data(), width, height, (ImageRotation)r);
+                }), dst.size());
+            }
+        }
+
+        std::vector<uint8_t> scaled(pixels);
+        Report("Rgb565DownscaleArea 1/2", Measure(rounds, [&]() {
+            Rgb565DownscaleArea(frame.data(), size.width, 0, 0, size.width, size.height,
+                scaled.data(), size.width / 2, size.height / 2);
+        }), pixels);
+        std::vector<uint16_t> native(pixels);
+        Rgb565SwapBytes(frame.data(), (uint8_t*)native.data(), pixels);
+        Report("Rgb565BandDownscaler 1/2, 16 row bands", Measure(rounds, [&]() {
+            Rgb565BandDownscaler downscaler;
+            downscaler.Begin(size.width, size.height, (uint16_t*)scaled.data(), size.width / 2, size.height / 2);
+            for (int y = 0; y < size.height; y += 16) {
+                downscaler.Push(native.data() + (size_t)y * size.width, std::min(16, size.height - y));
+            }
+        }), pixels);
+        std::vector<uint8_t> luma(pixels);
+        int step = (size.width + 159) / 160;
+        Report("Rgb565ToLuma + LaplacianVariance", Measure(rounds, [&]() {
+            Rgb565ToLuma(frame.data(), size.width, size.height, step, luma.data());
+            volatile uint32_t sharpness = LaplacianVariance(luma.data(), size.width / step, size.height / step);
+            (void)sharpness;
+        }), pixels);
+        printf("\n");
+    }
+    return errors == 0 ? 0 : 1;
+}
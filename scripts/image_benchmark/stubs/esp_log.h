@@ -0,0 +1,6 @@
+#pragma once
+
+// 自检只看结果，日志丢弃
+#define ESP_LOGI(tag, format, ...) ((void)(tag))
+#define ESP_LOGW(tag, format, ...) ((void)(tag))
+#define ESP_LOGE(tag, format, ...) ((void)(tag))
@@ -0,0 +1,167 @@
+/*
+ * JsonReader vs cJSON on recorded control messages
+ *
+ * Both paths do what the firmware does with an incoming message: look up `type`,
+ * and for MCP messages the JSON-RPC method, id and the tool arguments.
+ * Heap traffic is counted through cJSON_InitHooks() and a replaced operator new.
+ */
+
+#include "json_reader.h"
+
+#include <cJSON.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+static size_t g_alloc_count = 0;
+static size_t g_alloc_bytes = 0;
+
+void* operator new(size_t size) {
+    g_alloc_count++;
+    g_alloc_bytes += size;
+    void* p = malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static void* CountingMalloc(size_t size) {
+    g_alloc_count++;
+    g_alloc_bytes += size;
+    return malloc(size);
+}
+
+// Keep results alive so the compiler cannot drop the lookups
+static volatile int g_sink = 0;
+
+static void DispatchWithCJson(const std::string& message) {
+    cJSON* root = cJSON_Parse(message.c_str());
+    if (root == nullptr) {
+        return;
+    }
+    auto type = cJSON_GetObjectItem(root, "type");
+    if (cJSON_IsString(type)) {
+        if (strcmp(type->valuestring, "mcp") == 0) {
+            auto payload = cJSON_GetObjectItem(root, "payload");
+            auto method = cJSON_GetObjectItem(payload, "method");
+            auto id = cJSON_GetObjectItem(payload, "id");
+            if (cJSON_IsString(method) && strncmp(method->valuestring, "notifications", 13) != 0) {
+                auto params = cJSON_GetObjectItem(payload, "params");
+                auto arguments = cJSON_GetObjectItem(params, "arguments");
+                cJSON* item = nullptr;
+                cJSON_ArrayForEach(item, arguments) {
+                    g_sink += cJSON_IsString(item) ? (int)strlen(item->valuestring) : item->valueint;
+                }
+                g_sink += cJSON_IsNumber(id) ? id->valueint : 0;
+            }
+        } else if (strcmp(type->valuestring, "tts") == 0) {
+            auto state = cJSON_GetObjectItem(root, "state");
+            g_sink += cJSON_IsString(state) ? state->valuestring[0] : 0;
+        } else {
+            auto text = cJSON_GetObjectItem(root, "text");
+            g_sink += cJSON_IsString(text) ? (int)strlen(text->valuestring) : 0;
+        }
+    }
+    cJSON_Delete(root);
+}
+
+static void DispatchWithReader(const std::string& message) {
+    JsonReader root(message);
+    auto type = root["type"];
+    if (!type.IsString()) {
+        return;
+    }
+    if (type.Equals("mcp")) {
+        auto payload = root["payload"];
+        auto method = payload["method"];
+        auto id = payload["id"];
+        if (method.IsString() && !method.StartsWith("notifications")) {
+            payload["params"]["arguments"].ForEachMember([](std::string_view, const JsonReader& value) {
+                g_sink += value.IsString() ? (int)value.GetString().size() : value.GetInt();
+                return true;
+            });
+            g_sink += id.GetInt();
+        }
+    } else if (type.Equals("tts")) {
+        auto state = root["state"];
+        g_sink += state.IsString() ? state.raw()[1] : 0;
+    } else {
+        auto text = root["text"];
+        g_sink += text.IsString() ? (int)text.GetString().size() : 0;
+    }
+}
+
+struct Result {
+    double ns_per_message;
+    double allocs_per_message;
+    double bytes_per_message;
+};
+
+template<typename Dispatch>
+static Result Run(const std::vector<std::string>& messages, int iterations, Dispatch dispatch) {
+    // Warm up caches and the allocator
+    for (auto& message : messages) {
+        dispatch(message);
+    }
+
+    g_alloc_count = 0;
+    g_alloc_bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (auto& message : messages) {
+            dispatch(message);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    double count = (double)iterations * messages.size();
+    return {
+        std::chrono::duration<double, std::nano>(elapsed).count() / count,
+        g_alloc_count / count,
+        g_alloc_bytes / count,
+    };
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "messages.jsonl";
+    int iterations = argc > 2 ? atoi(argv[2]) : 20000;
+
+    std::vector<std::string> messages;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            messages.push_back(line);
+        }
+    }
+    if (messages.empty()) {
+        fprintf(stderr, "No messages in %s\n", path);
+        return 1;
+    }
+
+    cJSON_Hooks hooks = { CountingMalloc, free };
+    cJSON_InitHooks(&hooks);
+
+    auto cjson = Run(messages, iterations, DispatchWithCJson);
+    auto reader = Run(messages, iterations, DispatchWithReader);
+
+    printf("%zu messages x %d iterations\n", messages.size(), iterations);
+    printf("%-12s %12s %12s %12s\n", "parser", "ns/msg", "allocs/msg", "bytes/msg");
+    printf("%-12s %12.1f %12.2f %12.1f\n", "cJSON", cjson.ns_per_message, cjson.allocs_per_message, cjson.bytes_per_message);
+    printf("%-12s %12.1f %12.2f %12.1f\n", "JsonReader", reader.ns_per_message, reader.allocs_per_message, reader.bytes_per_message);
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * JsonWriter vs string concatenation vs cJSON for outgoing messages
+ *
+ * Builds the same listen / mcp / hello messages the protocol sends and reports
+ * time and heap allocations per message for each way of producing them.
+ */
+
+#include "json_writer.h"
+
+#include <cJSON.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+static size_t g_alloc_count = 0;
+
+void* operator new(size_t size) {
+    g_alloc_count++;
+    void* p = malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static void* CountingMalloc(size_t size) {
+    g_alloc_count++;
+    return malloc(size);
+}
+
+static const std::string kSessionId = "7b1c5e0a-3f4e-4c1d-9a7e-2d5b8c9f0a11";
+static const std::string kWakeWord = "你好小智";
+static const std::string kMcpResult = "{\"content\":[{\"type\":\"text\",\"text\":\"true\"}],\"isError\":false}";
+static volatile size_t g_sink = 0;
+
+static void BuildWithConcat() {
+    std::string listen = "{\"session_id\":\"" + kSessionId +
+                         "\",\"type\":\"listen\",\"state\":\"detect\",\"text\":\"" + kWakeWord + "\"}";
+    std::string reply = "{\"jsonrpc\":\"2.0\",\"id\":";
+    reply += std::to_string(42) + ",\"result\":";
+    reply += kMcpResult;
+    reply += "}";
+    std::string mcp = "{\"session_id\":\"" + kSessionId + "\",\"type\":\"mcp\",\"payload\":" + reply + "}";
+    std::string hello = "{\"type\":\"hello\",\"version\":" + std::to_string(3) +
+                        ",\"transport\":\"websocket\",\"audio_params\":{\"format\":\"opus\",\"sample_rate\":" +
+                        std::to_string(16000) + ",\"channels\":" + std::to_string(1) +
+                        ",\"frame_duration\":" + std::to_string(60) + "}}";
+    g_sink += listen.size() + mcp.size() + hello.size();
+}
+
+static void BuildWithCJson() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "session_id", kSessionId.c_str());
+    cJSON_AddStringToObject(root, "type", "listen");
+    cJSON_AddStringToObject(root, "state", "detect");
+    cJSON_AddStringToObject(root, "text", kWakeWord.c_str());
+    char* listen = cJSON_PrintUnformatted(root);
+    g_sink += listen != nullptr;
+    cJSON_free(listen);
+    cJSON_Delete(root);
+
+    cJSON* hello = cJSON_CreateObject();
+    cJSON_AddStringToObject(hello, "type", "hello");
+    cJSON_AddNumberToObject(hello, "version", 3);
+    cJSON_AddStringToObject(hello, "transport", "websocket");
+    cJSON* audio_params = cJSON_CreateObject();
+    cJSON_AddStringToObject(audio_params, "format", "opus");
+    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
+    cJSON_AddNumberToObject(audio_params, "channels", 1);
+    cJSON_AddNumberToObject(audio_params, "frame_duration", 60);
+    cJSON_AddItemToObject(hello, "audio_params", audio_params);
+    char* text = cJSON_PrintUnformatted(hello);
+    g_sink += text != nullptr;
+    cJSON_free(text);
+    cJSON_Delete(hello);
+}
+
+static void BuildWithWriter() {
+    char buffer[512];
+    JsonWriter listen(buffer, sizeof(buffer));
+    listen.BeginObject();
+    listen.Field("session_id", kSessionId);
+    listen.Field("type", "listen");
+    listen.Field("state", "detect");
+    listen.Field("text", kWakeWord);
+    listen.EndObject();
+    g_sink += listen.size();
+
+    JsonWriter hello(buffer, sizeof(buffer));
+    hello.BeginObject();
+    hello.Field("type", "hello");
+    hello.Field("version", 3);
+    hello.Field("transport", "websocket");
+    hello.Key("audio_params");
+    hello.BeginObject();
+    hello.Field("format", "opus");
+    hello.Field("sample_rate", 16000);
+    hello.Field("channels", 1);
+    hello.Field("frame_duration", 60);
+    hello.EndObject();
+    hello.EndObject();
+    g_sink += hello.size();
+
+    JsonWriter mcp(buffer, sizeof(buffer));
+    mcp.BeginObject();
+    mcp.Field("session_id", kSessionId);
+    mcp.Field("type", "mcp");
+    mcp.Key("payload");
+    mcp.BeginObject();
+    mcp.Field("jsonrpc", "2.0");
+    mcp.Field("id", 42);
+    mcp.Key("result");
+    mcp.Raw(kMcpResult);
+    mcp.EndObject();
+    mcp.EndObject();
+    g_sink += mcp.size();
+}
+
+template<typename Build>
+static void Run(const char* name, int iterations, Build build) {
+    build();
+    g_alloc_count = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        build();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-12s %12.1f %12.2f\n", name,
+        std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+        (double)g_alloc_count / iterations);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+
+    cJSON_Hooks hooks = { CountingMalloc, free };
+    cJSON_InitHooks(&hooks);
+
+    printf("%-12s %12s %12s\n", "builder", "ns/round", "allocs/round");
+    Run("concat", iterations, BuildWithConcat);
+    Run("cJSON", iterations, BuildWithCJson);
+    Run("JsonWriter", iterations, BuildWithWriter);
+    return 0;
+}
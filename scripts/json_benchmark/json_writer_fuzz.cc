@@ -0,0 +1,198 @@
+/*
+ * Fuzz JsonWriter against JsonReader
+ *
+ * The input drives a sequence of writer calls (containers, keys, strings, numbers).
+ * Whatever the writer produces must be valid JSON and every string must decode back
+ * to the exact bytes that were written. A fixed buffer writer must either match the
+ * std::string writer byte for byte or report overflow.
+ *
+ * With clang the target links against libFuzzer, otherwise it runs random inputs.
+ */
+
+#include "json_reader.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#define FUZZ_CHECK(cond) do { if (!(cond)) { fprintf(stderr, "check failed: %s\n", #cond); abort(); } } while (0)
+
+class Input {
+public:
+    Input(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+    bool empty() const { return pos_ >= size_; }
+    uint8_t Byte() { return pos_ < size_ ? data_[pos_++] : 0; }
+    std::string Bytes() {
+        size_t length = Byte() % 24;
+        std::string s;
+        while (length-- > 0 && !empty()) {
+            s.push_back((char)Byte());
+        }
+        return s;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+struct Writers {
+    std::string output;
+    JsonWriter dynamic{output};
+    char buffer[256];
+    JsonWriter fixed{buffer, sizeof(buffer)};
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    Input input(data, size);
+    Writers w;
+    std::vector<char> stack;   // '{' or '['
+    std::vector<std::string> strings;
+
+    w.dynamic.BeginArray();
+    w.fixed.BeginArray();
+    stack.push_back('[');
+    while (!input.empty() && stack.size() < 16) {
+        bool in_object = stack.back() == '{';
+        if (in_object) {
+            auto key = input.Bytes();
+            w.dynamic.Key(key);
+            w.fixed.Key(key);
+            strings.push_back(key);
+        }
+        switch (input.Byte() % 7) {
+            case 0:
+                w.dynamic.BeginObject();
+                w.fixed.BeginObject();
+                stack.push_back('{');
+                break;
+            case 1:
+                w.dynamic.BeginArray();
+                w.fixed.BeginArray();
+                stack.push_back('[');
+                break;
+            case 2: {
+                auto s = input.Bytes();
+                w.dynamic.String(s);
+                w.fixed.String(s);
+                strings.push_back(s);
+                break;
+            }
+            case 3: {
+                int64_t value = 0;
+                for (int i = 0; i < 8; i++) {
+                    value = (value << 8) | input.Byte();
+                }
+                w.dynamic.Int(value);
+                w.fixed.Int(value);
+                break;
+            }
+            case 4: {
+                bool value = input.Byte() & 1;
+                w.dynamic.Bool(value);
+                w.fixed.Bool(value);
+                break;
+            }
+            case 5:
+                w.dynamic.Null();
+                w.fixed.Null();
+                break;
+            default:
+                if (stack.size() > 1) {
+                    if (in_object) {
+                        w.dynamic.Null();
+                        w.fixed.Null();
+                    }
+                    if (stack.back() == '{') {
+                        w.dynamic.EndObject();
+                        w.fixed.EndObject();
+                    } else {
+                        w.dynamic.EndArray();
+                        w.fixed.EndArray();
+                    }
+                    stack.pop_back();
+                } else if (in_object) {
+                    w.dynamic.Null();
+                    w.fixed.Null();
+                }
+                break;
+        }
+    }
+    while (!stack.empty()) {
+        if (stack.back() == '{') {
+            w.dynamic.EndObject();
+        } else {
+            w.dynamic.EndArray();
+        }
+        stack.pop_back();
+    }
+
+    JsonReader reader(w.dynamic.view());
+    FUZZ_CHECK(reader.IsArray());
+    if (w.fixed.ok()) {
+        FUZZ_CHECK(w.output.compare(0, w.fixed.size(), w.fixed.view()) == 0);
+    }
+
+    // Every written string decodes back to its original bytes
+    std::string escaped;
+    for (auto& s : strings) {
+        escaped.clear();
+        JsonWriter::Escape(s, escaped);
+        std::string decoded;
+        FUZZ_CHECK(JsonReader::DecodeString(escaped, decoded));
+        FUZZ_CHECK(decoded == s);
+        FUZZ_CHECK(w.output.find("\"" + escaped + "\"") != std::string::npos);
+    }
+    return 0;
+}
+
+// Containers nested past JSON_WRITER_MAX_DEPTH are dropped together with their closers,
+// the writer must come back to the right depth for what follows
+static void CheckDepthOverflow() {
+    std::string output;
+    JsonWriter writer(output);
+    writer.BeginObject();
+    writer.Key("a");
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH + 8; i++) {
+        writer.BeginArray();
+    }
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH + 8; i++) {
+        writer.EndArray();
+    }
+    writer.Field("b", 1);
+    writer.EndObject();
+    FUZZ_CHECK(!writer.ok());
+    FUZZ_CHECK(std::count(output.begin(), output.end(), '[') == std::count(output.begin(), output.end(), ']'));
+    FUZZ_CHECK(output.compare(0, 5, "{\"a\":") == 0);
+    FUZZ_CHECK(output.size() > 7 && output.compare(output.size() - 7, 7, ",\"b\":1}") == 0);
+}
+
+#ifdef JSON_FUZZ_LIBFUZZER
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {
+    CheckDepthOverflow();
+    return 0;
+}
+#else
+int main(int argc, char** argv) {
+    CheckDepthOverflow();
+    int runs = argc > 1 ? atoi(argv[1]) : 100000;
+    std::mt19937 rng(argc > 2 ? atoi(argv[2]) : 1);
+    std::vector<uint8_t> data;
+    for (int i = 0; i < runs; i++) {
+        data.resize(rng() % 512);
+        for (auto& b : data) {
+            b = (uint8_t)rng();
+        }
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    printf("%d runs ok\n", runs);
+    return 0;
+}
+#endif
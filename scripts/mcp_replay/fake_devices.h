@@ -0,0 +1,113 @@
+#ifndef FAKE_DEVICES_H
+#define FAKE_DEVICES_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+#include "camera.h"
+#include "mcp_server.h"
+
+// 模拟外设的耗时都乘以这个系数，0 表示不等待
+inline double g_fake_delay_scale = 1.0;
+
+inline void FakeDelay(int ms) {
+    if (g_fake_delay_scale > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(ms * 1000 * g_fake_delay_scale)));
+    }
+}
+
+// 拍照和识图的耗时取自 ESP32-S3 + OV2640 上的典型值
+class FakeCamera : public Camera {
+public:
+    void SetExplainUrl(const std::string& url, const std::string& token) override {}
+    bool Capture() override {
+        FakeDelay(120);
+        return true;
+    }
+    bool SetHMirror(bool enabled) override { return true; }
+    bool SetVFlip(bool enabled) override { return true; }
+    std::string Explain(const std::string& question) override {
+        FakeDelay(1500);
+        return "{\"success\": true, \"text\": \"A desk with a cup on it\"}";
+    }
+    bool GetJpeg(int quality, std::vector<uint8_t>& jpeg) override {
+        FakeDelay(40);
+        jpeg.assign(12 * 1024, 0x5A);
+        return true;
+    }
+};
+
+/*
+ * Registers the tools of boards/otto-robot/otto_controller.cc with the same names, arguments
+ * and serial groups. Like the real controller a movement only queues an action and returns,
+ * the action itself takes steps * speed of simulated servo time on a separate thread.
+ */
+class FakeOttoController {
+public:
+    FakeOttoController() {
+        AddMovement("self.otto.walk_forward", PropertyList({
+            Property("steps", kPropertyTypeInteger, 3, 1, 100),
+            Property("speed", kPropertyTypeInteger, 1000, 500, 1500),
+            Property("arm_swing", kPropertyTypeInteger, 50, 0, 170),
+            Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+        AddMovement("self.otto.turn_left", PropertyList({
+            Property("steps", kPropertyTypeInteger, 3, 1, 100),
+            Property("speed", kPropertyTypeInteger, 1000, 500, 1500),
+            Property("arm_swing", kPropertyTypeInteger, 50, 0, 170),
+            Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+        AddMovement("self.otto.jump", PropertyList({
+            Property("steps", kPropertyTypeInteger, 1, 1, 100),
+            Property("speed", kPropertyTypeInteger, 1000, 500, 1500)}));
+        AddMovement("self.otto.swing", PropertyList({
+            Property("steps", kPropertyTypeInteger, 3, 1, 100),
+            Property("speed", kPropertyTypeInteger, 1000, 500, 1500),
+            Property("amount", kPropertyTypeInteger, 30, 0, 170)}));
+        AddMovement("self.otto.moonwalk", PropertyList({
+            Property("steps", kPropertyTypeInteger, 3, 1, 100),
+            Property("speed", kPropertyTypeInteger, 1000, 500, 1500),
+            Property("direction", kPropertyTypeInteger, 1, -1, 1),
+            Property("amount", kPropertyTypeInteger, 25, 0, 170)}));
+
+        auto& mcp_server = McpServer::GetInstance();
+        mcp_server.AddTool("self.otto.stop", "立即停止", PropertyList(),
+            [this](const PropertyList& properties) -> ReturnValue {
+                moving_until_us_ = 0;
+                return true;
+            });
+        mcp_server.AddTool("self.otto.get_trims", "获取当前的舵机微调设置", PropertyList(),
+            [](const PropertyList& properties) -> ReturnValue {
+                return "{\"left_leg\":0,\"right_leg\":0,\"left_foot\":0,\"right_foot\":0,\"left_hand\":0,\"right_hand\":0}";
+            });
+        mcp_server.AddTool("self.otto.get_status", "获取机器人状态，返回 moving 或 idle", PropertyList(),
+            [this](const PropertyList& properties) -> ReturnValue {
+                return esp_timer_get_time() < moving_until_us_ ? "moving" : "idle";
+            });
+
+        // 与 otto_controller.cc 相同的串行分组
+        mcp_server.SetToolSerialGroup("self.otto.", "servo");
+        mcp_server.SetToolSerialGroup("self.otto.stop", "");
+        mcp_server.SetToolSerialGroup("self.otto.get_trims", "");
+        mcp_server.SetToolSerialGroup("self.otto.get_status", "");
+    }
+
+private:
+    std::atomic<int64_t> moving_until_us_ = 0;
+
+    void AddMovement(const char* name, const PropertyList& properties) {
+        McpServer::GetInstance().AddTool(name, name, properties,
+            [this](const PropertyList& properties) -> ReturnValue {
+                int steps = properties["steps"].value<int>();
+                int speed = properties["speed"].value<int>();
+                // 动作排队后立即返回，舵机在后台运动
+                int64_t duration_us = (int64_t)(steps * speed * 1000 * g_fake_delay_scale);
+                moving_until_us_ = std::max<int64_t>(moving_until_us_, esp_timer_get_time()) + duration_us;
+                return true;
+            });
+    }
+};
+
+#endif // FAKE_DEVICES_H
@@ -0,0 +1,323 @@
+/*
+ * Replays MCP traffic recorded on a device (CONFIG_USE_MCP_RECORDER) through
+ * McpServer::ParseMessage(), with the Otto tools and the camera stubbed out.
+ *
+ * Latencies reported:
+ *   parse     JsonReader over the message text
+ *   dispatch  ParseMessage() until it returns, including replies sent from the calling task
+ *   reply     arrival of a request until its reply is sent, per method or tool
+ *
+ * Usage: mcp_replay <recording.jsonl> [speed] [delay_scale]
+ *   speed        1 keeps the recorded timing, 10 replays ten times faster, 0 sends back to back
+ *   delay_scale  factor for the simulated camera and servo time, 0 makes them instant
+ *
+ *        mcp_replay --check
+ *   checks that batches with reused request ids are all answered and nothing is misrouted,
+ *   exits non-zero if not
+ */
+
+#include "mcp_server.h"
+#include "json_reader.h"
+#include "application.h"
+#include "board.h"
+#include "fake_devices.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Every tools/call gets a reply within its timeout, the longest one is take_photo
+#define REPLY_WAIT_TIMEOUT_MS 70000
+// --check: the fake camera still takes a few hundred ms, long enough to keep a request pending
+#define CHECK_DELAY_SCALE 0.2
+#define CHECK_WAIT_TIMEOUT_MS 5000
+#define PHOTO_QUESTION "{\"question\":\"What is on the desk?\"}"
+
+struct RecordedMessage {
+    int time_ms;
+    std::string text;
+};
+
+struct PendingRequest {
+    int64_t start_us;
+    std::string name;
+};
+
+static std::mutex g_mutex;
+static std::condition_variable g_cv;
+static std::unordered_map<int, PendingRequest> g_pending;
+static std::map<std::string, std::vector<int64_t>> g_reply_us;
+static size_t g_requests = 0;
+static size_t g_replies = 0;
+static size_t g_notifications = 0;
+static size_t g_id_collisions = 0;
+static std::vector<std::string> g_check_messages;
+
+// A tools/call is reported under its tool name, everything else under its method
+static std::string RequestName(const JsonReader& request) {
+    std::string method = request["method"].GetString();
+    if (method == "tools/call") {
+        return request["params"]["name"].GetString(method);
+    }
+    return method;
+}
+
+static void TrackRequest(const JsonReader& request, int64_t start_us) {
+    auto id = request["id"];
+    if (!id.IsNumber() || !request["method"].IsString()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_requests++;
+    // Recordings spanning several sessions may reuse an id while the earlier request is still open
+    if (!g_pending.emplace(id.GetInt(), PendingRequest{start_us, RequestName(request)}).second) {
+        g_id_collisions++;
+        g_pending[id.GetInt()] = PendingRequest{start_us, RequestName(request)};
+    }
+}
+
+static void TrackReply(const JsonReader& reply, int64_t now_us) {
+    auto id = reply["id"];
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!id.IsNumber()) {
+        g_notifications++;
+        return;
+    }
+    auto it = g_pending.find(id.GetInt());
+    if (it == g_pending.end()) {
+        return;
+    }
+    g_replies++;
+    g_reply_us[it->second.name].push_back(now_us - it->second.start_us);
+    g_pending.erase(it);
+    g_cv.notify_all();
+}
+
+static void OnMcpMessage(const std::string& payload) {
+    int64_t now_us = esp_timer_get_time();
+    JsonReader json(payload);
+    if (json.IsArray()) {
+        json.ForEachElement([now_us](const JsonReader& reply) {
+            TrackReply(reply, now_us);
+            return true;
+        });
+    } else {
+        TrackReply(json, now_us);
+    }
+}
+
+static void CollectMessage(const std::string& payload) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_check_messages.push_back(payload);
+    g_cv.notify_all();
+}
+
+// "id:result" or "id:error" per reply, the replies of a batch sorted and in brackets since they
+// are collected in completion order
+static std::string DescribeMessage(const std::string& message) {
+    auto describe = [](const JsonReader& reply) {
+        return std::to_string(reply["id"].GetInt()) + (reply["error"].IsObject() ? ":error" : ":result");
+    };
+    JsonReader json(message);
+    if (!json.IsArray()) {
+        return describe(json);
+    }
+    std::vector<std::string> replies;
+    json.ForEachElement([&replies, &describe](const JsonReader& reply) {
+        replies.push_back(describe(reply));
+        return true;
+    });
+    std::sort(replies.begin(), replies.end());
+    std::string text;
+    for (auto& reply : replies) {
+        text += (text.empty() ? "" : " ") + reply;
+    }
+    return "[" + text + "]";
+}
+
+// Sends the messages in order and describes what comes back until expected messages have arrived
+static std::vector<std::string> Exchange(const std::vector<std::string>& messages, size_t expected) {
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_check_messages.clear();
+    }
+    for (auto& message : messages) {
+        McpServer::GetInstance().ParseMessage(message);
+    }
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_cv.wait_for(lock, std::chrono::milliseconds(CHECK_WAIT_TIMEOUT_MS), [expected]() {
+        return g_check_messages.size() >= expected;
+    });
+    std::vector<std::string> described;
+    for (auto& message : g_check_messages) {
+        described.push_back(DescribeMessage(message));
+    }
+    return described;
+}
+
+static std::string ToolCall(int id, const char* tool, const char* arguments = "{}") {
+    return "{\"jsonrpc\":\"2.0\",\"method\":\"tools/call\",\"id\":" + std::to_string(id) +
+        ",\"params\":{\"name\":\"" + tool + "\",\"arguments\":" + arguments + "}}";
+}
+
+static int CheckExchange(const char* name, const std::vector<std::string>& messages,
+    const std::vector<std::string>& expected) {
+    auto actual = Exchange(messages, expected.size());
+    std::string text;
+    for (auto& message : actual) {
+        text += (text.empty() ? "" : ", ") + message;
+    }
+    if (actual != expected) {
+        printf("FAIL %s: got %s\n", name, text.c_str());
+        return 1;
+    }
+    printf("ok   %s: %s\n", name, text.c_str());
+    return 0;
+}
+
+// JSON-RPC matches replies by id alone. A batch must still be answered when an id repeats, and a
+// reply must never end up in a batch it does not belong to
+static int RunChecks() {
+    int failures = 0;
+    failures += CheckExchange("duplicate id in a batch",
+        {"[" + ToolCall(100, "self.get_device_status") + "," + ToolCall(100, "self.otto.get_status") + "]"},
+        {"[100:error 100:result]"});
+    failures += CheckExchange("plain request reusing an id pending in a batch",
+        {"[" + ToolCall(200, "self.camera.take_photo", PHOTO_QUESTION) + "," + ToolCall(201, "self.get_device_status") + "]",
+            ToolCall(200, "self.get_device_status")},
+        {"200:error", "[200:result 201:result]"});
+    failures += CheckExchange("batch reusing the id of a pending request",
+        {ToolCall(300, "self.camera.take_photo", PHOTO_QUESTION),
+            "[" + ToolCall(300, "self.get_device_status") + "," + ToolCall(301, "self.get_device_status") + "]"},
+        {"[300:error 301:result]", "300:result"});
+    failures += CheckExchange("plain requests sharing an id",
+        {ToolCall(400, "self.get_device_status"), ToolCall(400, "self.otto.get_status")},
+        {"400:result", "400:result"});
+    printf("%s\n", failures == 0 ? "All checks passed" : "Some checks failed");
+    return failures == 0 ? 0 : 1;
+}
+
+static std::vector<RecordedMessage> LoadRecording(const char* path) {
+    std::vector<RecordedMessage> messages;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        JsonReader record(line);
+        auto msg = record["msg"];
+        if (!msg.IsObject() && !msg.IsArray()) {
+            continue;
+        }
+        messages.push_back({record["t"].GetInt(), std::string(msg.raw())});
+    }
+    return messages;
+}
+
+static void PrintHeader(const char* title, const char* unit) {
+    printf("\n%-32s %8s %10s %10s %10s %10s  (%s)\n", title, "count", "p50", "p90", "p99", "max", unit);
+}
+
+static void PrintPercentiles(const std::string& name, std::vector<int64_t>& samples, double divisor) {
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples, divisor](double p) {
+        size_t index = std::min(samples.size() - 1, (size_t)(p * (samples.size() - 1) + 0.5));
+        return samples[index] / divisor;
+    };
+    printf("%-32s %8zu %10.1f %10.1f %10.1f %10.1f\n", name.c_str(), samples.size(),
+        at(0.5), at(0.9), at(0.99), samples.back() / divisor);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <recording.jsonl> [speed] [delay_scale]\n       %s --check\n", argv[0], argv[0]);
+        return 1;
+    }
+    bool check = std::string(argv[1]) == "--check";
+    const char* path = argv[1];
+    double speed = argc > 2 ? atof(argv[2]) : 1.0;
+    g_fake_delay_scale = check ? CHECK_DELAY_SCALE : argc > 3 ? atof(argv[3]) : 1.0;
+
+    // Same order as the firmware: the board registers its tools, then the common ones go in front
+    FakeCamera camera;
+    Board::GetInstance().SetCamera(&camera);
+    auto& mcp_server = McpServer::GetInstance();
+    FakeOttoController otto;
+    mcp_server.AddCommonTools();
+    mcp_server.AddCommonResources();
+    if (check) {
+        Application::GetInstance().OnMcpMessage(CollectMessage);
+        return RunChecks();
+    }
+    Application::GetInstance().OnMcpMessage(OnMcpMessage);
+
+    auto messages = LoadRecording(path);
+    if (messages.empty()) {
+        fprintf(stderr, "No messages in %s\n", path);
+        return 1;
+    }
+
+    std::vector<int64_t> parse_us;
+    std::vector<int64_t> dispatch_us;
+    parse_us.reserve(messages.size());
+    dispatch_us.reserve(messages.size());
+
+    auto replay_start = std::chrono::steady_clock::now();
+    int first_time_ms = messages.front().time_ms;
+    for (const auto& message : messages) {
+        if (speed > 0) {
+            auto offset = std::chrono::microseconds((int64_t)((message.time_ms - first_time_ms) * 1000 / speed));
+            std::this_thread::sleep_until(replay_start + offset);
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        JsonReader json(message.text);
+        int64_t parsed_us = esp_timer_get_time();
+        // Registered before dispatch, a reply may be sent before ParseMessage() returns
+        if (json.IsArray()) {
+            json.ForEachElement([start_us](const JsonReader& request) {
+                TrackRequest(request, start_us);
+                return true;
+            });
+        } else {
+            TrackRequest(json, start_us);
+        }
+        int64_t tracked_us = esp_timer_get_time();
+        mcp_server.ParseMessage(json);
+        int64_t dispatched_us = esp_timer_get_time();
+        parse_us.push_back(parsed_us - start_us);
+        dispatch_us.push_back(dispatched_us - tracked_us);
+    }
+
+    size_t unanswered = 0;
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        g_cv.wait_for(lock, std::chrono::milliseconds(REPLY_WAIT_TIMEOUT_MS), []() {
+            return g_pending.empty();
+        });
+        unanswered = g_pending.size();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - replay_start).count();
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    printf("%zu messages, %zu requests, %zu replies, %zu notifications, %zu unanswered, %zu reused ids in %.1f s\n",
+        messages.size(), g_requests, g_replies, g_notifications, unanswered, g_id_collisions, elapsed_s);
+    PrintHeader("stage", "us");
+    PrintPercentiles("parse", parse_us, 1.0);
+    PrintPercentiles("dispatch", dispatch_us, 1.0);
+    PrintHeader("reply", "ms");
+    for (auto& [name, samples] : g_reply_us) {
+        PrintPercentiles(name, samples, 1000.0);
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <functional>
+
+enum DeviceState {
+    kStateBooting,
+    kStateIdle,
+    kStateListening,
+    kStateThinking,
+    kStateSpeaking,
+    kStateCapturingPhoto,
+    kStateAnalyzingPhoto,
+    kStateGeneratingResponse,
+    kStateError
+};
+
+// 回放用的 Application：上行的 MCP 消息交给回放器统计耗时
+class Application {
+public:
+    static Application& GetInstance() {
+        static Application instance;
+        return instance;
+    }
+
+    void SendMcpMessage(const std::string& payload) {
+        if (on_mcp_message_) {
+            on_mcp_message_(payload);
+        }
+    }
+
+    // 设备上由协议分片发出，这里拼回一条消息再回调
+    void SendMcpMessageChunked(const std::function<bool(std::string& chunk)>& source) {
+        std::string payload;
+        std::string chunk;
+        while (source(chunk)) {
+            payload += chunk;
+        }
+        SendMcpMessage(payload);
+    }
+
+    DeviceState GetState() const { return kStateIdle; }
+
+    void OnMcpMessage(std::function<void(const std::string&)> callback) {
+        on_mcp_message_ = callback;
+    }
+
+private:
+    std::function<void(const std::string&)> on_mcp_message_;
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+#include "camera.h"
+#include "display.h"
+
+class AudioCodec {
+public:
+    void SetOutputVolume(int volume) { output_volume_ = volume; }
+    int output_volume() const { return output_volume_; }
+
+private:
+    int output_volume_ = 70;
+};
+
+class Backlight {
+public:
+    void SetBrightness(uint8_t brightness, bool permanent = false) { brightness_ = brightness; }
+    uint8_t brightness() const { return brightness_; }
+
+private:
+    uint8_t brightness_ = 75;
+};
+
+// 回放用的板子：有屏幕、背光和电池，摄像头由回放器装上 FakeCamera
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+
+    AudioCodec* GetAudioCodec() { return &audio_codec_; }
+    Backlight* GetBacklight() { return &backlight_; }
+    Display* GetDisplay() { return &display_; }
+    Camera* GetCamera() { return camera_; }
+    void SetCamera(Camera* camera) { camera_ = camera; }
+
+    bool GetBatteryLevel(int& level, bool& charging, bool& discharging) {
+        level = 80;
+        charging = false;
+        discharging = true;
+        return true;
+    }
+
+    std::string GetNetworkStatusJson() {
+        return "{\"type\":\"wifi\",\"ssid\":\"replay\",\"signal\":\"strong\"}";
+    }
+
+    std::string GetDeviceStatusJson() {
+        return "{\"audio_speaker\":{\"volume\":" + std::to_string(audio_codec_.output_volume()) + "},"
+            "\"screen\":{\"brightness\":" + std::to_string(backlight_.brightness()) + ",\"theme\":\"" + display_.GetTheme() + "\"},"
+            "\"battery\":{\"level\":80,\"charging\":false},"
+            "\"network\":" + GetNetworkStatusJson() + "}";
+    }
+
+private:
+    AudioCodec audio_codec_;
+    Backlight backlight_;
+    Display display_;
+    Camera* camera_ = nullptr;
+};
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+class Display {
+public:
+    std::string GetTheme() { return theme_; }
+    void SetTheme(const std::string& theme) { theme_ = theme; }
+
+private:
+    std::string theme_ = "light";
+};
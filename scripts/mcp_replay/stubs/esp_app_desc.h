@@ -0,0 +1,10 @@
+#pragma once
+
+typedef struct {
+    char version[32];
+} esp_app_desc_t;
+
+inline const esp_app_desc_t* esp_app_get_description() {
+    static esp_app_desc_t desc = {"replay"};
+    return &desc;
+}
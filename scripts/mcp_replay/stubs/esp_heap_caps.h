@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+// 假定有 8MB PSRAM，内容大小的限制按固件的常见配置生效
+inline size_t heap_caps_get_total_size(uint32_t caps) {
+    return 8 * 1024 * 1024;
+}
+
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return 4 * 1024 * 1024;
+}
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+inline void heap_caps_free(void* ptr) {
+    free(ptr);
+}
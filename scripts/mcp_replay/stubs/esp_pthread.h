@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+
+#define ESP_OK 0
+#define ESP_ERR_NOT_FOUND 0x105
+
+// 主机上 std::thread 使用系统默认栈，配置只为通过编译
+typedef struct {
+    size_t stack_size;
+    size_t prio;
+    bool inherit_cfg;
+    const char* thread_name;
+    int pin_to_core;
+} esp_pthread_cfg_t;
+
+inline esp_pthread_cfg_t esp_pthread_get_default_config() {
+    return {};
+}
+
+inline int esp_pthread_get_cfg(esp_pthread_cfg_t* cfg) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline int esp_pthread_set_cfg(const esp_pthread_cfg_t* cfg) {
+    return 0;
+}
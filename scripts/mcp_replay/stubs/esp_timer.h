@@ -0,0 +1,93 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define ESP_ERROR_CHECK(x) (void)(x)
+
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+inline int64_t esp_timer_get_time() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// 每个定时器一个线程，只实现 MCP 代码用到的周期定时
+struct esp_timer {
+    esp_timer_create_args_t args;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t period_us = 0;
+    bool active = false;
+    bool quit = false;
+    std::thread thread;
+};
+typedef esp_timer* esp_timer_handle_t;
+
+inline int esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    auto timer = new esp_timer;
+    timer->args = *args;
+    timer->thread = std::thread([timer]() {
+        std::unique_lock<std::mutex> lock(timer->mutex);
+        while (!timer->quit) {
+            if (!timer->active) {
+                timer->cv.wait(lock);
+                continue;
+            }
+            auto period = std::chrono::microseconds(timer->period_us);
+            if (timer->cv.wait_for(lock, period) == std::cv_status::timeout && timer->active) {
+                lock.unlock();
+                timer->args.callback(timer->args.arg);
+                lock.lock();
+            }
+        }
+    });
+    *out_handle = timer;
+    return 0;
+}
+
+inline int esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->period_us = period_us;
+    timer->active = true;
+    timer->cv.notify_all();
+    return 0;
+}
+
+inline int esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->active = false;
+    timer->cv.notify_all();
+    return 0;
+}
+
+inline bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    return timer->active;
+}
+
+inline int esp_timer_delete(esp_timer_handle_t timer) {
+    {
+        std::lock_guard<std::mutex> lock(timer->mutex);
+        timer->quit = true;
+        timer->cv.notify_all();
+    }
+    timer->thread.join();
+    delete timer;
+    return 0;
+}
@@ -0,0 +1,289 @@
+// 主机端协议客户端：用 main/protocols 中真实的 WebsocketProtocol / MqttProtocol 连接 protocol_stub_server.py，
+// 按设备的流程跑完 hello、listen、上行音频、MCP 应答和 TTS 下行，检查会话号、收到的音频帧与桩服务器发出的一致
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "protocols/websocket_protocol.h"
+#include "protocols/mqtt_protocol.h"
+#include "settings.h"
+#include "json_reader.h"
+#include "json_writer.h"
+
+// 设备上每个 Opus 包 60ms，桩服务器下行的时间戳也按这个间隔递增
+#define FRAME_DURATION_MS 60
+#define MCP_REPLY_PIECE_SIZE 7
+
+static double NowMs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static double Percentile(std::vector<double> values, int p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+// .p3 文件：|type 1u|reserved 1u|payload_size 2u|payload|
+static std::vector<std::vector<uint8_t>> LoadP3(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<std::vector<uint8_t>> frames;
+    size_t offset = 0;
+    while (offset + 4 <= data.size()) {
+        size_t size = (data[offset + 2] << 8) | data[offset + 3];
+        if (offset + 4 + size > data.size()) {
+            break;
+        }
+        frames.emplace_back(data.begin() + offset + 4, data.begin() + offset + 4 + size);
+        offset += 4 + size;
+    }
+    return frames;
+}
+
+// 回调在 WebSocket / MQTT / UDP 的接收线程中执行，主线程等待 tts stop
+struct Conversation {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool tts_stopped = false;
+    std::string stt_text;
+    std::string error;
+    int mcp_replies = 0;
+    double first_audio_ms = 0;
+    std::vector<std::unique_ptr<AudioStreamPacket>> packets;
+
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        tts_stopped = false;
+        stt_text.clear();
+        error.clear();
+        mcp_replies = 0;
+        first_audio_ms = 0;
+        packets.clear();
+    }
+};
+
+static void Usage(const char* name) {
+    printf("Usage: %s [--transport websocket|mqtt] [--url URL] [--endpoint HOST:PORT] [--version 1|2|3]\n"
+        "    [--rounds N] [--utterance-frames N] [--audio FILE.p3]\n", name);
+}
+
+int main(int argc, char** argv) {
+    std::string transport = "websocket";
+    std::string url = "ws://127.0.0.1:8000/xiaozhi/v1/";
+    std::string endpoint = "127.0.0.1:1883";
+    std::string audio_file = PROTOCOL_STUB_DIR "/../../main/assets/zh-CN/welcome.p3";
+    int version = 1;
+    int rounds = 3;
+    int utterance_frames = 25;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--transport" && has_value) {
+            transport = argv[++i];
+        } else if (arg == "--url" && has_value) {
+            url = argv[++i];
+        } else if (arg == "--endpoint" && has_value) {
+            endpoint = argv[++i];
+        } else if (arg == "--version" && has_value) {
+            version = atoi(argv[++i]);
+        } else if (arg == "--rounds" && has_value) {
+            rounds = atoi(argv[++i]);
+        } else if (arg == "--utterance-frames" && has_value) {
+            utterance_frames = atoi(argv[++i]);
+        } else if (arg == "--audio" && has_value) {
+            audio_file = argv[++i];
+        } else {
+            Usage(argv[0]);
+            return 2;
+        }
+    }
+    if (transport != "websocket" && transport != "mqtt") {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    // 桩服务器默认下行同一个文件，收到的帧逐个与它比较
+    auto frames = LoadP3(audio_file);
+    if (frames.empty()) {
+        printf("No audio in %s\n", audio_file.c_str());
+        return 2;
+    }
+
+    // 设备上这些值来自 OTA 响应写入的 NVS
+    std::unique_ptr<Protocol> protocol;
+    if (transport == "websocket") {
+        Settings settings("websocket", true);
+        settings.SetString("url", url);
+        settings.SetInt("version", version);
+        protocol = std::make_unique<WebsocketProtocol>();
+    } else {
+        Settings settings("mqtt", true);
+        settings.SetString("endpoint", endpoint);
+        settings.SetString("client_id", "protocol_client");
+        settings.SetString("publish_topic", "device-server");
+        protocol = std::make_unique<MqttProtocol>();
+    }
+
+    Conversation conversation;
+    protocol->OnNetworkError([&conversation](const std::string& message) {
+        std::lock_guard<std::mutex> lock(conversation.mutex);
+        conversation.error = message;
+        conversation.cv.notify_all();
+    });
+    protocol->OnIncomingAudio([&conversation](std::unique_ptr<AudioStreamPacket> packet) {
+        std::lock_guard<std::mutex> lock(conversation.mutex);
+        if (conversation.packets.empty()) {
+            conversation.first_audio_ms = NowMs();
+        }
+        conversation.packets.push_back(std::move(packet));
+        conversation.cv.notify_all();
+    });
+    // 桩服务器在 hello 之后发 initialize 和 tools/list，像设备一样经 SendMcpMessage 回应。initialize 的回应
+    // 按 MCP_REPLY_PIECE_SIZE 切开经 SendMcpMessageChunked 发出（WebSocket 上是分片帧），桩服务器拼不出完整
+    // 消息就不会接着发 tools/list，本轮因此失败
+    Protocol* raw_protocol = protocol.get();
+    protocol->OnIncomingJson([&conversation, raw_protocol](const JsonReader& root) {
+        auto type = root["type"];
+        if (type.Equals("mcp")) {
+            auto payload = root["payload"];
+            std::string reply;
+            JsonWriter writer(reply);
+            writer.BeginObject();
+            writer.Field("jsonrpc", "2.0");
+            writer.Field("id", payload["id"].GetInt());
+            writer.Key("result");
+            writer.BeginObject();
+            if (payload["method"].Equals("tools/list")) {
+                writer.Key("tools");
+                writer.BeginArray();
+                writer.EndArray();
+            }
+            writer.EndObject();
+            writer.EndObject();
+            if (payload["method"].Equals("initialize")) {
+                size_t offset = 0;
+                raw_protocol->SendMcpMessageChunked([&reply, &offset](std::string& chunk) {
+                    chunk = reply.substr(offset, MCP_REPLY_PIECE_SIZE);
+                    offset += chunk.size();
+                    return !chunk.empty();
+                });
+            } else {
+                raw_protocol->SendMcpMessage(reply);
+            }
+            std::lock_guard<std::mutex> lock(conversation.mutex);
+            conversation.mcp_replies++;
+        } else if (type.Equals("stt")) {
+            std::lock_guard<std::mutex> lock(conversation.mutex);
+            conversation.stt_text = root["text"].GetString();
+        } else if (type.Equals("tts") && root["state"].Equals("stop")) {
+            std::lock_guard<std::mutex> lock(conversation.mutex);
+            conversation.tts_stopped = true;
+            conversation.cv.notify_all();
+        }
+    });
+
+    if (transport == "mqtt" && !protocol->Start()) {
+        printf("FAIL could not connect to %s\n", endpoint.c_str());
+        return 1;
+    }
+
+    // v2 和 UDP 通道带时间戳，v1 / v3 没有
+    bool has_timestamps = transport == "mqtt" || version == 2;
+    int failures = 0;
+    std::set<std::string> session_ids;
+    std::vector<double> open_ms, hello_rtt_ms, first_audio_ms;
+    for (int round = 0; round < rounds; round++) {
+        conversation.Reset();
+        if (!protocol->OpenAudioChannel()) {
+            printf("round %d: FAIL OpenAudioChannel() %s\n", round + 1, conversation.error.c_str());
+            failures++;
+            break;
+        }
+        std::string session_id = protocol->session_id();
+        open_ms.push_back(protocol->statistics().channel_open_time_us / 1000.0);
+        hello_rtt_ms.push_back(protocol->statistics().hello_rtt_us / 1000.0);
+
+        double listen_start = NowMs();
+        protocol->SendStartListening(kListeningModeManualStop);
+        for (int i = 0; i < utterance_frames; i++) {
+            auto packet = std::make_unique<AudioStreamPacket>();
+            packet->sample_rate = 16000;
+            packet->frame_duration = FRAME_DURATION_MS;
+            packet->timestamp = i * FRAME_DURATION_MS;
+            packet->payload = frames[i % frames.size()];
+            protocol->SendAudio(std::move(packet));
+            std::this_thread::sleep_for(std::chrono::milliseconds(FRAME_DURATION_MS));
+        }
+        protocol->SendStopListening();
+
+        std::unique_lock<std::mutex> lock(conversation.mutex);
+        bool stopped = conversation.cv.wait_for(lock, std::chrono::seconds(30), [&conversation]() {
+            return conversation.tts_stopped || !conversation.error.empty();
+        });
+        // UDP 音频与 MQTT 上的 tts stop 走不同的线程，给最后几帧一点时间
+        conversation.cv.wait_for(lock, std::chrono::seconds(1), [&conversation, &frames]() {
+            return conversation.packets.size() >= frames.size();
+        });
+
+        std::string detail;
+        if (!stopped || !conversation.tts_stopped) {
+            detail = "no tts stop within 30 s " + conversation.error;
+        } else if (session_id.empty() || !session_ids.insert(session_id).second) {
+            detail = "missing or reused session id \"" + session_id + "\"";
+        } else if (conversation.stt_text.empty()) {
+            detail = "no stt text";
+        } else if (conversation.mcp_replies < 2) {
+            detail = "answered " + std::to_string(conversation.mcp_replies) + " mcp requests, expected 2";
+        } else if (conversation.packets.size() != frames.size()) {
+            detail = "received " + std::to_string(conversation.packets.size()) + " audio frames, expected " +
+                std::to_string(frames.size());
+        }
+        for (size_t i = 0; detail.empty() && i < frames.size(); i++) {
+            auto& packet = conversation.packets[i];
+            if (packet->payload != frames[i]) {
+                detail = "audio frame " + std::to_string(i) + " differs";
+            } else if (has_timestamps && packet->timestamp != i * FRAME_DURATION_MS) {
+                detail = "audio frame " + std::to_string(i) + " timestamp " + std::to_string(packet->timestamp);
+            } else if (packet->sample_rate != 16000 || packet->frame_duration != FRAME_DURATION_MS) {
+                detail = "audio frame " + std::to_string(i) + " does not carry the server hello audio params";
+            }
+        }
+        if (conversation.first_audio_ms > 0) {
+            first_audio_ms.push_back(conversation.first_audio_ms - listen_start);
+        }
+        lock.unlock();
+
+        protocol->CloseAudioChannel();
+        auto& stats = protocol->statistics();
+        if (detail.empty() && stats.packets_sent != (uint32_t)utterance_frames) {
+            detail = "sent " + std::to_string(stats.packets_sent) + " audio packets, expected " +
+                std::to_string(utterance_frames);
+        }
+        if (detail.empty()) {
+            printf("ok   round %d: session %s, %u frames up, %u frames down\n", round + 1, session_id.c_str(),
+                stats.packets_sent, stats.packets_received);
+        } else {
+            printf("round %d: FAIL %s\n", round + 1, detail.c_str());
+            failures++;
+        }
+    }
+
+    printf("%d rounds, %d failed\n", rounds, failures);
+    printf("channel open ms p50 %.1f max %.1f, hello rtt ms p50 %.1f\n", Percentile(open_ms, 50),
+        Percentile(open_ms, 100), Percentile(hello_rtt_ms, 50));
+    printf("listen start -> first audio ms p50 %.0f\n", Percentile(first_audio_ms, 50));
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,599 @@
+import argparse
+import asyncio
+import json
+import os
+import random
+import ssl
+import struct
+import time
+import uuid
+
+import websockets
+from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+
+
+'''
+  A local stub of the xiaozhi server used to check protocol conformance and load.
+
+  Server mode speaks:
+    - WebSocket: hello / listen / abort / mcp JSON flows, binary protocol version 1, 2 and 3
+    - MQTT 3.1.1 (minimal broker, QoS 0/1) for the control channel + AES-CTR encrypted UDP audio
+
+  Point the device to it (websocket url / mqtt endpoint in the OTA response or NVS settings),
+  or run `--client` to drive the same flows from the host.
+
+  Downlink audio can be impaired with latency, jitter, loss and reordering, and the server
+  can drop the connection periodically to measure how fast the device recovers.
+'''
+
+FRAME_DURATION_MS = 60
+DEFAULT_AUDIO_FILE = os.path.join(os.path.dirname(__file__), '../../main/assets/zh-CN/welcome.p3')
+
+
+def now_ms():
+    return time.monotonic() * 1000
+
+
+def load_p3(path):
+    ''' Read opus frames from a .p3 file: |type 1u|reserved 1u|payload_size 2u|payload| '''
+    frames = []
+    with open(path, 'rb') as f:
+        data = f.read()
+    offset = 0
+    while offset + 4 <= len(data):
+        size = struct.unpack('>H', data[offset + 2:offset + 4])[0]
+        frames.append(data[offset + 4:offset + 4 + size])
+        offset += 4 + size
+    return frames
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+class Impairment:
+    ''' Applies latency, jitter, loss and reordering to a stream of downlink sends '''
+    def __init__(self, latency_ms, jitter_ms, loss, reorder):
+        self.latency_ms = latency_ms
+        self.jitter_ms = jitter_ms
+        self.loss = loss
+        self.reorder = reorder
+        self.held = None
+        self.dropped = 0
+        self.reordered = 0
+
+    def delay(self):
+        return max(0, self.latency_ms + random.uniform(-self.jitter_ms, self.jitter_ms)) / 1000
+
+    async def send(self, send_func, item):
+        if random.random() < self.loss:
+            self.dropped += 1
+            return
+        if self.held is None and random.random() < self.reorder:
+            # Hold this item back and send it after the next one
+            self.held = item
+            return
+        await asyncio.sleep(self.delay())
+        await send_func(item)
+        if self.held is not None:
+            held, self.held = self.held, None
+            self.reordered += 1
+            await send_func(held)
+
+
+class Metrics:
+    def __init__(self):
+        self.sessions = 0
+        self.open_times = []
+        self.mcp_round_trips = []
+        self.recovery_times = []
+        self.uplink_packets = 0
+        self.uplink_bytes = 0
+        self.uplink_gaps = 0
+        self.uplink_first = None
+        self.uplink_last = None
+        self.downlink_packets = 0
+        self.abort_latencies = []
+        self.disconnected_at = None
+
+    def on_uplink(self, size):
+        t = now_ms()
+        if self.uplink_first is None:
+            self.uplink_first = t
+        self.uplink_last = t
+        self.uplink_packets += 1
+        self.uplink_bytes += size
+
+    def report(self, impairment):
+        print('\n===== protocol stub report =====')
+        print(f'sessions: {self.sessions}')
+        print(f'channel open (ms): p50={percentile(self.open_times, 50):.1f} p90={percentile(self.open_times, 90):.1f} '
+              f'max={max(self.open_times, default=0):.1f}')
+        print(f'mcp round trip (ms): p50={percentile(self.mcp_round_trips, 50):.1f} p90={percentile(self.mcp_round_trips, 90):.1f}')
+        if self.uplink_first is not None and self.uplink_last > self.uplink_first:
+            seconds = (self.uplink_last - self.uplink_first) / 1000
+            print(f'uplink: {self.uplink_packets} packets, {self.uplink_bytes} bytes, '
+                  f'{self.uplink_packets / seconds:.1f} pkt/s, {self.uplink_bytes * 8 / seconds / 1000:.1f} kbps, '
+                  f'{self.uplink_gaps} sequence gaps')
+        print(f'downlink: {self.downlink_packets} packets, {impairment.dropped} dropped, {impairment.reordered} reordered')
+        if self.abort_latencies:
+            print(f'abort -> tts stop (ms): p50={percentile(self.abort_latencies, 50):.1f}')
+        if self.recovery_times:
+            print(f'recovery after disconnect (ms): p50={percentile(self.recovery_times, 50):.1f} '
+                  f'max={max(self.recovery_times):.1f}')
+        print('CPU per packet is logged by the device when the audio channel closes')
+
+
+class Session:
+    ''' Transport independent conversation logic: hello, mcp, listen, tts and abort '''
+    def __init__(self, args, metrics, impairment, frames):
+        self.args = args
+        self.metrics = metrics
+        self.impairment = impairment
+        self.frames = frames
+        self.session_id = str(uuid.uuid4())
+        self.send_json = None
+        self.send_audio = None
+        self.tts_task = None
+        self.mcp_id = 0
+        self.mcp_pending = {}
+        self.listen_frames = 0
+        self.abort_time = None
+
+    def server_hello(self, transport):
+        return {
+            'type': 'hello',
+            'transport': transport,
+            'session_id': self.session_id,
+            'audio_params': {
+                'format': 'opus',
+                'sample_rate': 16000,
+                'channels': 1,
+                'frame_duration': FRAME_DURATION_MS,
+            },
+        }
+
+    async def on_hello(self, message, connect_time):
+        self.metrics.sessions += 1
+        self.metrics.open_times.append(now_ms() - connect_time)
+        if self.metrics.disconnected_at is not None:
+            self.metrics.recovery_times.append(now_ms() - self.metrics.disconnected_at)
+            self.metrics.disconnected_at = None
+        print(f'[{self.session_id[:8]}] hello version={message.get("version")} features={message.get("features")}')
+        if message.get('features', {}).get('mcp'):
+            asyncio.ensure_future(self.start_mcp())
+
+    async def call_mcp(self, method, params=None):
+        self.mcp_id += 1
+        payload = {'jsonrpc': '2.0', 'id': self.mcp_id, 'method': method}
+        if params is not None:
+            payload['params'] = params
+        future = asyncio.get_event_loop().create_future()
+        self.mcp_pending[self.mcp_id] = (future, now_ms())
+        await self.send_json({'session_id': self.session_id, 'type': 'mcp', 'payload': payload})
+        try:
+            return await asyncio.wait_for(future, 10)
+        except asyncio.TimeoutError:
+            print(f'[{self.session_id[:8]}] mcp {method} timeout')
+            return None
+
+    async def start_mcp(self):
+        await self.call_mcp('initialize', {'capabilities': {}})
+        result = await self.call_mcp('tools/list', {'cursor': ''})
+        if result is not None:
+            tools = result.get('result', {}).get('tools', [])
+            print(f'[{self.session_id[:8]}] {len(tools)} tools: {[t["name"] for t in tools]}')
+        for call in self.args.mcp_call:
+            name, _, arguments = call.partition(':')
+            result = await self.call_mcp('tools/call', {'name': name, 'arguments': json.loads(arguments or '{}')})
+            print(f'[{self.session_id[:8]}] {name} -> {json.dumps(result, ensure_ascii=False)[:200]}')
+
+    async def on_json(self, message):
+        msg_type = message.get('type')
+        if msg_type == 'mcp':
+            payload = message.get('payload', {})
+            pending = self.mcp_pending.pop(payload.get('id'), None)
+            if pending is not None:
+                future, start = pending
+                self.metrics.mcp_round_trips.append(now_ms() - start)
+                future.set_result(payload)
+        elif msg_type == 'listen':
+            state = message.get('state')
+            if state == 'start':
+                self.listen_frames = 0
+            elif state == 'stop':
+                self.start_tts()
+            elif state == 'detect':
+                print(f'[{self.session_id[:8]}] wake word: {message.get("text")}')
+        elif msg_type == 'abort':
+            self.abort_time = now_ms()
+            if self.tts_task is not None:
+                self.tts_task.cancel()
+        elif msg_type == 'goodbye':
+            if self.tts_task is not None:
+                self.tts_task.cancel()
+
+    def on_audio(self, size):
+        self.metrics.on_uplink(size)
+        self.listen_frames += 1
+        # Auto mode does not send listen stop, answer after the configured utterance length
+        if self.listen_frames == self.args.utterance_frames:
+            self.start_tts()
+
+    def start_tts(self):
+        if self.tts_task is None or self.tts_task.done():
+            self.tts_task = asyncio.ensure_future(self.play_tts())
+
+    async def play_tts(self):
+        sid = self.session_id
+        try:
+            await self.send_json({'session_id': sid, 'type': 'stt', 'text': 'stub server test'})
+            await self.send_json({'session_id': sid, 'type': 'llm', 'emotion': 'happy', 'text': '😀'})
+            await self.send_json({'session_id': sid, 'type': 'tts', 'state': 'start'})
+            await self.send_json({'session_id': sid, 'type': 'tts', 'state': 'sentence_start', 'text': 'stub server test'})
+            start = now_ms()
+            for i, frame in enumerate(self.frames):
+                await self.impairment.send(self.send_audio, (i, frame))
+                self.metrics.downlink_packets += 1
+                # Pace in real time, with a little burst ahead like the real server
+                ahead = (i + 1) * FRAME_DURATION_MS - (now_ms() - start)
+                if ahead > 3 * FRAME_DURATION_MS:
+                    await asyncio.sleep((ahead - 3 * FRAME_DURATION_MS) / 1000)
+        except asyncio.CancelledError:
+            pass
+        await self.send_json({'session_id': sid, 'type': 'tts', 'state': 'stop'})
+        if self.abort_time is not None:
+            self.metrics.abort_latencies.append(now_ms() - self.abort_time)
+            self.abort_time = None
+
+
+# -------------------------------------------------------------------------------------------------
+# WebSocket
+# -------------------------------------------------------------------------------------------------
+
+def pack_ws_audio(version, timestamp, payload):
+    if version == 2:
+        return struct.pack('>HHIII', version, 0, 0, timestamp, len(payload)) + payload
+    if version == 3:
+        return struct.pack('>BBH', 0, 0, len(payload)) + payload
+    return payload
+
+
+def unpack_ws_audio(version, data):
+    if version == 2:
+        _, _, _, timestamp, size = struct.unpack('>HHIII', data[:16])
+        return timestamp, data[16:16 + size]
+    if version == 3:
+        _, _, size = struct.unpack('>BBH', data[:4])
+        return 0, data[4:4 + size]
+    return 0, data
+
+
+def request_header(ws, name):
+    request = getattr(ws, 'request', None)
+    headers = request.headers if request is not None else ws.request_headers
+    return headers.get(name)
+
+
+async def websocket_handler(ws, args, metrics, impairment, frames):
+    connect_time = now_ms()
+    version = int(request_header(ws, 'Protocol-Version') or 1)
+    print(f'WebSocket connected, device={request_header(ws, "Device-Id")} version={version}')
+    session = Session(args, metrics, impairment, frames)
+
+    async def send_json(message):
+        await ws.send(json.dumps(message, ensure_ascii=False))
+
+    async def send_audio(item):
+        index, frame = item
+        await ws.send(pack_ws_audio(version, index * FRAME_DURATION_MS, frame))
+
+    session.send_json = send_json
+    session.send_audio = send_audio
+
+    drop_task = None
+    if args.drop_after > 0:
+        async def drop():
+            await asyncio.sleep(args.drop_after)
+            print('Dropping websocket connection')
+            metrics.disconnected_at = now_ms()
+            await ws.close()
+        drop_task = asyncio.ensure_future(drop())
+
+    try:
+        async for data in ws:
+            if isinstance(data, bytes):
+                _, payload = unpack_ws_audio(version, data)
+                session.on_audio(len(payload))
+                continue
+            message = json.loads(data)
+            if message.get('type') == 'hello':
+                await asyncio.sleep(impairment.delay())
+                await send_json(session.server_hello('websocket'))
+                await session.on_hello(message, connect_time)
+            else:
+                await session.on_json(message)
+    except websockets.ConnectionClosed:
+        pass
+    finally:
+        if drop_task is not None:
+            drop_task.cancel()
+        if session.tts_task is not None:
+            session.tts_task.cancel()
+        print('WebSocket disconnected')
+
+
+# -------------------------------------------------------------------------------------------------
+# MQTT + UDP
+# -------------------------------------------------------------------------------------------------
+
+def mqtt_encode_length(length):
+    encoded = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        encoded.append(byte | (0x80 if length > 0 else 0))
+        if length == 0:
+            return bytes(encoded)
+
+
+async def mqtt_read_packet(reader):
+    header = await reader.readexactly(1)
+    length, multiplier = 0, 1
+    while True:
+        byte = (await reader.readexactly(1))[0]
+        length += (byte & 0x7F) * multiplier
+        multiplier *= 128
+        if not byte & 0x80:
+            break
+    return header[0], await reader.readexactly(length)
+
+
+def mqtt_string(value):
+    value = value.encode() if isinstance(value, str) else value
+    return struct.pack('>H', len(value)) + value
+
+
+def mqtt_publish_packet(topic, payload):
+    body = mqtt_string(topic) + payload
+    return bytes([0x30]) + mqtt_encode_length(len(body)) + body
+
+
+class UdpAudioChannel(asyncio.DatagramProtocol):
+    ''' AES-CTR encrypted audio: |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|payload| '''
+    def __init__(self, metrics):
+        self.metrics = metrics
+        self.sessions = {}
+        self.transport = None
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def register(self, session):
+        self.sessions[session.ssrc] = session
+
+    def unregister(self, session):
+        self.sessions.pop(session.ssrc, None)
+
+    def datagram_received(self, data, addr):
+        if len(data) < 16 or data[0] != 0x01:
+            return
+        session = self.sessions.get(data[4:8])
+        if session is None:
+            return
+        session.udp_addr = addr
+        sequence = struct.unpack('>I', data[12:16])[0]
+        if session.remote_sequence and sequence != session.remote_sequence + 1:
+            self.metrics.uplink_gaps += 1
+        session.remote_sequence = sequence
+        decryptor = Cipher(algorithms.AES(session.key), modes.CTR(data[:16])).decryptor()
+        payload = decryptor.update(data[16:]) + decryptor.finalize()
+        session.on_audio(len(payload))
+
+    def send(self, session, timestamp, payload):
+        if session.udp_addr is None:
+            return
+        session.local_sequence += 1
+        nonce = bytearray(session.nonce)
+        nonce[2:4] = struct.pack('>H', len(payload))
+        nonce[8:12] = struct.pack('>I', timestamp & 0xFFFFFFFF)
+        nonce[12:16] = struct.pack('>I', session.local_sequence)
+        encryptor = Cipher(algorithms.AES(session.key), modes.CTR(bytes(nonce))).encryptor()
+        self.transport.sendto(bytes(nonce) + encryptor.update(payload) + encryptor.finalize(), session.udp_addr)
+
+
+async def mqtt_handler(reader, writer, args, metrics, impairment, frames, udp):
+    connect_time = now_ms()
+    client_id = None
+    session = None
+    write_lock = asyncio.Lock()
+
+    async def write(packet):
+        async with write_lock:
+            writer.write(packet)
+            await writer.drain()
+
+    async def send_json(message):
+        await write(mqtt_publish_packet(f'devices/p2p/{client_id}', json.dumps(message, ensure_ascii=False).encode()))
+
+    try:
+        while True:
+            packet_type, body = await mqtt_read_packet(reader)
+            kind = packet_type >> 4
+            if kind == 1:  # CONNECT
+                offset = 2 + struct.unpack('>H', body[:2])[0] + 4
+                client_id = body[offset + 2:offset + 2 + struct.unpack('>H', body[offset:offset + 2])[0]].decode()
+                print(f'MQTT connected, client_id={client_id}')
+                await write(bytes([0x20, 0x02, 0x00, 0x00]))
+            elif kind == 3:  # PUBLISH
+                qos = (packet_type >> 1) & 0x03
+                topic_len = struct.unpack('>H', body[:2])[0]
+                offset = 2 + topic_len
+                if qos > 0:
+                    packet_id = body[offset:offset + 2]
+                    offset += 2
+                    await write(bytes([0x40, 0x02]) + packet_id)
+                message = json.loads(body[offset:])
+                if message.get('type') == 'hello':
+                    if session is not None:
+                        udp.unregister(session)
+                    session = Session(args, metrics, impairment, frames)
+                    session.send_json = send_json
+                    session.key = os.urandom(16)
+                    session.ssrc = os.urandom(4)
+                    session.nonce = bytes([0x01, 0x00, 0x00, 0x00]) + session.ssrc + bytes(8)
+                    session.udp_addr = None
+                    session.local_sequence = 0
+                    session.remote_sequence = 0
+
+                    async def send_audio(item, session=session):
+                        index, frame = item
+                        udp.send(session, index * FRAME_DURATION_MS, frame)
+                    session.send_audio = send_audio
+                    udp.register(session)
+
+                    hello = session.server_hello('udp')
+                    hello['udp'] = {
+                        'server': args.udp_host,
+                        'port': args.udp_port,
+                        'key': session.key.hex().upper(),
+                        'nonce': session.nonce.hex().upper(),
+                    }
+                    await asyncio.sleep(impairment.delay())
+                    await send_json(hello)
+                    await session.on_hello(message, connect_time)
+                    connect_time = now_ms()
+                elif session is not None:
+                    await session.on_json(message)
+            elif kind == 8:  # SUBSCRIBE
+                packet_id = body[:2]
+                await write(bytes([0x90, 0x03]) + packet_id + bytes([0x00]))
+            elif kind == 12:  # PINGREQ
+                await write(bytes([0xD0, 0x00]))
+            elif kind == 14:  # DISCONNECT
+                break
+    except (asyncio.IncompleteReadError, ConnectionResetError):
+        pass
+    finally:
+        if session is not None:
+            udp.unregister(session)
+            if session.tts_task is not None:
+                session.tts_task.cancel()
+        writer.close()
+        print(f'MQTT disconnected, client_id={client_id}')
+
+
+# -------------------------------------------------------------------------------------------------
+# Host client, drives the same flows as the device does
+# -------------------------------------------------------------------------------------------------
+
+async def run_websocket_client(args, frames):
+    open_times, first_audio_times = [], []
+    for round_index in range(args.rounds):
+        start = now_ms()
+        async with websockets.connect(args.url, additional_headers={'Protocol-Version': str(args.version)}) as ws:
+            await ws.send(json.dumps({
+                'type': 'hello', 'version': args.version, 'transport': 'websocket',
+                'features': {'mcp': True},
+                'audio_params': {'format': 'opus', 'sample_rate': 16000, 'channels': 1, 'frame_duration': FRAME_DURATION_MS},
+            }))
+            session_id = None
+            received, tts_stopped = 0, False
+            listen_start = None
+            async for data in ws:
+                if isinstance(data, bytes):
+                    if received == 0:
+                        first_audio_times.append(now_ms() - listen_start)
+                    received += 1
+                    continue
+                message = json.loads(data)
+                if message['type'] == 'hello':
+                    session_id = message['session_id']
+                    open_times.append(now_ms() - start)
+                    listen_start = now_ms()
+                    await ws.send(json.dumps({'session_id': session_id, 'type': 'listen', 'state': 'start', 'mode': 'manual'}))
+                    for i, frame in enumerate(frames[:args.utterance_frames]):
+                        await ws.send(pack_ws_audio(args.version, i * FRAME_DURATION_MS, frame))
+                        await asyncio.sleep(FRAME_DURATION_MS / 1000)
+                    await ws.send(json.dumps({'session_id': session_id, 'type': 'listen', 'state': 'stop'}))
+                elif message['type'] == 'mcp':
+                    payload = message['payload']
+                    result = {'tools': []} if payload['method'] == 'tools/list' else {}
+                    await ws.send(json.dumps({'session_id': session_id, 'type': 'mcp',
+                                              'payload': {'jsonrpc': '2.0', 'id': payload['id'], 'result': result}}))
+                elif message['type'] == 'tts' and message['state'] == 'stop':
+                    tts_stopped = True
+                    break
+            print(f'round {round_index + 1}: received {received} audio frames, tts stopped: {tts_stopped}')
+    print(f'client channel open (ms): p50={percentile(open_times, 50):.1f} max={max(open_times, default=0):.1f}')
+    print(f'client listen start -> first audio (ms): p50={percentile(first_audio_times, 50):.1f}')
+
+
+async def main(args):
+    frames = load_p3(args.audio)
+    metrics = Metrics()
+    impairment = Impairment(args.latency, args.jitter, args.loss, args.reorder)
+
+    if args.client:
+        await run_websocket_client(args, frames)
+        return
+
+    ssl_context = None
+    if args.tls_cert:
+        ssl_context = ssl.create_default_context(ssl.Purpose.CLIENT_AUTH)
+        ssl_context.load_cert_chain(args.tls_cert, args.tls_key)
+
+    loop = asyncio.get_event_loop()
+    udp_transport, udp = await loop.create_datagram_endpoint(
+        lambda: UdpAudioChannel(metrics), local_addr=('0.0.0.0', args.udp_port))
+    mqtt_server = await asyncio.start_server(
+        lambda r, w: mqtt_handler(r, w, args, metrics, impairment, frames, udp),
+        '0.0.0.0', args.mqtt_port, ssl=ssl_context)
+    ws_server = await websockets.serve(
+        lambda ws, *_: websocket_handler(ws, args, metrics, impairment, frames),
+        '0.0.0.0', args.ws_port, ssl=ssl_context)
+
+    print(f'WebSocket: ws{"s" if ssl_context else ""}://<host>:{args.ws_port}/xiaozhi/v1/')
+    print(f'MQTT: <host>:{args.mqtt_port}, UDP audio: {args.udp_host}:{args.udp_port}')
+    print(f'Impairment: latency={args.latency}ms jitter={args.jitter}ms loss={args.loss} reorder={args.reorder}')
+    try:
+        if args.duration > 0:
+            await asyncio.sleep(args.duration)
+        else:
+            await asyncio.Future()
+    finally:
+        ws_server.close()
+        mqtt_server.close()
+        udp_transport.close()
+        metrics.report(impairment)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='本地协议桩服务器，用于协议一致性与负载测试')
+    parser.add_argument('--ws-port', type=int, default=8000, help='WebSocket 端口 (默认: 8000)')
+    parser.add_argument('--mqtt-port', type=int, default=1883, help='MQTT 端口 (默认: 1883)')
+    parser.add_argument('--udp-port', type=int, default=8888, help='UDP 音频端口 (默认: 8888)')
+    parser.add_argument('--udp-host', default='192.168.1.100', help='下发给设备的 UDP 服务器地址')
+    parser.add_argument('--tls-cert', help='TLS 证书 (MQTT 8883 / wss)')
+    parser.add_argument('--tls-key', help='TLS 私钥')
+    parser.add_argument('--audio', default=DEFAULT_AUDIO_FILE, help='下行 TTS 音频 (.p3 文件)')
+    parser.add_argument('--latency', type=float, default=0, help='注入延迟 ms')
+    parser.add_argument('--jitter', type=float, default=0, help='注入抖动 ms')
+    parser.add_argument('--loss', type=float, default=0, help='下行丢包率 0~1')
+    parser.add_argument('--reorder', type=float, default=0, help='下行乱序率 0~1')
+    parser.add_argument('--drop-after', type=float, default=0, help='连接建立 N 秒后主动断开，用于测量恢复时间')
+    parser.add_argument('--utterance-frames', type=int, default=25, help='自动模式下收到多少帧上行音频后开始回复')
+    parser.add_argument('--mcp-call', action='append', default=[], help='会话开始后调用的工具，格式 name:{json}')
+    parser.add_argument('--duration', type=float, default=0, help='运行 N 秒后输出报告并退出 (默认: 一直运行)')
+    parser.add_argument('--client', action='store_true', help='以模拟设备的方式连接 --url 并跑完整流程')
+    parser.add_argument('--url', default='ws://127.0.0.1:8000/xiaozhi/v1/', help='客户端模式的服务器地址')
+    parser.add_argument('--version', type=int, default=1, choices=[1, 2, 3], help='客户端模式的二进制协议版本')
+    parser.add_argument('--rounds', type=int, default=5, help='客户端模式的会话轮数')
+    args = parser.parse_args()
+    try:
+        asyncio.run(main(args))
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,26 @@
+#pragma once
+#include <functional>
+
+// 设备上由 audio_service.h 定义
+#define OPUS_FRAME_DURATION_MS 60
+
+// 主机上一直当作在说话，PacedSendScheduler 不会因为静音丢包
+class AudioService {
+public:
+    bool IsVoiceDetected() const { return true; }
+};
+
+// 只有协议类用到的部分，Schedule 直接在调用的线程里执行
+class Application {
+public:
+    static Application& GetInstance() {
+        static Application instance;
+        return instance;
+    }
+
+    AudioService& GetAudioService() { return audio_service_; }
+    void Schedule(std::function<void()> callback) { callback(); }
+
+private:
+    AudioService audio_service_;
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+// 只有协议类用到的几条，与 gen_lang.py 生成的结构相同
+namespace Lang {
+    namespace Strings {
+        constexpr const char* SERVER_ERROR = "SERVER_ERROR";
+        constexpr const char* SERVER_NOT_CONNECTED = "SERVER_NOT_CONNECTED";
+        constexpr const char* SERVER_NOT_FOUND = "SERVER_NOT_FOUND";
+        constexpr const char* SERVER_TIMEOUT = "SERVER_TIMEOUT";
+    }
+}
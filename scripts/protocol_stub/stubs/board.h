@@ -0,0 +1,27 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "web_socket.h"
+#include "mqtt.h"
+#include "udp.h"
+
+// 只提供协议类用到的部分，WebSocket / MQTT / UDP 都走主机的 socket
+class NetworkInterface {
+public:
+    std::unique_ptr<WebSocket> CreateWebSocket(int connect_id) { return std::make_unique<WebSocket>(); }
+    std::unique_ptr<Mqtt> CreateMqtt(int connect_id) { return std::make_unique<Mqtt>(); }
+    std::unique_ptr<Udp> CreateUdp(int connect_id) { return std::make_unique<Udp>(); }
+};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+    NetworkInterface* GetNetwork() { return &network_; }
+    std::string GetUuid() { return "00000000-0000-0000-0000-000000000000"; }
+
+private:
+    NetworkInterface network_;
+};
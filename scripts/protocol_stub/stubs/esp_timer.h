@@ -0,0 +1,93 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#define ESP_OK 0
+
+inline int64_t esp_timer_get_time() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+// 每个定时器一个线程，只实现一次性定时；回调在该线程中执行，与设备上的 esp_timer 任务相同
+struct esp_timer {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+    esp_timer_cb_t callback;
+    void* arg;
+    bool active = false;
+    bool quit = false;
+    std::chrono::steady_clock::time_point deadline;
+};
+typedef esp_timer* esp_timer_handle_t;
+
+inline int esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    auto timer = new esp_timer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->thread = std::thread([timer]() {
+        std::unique_lock<std::mutex> lock(timer->mutex);
+        while (!timer->quit) {
+            if (!timer->active) {
+                timer->cv.wait(lock);
+            } else if (timer->cv.wait_until(lock, timer->deadline) == std::cv_status::timeout && timer->active) {
+                timer->active = false;
+                lock.unlock();
+                timer->callback(timer->arg);
+                lock.lock();
+            }
+        }
+    });
+    *out = timer;
+    return ESP_OK;
+}
+
+inline int esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    timer->active = true;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+inline int esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    timer->active = false;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+inline bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    return timer->active;
+}
+
+inline int esp_timer_delete(esp_timer_handle_t timer) {
+    {
+        std::lock_guard<std::mutex> lock(timer->mutex);
+        timer->quit = true;
+        timer->cv.notify_all();
+    }
+    timer->thread.join();
+    delete timer;
+    return ESP_OK;
+}
@@ -0,0 +1,207 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * 主机上的 MQTT 3.1.1 客户端，接口与 esp-ml307 的 Mqtt 一致，只实现 MqttProtocol 用到的部分：
+ * 明文 TCP 连接，QoS 0 发布，接收服务器发来的 PUBLISH。接收在单独的线程中进行，OnMessage 和 OnDisconnected
+ * 在该线程中回调。没有实现心跳，检查用的会话远短于保活时间。
+ */
+class Mqtt {
+public:
+    ~Mqtt() { Disconnect(); }
+
+    void SetKeepAlive(int keep_alive_seconds) { keep_alive_seconds_ = keep_alive_seconds; }
+    void OnDisconnected(std::function<void()> callback) { on_disconnected_ = callback; }
+    void OnMessage(std::function<void(const std::string& topic, const std::string& payload)> callback) {
+        on_message_ = callback;
+    }
+    bool IsConnected() const { return connected_; }
+
+    bool Connect(const std::string& broker_address, int broker_port, const std::string& client_id,
+        const std::string& username, const std::string& password) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(broker_address.c_str(), std::to_string(broker_port).c_str(), &hints, &result) != 0) {
+            return false;
+        }
+        for (auto ai = result; ai != nullptr && fd_ < 0; ai = ai->ai_next) {
+            fd_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd_ >= 0 && connect(fd_, ai->ai_addr, ai->ai_addrlen) != 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        freeaddrinfo(result);
+        if (fd_ < 0) {
+            return false;
+        }
+        // 控制消息都很短，不等 Nagle 合并，否则握手耗时里会多出一个延迟确认
+        int nodelay = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        // CONNECT：协议名 MQTT，级别 4，clean session，有用户名密码时带上
+        uint8_t flags = 0x02;
+        std::string body = String("MQTT");
+        body += (char)0x04;
+        std::string payload = String(client_id);
+        if (!username.empty()) {
+            flags |= 0x80;
+            payload += String(username);
+        }
+        if (!password.empty()) {
+            flags |= 0x40;
+            payload += String(password);
+        }
+        body += (char)flags;
+        body += (char)(keep_alive_seconds_ >> 8);
+        body += (char)(keep_alive_seconds_ & 0xFF);
+        if (!SendPacket(0x10, body + payload)) {
+            Disconnect();
+            return false;
+        }
+        uint8_t type;
+        std::string connack;
+        if (!ReadPacket(type, connack) || (type >> 4) != 2 || connack.size() < 2 || connack[1] != 0) {
+            fprintf(stderr, "Mqtt: connection refused\n");
+            Disconnect();
+            return false;
+        }
+        connected_ = true;
+        receive_thread_ = std::thread([this]() {
+            ReceiveLoop();
+        });
+        return true;
+    }
+
+    void Disconnect() {
+        closing_ = true;
+        if (fd_ >= 0) {
+            if (connected_) {
+                SendPacket(0xE0, "");
+            }
+            shutdown(fd_, SHUT_RDWR);
+        }
+        if (receive_thread_.joinable()) {
+            receive_thread_.join();
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        connected_ = false;
+    }
+
+    bool Publish(const std::string& topic, const std::string& payload, int qos = 0) {
+        if (!connected_) {
+            return false;
+        }
+        return SendPacket(0x30, String(topic) + payload);
+    }
+
+private:
+    int fd_ = -1;
+    int keep_alive_seconds_ = 120;
+    std::string buffer_;
+    std::mutex send_mutex_;
+    std::thread receive_thread_;
+    std::atomic<bool> connected_ = false;
+    std::atomic<bool> closing_ = false;
+    std::function<void()> on_disconnected_;
+    std::function<void(const std::string& topic, const std::string& payload)> on_message_;
+
+    static std::string String(const std::string& value) {
+        std::string encoded;
+        encoded += (char)(value.size() >> 8);
+        encoded += (char)(value.size() & 0xFF);
+        return encoded + value;
+    }
+
+    bool SendPacket(uint8_t header, const std::string& body) {
+        std::string packet(1, (char)header);
+        size_t length = body.size();
+        do {
+            uint8_t byte = length % 128;
+            length /= 128;
+            packet += (char)(byte | (length > 0 ? 0x80 : 0));
+        } while (length > 0);
+        packet += body;
+
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        auto p = packet.data();
+        size_t left = packet.size();
+        while (left > 0) {
+            ssize_t n = send(fd_, p, left, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            p += n;
+            left -= n;
+        }
+        return true;
+    }
+
+    bool Take(size_t len, std::string& out) {
+        char chunk[4096];
+        while (buffer_.size() < len) {
+            ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return false;
+            }
+            buffer_.append(chunk, n);
+        }
+        out = buffer_.substr(0, len);
+        buffer_.erase(0, len);
+        return true;
+    }
+
+    bool ReadPacket(uint8_t& type, std::string& body) {
+        std::string byte;
+        if (!Take(1, byte)) {
+            return false;
+        }
+        type = byte[0];
+        size_t length = 0;
+        int shift = 0;
+        do {
+            if (!Take(1, byte)) {
+                return false;
+            }
+            length |= (size_t)(byte[0] & 0x7F) << shift;
+            shift += 7;
+        } while (byte[0] & 0x80);
+        return Take(length, body);
+    }
+
+    void ReceiveLoop() {
+        uint8_t type;
+        std::string body;
+        while (ReadPacket(type, body)) {
+            if ((type >> 4) != 3 || body.size() < 2) {
+                continue;
+            }
+            size_t topic_len = ((uint8_t)body[0] << 8) | (uint8_t)body[1];
+            size_t offset = 2 + topic_len + (((type >> 1) & 0x03) > 0 ? 2 : 0);
+            if (offset <= body.size() && on_message_) {
+                on_message_(body.substr(2, topic_len), body.substr(offset));
+            }
+        }
+        connected_ = false;
+        if (!closing_ && on_disconnected_) {
+            on_disconnected_();
+        }
+    }
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+
+// 没有 NVS，所有命名空间的值放在进程内的表里，客户端启动时写入 url / endpoint 等设置
+class Settings {
+public:
+    Settings(const std::string& ns, bool read_write = false) : ns_(ns) {}
+
+    std::string GetString(const std::string& key, const std::string& default_value = "") {
+        auto it = strings_.find(ns_ + "." + key);
+        return it != strings_.end() ? it->second : default_value;
+    }
+    void SetString(const std::string& key, const std::string& value) { strings_[ns_ + "." + key] = value; }
+    int32_t GetInt(const std::string& key, int32_t default_value = 0) {
+        auto it = ints_.find(ns_ + "." + key);
+        return it != ints_.end() ? it->second : default_value;
+    }
+    void SetInt(const std::string& key, int32_t value) { ints_[ns_ + "." + key] = value; }
+
+private:
+    static inline std::map<std::string, std::string> strings_;
+    static inline std::map<std::string, int32_t> ints_;
+    std::string ns_;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * 主机上的 UDP 客户端，接口与 esp-ml307 的 Udp 一致。接收在单独的线程中进行，OnMessage 在该线程中回调，
+ * 与设备上的接收任务相同。
+ */
+class Udp {
+public:
+    ~Udp() { Disconnect(); }
+
+    void OnMessage(std::function<void(const std::string& data)> callback) { on_message_ = callback; }
+
+    bool Connect(const std::string& host, int port) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) {
+            return false;
+        }
+        for (auto ai = result; ai != nullptr && fd_ < 0; ai = ai->ai_next) {
+            fd_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd_ >= 0 && connect(fd_, ai->ai_addr, ai->ai_addrlen) != 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        freeaddrinfo(result);
+        if (fd_ < 0) {
+            return false;
+        }
+        running_ = true;
+        receive_thread_ = std::thread([this]() {
+            ReceiveLoop();
+        });
+        return true;
+    }
+
+    void Disconnect() {
+        running_ = false;
+        if (receive_thread_.joinable()) {
+            receive_thread_.join();
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    int Send(const std::string& data) {
+        if (fd_ < 0) {
+            return -1;
+        }
+        return send(fd_, data.data(), data.size(), 0);
+    }
+
+private:
+    int fd_ = -1;
+    std::atomic<bool> running_ = false;
+    std::thread receive_thread_;
+    std::function<void(const std::string& data)> on_message_;
+
+    // 连接的 UDP socket 不能靠 shutdown 唤醒，用短超时的 poll 检查退出标志
+    void ReceiveLoop() {
+        char buffer[1500];
+        while (running_) {
+            pollfd pfd = {fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+            if (n > 0 && on_message_) {
+                on_message_(std::string(buffer, n));
+            }
+        }
+    }
+};
@@ -0,0 +1,373 @@
+/*
+ * PacedSendScheduler 行为检查
+ *
+ * 调度器照 WebsocketProtocol 的方式接线：编码节奏（每 60ms 一包）调用 Enqueue()，发送线程通过回调写入模拟链路。
+ * 模拟链路有固定大小的发送缓冲区（与 lwIP TCP 发送缓冲区一样写满时阻塞）并按设定速率送出，
+ * 记录每个包从编码到送达对端的延迟。慢速链路上同时跑一遍不经调度器、直接按顺序写入的对照。
+ * 每个场景检查一组预期行为，有不满足的返回非零。
+ */
+
+#include "paced_send_scheduler.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define FRAME_DURATION_MS 60
+// 说话 2 秒、停顿 1 秒；语音包约 21kbps，静音包很小
+#define VOICE_MS 2000
+#define SILENCE_MS 1000
+#define VOICE_PACKET_BYTES 160
+#define SILENCE_PACKET_BYTES 20
+// ESP-IDF 默认的 TCP 发送缓冲区
+#define LINK_SEND_BUFFER_BYTES 5744
+
+// 送达对端的包，时间单位毫秒
+struct Delivery {
+    uint32_t created_ms;
+    uint32_t latency_ms;
+    bool voice;
+};
+
+class FakeLink {
+public:
+    FakeLink(double rate, int64_t start_us) : rate_(rate), start_us_(start_us), last_us_(start_us) {}
+
+    // 发送缓冲区写满时阻塞，直到链路送出足够的字节
+    bool Write(std::unique_ptr<AudioStreamPacket> packet) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int64_t now = esp_timer_get_time();
+        if (now < fail_until_us_) {
+            return false;
+        }
+        size_t size = packet->payload.size();
+        Drain(now);
+        while (now < pause_until_us_) {
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(pause_until_us_ - now));
+            lock.lock();
+            now = esp_timer_get_time();
+            Drain(now);
+        }
+        while (buffered_ + size > LINK_SEND_BUFFER_BYTES) {
+            auto wait_us = (int64_t)((buffered_ + size - LINK_SEND_BUFFER_BYTES) * 1000000.0 / rate_) + 1;
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+            lock.lock();
+            Drain(esp_timer_get_time());
+        }
+        buffered_ += size;
+        written_ += size;
+        in_buffer_.push_back({written_, packet->timestamp, size == VOICE_PACKET_BYTES});
+        return true;
+    }
+
+    // 之后的写入立即失败，与连接断开时相同
+    void FailFor(int ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fail_until_us_ = esp_timer_get_time() + ms * 1000LL;
+    }
+
+    // 链路停止送出，写入一直阻塞到恢复，与 4G 模组掉线重连时相同
+    void PauseFor(int ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Drain(esp_timer_get_time());
+        pause_until_us_ = esp_timer_get_time() + ms * 1000LL;
+    }
+
+    // 结束时还在发送缓冲区里的包按至少等到现在计入延迟
+    std::vector<Delivery> Delivered() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = esp_timer_get_time();
+        Drain(now);
+        auto result = delivered_;
+        for (auto& record : in_buffer_) {
+            uint32_t now_ms = (now - start_us_) / 1000;
+            result.push_back({record.created_ms, now_ms - record.created_ms, record.voice});
+        }
+        return result;
+    }
+
+private:
+    struct Record {
+        double end;             // 包最后一个字节在写入流中的位置
+        uint32_t created_ms;
+        bool voice;
+    };
+
+    std::mutex mutex_;
+    double rate_;
+    int64_t start_us_;
+    int64_t last_us_;
+    int64_t fail_until_us_ = 0;
+    int64_t pause_until_us_ = 0;
+    double buffered_ = 0;
+    double written_ = 0;
+    double sent_ = 0;
+    std::deque<Record> in_buffer_;
+    std::vector<Delivery> delivered_;
+
+    // 从 last_us_ 起缓冲区一直以 rate_ 送出，算出每个包最后一个字节离开的时间
+    void Drain(int64_t now) {
+        if (now < pause_until_us_) {
+            last_us_ = now;
+            return;
+        }
+        last_us_ = std::max(last_us_, pause_until_us_);
+        double drained = std::min(buffered_, rate_ * (now - last_us_) / 1000000.0);
+        while (!in_buffer_.empty() && in_buffer_.front().end <= sent_ + drained) {
+            auto& record = in_buffer_.front();
+            int64_t delivered_us = last_us_ + (int64_t)((record.end - sent_) * 1000000.0 / rate_);
+            uint32_t delivered_ms = (delivered_us - start_us_) / 1000;
+            delivered_.push_back({record.created_ms, delivered_ms - record.created_ms, record.voice});
+            in_buffer_.pop_front();
+        }
+        sent_ += drained;
+        buffered_ -= drained;
+        last_us_ = now;
+    }
+};
+
+struct Scenario {
+    const char* name;
+    double link_rate;       // 字节每秒
+    int duration_ms;
+    int outage_at_ms;       // 链路在这个时间开始连续发送失败，0 表示没有
+    int outage_ms;
+    int pause_at_ms;        // 链路在这个时间停止送出，0 表示没有
+    int pause_ms;
+};
+
+struct Result {
+    SendSchedulerStats stats;
+    int produced_voice = 0;
+    int produced_silence = 0;
+    // 送达的包，以及结束时还在排队的包（延迟只是下限）
+    std::vector<Delivery> delivered;
+};
+
+// 不经调度器，编码出来的包按顺序直接写入链路
+class DirectSender {
+public:
+    explicit DirectSender(FakeLink& link) : link_(link), thread_([this]() { Loop(); }) {}
+    ~DirectSender() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    void Enqueue(std::unique_ptr<AudioStreamPacket> packet) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(packet));
+        cv_.notify_all();
+    }
+
+    // 还没写入链路的包
+    std::vector<uint32_t> Pending() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint32_t> created;
+        for (auto& packet : queue_) {
+            created.push_back(packet->timestamp);
+        }
+        return created;
+    }
+
+private:
+    FakeLink& link_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::unique_ptr<AudioStreamPacket>> queue_;
+    bool quit_ = false;
+    std::thread thread_;
+
+    void Loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!quit_) {
+            if (queue_.empty()) {
+                cv_.wait(lock);
+                continue;
+            }
+            auto packet = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            link_.Write(std::move(packet));
+            lock.lock();
+        }
+    }
+};
+
+static Result Run(const Scenario& scenario, bool paced) {
+    int64_t start_us = esp_timer_get_time();
+    FakeLink link(scenario.link_rate, start_us);
+    std::unique_ptr<PacedSendScheduler> scheduler;
+    std::unique_ptr<DirectSender> direct;
+    if (paced) {
+        scheduler = std::make_unique<PacedSendScheduler>([&link](std::unique_ptr<AudioStreamPacket> packet) {
+            return link.Write(std::move(packet));
+        }, FRAME_DURATION_MS);
+        // 设备上取自握手的往返时间
+        scheduler->OnRttSample(80);
+        scheduler->Start();
+    } else {
+        direct = std::make_unique<DirectSender>(link);
+    }
+
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < scenario.duration_ms; t += FRAME_DURATION_MS) {
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(t));
+        if (scenario.outage_ms > 0 && t == scenario.outage_at_ms) {
+            link.FailFor(scenario.outage_ms);
+        }
+        if (scenario.pause_ms > 0 && t == scenario.pause_at_ms) {
+            link.PauseFor(scenario.pause_ms);
+        }
+        bool voice = t % (VOICE_MS + SILENCE_MS) < VOICE_MS;
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->sample_rate = 16000;
+        packet->frame_duration = FRAME_DURATION_MS;
+        packet->timestamp = t;
+        packet->payload.resize(voice ? VOICE_PACKET_BYTES : SILENCE_PACKET_BYTES);
+        (voice ? result.produced_voice : result.produced_silence)++;
+        if (paced) {
+            scheduler->Enqueue(std::move(packet), voice);
+        } else {
+            direct->Enqueue(std::move(packet));
+        }
+    }
+    if (paced) {
+        scheduler->Stop();
+        result.stats = scheduler->stats();
+    }
+    result.delivered = link.Delivered();
+    if (direct) {
+        // 对照组积压的包同样按至少等到现在计入延迟
+        uint32_t now_ms = (esp_timer_get_time() - start_us) / 1000;
+        for (auto created_ms : direct->Pending()) {
+            bool voice = created_ms % (VOICE_MS + SILENCE_MS) < VOICE_MS;
+            result.delivered.push_back({created_ms, now_ms - created_ms, voice});
+        }
+        // 发送线程可能还阻塞在写入中
+        direct.reset();
+    }
+    return result;
+}
+
+// 在 [from_ms, to_ms) 内编码的包送达延迟的百分位数，没有送达的返回 0
+static uint32_t LatencyPercentile(const Result& r, int from_ms, int to_ms, int percentile) {
+    std::vector<uint32_t> latencies;
+    for (auto& d : r.delivered) {
+        if ((int)d.created_ms >= from_ms && (int)d.created_ms < to_ms) {
+            latencies.push_back(d.latency_ms);
+        }
+    }
+    if (latencies.empty()) {
+        return 0;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies[std::min(latencies.size() - 1, latencies.size() * percentile / 100)];
+}
+
+static int CountDelivered(const Result& r, int from_ms, int to_ms, bool voice) {
+    int count = 0;
+    for (auto& d : r.delivered) {
+        if ((int)d.created_ms >= from_ms && (int)d.created_ms < to_ms && d.voice == voice) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static int CountProduced(int from_ms, int to_ms, bool voice) {
+    int count = 0;
+    for (int t = 0; t < to_ms; t += FRAME_DURATION_MS) {
+        if (t >= from_ms && (t % (VOICE_MS + SILENCE_MS) < VOICE_MS) == voice) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static int failures = 0;
+
+static void Check(bool ok, const char* description) {
+    printf("  %-4s %s\n", ok ? "ok" : "FAIL", description);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static void Print(const Scenario& scenario, const Result& r) {
+    auto& s = r.stats;
+    int half = scenario.duration_ms / 2;
+    printf("%s: link %.1f KB/s, %d s\n", scenario.name, scenario.link_rate / 1000, scenario.duration_ms / 1000);
+    printf("  produced %d voice / %d silence, sent %u, dropped %u voice / %u silence, stalls %u, failures %u\n",
+        r.produced_voice, r.produced_silence, s.packets_sent, s.dropped_voice, s.dropped_silence, s.stalls, s.send_failures);
+    printf("  latency p95: first half %u ms, second half %u ms; final pacing %d bps\n",
+        LatencyPercentile(r, 0, half, 95), LatencyPercentile(r, half, scenario.duration_ms, 95), s.pacing_rate_bps);
+}
+
+int main(int argc, char** argv) {
+    // 平均音频码率约 1.9KB/s，说话时约 2.7KB/s
+    Scenario fast = {"fast", 8000, 8000, 0, 0, 0, 0};
+    Scenario slow = {"slow", 1000, 20000, 0, 0, 0, 0};
+    Scenario paused = {"paused", 8000, 12000, 0, 0, 3000, 5000};
+    Scenario outage = {"outage", 8000, 8000, 2040, 1000, 0, 0};
+
+    auto r = Run(fast, true);
+    Print(fast, r);
+    Check(r.stats.stalls == 0, "no stalls while the link keeps up");
+    Check(r.stats.dropped_voice + r.stats.dropped_silence == 0, "nothing dropped while the link keeps up");
+    Check(r.stats.pacing_rate_bps == 0, "not pacing");
+    Check(LatencyPercentile(r, 0, fast.duration_ms, 95) < 100, "p95 latency under 100 ms");
+
+    r = Run(slow, true);
+    Print(slow, r);
+    auto direct = Run(slow, false);
+    uint32_t paced_p95 = LatencyPercentile(r, slow.duration_ms / 2, slow.duration_ms, 95);
+    uint32_t direct_p95 = LatencyPercentile(direct, slow.duration_ms / 2, slow.duration_ms, 95);
+    printf("  unpaced second half latency p95 %u ms\n", direct_p95);
+    Check(r.stats.stalls > 0, "the full send buffer is detected as a stall");
+    Check(r.stats.pacing_rate_bps > 0, "pacing once stalled");
+    Check(r.stats.dropped_voice + r.stats.dropped_silence > 0, "stale packets are dropped");
+    // 发送缓冲区里的数据调度器管不到，延迟上限是截止时间加上缓冲区排空的时间
+    Check(paced_p95 < SEND_SCHEDULER_DEADLINE_MS + LINK_SEND_BUFFER_BYTES * 1000 / slow.link_rate,
+        "latency bounded by the deadline plus the send buffer");
+    Check(paced_p95 * 2 < direct_p95, "latency under half of the unpaced backlog");
+
+    r = Run(paused, true);
+    Print(paused, r);
+    // 停顿期间积压的包超过截止时间能容纳的数量，先丢静音
+    int pause_end = paused.pause_at_ms + paused.pause_ms;
+    int silence_kept = CountDelivered(r, paused.pause_at_ms, pause_end, false);
+    int voice_kept = CountDelivered(r, paused.pause_at_ms, pause_end, true);
+    int voice_lost = CountProduced(paused.pause_at_ms, pause_end, true) - voice_kept;
+    printf("  from the pause: delivered %d voice / %d silence, lost %d voice\n", voice_kept, silence_kept, voice_lost);
+    Check(r.stats.stalls > 0, "the blocked send is detected as a stall");
+    Check(r.stats.dropped_silence > 0, "stale silence is dropped");
+    Check(voice_lost == 0 || silence_kept <= 2, "silence goes before voice");
+    Check(LatencyPercentile(r, paused.duration_ms - 2000, paused.duration_ms, 95) < 100, "latency back under 100 ms at the end");
+
+    r = Run(outage, true);
+    Print(outage, r);
+    Check(r.stats.send_failures > 0, "failed sends are counted");
+    Check(r.stats.send_failures <= outage.outage_ms / 100 + 2, "failed sends back off instead of retrying in a loop");
+    Check(r.stats.pacing_rate_bps == 0, "pacing off again after the link recovers");
+    Check(LatencyPercentile(r, outage.duration_ms - 2000, outage.duration_ms, 95) < 100, "latency back under 100 ms at the end");
+
+    printf(failures == 0 ? "all checks passed\n" : "%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdio>
+
+// 模拟时只保留错误，统计由模拟程序从 stats() 中读取后打印
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) do {} while (0)
+#define ESP_LOGI(tag, format, ...) do {} while (0)
+#define ESP_LOGD(tag, format, ...) do {} while (0)
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// 没有 NVS，全部返回默认值
+class Settings {
+public:
+    Settings(const std::string& ns, bool read_write = false) {}
+    int32_t GetInt(const std::string& key, int32_t default_value = 0) { return default_value; }
+};
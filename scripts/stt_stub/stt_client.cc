@@ -0,0 +1,270 @@
+// 主机端听写客户端：用 main/ 中真实的 XunfeiSttService 按设备的节奏把 .p3 音频推给桩服务器，
+// 检查动态修正（wpgs）拼出的中间结果和最终文本与 transcripts.jsonl 中录好的一致
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "services/xunfei_stt_service.h"
+#include "audio/audio_service.h"
+#include "json_reader.h"
+
+// 设备上每个 Opus 包 60ms
+#define FRAME_DURATION_MS 60
+
+static double NowMs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static double Percentile(std::vector<double> values, int p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+// .p3 文件：|type 1u|reserved 1u|payload_size 2u|payload|
+static std::vector<std::vector<uint8_t>> LoadP3(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<std::vector<uint8_t>> frames;
+    size_t offset = 0;
+    while (offset + 4 <= data.size()) {
+        size_t size = (data[offset + 2] << 8) | data[offset + 3];
+        if (offset + 4 + size > data.size()) {
+            break;
+        }
+        frames.emplace_back(data.begin() + offset + 4, data.begin() + offset + 4 + size);
+        offset += 4 + size;
+    }
+    return frames;
+}
+
+// 按 UTF-8 字符切分，桩服务器按字符逐个显示没有 hypotheses 的句子
+static std::vector<std::string> SplitCharacters(const std::string& text) {
+    std::vector<std::string> chars;
+    for (size_t i = 0; i < text.size();) {
+        size_t len = 1;
+        while (i + len < text.size() && ((uint8_t)text[i + len] & 0xC0) == 0x80) {
+            len++;
+        }
+        chars.push_back(text.substr(i, len));
+        i += len;
+    }
+    return chars;
+}
+
+struct Transcript {
+    std::string text;
+    std::vector<std::pair<int, std::string>> hypotheses;   // 收到多少个音频包时，到那时为止整句的中间结果
+};
+
+static std::vector<Transcript> LoadTranscripts(const std::string& path, int packets_per_char) {
+    std::vector<Transcript> transcripts;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        JsonReader root(line.data(), line.size());
+        Transcript transcript;
+        transcript.text = root["text"].GetString();
+        root["hypotheses"].ForEachElement([&transcript](const JsonReader& hypothesis) {
+            int packets = 0;
+            std::string text;
+            int index = 0;
+            hypothesis.ForEachElement([&](const JsonReader& value) {
+                if (index++ == 0) {
+                    packets = value.GetInt();
+                } else {
+                    text = value.GetString();
+                }
+                return index < 2;
+            });
+            transcript.hypotheses.emplace_back(packets, text);
+            return true;
+        });
+        if (transcript.hypotheses.empty()) {
+            // 与桩服务器相同：每 packets_per_char 个包多显示一个字
+            auto chars = SplitCharacters(transcript.text);
+            std::string partial;
+            for (size_t i = 0; i + 1 < chars.size(); i++) {
+                partial += chars[i];
+                transcript.hypotheses.emplace_back((i + 1) * packets_per_char, partial);
+            }
+        }
+        transcripts.push_back(std::move(transcript));
+    }
+    return transcripts;
+}
+
+// 发出 packets 个包后应当依次收到的整句文本，相同的文本不会重复回调
+static std::vector<std::string> ExpectedPartials(const Transcript& transcript, int packets) {
+    std::vector<std::string> partials;
+    for (auto& [count, text] : transcript.hypotheses) {
+        if (count <= packets && (partials.empty() || partials.back() != text)) {
+            partials.push_back(text);
+        }
+    }
+    if (partials.empty() || partials.back() != transcript.text) {
+        partials.push_back(transcript.text);
+    }
+    return partials;
+}
+
+static std::string Join(const std::vector<std::string>& texts) {
+    std::string joined;
+    for (auto& text : texts) {
+        joined += (joined.empty() ? "\"" : " -> \"") + text + "\"";
+    }
+    return joined;
+}
+
+static void Usage(const char* name) {
+    printf("Usage: %s [--url URL] [--audio FILE.p3] [--packets N] [--rounds N] [--transcripts FILE]\n"
+        "    [--packets-per-char N] [--app-id ID] [--api-key KEY] [--api-secret SECRET] [--no-check]\n", name);
+}
+
+int main(int argc, char** argv) {
+    std::string url = "ws://127.0.0.1:8091/v2/iat";
+    std::string audio_file = STT_STUB_DIR "/../../main/assets/zh-CN/welcome.p3";
+    std::string transcripts_file = STT_STUB_DIR "/transcripts.jsonl";
+    std::string app_id, api_key, api_secret;
+    int packets = 30;
+    int rounds = 0;
+    int packets_per_char = 3;
+    bool check = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--url" && has_value) {
+            url = argv[++i];
+        } else if (arg == "--audio" && has_value) {
+            audio_file = argv[++i];
+        } else if (arg == "--packets" && has_value) {
+            packets = atoi(argv[++i]);
+        } else if (arg == "--rounds" && has_value) {
+            rounds = atoi(argv[++i]);
+        } else if (arg == "--transcripts" && has_value) {
+            transcripts_file = argv[++i];
+        } else if (arg == "--packets-per-char" && has_value) {
+            packets_per_char = atoi(argv[++i]);
+        } else if (arg == "--app-id" && has_value) {
+            app_id = argv[++i];
+        } else if (arg == "--api-key" && has_value) {
+            api_key = argv[++i];
+        } else if (arg == "--api-secret" && has_value) {
+            api_secret = argv[++i];
+        } else if (arg == "--no-check") {
+            check = false;
+        } else {
+            Usage(argv[0]);
+            return 2;
+        }
+    }
+
+    auto frames = LoadP3(audio_file);
+    if (frames.empty()) {
+        printf("No audio in %s\n", audio_file.c_str());
+        return 2;
+    }
+    // 音频不够时循环使用，包数决定桩服务器发出哪些中间结果
+    packets = std::max(packets, 1);
+    auto transcripts = LoadTranscripts(transcripts_file, packets_per_char);
+    if (check && transcripts.empty()) {
+        printf("No transcripts in %s\n", transcripts_file.c_str());
+        return 2;
+    }
+    if (rounds <= 0) {
+        rounds = check ? transcripts.size() : 1;
+    }
+
+    XunfeiSttService service(app_id, api_key, api_secret, url);
+    int failures = 0;
+    std::vector<double> first_partial_ms, final_ms;
+    for (int round = 0; round < rounds; round++) {
+        AudioService audio_service;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+        std::string result;
+        std::vector<std::string> partials;
+        double start = NowMs();
+        double first_partial = 0;
+
+        bool started = service.Recognize(audio_service, [&](const std::string& text) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (partials.empty()) {
+                first_partial = NowMs();
+            }
+            partials.push_back(text);
+        }, [&](const std::string& text) {
+            std::lock_guard<std::mutex> lock(mutex);
+            result = text;
+            done = true;
+            cv.notify_all();
+        });
+        if (!started) {
+            printf("round %d: Recognize() refused to start\n", round + 1);
+            failures++;
+            continue;
+        }
+
+        // 按设备的节奏：VAD 检测到说话，每 60ms 一个包进发送队列，VAD 判断说完
+        service.OnVadChange(true);
+        for (int i = 0; i < packets; i++) {
+            auto packet = std::make_unique<AudioStreamPacket>();
+            packet->sample_rate = 16000;
+            packet->frame_duration = FRAME_DURATION_MS;
+            packet->payload = frames[i % frames.size()];
+            audio_service.PushPacketToSendQueue(std::move(packet));
+            service.OnAudioAvailable();
+            std::this_thread::sleep_for(std::chrono::milliseconds(FRAME_DURATION_MS));
+        }
+        double speech_end = NowMs();
+        service.OnVadChange(false);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        // 识别任务自己有超时，正常总会回调 on_result
+        if (!cv.wait_for(lock, std::chrono::seconds(30), [&done]() { return done; })) {
+            printf("round %d: FAIL no result within 30 s\n", round + 1);
+            fflush(stdout);
+            // 识别任务还引用着 audio_service，不能正常析构
+            std::_Exit(1);
+        }
+        final_ms.push_back(NowMs() - speech_end);
+        if (first_partial > 0) {
+            first_partial_ms.push_back(first_partial - start);
+        }
+
+        if (!check) {
+            printf("round %d: \"%s\" (%u partials)\n", round + 1, result.c_str(), partials.size());
+            continue;
+        }
+        // 桩服务器按连接上的会话顺序回放，需要新启动的桩服务器
+        const auto& transcript = transcripts[round % transcripts.size()];
+        auto expected = ExpectedPartials(transcript, packets);
+        if (result != transcript.text || partials != expected) {
+            printf("round %d: FAIL \"%s\", expected \"%s\"\n  partials %s\n  expected %s\n", round + 1,
+                result.c_str(), transcript.text.c_str(), Join(partials).c_str(), Join(expected).c_str());
+            failures++;
+        } else {
+            printf("ok   round %d: %s\n", round + 1, Join(partials).c_str());
+        }
+    }
+
+    printf("%d rounds, %d failed, %d websocket connections\n", rounds, failures, WebSocket::connections);
+    printf("speech start -> first partial ms p50 %.0f\n", Percentile(first_partial_ms, 50));
+    printf("end of speech -> final text ms p50 %.0f p90 %.0f\n", Percentile(final_ms, 50), Percentile(final_ms, 90));
+    return failures == 0 ? 0 : 1;
+}
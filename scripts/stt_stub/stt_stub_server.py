@@ -0,0 +1,375 @@
+import argparse
+import asyncio
+import base64
+import datetime
+import hashlib
+import hmac
+import json
+import os
+import random
+import struct
+import time
+import urllib.parse
+
+import websockets
+
+
+'''
+  A local stub of the Xunfei streaming dictation (iat v2) websocket API used by XunfeiSttService.
+
+  The device streams Opus packets in JSON frames (status 0 / 1 / 2, base64 audio, every packet
+  prefixed by its 2-byte big-endian length). The stub replays recorded transcripts against the
+  incoming audio: each hypothesis is sent once the given number of audio packets has arrived,
+  using the same dynamic correction format (dwa=wpgs, pgs apd / rpl) as the real service, and
+  the final result follows the last frame after --final-delay.
+
+  `--client` streams a .p3 file the way the device does, against the stub or the real service,
+  and reports the time from the end of speech to the final text.
+'''
+
+FRAME_DURATION_MS = 60
+DEFAULT_TRANSCRIPTS = os.path.join(os.path.dirname(__file__), 'transcripts.jsonl')
+DEFAULT_AUDIO_FILE = os.path.join(os.path.dirname(__file__), '../../main/assets/zh-CN/welcome.p3')
+
+
+def now_ms():
+    return time.monotonic() * 1000
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def load_p3(path):
+    ''' Read opus frames from a .p3 file: |type 1u|reserved 1u|payload_size 2u|payload| '''
+    frames = []
+    with open(path, 'rb') as f:
+        data = f.read()
+    offset = 0
+    while offset + 4 <= len(data):
+        size = struct.unpack('>H', data[offset + 2:offset + 4])[0]
+        frames.append(data[offset + 4:offset + 4 + size])
+        offset += 4 + size
+    return frames
+
+
+def split_packets(audio):
+    ''' Split an opus-wb payload into packets, None if the length prefixes do not add up '''
+    packets = []
+    offset = 0
+    while offset + 2 <= len(audio):
+        size = struct.unpack('>H', audio[offset:offset + 2])[0]
+        if offset + 2 + size > len(audio):
+            return None
+        packets.append(audio[offset + 2:offset + 2 + size])
+        offset += 2 + size
+    return packets if offset == len(audio) else None
+
+
+def load_transcripts(path):
+    '''
+      One utterance per line: {"text": "...", "hypotheses": [[packets, "partial"], ...]}
+      Without hypotheses the text is revealed one character every --packets-per-char packets.
+    '''
+    transcripts = []
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            line = line.strip()
+            if line and not line.startswith('#'):
+                transcripts.append(json.loads(line))
+    return transcripts
+
+
+class Utterance:
+    ''' Turns a list of whole-sentence hypotheses into wpgs results, apd when the text only grew '''
+    def __init__(self, transcript, packets_per_char):
+        self.text = transcript['text']
+        self.hypotheses = transcript.get('hypotheses') or [
+            [(i + 1) * packets_per_char, self.text[:i + 1]] for i in range(len(self.text) - 1)]
+        self.next = 0
+        self.sn = 0
+        self.committed = ''
+
+    def result(self, text, last):
+        self.sn += 1
+        if text.startswith(self.committed):
+            result = {'sn': self.sn, 'ls': last, 'pgs': 'apd', 'ws': words(text[len(self.committed):])}
+        else:
+            result = {'sn': self.sn, 'ls': last, 'pgs': 'rpl', 'rg': [1, self.sn - 1], 'ws': words(text)}
+        self.committed = text
+        return result
+
+    def due(self, packets):
+        ''' Hypotheses whose packet count has been reached '''
+        results = []
+        while self.next < len(self.hypotheses) and self.hypotheses[self.next][0] <= packets:
+            results.append(self.result(self.hypotheses[self.next][1], False))
+            self.next += 1
+        return results
+
+
+def words(text):
+    return [{'bg': 0, 'cw': [{'sc': 0, 'w': w}]} for w in text]
+
+
+class Stats:
+    def __init__(self):
+        self.connections = 0
+        self.sessions = 0
+        self.reused = 0
+        self.errors = 0
+        self.packets = []
+        self.batch_sizes = []
+        self.audio_gaps = []
+        self.first_audio = []
+
+    def report(self):
+        print('==== STT stub report ====')
+        print(f'connections {self.connections}, sessions {self.sessions}, on a reused connection {self.reused}, '
+              f'errors injected {self.errors}')
+        if self.packets:
+            print(f'packets per session p50 {percentile(self.packets, 50)} max {max(self.packets)}')
+        if self.batch_sizes:
+            print(f'packets per frame p50 {percentile(self.batch_sizes, 50)} max {max(self.batch_sizes)} '
+                  '(large values: audio queued while connecting)')
+        if self.audio_gaps:
+            print(f'ms between audio frames p50 {percentile(self.audio_gaps, 50):.0f} p90 {percentile(self.audio_gaps, 90):.0f}')
+        if self.first_audio:
+            print(f'connect -> first audio ms p50 {percentile(self.first_audio, 50):.0f}')
+
+
+class SttStub:
+    def __init__(self, args):
+        self.args = args
+        self.transcripts = load_transcripts(args.transcripts)
+        self.stats = Stats()
+        self.turn = 0
+
+    def check_auth(self, ws):
+        query = urllib.parse.parse_qs(urllib.parse.urlparse(ws.request.path).query)
+        return all(key in query for key in ('authorization', 'date', 'host'))
+
+    async def send(self, ws, sid, status, result=None, code=0, message='success'):
+        response = {'code': code, 'message': message, 'sid': sid}
+        if code == 0:
+            response['data'] = {'status': status, 'result': result}
+        await ws.send(json.dumps(response, ensure_ascii=self.args.ascii))
+
+    async def handle(self, ws):
+        self.stats.connections += 1
+        connect_time = now_ms()
+        print(f'{ws.remote_address} connected {ws.request.path}')
+        if self.args.check_auth and not self.check_auth(ws):
+            await self.send(ws, '', 0, code=10313, message='authorization, date or host missing')
+            await ws.close()
+            return
+        sessions_on_connection = 0
+        try:
+            while True:
+                if not await self.session(ws, connect_time, sessions_on_connection):
+                    break
+                sessions_on_connection += 1
+                if not self.args.keep_alive:
+                    # The real service closes the connection after every final result
+                    break
+        except websockets.ConnectionClosed:
+            pass
+        print(f'{ws.remote_address} closed after {sessions_on_connection} sessions')
+
+    async def session(self, ws, connect_time, index):
+        ''' One utterance, from the status 0 frame to the final result. False when the connection ended '''
+        utterance = None
+        sid = f'iat{random.randrange(1 << 32):08x}'
+        packets = []
+        last_audio = None
+        async for data in ws:
+            frame = json.loads(data)
+            body = frame.get('data', {})
+            status = body.get('status')
+            if utterance is None:
+                if status != 0 or 'common' not in frame or 'business' not in frame:
+                    await self.send(ws, sid, 0, code=10160, message='first frame must carry common and business')
+                    return False
+                utterance = Utterance(self.transcripts[self.turn % len(self.transcripts)], self.args.packets_per_char)
+                self.turn += 1
+                self.stats.sessions += 1
+                if index > 0:
+                    self.stats.reused += 1
+                if self.args.error_rate > 0 and random.random() < self.args.error_rate:
+                    self.stats.errors += 1
+                    await self.send(ws, sid, 0, code=10114, message='session timeout (injected)')
+                    return False
+                print(f'session {sid}: app_id={frame["common"].get("app_id")} encoding={body.get("encoding")} '
+                      f'business={json.dumps(frame["business"], ensure_ascii=False)}')
+
+            audio = base64.b64decode(body.get('audio', ''))
+            if audio:
+                batch = split_packets(audio)
+                if batch is None:
+                    await self.send(ws, sid, 0, code=10161, message='bad opus-wb length prefix')
+                    return False
+                if last_audio is None:
+                    self.stats.first_audio.append(now_ms() - connect_time)
+                else:
+                    self.stats.audio_gaps.append(now_ms() - last_audio)
+                last_audio = now_ms()
+                packets += batch
+                self.stats.batch_sizes.append(len(batch))
+            for result in utterance.due(len(packets)):
+                await self.send(ws, sid, 1, result)
+
+            if status == 2:
+                self.stats.packets.append(len(packets))
+                await asyncio.sleep(self.args.final_delay / 1000)
+                await self.send(ws, sid, 2, utterance.result(utterance.text, True))
+                print(f'session {sid}: {len(packets)} packets ({len(packets) * FRAME_DURATION_MS} ms) -> {utterance.text}')
+                self.save(sid, packets)
+                return True
+        return False
+
+    def save(self, sid, packets):
+        if not self.args.save_dir:
+            return
+        os.makedirs(self.args.save_dir, exist_ok=True)
+        with open(os.path.join(self.args.save_dir, f'{sid}.p3'), 'wb') as f:
+            for packet in packets:
+                f.write(struct.pack('>BBH', 0, 0, len(packet)) + packet)
+
+
+# -------------------------------------------------------------------------------------------------
+# Host client, streams a .p3 file the way XunfeiSttService does
+# -------------------------------------------------------------------------------------------------
+
+def signed_url(url, api_key, api_secret):
+    if not api_key or not api_secret:
+        return url
+    parts = urllib.parse.urlparse(url)
+    date = datetime.datetime.now(datetime.timezone.utc).strftime('%a, %d %b %Y %H:%M:%S GMT')
+    origin = f'host: {parts.netloc}\ndate: {date}\nGET {parts.path} HTTP/1.1'
+    signature = base64.b64encode(hmac.new(api_secret.encode(), origin.encode(), hashlib.sha256).digest()).decode()
+    authorization = (f'api_key="{api_key}", algorithm="hmac-sha256", headers="host date request-line", '
+                     f'signature="{signature}"')
+    query = urllib.parse.urlencode({'authorization': base64.b64encode(authorization.encode()).decode(),
+                                    'date': date, 'host': parts.netloc})
+    return f'{url}?{query}'
+
+
+def apply_result(sentences, result):
+    ''' Same bookkeeping as XunfeiSttService::OnData '''
+    text = ''.join(cw['cw'][0]['w'] for cw in result.get('ws', []))
+    sn = result.get('sn', 0)
+    if result.get('pgs') == 'rpl':
+        first, last = result.get('rg', [0, 0])
+        for i in range(max(first, 1), min(last, len(sentences)) + 1):
+            sentences[i - 1] = ''
+    if sn > 0:
+        while len(sentences) < sn:
+            sentences.append('')
+        sentences[sn - 1] = text
+    return ''.join(sentences)
+
+
+async def run_client(args):
+    frames = load_p3(args.audio)[:args.packets] if args.packets > 0 else load_p3(args.audio)
+    connect_ms, first_partial_ms, final_ms = [], [], []
+    for round_index in range(args.rounds):
+        start = now_ms()
+        async with websockets.connect(signed_url(args.url, args.api_key, args.api_secret)) as ws:
+            connect_ms.append(now_ms() - start)
+            sentences = []
+            speech_start = now_ms()
+            first_partial = None
+            end_of_speech = None
+
+            async def send_audio():
+                nonlocal end_of_speech
+                for i, frame in enumerate(frames):
+                    message = {'data': {'status': 0 if i == 0 else 1, 'format': 'audio/L16;rate=16000',
+                                        'encoding': 'opus-wb',
+                                        'audio': base64.b64encode(struct.pack('>H', len(frame)) + frame).decode()}}
+                    if i == 0:
+                        message['common'] = {'app_id': args.app_id}
+                        message['business'] = {'language': 'zh_cn', 'domain': 'iat', 'accent': 'mandarin',
+                                               'dwa': 'wpgs', 'vad_eos': 3000}
+                    await ws.send(json.dumps(message))
+                    await asyncio.sleep(FRAME_DURATION_MS / 1000)
+                end_of_speech = now_ms()
+                await ws.send(json.dumps({'data': {'status': 2, 'format': 'audio/L16;rate=16000',
+                                                   'encoding': 'opus-wb', 'audio': ''}}))
+
+            sender = asyncio.ensure_future(send_audio())
+            text = ''
+            try:
+                async for data in ws:
+                    response = json.loads(data)
+                    if response['code'] != 0:
+                        print(f'round {round_index + 1}: error {response["code"]} {response["message"]}')
+                        break
+                    result = response['data'].get('result')
+                    if result:
+                        text = apply_result(sentences, result)
+                        if first_partial is None:
+                            first_partial = now_ms()
+                        print(f'  {text}')
+                    if response['data']['status'] == 2:
+                        final_ms.append(now_ms() - end_of_speech)
+                        break
+            finally:
+                sender.cancel()
+            if first_partial is not None:
+                first_partial_ms.append(first_partial - speech_start)
+            print(f'round {round_index + 1}: "{text}"')
+    print(f'connect ms p50 {percentile(connect_ms, 50):.0f}')
+    print(f'speech start -> first partial ms p50 {percentile(first_partial_ms, 50):.0f}')
+    print(f'end of speech -> final text ms p50 {percentile(final_ms, 50):.0f} p90 {percentile(final_ms, 90):.0f}')
+
+
+async def main():
+    parser = argparse.ArgumentParser(description='Local stub of the Xunfei streaming dictation API')
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=8091)
+    parser.add_argument('--transcripts', default=DEFAULT_TRANSCRIPTS, help='recorded transcripts (.jsonl)')
+    parser.add_argument('--packets-per-char', type=int, default=3,
+                        help='reveal one character every N packets for transcripts without hypotheses')
+    parser.add_argument('--final-delay', type=int, default=150, help='ms between the last frame and the final result')
+    parser.add_argument('--keep-alive', action='store_true', help='keep the connection after the final result')
+    parser.add_argument('--check-auth', action='store_true', help='require authorization, date and host in the URL')
+    parser.add_argument('--error-rate', type=float, default=0, help='probability of failing a session')
+    parser.add_argument('--ascii', action='store_true', help='escape non-ASCII text as \\uXXXX')
+    parser.add_argument('--save-dir', default='', help='save the received audio of every session as .p3')
+    parser.add_argument('--duration', type=float, default=0, help='exit after N seconds')
+    parser.add_argument('--client', action='store_true', help='stream --audio to --url like the device')
+    parser.add_argument('--url', default='ws://127.0.0.1:8091/v2/iat')
+    parser.add_argument('--audio', default=DEFAULT_AUDIO_FILE, help='client audio (.p3, 16 kHz opus, 60 ms)')
+    parser.add_argument('--packets', type=int, default=0, help='client: send only the first N packets')
+    parser.add_argument('--rounds', type=int, default=3)
+    parser.add_argument('--app-id', default='stub')
+    parser.add_argument('--api-key', default='')
+    parser.add_argument('--api-secret', default='')
+    args = parser.parse_args()
+
+    if args.client:
+        await run_client(args)
+        return
+
+    stub = SttStub(args)
+    server = await websockets.serve(stub.handle, args.host, args.port)
+    print(f'STT stub listening on ws://{args.host}:{args.port}/v2/iat with {len(stub.transcripts)} transcripts')
+    try:
+        if args.duration > 0:
+            await asyncio.sleep(args.duration)
+        else:
+            await asyncio.Future()
+    finally:
+        server.close()
+        stub.stats.report()
+
+
+if __name__ == '__main__':
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
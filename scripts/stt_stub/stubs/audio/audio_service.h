@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct AudioStreamPacket {
+    int sample_rate = 0;
+    int frame_duration = 0;
+    uint32_t timestamp = 0;
+    std::vector<uint8_t> payload;
+};
+
+// 只有发送队列：客户端按设备的节奏放入 Opus 包，XunfeiSttService 取出上传
+class AudioService {
+public:
+    void PushPacketToSendQueue(std::unique_ptr<AudioStreamPacket> packet) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        send_queue_.push_back(std::move(packet));
+    }
+
+    std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (send_queue_.empty()) {
+            return nullptr;
+        }
+        auto packet = std::move(send_queue_.front());
+        send_queue_.pop_front();
+        return packet;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<std::unique_ptr<AudioStreamPacket>> send_queue_;
+};
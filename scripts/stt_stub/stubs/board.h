@@ -0,0 +1,25 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "web_socket.h"
+
+// 只提供 XunfeiSttService 用到的部分，WebSocket 走主机的 socket
+class NetworkInterface {
+public:
+    std::unique_ptr<WebSocket> CreateWebSocket(int connect_id) {
+        (void)connect_id;
+        return std::make_unique<WebSocket>();
+    }
+};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+    NetworkInterface* GetNetwork() { return &network_; }
+
+private:
+    NetworkInterface network_;
+};
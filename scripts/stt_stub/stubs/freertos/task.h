@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include "FreeRTOS.h"
+
+// 任务用分离的 std::thread 代替，栈大小和优先级不起作用；任务函数返回即结束，vTaskDelete 什么也不做
+typedef void (*TaskFunction_t)(void* arg);
+typedef void* TaskHandle_t;
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+    UBaseType_t priority, TaskHandle_t* handle) {
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+    if (handle != nullptr) {
+        *handle = nullptr;
+    }
+    std::thread([function, arg]() {
+        function(arg);
+    }).detach();
+    return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t handle) {
+    (void)handle;
+}
+
+// 主机上一个 tick 就是一毫秒
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <openssl/evp.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+
+// 与 mbedtls 相同，dst 还要放下结尾的 '\0'
+inline int mbedtls_base64_encode(unsigned char* dst, size_t dst_len, size_t* written, const unsigned char* src,
+    size_t src_len) {
+    size_t needed = (src_len + 2) / 3 * 4;
+    if (dst_len < needed + 1) {
+        *written = needed + 1;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+    *written = EVP_EncodeBlock(dst, src, src_len);
+    return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+// 只有 GetSignedUrl 用到的 HMAC-SHA256，由主机的 OpenSSL 计算
+typedef enum {
+    MBEDTLS_MD_SHA256 = 6,
+} mbedtls_md_type_t;
+
+typedef struct mbedtls_md_info_t {
+    mbedtls_md_type_t type;
+} mbedtls_md_info_t;
+
+inline const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t type) {
+    static const mbedtls_md_info_t sha256 = {MBEDTLS_MD_SHA256};
+    return type == MBEDTLS_MD_SHA256 ? &sha256 : nullptr;
+}
+
+inline int mbedtls_md_hmac(const mbedtls_md_info_t* info, const unsigned char* key, size_t key_len,
+    const unsigned char* input, size_t input_len, unsigned char* output) {
+    if (info == nullptr) {
+        return -1;
+    }
+    unsigned int len = 0;
+    return HMAC(EVP_sha256(), key, key_len, input, input_len, output, &len) != nullptr ? 0 : -1;
+}
@@ -0,0 +1,242 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * 主机上的 WebSocket 客户端，接口与 esp-ml307 的 WebSocket 一致，只实现 XunfeiSttService 用到的部分：
+ * ws:// 地址，文本和二进制帧（含分片），回应 ping。接收在单独的线程中进行，OnData 和 OnDisconnected
+ * 在该线程中回调，与设备上的接收任务相同。
+ */
+class WebSocket {
+public:
+    static inline int connections = 0;  // 建立过的连接数，用来确认连接复用
+
+    ~WebSocket() { Close(); }
+
+    void SetHeader(const char* key, const char* value) { headers_[key] = value; }
+    void OnData(std::function<void(const char* data, size_t len, bool binary)> callback) { on_data_ = callback; }
+    void OnDisconnected(std::function<void()> callback) { on_disconnected_ = callback; }
+    bool IsConnected() const { return connected_; }
+
+    bool Connect(const char* url) {
+        std::string rest = url;
+        if (rest.rfind("ws://", 0) != 0) {
+            fprintf(stderr, "WebSocket: only ws:// is supported on the host, got %s\n", url);
+            return false;
+        }
+        rest = rest.substr(5);
+        std::string path = "/";
+        auto slash = rest.find('/');
+        if (slash != std::string::npos) {
+            path = rest.substr(slash);
+            rest = rest.substr(0, slash);
+        }
+        auto colon = rest.find(':');
+        std::string host = rest.substr(0, colon);
+        std::string port = colon == std::string::npos ? "80" : rest.substr(colon + 1);
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+            return false;
+        }
+        for (auto ai = result; ai != nullptr && fd_ < 0; ai = ai->ai_next) {
+            fd_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd_ >= 0 && connect(fd_, ai->ai_addr, ai->ai_addrlen) != 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        freeaddrinfo(result);
+        if (fd_ < 0) {
+            return false;
+        }
+
+        // 固定的 Sec-WebSocket-Key 就够了，服务端只检查格式
+        std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + rest + "\r\nUpgrade: websocket\r\n"
+            "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n";
+        for (auto& [key, value] : headers_) {
+            request += key + ": " + value + "\r\n";
+        }
+        request += "\r\n";
+        if (!SendAll(request.data(), request.size())) {
+            Close();
+            return false;
+        }
+        size_t end;
+        while ((end = buffer_.find("\r\n\r\n")) == std::string::npos) {
+            if (!Fill()) {
+                Close();
+                return false;
+            }
+        }
+        std::string status_line = buffer_.substr(0, buffer_.find("\r\n"));
+        buffer_.erase(0, end + 4);
+        if (status_line.find(" 101") == std::string::npos) {
+            fprintf(stderr, "WebSocket: handshake failed: %s\n", status_line.c_str());
+            Close();
+            return false;
+        }
+        connections++;
+        connected_ = true;
+        receive_thread_ = std::thread([this]() {
+            ReceiveLoop();
+        });
+        return true;
+    }
+
+    bool Send(const std::string& text) { return Send(text.data(), text.size(), false); }
+
+    // fin 为 false 时发出分片，后续分片以延续帧（opcode 0）发出，直到 fin 为 true 的最后一片
+    bool Send(const void* data, size_t len, bool binary = false, bool fin = true) {
+        uint8_t opcode = continuation_ ? 0x0 : (binary ? 0x2 : 0x1);
+        continuation_ = !fin;
+        return SendFrame(opcode, fin, (const uint8_t*)data, len);
+    }
+
+    void Close() {
+        closing_ = true;
+        if (fd_ >= 0) {
+            shutdown(fd_, SHUT_RDWR);
+        }
+        if (receive_thread_.joinable()) {
+            receive_thread_.join();
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        connected_ = false;
+    }
+
+private:
+    int fd_ = -1;
+    std::string buffer_;
+    std::map<std::string, std::string> headers_;
+    std::mutex send_mutex_;
+    std::thread receive_thread_;
+    std::atomic<bool> connected_ = false;
+    std::atomic<bool> closing_ = false;
+    bool continuation_ = false;
+    std::function<void(const char* data, size_t len, bool binary)> on_data_;
+    std::function<void()> on_disconnected_;
+
+    bool SendAll(const void* data, size_t len) {
+        auto p = (const char*)data;
+        while (len > 0) {
+            ssize_t n = send(fd_, p, len, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // 客户端发出的帧必须加掩码，掩码取 0 时载荷不变
+    bool SendFrame(uint8_t opcode, bool fin, const uint8_t* data, size_t len) {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        if (!connected_) {
+            return false;
+        }
+        std::string frame;
+        frame += (char)((fin ? 0x80 : 0x00) | opcode);
+        if (len < 126) {
+            frame += (char)(0x80 | len);
+        } else if (len < 65536) {
+            frame += (char)(0x80 | 126);
+            frame += (char)(len >> 8);
+            frame += (char)(len & 0xFF);
+        } else {
+            frame += (char)(0x80 | 127);
+            for (int i = 7; i >= 0; i--) {
+                frame += (char)((uint64_t)len >> (i * 8));
+            }
+        }
+        frame.append(4, '\0');
+        frame.append((const char*)data, len);
+        return SendAll(frame.data(), frame.size());
+    }
+
+    bool Fill() {
+        char chunk[4096];
+        ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, n);
+        return true;
+    }
+
+    bool Take(size_t len, std::string& out) {
+        while (buffer_.size() < len) {
+            if (!Fill()) {
+                return false;
+            }
+        }
+        out = buffer_.substr(0, len);
+        buffer_.erase(0, len);
+        return true;
+    }
+
+    void ReceiveLoop() {
+        std::string message;
+        bool binary = false;
+        std::string header;
+        while (Take(2, header)) {
+            bool fin = header[0] & 0x80;
+            uint8_t opcode = header[0] & 0x0F;
+            bool masked = header[1] & 0x80;
+            uint64_t len = header[1] & 0x7F;
+            std::string extra;
+            if (len == 126 || len == 127) {
+                if (!Take(len == 126 ? 2 : 8, extra)) {
+                    break;
+                }
+                len = 0;
+                for (unsigned char c : extra) {
+                    len = (len << 8) | c;
+                }
+            }
+            std::string mask, payload;
+            if ((masked && !Take(4, mask)) || !Take(len, payload)) {
+                break;
+            }
+            for (size_t i = 0; masked && i < payload.size(); i++) {
+                payload[i] ^= mask[i % 4];
+            }
+            if (opcode == 0x8) {
+                break;
+            } else if (opcode == 0x9) {
+                SendFrame(0xA, true, (const uint8_t*)payload.data(), payload.size());
+                continue;
+            } else if (opcode == 0xA) {
+                continue;
+            }
+            if (opcode != 0x0) {
+                message.clear();
+                binary = opcode == 0x2;
+            }
+            message += payload;
+            if (fin && on_data_) {
+                on_data_(message.data(), message.size(), binary);
+            }
+        }
+        connected_ = false;
+        if (!closing_ && on_disconnected_) {
+            on_disconnected_();
+        }
+    }
+};
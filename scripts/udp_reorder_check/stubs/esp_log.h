@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdio>
+
+// 检查只看回调和 stats()，日志全部去掉
+#define ESP_LOGE(tag, format, ...) do {} while (0)
+#define ESP_LOGW(tag, format, ...) do {} while (0)
+#define ESP_LOGI(tag, format, ...) do {} while (0)
+#define ESP_LOGD(tag, format, ...) do {} while (0)
@@ -0,0 +1,211 @@
+/*
+ * UdpReorderBuffer 行为检查
+ *
+ * 按 MqttProtocol 的方式接线（窗口 8 个包），用构造的序号序列检查：按序释放、乱序重排、已释放的重复包与
+ * 被跳过后才到的迟到包的区分、32 位序号回绕、等待超时后跳过空洞、MQTT_UDP_MAX_CONCEALED_FRAMES 个补帧
+ * 的上限和补帧的时间戳，以及序号大跳时的重新同步。有不满足的返回非零。
+ */
+
+#include "udp_reorder_buffer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define WINDOW 8
+#define HOLD_MS 20
+#define MAX_CONCEALED 3
+#define FRAME_DURATION_MS 60
+
+// 释放出来的包：sequence 来自载荷，补帧的载荷为空，记为 -1
+struct Released {
+    int64_t sequence;
+    uint32_t timestamp;
+};
+
+class Harness {
+public:
+    Harness(int max_concealed = MAX_CONCEALED) : buffer_(WINDOW, HOLD_MS, max_concealed) {
+        buffer_.OnPacket([this](std::unique_ptr<AudioStreamPacket> packet) {
+            int64_t sequence = -1;
+            if (packet->payload.size() == sizeof(uint32_t)) {
+                uint32_t value;
+                memcpy(&value, packet->payload.data(), sizeof(value));
+                sequence = value;
+            }
+            released.push_back({sequence, packet->timestamp});
+        });
+        buffer_.OnGap([this](uint32_t lost_count) {
+            gaps.push_back(lost_count);
+        });
+    }
+
+    // 时间戳与服务器一样按毫秒递增，timestamps 为 false 时模拟不带时间戳的服务器
+    void Push(uint32_t sequence, bool timestamps = true) {
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->sample_rate = 24000;
+        packet->frame_duration = FRAME_DURATION_MS;
+        packet->timestamp = timestamps ? 1000 + sequence * FRAME_DURATION_MS : 0;
+        packet->payload.resize(sizeof(sequence));
+        memcpy(packet->payload.data(), &sequence, sizeof(sequence));
+        buffer_.Push(sequence, std::move(packet));
+    }
+
+    bool Flush() { return buffer_.Flush(); }
+    const UdpReorderStats& stats() const { return buffer_.stats(); }
+
+    std::vector<int64_t> sequences() const {
+        std::vector<int64_t> result;
+        for (auto& r : released) {
+            result.push_back(r.sequence);
+        }
+        return result;
+    }
+
+    std::vector<Released> released;
+    std::vector<uint32_t> gaps;
+
+private:
+    UdpReorderBuffer buffer_;
+};
+
+static int failures = 0;
+
+static std::string Format(const std::vector<int64_t>& values) {
+    std::string text;
+    for (auto value : values) {
+        text += (text.empty() ? "" : " ") + std::to_string(value);
+    }
+    return "[" + text + "]";
+}
+
+static void Check(const char* name, bool ok, const std::string& detail = "") {
+    if (ok) {
+        printf("ok   %s\n", name);
+    } else {
+        printf("FAIL %s %s\n", name, detail.c_str());
+        failures++;
+    }
+}
+
+static void CheckSequences(const char* name, const Harness& harness, const std::vector<int64_t>& expected) {
+    auto actual = harness.sequences();
+    Check(name, actual == expected, "released " + Format(actual) + ", expected " + Format(expected));
+}
+
+static void WaitHold() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(HOLD_MS + 10));
+}
+
+int main() {
+    {
+        Harness h;
+        for (uint32_t i = 0; i < 10; i++) {
+            h.Push(i);
+        }
+        CheckSequences("in order", h, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+        Check("in order: nothing held or lost", !h.Flush() && h.gaps.empty() && h.stats().reordered == 0);
+    }
+    {
+        Harness h;
+        for (uint32_t i : {0, 2, 1, 3, 5, 4}) {
+            h.Push(i);
+        }
+        CheckSequences("reordered", h, {0, 1, 2, 3, 4, 5});
+        Check("reordered: counted", h.stats().reordered == 2 && h.gaps.empty(),
+            "reordered " + std::to_string(h.stats().reordered));
+    }
+    {
+        Harness h;
+        // 1 已经释放过，3 还在窗口里等 2
+        for (uint32_t i : {0, 1, 1, 3, 3, 2}) {
+            h.Push(i);
+        }
+        CheckSequences("duplicates", h, {0, 1, 2, 3});
+        Check("duplicates: counted, not late", h.stats().duplicated == 2 && h.stats().late_dropped == 0,
+            "duplicated " + std::to_string(h.stats().duplicated) + " late " + std::to_string(h.stats().late_dropped));
+    }
+    {
+        Harness h(0);
+        // 10 放不进 0 之后的窗口，1 和 2 被当作丢失跳过；之后才到的 1 是迟到，0 是重复
+        h.Push(0);
+        h.Push(10);
+        h.Push(1);
+        h.Push(0);
+        Check("late vs duplicate", h.stats().late_dropped == 1 && h.stats().duplicated == 1,
+            "late " + std::to_string(h.stats().late_dropped) + " duplicated " + std::to_string(h.stats().duplicated));
+        Check("window overflow skips the oldest", h.gaps == std::vector<uint32_t>{2} && h.stats().lost == 2,
+            "lost " + std::to_string(h.stats().lost));
+    }
+    {
+        Harness h;
+        for (uint32_t i : {0xFFFFFFFEu, 0u, 0xFFFFFFFFu, 1u, 2u}) {
+            h.Push(i);
+        }
+        CheckSequences("wraparound", h, {0xFFFFFFFEu, 0xFFFFFFFFu, 0, 1, 2});
+        Check("wraparound: no loss", h.gaps.empty() && h.stats().reordered == 1);
+        h.Push(0xFFFFFFFFu);
+        Check("wraparound: duplicate across the wrap", h.stats().duplicated == 1 && h.stats().late_dropped == 0);
+    }
+    {
+        Harness h;
+        h.Push(0);
+        h.Push(2);
+        bool held = h.Flush();
+        CheckSequences("hold: waits for the missing packet", h, {0});
+        Check("hold: still held before the timeout", held && h.gaps.empty());
+        WaitHold();
+        held = h.Flush();
+        CheckSequences("hold: released after the timeout", h, {0, -1, 2});
+        Check("hold: gap reported once", !held && h.gaps == std::vector<uint32_t>{1});
+        // 补帧的时间戳接在前一个包后面
+        Check("hold: concealment timestamp", h.released[1].timestamp == 1000 + 1 * FRAME_DURATION_MS,
+            "timestamp " + std::to_string(h.released[1].timestamp));
+    }
+    {
+        Harness h;
+        h.Push(0);
+        h.Push(6);
+        WaitHold();
+        h.Flush();
+        CheckSequences("conceal: capped", h, {0, -1, -1, -1, 6});
+        Check("conceal: stats", h.stats().lost == 5 && h.stats().concealed == MAX_CONCEALED,
+            "lost " + std::to_string(h.stats().lost) + " concealed " + std::to_string(h.stats().concealed));
+        bool timestamps = true;
+        for (int i = 1; i <= MAX_CONCEALED; i++) {
+            timestamps = timestamps && h.released[i].timestamp == 1000 + i * FRAME_DURATION_MS;
+        }
+        Check("conceal: timestamps continue from the last packet", timestamps);
+        // 一个空洞之后紧接着又一个：时间戳按跳过的序号数推进，与后面真实的包对得上
+        h.Push(8);
+        h.Push(7);
+        h.Push(10);
+        WaitHold();
+        h.Flush();
+        Check("conceal: second gap", h.released.size() == 9 && h.released[7].sequence == -1 &&
+            h.released[7].timestamp == 1000 + 9 * FRAME_DURATION_MS && h.released[8].sequence == 10);
+    }
+    {
+        Harness h;
+        h.Push(0, false);
+        h.Push(2, false);
+        WaitHold();
+        h.Flush();
+        Check("conceal: no timestamps from the server", h.released.size() == 3 && h.released[1].timestamp == 0);
+    }
+    {
+        Harness h;
+        h.Push(100);
+        h.Push(102);
+        h.Push(1000);
+        h.Push(1001);
+        CheckSequences("resync: held packets flushed in order", h, {100, 102, 1000, 1001});
+        Check("resync: no huge gap concealed", h.gaps.empty() && h.stats().concealed == 0);
+    }
+
+    printf("%s\n", failures == 0 ? "All checks passed" : "Some checks failed");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "http.h"
+
+// 只提供 PrivateVisionService 用到的部分，HTTP 走主机的 socket
+class NetworkInterface {
+public:
+    std::unique_ptr<Http> CreateHttp(int connect_id) {
+        (void)connect_id;
+        return std::make_unique<PosixHttp>();
+    }
+};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+    NetworkInterface* GetNetwork() { return &network_; }
+    std::string GetUuid() { return "vision-client"; }
+
+private:
+    NetworkInterface network_;
+};
@@ -0,0 +1,5 @@
+#pragma once
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
@@ -0,0 +1,9 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include "FreeRTOS.h"
+
+// 主机上一个 tick 就是一毫秒
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
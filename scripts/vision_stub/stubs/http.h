@@ -0,0 +1,282 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// 与 esp-ml307 的 Http 接口一致
+class Http {
+public:
+    virtual ~Http() = default;
+    virtual void SetTimeout(int timeout_ms) = 0;
+    virtual void SetHeader(const std::string& key, const std::string& value) = 0;
+    virtual void SetContent(std::string&& content) = 0;
+    virtual bool Open(const std::string& method, const std::string& url) = 0;
+    virtual void Close() = 0;
+    virtual int Read(char* buffer, size_t buffer_size) = 0;
+    virtual int Write(const char* buffer, size_t buffer_size) = 0;
+    virtual int GetStatusCode() = 0;
+    virtual std::string GetResponseHeader(const std::string& key) const = 0;
+    virtual size_t GetBodyLength() = 0;
+    virtual std::string ReadAll() = 0;
+};
+
+/*
+ * 主机上的 HTTP/1.1 客户端，只实现 PrivateVisionService 用到的部分：
+ * 分块或定长请求体、分块或定长回复，上一次回复读完且服务器没有关闭时 Open() 复用同一个 socket。
+ */
+class PosixHttp : public Http {
+public:
+    static inline int connections = 0;  // 建立过的 TCP 连接数，用来确认连接复用
+
+    ~PosixHttp() override { Close(); }
+
+    void SetTimeout(int timeout_ms) override { timeout_ms_ = timeout_ms; }
+    void SetHeader(const std::string& key, const std::string& value) override { headers_[key] = value; }
+    void SetContent(std::string&& content) override { content_ = std::move(content); }
+
+    bool Open(const std::string& method, const std::string& url) override {
+        std::string host, port = "80", path = "/";
+        if (url.rfind("http://", 0) != 0) {
+            return false;
+        }
+        auto rest = url.substr(7);
+        auto slash = rest.find('/');
+        if (slash != std::string::npos) {
+            path = rest.substr(slash);
+            rest = rest.substr(0, slash);
+        }
+        auto colon = rest.find(':');
+        host = rest.substr(0, colon);
+        if (colon != std::string::npos) {
+            port = rest.substr(colon + 1);
+        }
+
+        // 上一次回复没读完、服务器已经关闭或者换了主机时重新连接
+        if (fd_ >= 0 && (!response_done_ || host + ":" + port != peer_ || PeerClosed())) {
+            Close();
+        }
+        if (fd_ < 0 && !Connect(host, port)) {
+            return false;
+        }
+
+        chunked_request_ = headers_.count("Transfer-Encoding") && headers_["Transfer-Encoding"] == "chunked";
+        std::string request = method + " " + path + " HTTP/1.1\r\nHost: " + host + "\r\n";
+        for (auto& [key, value] : headers_) {
+            request += key + ": " + value + "\r\n";
+        }
+        if (!chunked_request_) {
+            request += "Content-Length: " + std::to_string(content_.size()) + "\r\n";
+        }
+        request += "\r\n" + content_;
+        content_.clear();
+        status_code_ = -1;
+        response_headers_.clear();
+        response_done_ = false;
+        return SendAll(request.data(), request.size());
+    }
+
+    void Close() override {
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        buffer_.clear();
+    }
+
+    int Write(const char* data, size_t len) override {
+        if (!chunked_request_) {
+            return SendAll(data, len) ? len : -1;
+        }
+        char size_line[16];
+        snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+        std::string chunk = size_line;
+        chunk.append(data, len);
+        chunk += "\r\n";
+        return SendAll(chunk.data(), chunk.size()) ? len : -1;
+    }
+
+    int GetStatusCode() override {
+        if (status_code_ < 0) {
+            status_code_ = ReadHeaders() ? status_code_ : 0;
+        }
+        return status_code_;
+    }
+
+    std::string GetResponseHeader(const std::string& key) const override {
+        std::string lower = key;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        auto it = response_headers_.find(lower);
+        return it == response_headers_.end() ? "" : it->second;
+    }
+
+    size_t GetBodyLength() override { return chunked_response_ ? 0 : remaining_; }
+
+    int Read(char* out, size_t size) override {
+        if (GetStatusCode() <= 0) {
+            return -1;
+        }
+        if (response_done_) {
+            return 0;
+        }
+        if (chunked_response_ && remaining_ == 0) {
+            std::string line;
+            if (!ReadLine(line)) {
+                return -1;
+            }
+            remaining_ = strtoul(line.c_str(), nullptr, 16);
+            if (remaining_ == 0) {
+                while (ReadLine(line) && !line.empty()) {
+                }
+                response_done_ = true;
+                return 0;
+            }
+        }
+        if (remaining_ == 0) {
+            response_done_ = true;
+            return 0;
+        }
+        if (buffer_.empty() && !Fill()) {
+            return -1;
+        }
+        size_t n = std::min({size, remaining_, buffer_.size()});
+        memcpy(out, buffer_.data(), n);
+        buffer_.erase(0, n);
+        remaining_ -= n;
+        if (chunked_response_ && remaining_ == 0) {
+            std::string crlf;
+            ReadLine(crlf);
+        } else if (remaining_ == 0) {
+            response_done_ = true;
+        }
+        return n;
+    }
+
+    std::string ReadAll() override {
+        std::string body;
+        char buffer[1024];
+        int n;
+        while ((n = Read(buffer, sizeof(buffer))) > 0) {
+            body.append(buffer, n);
+        }
+        return body;
+    }
+
+private:
+    int fd_ = -1;
+    std::string peer_;
+    int timeout_ms_ = 30000;
+    std::map<std::string, std::string> headers_;
+    std::string content_;
+    bool chunked_request_ = false;
+    int status_code_ = -1;
+    std::map<std::string, std::string> response_headers_;
+    bool chunked_response_ = false;
+    size_t remaining_ = 0;
+    bool response_done_ = true;
+    std::string buffer_;
+
+    bool Connect(const std::string& host, const std::string& port) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+            return false;
+        }
+        for (auto ai = result; ai != nullptr; ai = ai->ai_next) {
+            fd_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd_ >= 0) {
+                // 设备上 lwIP 的发送缓冲区只有十几 KB，写入很快就会等待对方确认，上传耗时才接近设备
+                int send_buffer = 8 * 1024;  // Linux 实际分配两倍
+                setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &send_buffer, sizeof(send_buffer));
+            }
+            if (fd_ >= 0 && connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0) {
+                break;
+            }
+            if (fd_ >= 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        freeaddrinfo(result);
+        if (fd_ < 0) {
+            return false;
+        }
+        timeval tv = {timeout_ms_ / 1000, (timeout_ms_ % 1000) * 1000};
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        peer_ = host + ":" + port;
+        connections++;
+        return true;
+    }
+
+    bool PeerClosed() {
+        char c;
+        ssize_t ret = recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+    }
+
+    bool SendAll(const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t ret = send(fd_, data, len, MSG_NOSIGNAL);
+            if (ret <= 0) {
+                return false;
+            }
+            data += ret;
+            len -= ret;
+        }
+        return true;
+    }
+
+    bool Fill() {
+        char buffer[1024];
+        ssize_t ret = recv(fd_, buffer, sizeof(buffer), 0);
+        if (ret <= 0) {
+            return false;
+        }
+        buffer_.append(buffer, ret);
+        return true;
+    }
+
+    bool ReadLine(std::string& line) {
+        size_t pos;
+        while ((pos = buffer_.find("\r\n")) == std::string::npos) {
+            if (!Fill()) {
+                return false;
+            }
+        }
+        line = buffer_.substr(0, pos);
+        buffer_.erase(0, pos + 2);
+        return true;
+    }
+
+    bool ReadHeaders() {
+        std::string line;
+        if (fd_ < 0 || !ReadLine(line) || line.size() < 12) {
+            return false;
+        }
+        status_code_ = atoi(line.c_str() + 9);
+        while (ReadLine(line) && !line.empty()) {
+            auto colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string key = line.substr(0, colon);
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            response_headers_[key] = value;
+        }
+        chunked_response_ = GetResponseHeader("Transfer-Encoding") == "chunked";
+        remaining_ = chunked_response_ ? 0 : strtoul(GetResponseHeader("Content-Length").c_str(), nullptr, 10);
+        response_done_ = !chunked_response_ && remaining_ == 0;
+        return true;
+    }
+};
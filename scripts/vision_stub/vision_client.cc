@@ -0,0 +1,158 @@
+// 主机端识图客户端：用 main/ 中真实的 PrivateVisionService 向桩服务器（或真实服务器）上传照片，
+// 检查分块上传、回复的增量解析、连接复用和重试
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "services/private_vision_service.h"
+
+static double NowMs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static double Percentile(std::vector<double> values, int p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+// 把回复逐字节喂给解析器，结果必须与一次喂完相同
+static bool SelfTest() {
+    struct Case {
+        const char* json;
+        const char* text;
+    } cases[] = {
+        {R"({"success": true, "text": "一只猫"})", "一只猫"},
+        {R"({"meta": {"text": "nested"}, "description": "outer"})", "outer"},
+        {R"({"question": "text", "result": "a\"b\\c\/d\ne"})", "a\"b\\c/d\ne"},
+        {R"({"text": "一只🐱"})", "一只🐱"},
+        {R"({"text": "\u4e00\u53EA\ud83d\udc31"})", "一只🐱"},
+        {R"({"list": ["text", "x"], "text": "ok", "description": "ignored"})", "ok"},
+        {R"({"success": false, "message": "no text"})", ""},
+    };
+    bool ok = true;
+    for (auto& c : cases) {
+        std::string last;
+        int callbacks = 0;
+        VisionResponseParser parser([&](const std::string& text) {
+            last = text;
+            callbacks++;
+        });
+        for (const char* p = c.json; *p; p++) {
+            parser.Feed(p, 1);
+        }
+        VisionResponseParser whole;
+        whole.Feed(c.json, strlen(c.json));
+        // 回调拿到的文字不能截断在多字节字符中间
+        bool complete = last.empty() || (uint8_t)last.back() < 0x80 || last == parser.text();
+        if (parser.text() != c.text || whole.text() != c.text || !complete ||
+            (c.text[0] != '\0' && last != c.text)) {
+            printf("FAIL %s -> \"%s\" (whole \"%s\", last callback \"%s\")\n", c.json, parser.text().c_str(),
+                whole.text().c_str(), last.c_str());
+            ok = false;
+        } else {
+            printf("ok   %s (%d callbacks)\n", c.json, callbacks);
+        }
+    }
+    return ok;
+}
+
+static void Usage(const char* name) {
+    printf("Usage: %s [--self-test] [--url URL] [--key KEY] [--rounds N] [--chunk BYTES] "
+        "[--question TEXT] [--prepare] photo.jpg...\n", name);
+}
+
+int main(int argc, char** argv) {
+    std::string url = "http://127.0.0.1:8090/vision/explain";
+    std::string key;
+    std::string question = "这是什么？";
+    int rounds = 1;
+    size_t chunk_size = 4096;
+    bool prepare = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--self-test") {
+            return SelfTest() ? 0 : 1;
+        } else if (arg == "--url" && i + 1 < argc) {
+            url = argv[++i];
+        } else if (arg == "--key" && i + 1 < argc) {
+            key = argv[++i];
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (arg == "--chunk" && i + 1 < argc) {
+            chunk_size = atoi(argv[++i]);
+        } else if (arg == "--question" && i + 1 < argc) {
+            question = argv[++i];
+        } else if (arg == "--prepare") {
+            prepare = true;
+        } else if (arg[0] == '-') {
+            Usage(argv[0]);
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::vector<uint8_t>> photos;
+    for (auto& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            printf("Cannot open %s\n", file.c_str());
+            return 1;
+        }
+        photos.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    PrivateVisionService service;
+    service.Initialize(url, key);
+    if (prepare) {
+        // 与设备上说话时提前连接一样，第一次请求不再等握手
+        double start = NowMs();
+        bool ok = service.Prepare();
+        printf("prepare %s in %.0f ms\n", ok ? "ok" : "failed", NowMs() - start);
+    }
+    std::vector<double> total_ms, first_text_ms;
+    int failures = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (auto& photo : photos) {
+            BufferJpegSource source(photo.data(), photo.size(), nullptr, chunk_size);
+            double start = NowMs();
+            double first_text = 0;
+            auto response = service.AnalyzeImage(source, question, [&](const std::string& text) {
+                if (first_text == 0) {
+                    first_text = NowMs();
+                }
+                printf("\r  %s", text.c_str());
+                fflush(stdout);
+            });
+            double end = NowMs();
+            printf("\n");
+            if (first_text == 0) {
+                failures++;
+                printf("  no text in response: %s\n", response.c_str());
+                continue;
+            }
+            total_ms.push_back(end - start);
+            first_text_ms.push_back(first_text - start);
+        }
+    }
+
+    int requests = rounds * (int)photos.size();
+    printf("==== %d requests, %d failed, %d TCP connections ====\n", requests, failures, PosixHttp::connections);
+    printf("first text ms p50 %.0f p90 %.0f\n", Percentile(first_text_ms, 50), Percentile(first_text_ms, 90));
+    printf("total ms      p50 %.0f p90 %.0f\n", Percentile(total_ms, 50), Percentile(total_ms, 90));
+    return failures == 0 ? 0 : 1;
+}
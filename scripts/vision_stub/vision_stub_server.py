@@ -0,0 +1,274 @@
+import argparse
+import asyncio
+import json
+import os
+import random
+import socket
+import time
+
+
+'''
+  A local stub of the private vision server used by PrivateVisionService.
+
+  It accepts `POST` with a multipart/form-data body (fields `question` and `file`), sent either
+  with Content-Length or chunked, keeps connections alive and streams the JSON answer back in
+  small chunked pieces so the incremental parser on the device can be watched at work.
+
+  Faults can be injected to exercise the retry path: 5xx answers, closing the connection after
+  the upload, closing idle connections, and delays before and during the answer. --bandwidth
+  reads the upload slowly to stand in for a weak Wi-Fi link.
+'''
+
+
+def now_ms():
+    return time.monotonic() * 1000
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+class Stats:
+    def __init__(self):
+        self.connections = 0
+        self.requests = 0
+        self.reused = 0
+        self.warmups = 0
+        self.failures_injected = 0
+        self.bad_requests = 0
+        self.upload_ms = []
+        self.image_sizes = []
+        self.chunk_sizes = []
+
+    def report(self):
+        print('==== vision stub report ====')
+        print(f'connections {self.connections}, requests {self.requests}, reused {self.reused}, '
+              f'warm-ups {self.warmups}')
+        print(f'injected failures {self.failures_injected}, bad requests {self.bad_requests}')
+        if self.upload_ms:
+            print(f'upload ms p50 {percentile(self.upload_ms, 50):.0f} p90 {percentile(self.upload_ms, 90):.0f} '
+                  f'max {max(self.upload_ms):.0f}')
+        if self.image_sizes:
+            print(f'image bytes avg {sum(self.image_sizes) / len(self.image_sizes):.0f} max {max(self.image_sizes)}')
+        if self.chunk_sizes:
+            print(f'request chunks {len(self.chunk_sizes)}, avg {sum(self.chunk_sizes) / len(self.chunk_sizes):.0f} bytes')
+
+
+class BadRequest(Exception):
+    pass
+
+
+async def read_exactly(reader, size, bandwidth):
+    ''' readexactly(), limited to bandwidth KB/s when set '''
+    if bandwidth <= 0:
+        return await reader.readexactly(size)
+    data = bytearray()
+    while len(data) < size:
+        piece = await reader.readexactly(min(1024, size - len(data)))
+        data += piece
+        await asyncio.sleep(len(piece) / (bandwidth * 1024))
+    return bytes(data)
+
+
+async def read_body(reader, headers, stats, bandwidth=0):
+    ''' Returns the body and the time the first body byte arrived '''
+    if headers.get('transfer-encoding', '').lower() == 'chunked':
+        body = bytearray()
+        first_byte = None
+        while True:
+            line = await reader.readline()
+            if first_byte is None:
+                first_byte = now_ms()
+            size = int(line.split(b';')[0].strip() or b'0', 16)
+            if size == 0:
+                # Trailers end with an empty line
+                while (await reader.readline()).strip():
+                    pass
+                return bytes(body), first_byte
+            body += await read_exactly(reader, size, bandwidth)
+            stats.chunk_sizes.append(size)
+            if await reader.readexactly(2) != b'\r\n':
+                raise BadRequest('chunk not terminated by CRLF')
+    length = int(headers.get('content-length', '0'))
+    first_byte = now_ms()
+    return await read_exactly(reader, length, bandwidth), first_byte
+
+
+def parse_multipart(body, content_type):
+    if 'boundary=' not in content_type:
+        raise BadRequest('no multipart boundary')
+    boundary = content_type.split('boundary=', 1)[1].strip().strip('"').encode()
+    fields = {}
+    for part in body.split(b'--' + boundary):
+        if not part or part.startswith(b'--'):
+            continue
+        part = part[2:] if part.startswith(b'\r\n') else part
+        if part.endswith(b'\r\n'):
+            part = part[:-2]
+        head, _, value = part.partition(b'\r\n\r\n')
+        name = None
+        for line in head.decode(errors='replace').split('\r\n'):
+            if line.lower().startswith('content-disposition:') and 'name="' in line:
+                name = line.split('name="', 1)[1].split('"', 1)[0]
+        if name:
+            fields[name] = value
+    return fields
+
+
+class VisionStub:
+    def __init__(self, args):
+        self.args = args
+        self.stats = Stats()
+        self.fail_remaining = args.fail_first
+
+    def answer(self, question, image):
+        text = self.args.answer or f'这是一张 {len(image)} 字节的照片。你问的是：{question}'
+        return json.dumps({'success': True, 'text': text, 'question': question}, ensure_ascii=self.args.ascii)
+
+    async def send_chunked(self, writer, data):
+        piece = self.args.piece_size
+        for i in range(0, len(data), piece):
+            chunk = data[i:i + piece]
+            writer.write(f'{len(chunk):x}\r\n'.encode() + chunk + b'\r\n')
+            await writer.drain()
+            if self.args.piece_delay > 0:
+                await asyncio.sleep(self.args.piece_delay / 1000)
+        writer.write(b'0\r\n\r\n')
+        await writer.drain()
+
+    async def handle(self, reader, writer):
+        peer = writer.get_extra_info('peername')
+        self.stats.connections += 1
+        served = 0
+        try:
+            while True:
+                try:
+                    timeout = self.args.idle_timeout if self.args.idle_timeout > 0 else None
+                    request_line = await asyncio.wait_for(reader.readline(), timeout)
+                except asyncio.TimeoutError:
+                    print(f'{peer} idle, closing')
+                    break
+                if not request_line:
+                    break
+                headers = {}
+                while True:
+                    line = (await reader.readline()).decode(errors='replace').strip()
+                    if not line:
+                        break
+                    key, _, value = line.partition(':')
+                    headers[key.strip().lower()] = value.strip()
+
+                if request_line.startswith(b'OPTIONS '):
+                    # Connection warm-up from PrivateVisionService::Prepare(), the connection stays open
+                    await read_body(reader, headers, self.stats)
+                    self.stats.warmups += 1
+                    served += 1
+                    print(f'{peer} warm-up {request_line.decode().strip()}')
+                    writer.write(b'HTTP/1.1 204 No Content\r\nAllow: POST, OPTIONS\r\nConnection: keep-alive\r\n\r\n')
+                    await writer.drain()
+                    continue
+
+                try:
+                    body, first_byte = await read_body(reader, headers, self.stats, self.args.bandwidth)
+                    fields = parse_multipart(body, headers.get('content-type', ''))
+                    image = fields.get('file', b'')
+                    if not image.startswith(b'\xff\xd8') or not image.endswith(b'\xff\xd9'):
+                        raise BadRequest('file is not a complete JPEG')
+                except (BadRequest, ValueError) as e:
+                    self.stats.bad_requests += 1
+                    print(f'{peer} bad request: {e}')
+                    writer.write(b'HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n')
+                    await writer.drain()
+                    break
+                upload_ms = now_ms() - first_byte
+                question = fields.get('question', b'').decode(errors='replace')
+
+                self.stats.requests += 1
+                if served > 0:
+                    self.stats.reused += 1
+                served += 1
+                self.stats.upload_ms.append(upload_ms)
+                self.stats.image_sizes.append(len(image))
+                print(f'{peer} #{served} {request_line.decode().strip()} image {len(image)} bytes, '
+                      f'upload {upload_ms:.0f} ms, question: {question}')
+                if self.args.save_dir:
+                    os.makedirs(self.args.save_dir, exist_ok=True)
+                    with open(os.path.join(self.args.save_dir, f'{self.stats.requests:04d}.jpg'), 'wb') as f:
+                        f.write(image)
+
+                if self.args.delay > 0:
+                    await asyncio.sleep(self.args.delay / 1000)
+
+                if self.fail_remaining > 0 or random.random() < self.args.fail_rate:
+                    self.fail_remaining = max(0, self.fail_remaining - 1)
+                    self.stats.failures_injected += 1
+                    print(f'{peer} injecting 503')
+                    writer.write(b'HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n')
+                    await writer.drain()
+                    continue
+
+                if random.random() < self.args.drop_rate:
+                    self.stats.failures_injected += 1
+                    print(f'{peer} injecting connection drop')
+                    break
+
+                close = self.args.close_every > 0 and served % self.args.close_every == 0
+                data = self.answer(question, image).encode()
+                writer.write(b'HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n'
+                             b'Transfer-Encoding: chunked\r\n' +
+                             (b'Connection: close\r\n' if close else b'Connection: keep-alive\r\n') + b'\r\n')
+                await self.send_chunked(writer, data)
+                if close:
+                    break
+        except (asyncio.IncompleteReadError, ConnectionError) as e:
+            print(f'{peer} connection lost: {e}')
+        finally:
+            writer.close()
+
+
+async def main():
+    parser = argparse.ArgumentParser(description='Local stub of the private vision server')
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=8090)
+    parser.add_argument('--answer', default='', help='fixed answer text')
+    parser.add_argument('--ascii', action='store_true', help='escape non-ASCII text as \\uXXXX')
+    parser.add_argument('--delay', type=int, default=0, help='ms before the answer starts')
+    parser.add_argument('--piece-size', type=int, default=16, help='bytes per answer chunk')
+    parser.add_argument('--piece-delay', type=int, default=50, help='ms between answer chunks')
+    parser.add_argument('--fail-first', type=int, default=0, help='answer the first N requests with 503')
+    parser.add_argument('--fail-rate', type=float, default=0, help='probability of a 503 answer')
+    parser.add_argument('--drop-rate', type=float, default=0, help='probability of closing without an answer')
+    parser.add_argument('--close-every', type=int, default=0, help='send Connection: close every N requests')
+    parser.add_argument('--idle-timeout', type=float, default=0, help='close connections idle for N seconds')
+    parser.add_argument('--bandwidth', type=float, default=0, help='read request bodies at N KB/s')
+    parser.add_argument('--save-dir', default='', help='save received images here')
+    parser.add_argument('--duration', type=float, default=0, help='exit after N seconds')
+    args = parser.parse_args()
+
+    stub = VisionStub(args)
+    if args.bandwidth > 0:
+        # Small buffers so the throttled reads push back on the sender instead of piling up in the kernel
+        sock = socket.create_server((args.host, args.port))
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+        server = await asyncio.start_server(stub.handle, sock=sock, limit=4096)
+    else:
+        server = await asyncio.start_server(stub.handle, args.host, args.port)
+    print(f'vision stub listening on {args.host}:{args.port}')
+    try:
+        async with server:
+            if args.duration > 0:
+                await asyncio.sleep(args.duration)
+            else:
+                await server.serve_forever()
+    finally:
+        stub.stats.report()
+
+
+if __name__ == '__main__':
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass